@@ -9,6 +9,7 @@ test_env = env.Clone()
 test_env['LIBS'] = [env['MAPNIK_NAME']]
 test_env.AppendUnique(LIBS=copy(env['LIBMAPNIK_LIBS']))
 test_env.AppendUnique(LIBS='mapnik-wkt')
+test_env.AppendUnique(LIBS='mapnik-json')
 if env['PLATFORM'] == 'Linux':
     test_env.AppendUnique(LIBS='dl')
     test_env.AppendUnique(LIBS='rt')
@@ -48,6 +49,9 @@ benchmarks = [
     "test_quad_tree.cpp",
     "test_noop_rendering.cpp",
     "test_getline.cpp",
+    "test_composite.cpp",
+    "test_geojson_parse.cpp",
+    "test_rule_filters.cpp",
 #    "test_numeric_cast_vs_static_cast.cpp",
 ]
 for cpp_test in benchmarks:
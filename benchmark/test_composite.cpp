@@ -0,0 +1,62 @@
+#include "bench_framework.hpp"
+#include <mapnik/image.hpp>
+#include <mapnik/image_compositing.hpp>
+#include <mapnik/util/simd_composite.hpp>
+
+class test : public benchmark::test_case
+{
+    mapnik::util::simd_level level_;
+    mapnik::composite_mode_e mode_;
+    float opacity_;
+    mapnik::image_rgba8 src_;
+    mapnik::image_rgba8 dst_;
+public:
+    test(mapnik::parameters const& params, mapnik::util::simd_level level)
+     : test_case(params),
+       level_(level),
+       mode_(*mapnik::comp_op_from_string(*params.get<std::string>("mode", "src-over"))),
+       opacity_(*params.get<double>("opacity", 1.0)),
+       src_(1024, 1024, true, true),
+       dst_(1024, 1024, true, true)
+    {
+        for (unsigned y = 0; y < src_.height(); ++y)
+        {
+            for (unsigned x = 0; x < src_.width(); ++x)
+            {
+                unsigned a = (x * y) & 0xff;
+                src_(x, y) = (a << 24) | (((x * a) >> 8) & 0xff) << 8 | ((y * a) >> 8);
+                dst_(x, y) = 0xff000000 | (x & 0xff) << 16 | (y & 0xff);
+            }
+        }
+    }
+    bool validate() const
+    {
+        return level_ <= mapnik::util::cpu_simd_level();
+    }
+    bool operator()() const
+    {
+        mapnik::util::set_composite_simd_level(level_);
+        mapnik::image_rgba8 dst(dst_);
+        for (std::size_t i=0;i<iterations_;++i) {
+            mapnik::composite(dst, src_, mode_, opacity_, 0, 0);
+        }
+        mapnik::util::set_composite_simd_level(mapnik::util::cpu_simd_level());
+        return true;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    using mapnik::util::simd_level;
+    benchmark::sequencer seq(argc, argv);
+    seq.run<test>("composite agg", simd_level::none);
+    if (mapnik::util::cpu_simd_level() >= simd_level::sse41)
+    {
+        seq.run<test>("composite sse4.1", simd_level::sse41);
+    }
+    if (mapnik::util::cpu_simd_level() >= simd_level::avx2)
+    {
+        seq.run<test>("composite avx2", simd_level::avx2);
+    }
+    return seq.done();
+}
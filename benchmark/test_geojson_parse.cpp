@@ -0,0 +1,119 @@
+#include "bench_framework.hpp"
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/json/feature_grammar.hpp>
+#include <mapnik/json/feature_parser.hpp>
+
+namespace {
+
+std::string default_feature()
+{
+    std::string json = R"({"type":"Feature","properties":{"name":"Main Street","lanes":2,"oneway":false,)"
+        R"("speed":50.5,"tags":["residential","paved"]},"geometry":{"type":"Polygon","coordinates":[[)";
+    for (int i = 0; i < 100; ++i)
+    {
+        json += "[" + std::to_string(14.4 + i * 0.001) + "," + std::to_string(50.1 + (i % 7) * 0.001) + "],";
+    }
+    json += "[14.4,50.1]]]}}";
+    return json;
+}
+
+}
+
+class test_grammar : public benchmark::test_case
+{
+public:
+    std::string json_;
+    test_grammar(mapnik::parameters const& params)
+     : test_case(params),
+       json_(default_feature()) {}
+
+    bool parse(mapnik::feature_impl & feature) const
+    {
+        static const mapnik::transcoder tr("utf8");
+        static const mapnik::json::feature_grammar<char const*, mapnik::feature_impl> grammar(tr);
+        boost::spirit::standard::space_type space;
+        char const* start = json_.c_str();
+        char const* end = start + json_.size();
+        return boost::spirit::qi::phrase_parse(start, end, (grammar)(boost::phoenix::ref(feature)), space)
+            && start == end;
+    }
+
+    bool validate() const
+    {
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        return parse(*feature) && feature->get("lanes") == mapnik::value_integer(2);
+    }
+
+    bool operator()() const
+    {
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        for (std::size_t i = 0; i < iterations_; ++i)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+            if (!parse(*feature)) return false;
+        }
+        return true;
+    }
+};
+
+class test_parser : public benchmark::test_case
+{
+public:
+    std::string json_;
+    test_parser(mapnik::parameters const& params)
+     : test_case(params),
+       json_(default_feature()) {}
+
+    bool parse(mapnik::feature_impl & feature) const
+    {
+        static const mapnik::transcoder tr("utf8");
+        char const* start = json_.c_str();
+        char const* end = start + json_.size();
+        return mapnik::json::parse_feature(start, end, feature, tr) && start == end;
+    }
+
+    bool validate() const
+    {
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        return parse(*feature) && feature->get("lanes") == mapnik::value_integer(2);
+    }
+
+    bool operator()() const
+    {
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        for (std::size_t i = 0; i < iterations_; ++i)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+            if (!parse(*feature)) return false;
+        }
+        return true;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    int return_value = 0;
+    try
+    {
+        mapnik::parameters params;
+        benchmark::handle_args(argc,argv,params);
+        {
+            test_grammar test_runner(params);
+            return_value = return_value | run(test_runner,"geojson feature_grammar");
+        }
+        {
+            test_parser test_runner2(params);
+            return_value = return_value | run(test_runner2,"geojson parse_feature");
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        std::clog << ex.what() << "\n";
+        return -1;
+    }
+    return return_value;
+}
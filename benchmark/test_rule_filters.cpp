@@ -0,0 +1,165 @@
+#include "bench_framework.hpp"
+#include <mapnik/unicode.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_evaluator.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/filter_program.hpp>
+
+namespace {
+
+// filters of a road layer style, rules share attribute comparisons
+std::vector<mapnik::expression_ptr> make_filters()
+{
+    std::vector<mapnik::expression_ptr> filters;
+    std::vector<std::string> classes = {"motorway", "trunk", "primary", "secondary", "tertiary",
+                                        "residential", "service", "track", "path", "footway"};
+    for (auto const& c : classes)
+    {
+        filters.push_back(mapnik::parse_expression("[class] = '" + c + "' and [tunnel] = 1"));
+        filters.push_back(mapnik::parse_expression("[class] = '" + c + "' and [bridge] = 1"));
+        filters.push_back(mapnik::parse_expression("[class] = '" + c + "' and [oneway] = 1 and [layer] > 0"));
+        filters.push_back(mapnik::parse_expression("[class] = '" + c + "' and not ([tunnel] = 1 or [bridge] = 1)"));
+        filters.push_back(mapnik::parse_expression("[class] = '" + c + "' and [mapnik::geometry_type] = linestring"));
+    }
+    return filters;
+}
+
+std::vector<mapnik::feature_ptr> make_features()
+{
+    static const mapnik::transcoder tr("utf8");
+    std::vector<mapnik::feature_ptr> features;
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    std::vector<std::string> classes = {"primary", "residential", "footway", "service", "rail"};
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+        feature->put_new("class", tr.transcode(classes[i % classes.size()].c_str()));
+        feature->put_new("tunnel", mapnik::value_integer(i % 7 == 0));
+        feature->put_new("bridge", mapnik::value_integer(i % 5 == 0));
+        feature->put_new("oneway", mapnik::value_integer(i % 2));
+        feature->put_new("layer", mapnik::value_integer(i % 3 - 1));
+        feature->put_new("name", tr.transcode("Main Street"));
+        features.push_back(feature);
+    }
+    return features;
+}
+
+}
+
+class test_evaluate : public benchmark::test_case
+{
+public:
+    std::vector<mapnik::expression_ptr> filters_;
+    std::vector<mapnik::feature_ptr> features_;
+    test_evaluate(mapnik::parameters const& params)
+     : test_case(params),
+       filters_(make_filters()),
+       features_(make_features()) {}
+
+    std::size_t count() const
+    {
+        mapnik::attributes vars;
+        std::size_t matches = 0;
+        for (auto const& feature : features_)
+        {
+            for (auto const& filter : filters_)
+            {
+                mapnik::value result = mapnik::util::apply_visitor(
+                    mapnik::evaluate<mapnik::feature_impl, mapnik::value, mapnik::attributes>(*feature, vars), *filter);
+                if (result.to_bool()) ++matches;
+            }
+        }
+        return matches;
+    }
+
+    bool validate() const
+    {
+        return count() > 0;
+    }
+
+    bool operator()() const
+    {
+        for (std::size_t i = 0; i < iterations_; ++i)
+        {
+            if (count() == 0) return false;
+        }
+        return true;
+    }
+};
+
+class test_filter_program : public benchmark::test_case
+{
+public:
+    std::vector<mapnik::expression_ptr> filters_;
+    std::vector<mapnik::feature_ptr> features_;
+    mapnik::filter_program program_;
+    std::vector<std::size_t> indices_;
+    test_filter_program(mapnik::parameters const& params)
+     : test_case(params),
+       filters_(make_filters()),
+       features_(make_features()),
+       program_(),
+       indices_()
+    {
+        for (auto const& filter : filters_)
+        {
+            indices_.push_back(program_.compile(*filter));
+        }
+    }
+
+    std::size_t count() const
+    {
+        mapnik::attributes vars;
+        mapnik::filter_evaluator evaluator(program_, vars);
+        std::size_t matches = 0;
+        for (auto const& feature : features_)
+        {
+            evaluator.set_feature(*feature);
+            for (std::size_t index : indices_)
+            {
+                if (evaluator.test(index)) ++matches;
+            }
+        }
+        return matches;
+    }
+
+    bool validate() const
+    {
+        test_evaluate expected(mapnik::parameters{});
+        return count() == expected.count();
+    }
+
+    bool operator()() const
+    {
+        for (std::size_t i = 0; i < iterations_; ++i)
+        {
+            if (count() == 0) return false;
+        }
+        return true;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    int return_value = 0;
+    try
+    {
+        mapnik::parameters params;
+        benchmark::handle_args(argc,argv,params);
+        {
+            test_evaluate test_runner(params);
+            return_value = return_value | run(test_runner,"rule filters evaluate");
+        }
+        {
+            test_filter_program test_runner2(params);
+            return_value = return_value | run(test_runner2,"rule filters filter_program");
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        std::clog << ex.what() << "\n";
+        return -1;
+    }
+    return return_value;
+}
@@ -24,9 +24,9 @@
 #define MAPNIK_AGG_RASTERIZER_HPP
 
 // mapnik
+#include <mapnik/box2d.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
-
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
 #include "agg_rasterizer_scanline_aa.h"
@@ -34,7 +34,41 @@
 
 namespace mapnik {
 
-struct rasterizer :  agg::rasterizer_scanline_aa<agg::rasterizer_sl_clip_int_sat>, util::noncopyable {};
+struct rasterizer :  agg::rasterizer_scanline_aa<agg::rasterizer_sl_clip_int_sat>, util::noncopyable
+{
+    using base_type = agg::rasterizer_scanline_aa<agg::rasterizer_sl_clip_int_sat>;
+
+    // Hides base_type::rewind_scanlines(), agg::render_scanlines() and friends
+    // are templates calling it on the static type, so everything rendered
+    // through this rasterizer extends the painted extent.
+    bool rewind_scanlines()
+    {
+        if (!base_type::rewind_scanlines()) return false;
+        painted_extent_.expand_to_include(box2d<int>(min_x(), min_y(), max_x() + 1, max_y() + 1));
+        return true;
+    }
+
+    // Pixels written into the target buffer without scanlines
+    // (blits of images, glyphs, ...) have to be marked explicitly.
+    void mark_painted(box2d<int> const& box)
+    {
+        if (box.valid()) painted_extent_.expand_to_include(box);
+    }
+
+    // Union of all pixels touched since the last reset, max coordinates are exclusive.
+    box2d<int> const& painted_extent() const
+    {
+        return painted_extent_;
+    }
+
+    void reset_painted_extent()
+    {
+        painted_extent_ = box2d<int>();
+    }
+
+private:
+    box2d<int> painted_extent_;
+};
 
 }
 
@@ -36,6 +36,7 @@
 #include <mapnik/symbolizer_enumerations.hpp>
 #include <mapnik/renderer_common.hpp>
 #include <mapnik/image_util.hpp>
+#include <mapnik/image_pool.hpp>
 // stl
 #include <memory>
 #include <stack>
@@ -70,12 +71,21 @@ public:
     {
     }
 
+    // buffers are borrowed from the image pool
     T & push()
     {
-        this->emplace(width_, height_);
+        this->emplace(image_pool<typename T::pixel>::acquire(width_, height_));
         return this->top();
     }
 
+    // returns the top buffer to the pool, pixels outside of the dirty
+    // extent were left transparent
+    void pop(box2d<int> const& dirty)
+    {
+        image_pool<typename T::pixel>::release(std::move(this->top()), dirty);
+        std::stack<T>::pop();
+    }
+
 private:
     const std::size_t width_;
     const std::size_t height_;
@@ -187,16 +197,23 @@ protected:
     void debug_draw_box(box2d<double> const& extent,
                         double x, double y, double angle = 0.0);
     void draw_geo_extent(box2d<double> const& extent,mapnik::color const& color);
+    // marks the whole current buffer as painted, for output
+    // which bypasses the extent tracking of ras_ptr
+    void mark_painted();
 
 private:
     std::stack<std::reference_wrapper<buffer_type>> buffers_;
+    // painted part of each buffer on buffers_, pixels outside are transparent
+    std::stack<box2d<int>> painted_regions_;
     buffer_stack<buffer_type> internal_buffers_;
     std::unique_ptr<buffer_type> inflated_buffer_;
+    box2d<int> inflated_painted_;
     const std::unique_ptr<rasterizer> ras_ptr;
     gamma_method_enum gamma_method_;
     double gamma_;
     renderer_common common_;
     void setup(Map const & m, buffer_type & pixmap);
+    box2d<int> & painted_region();
 };
 
 extern template class MAPNIK_DECL agg_renderer<image<rgba8_t>>;
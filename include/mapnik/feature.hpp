@@ -80,6 +80,7 @@ public:
     }
 
     inline size_type size() const { return mapping_.size(); }
+    inline const_iterator find(key_type const& name) const { return mapping_.find(name); }
     inline const_iterator begin() const { return mapping_.begin();}
     inline const_iterator end() const { return mapping_.end();}
 
@@ -92,6 +93,19 @@ using context_ptr = std::shared_ptr<context_type>;
 
 static const value default_feature_value{};
 
+// Decodes attribute values of features from the raw record of a datasource
+// when they are read for the first time, see feature_impl::set_attribute_decoder.
+class MAPNIK_DECL attribute_decoder
+{
+public:
+    virtual ~attribute_decoder() {}
+    // Decodes the attribute at index of the feature context, val is left
+    // untouched if the record has no value for it.
+    virtual void decode(char const* record, std::size_t index, value & val) const = 0;
+};
+
+using attribute_decoder_ptr = std::shared_ptr<attribute_decoder const>;
+
 class MAPNIK_DECL feature_impl : private util::noncopyable
 {
     friend class feature_kv_iterator;
@@ -106,7 +120,10 @@ public:
         ctx_(ctx),
         data_(ctx_->mapping_.size()),
         geom_(geometry::geometry_empty()),
-        raster_() {}
+        raster_(),
+        decoder_(),
+        record_(nullptr),
+        pending_() {}
 
     inline mapnik::value_integer id() const { return id_;}
     inline void set_id(mapnik::value_integer _id) { id_ = _id;}
@@ -129,6 +146,7 @@ public:
             && itr->second < data_.size())
         {
             data_[itr->second] = std::move(val);
+            if (itr->second < pending_.size()) pending_[itr->second] = false;
         }
         else
         {
@@ -136,6 +154,18 @@ public:
         }
     }
 
+    // Sets the value at index of the context mapping, as found by
+    // context_type::find, without looking up the key.
+    inline void put_at(std::size_t index, value && val)
+    {
+        if (index >= data_.size())
+        {
+            throw std::out_of_range("Attribute index out of range");
+        }
+        data_[index] = std::move(val);
+        if (index < pending_.size()) pending_[index] = false;
+    }
+
     inline void put_new(context_type::key_type const& key, value && val)
     {
         context_type::map_type::const_iterator itr = ctx_->mapping_.find(key);
@@ -143,6 +173,7 @@ public:
             && itr->second < data_.size())
         {
             data_[itr->second] = std::move(val);
+            if (itr->second < pending_.size()) pending_[itr->second] = false;
         }
         else
         {
@@ -169,7 +200,14 @@ public:
     inline value_type const& get(std::size_t index) const
     {
         if (index < data_.size())
+        {
+            if (index < pending_.size() && pending_[index])
+            {
+                pending_[index] = false;
+                decoder_->decode(record_, index, data_[index]);
+            }
             return data_[index];
+        }
         return default_feature_value;
     }
 
@@ -180,12 +218,37 @@ public:
 
     inline cont_type const& get_data() const
     {
+        decode_attributes();
         return data_;
     }
 
     inline void set_data(cont_type const& data)
     {
         data_ = data;
+        pending_.clear();
+    }
+
+    // Attributes are decoded from record by decoder when they are read for
+    // the first time and kept in the feature. The decoder has to keep the
+    // record alive. Decoding modifies the feature, so a feature shared
+    // between threads must have its attributes decoded before.
+    inline void set_attribute_decoder(attribute_decoder_ptr const& decoder, char const* record)
+    {
+        decoder_ = decoder;
+        record_ = record;
+        pending_.assign(data_.size(), true);
+    }
+
+    inline void decode_attributes() const
+    {
+        for (std::size_t index = 0; index < pending_.size(); ++index)
+        {
+            if (pending_[index])
+            {
+                pending_[index] = false;
+                decoder_->decode(record_, index, data_[index]);
+            }
+        }
     }
 
     inline context_ptr context() const
@@ -193,6 +256,11 @@ public:
         return ctx_;
     }
 
+    inline context_type const& get_context() const
+    {
+        return *ctx_;
+    }
+
     inline void set_geometry(geometry::geometry<double> && geom)
     {
         geom_ = std::move(geom);
@@ -242,13 +310,14 @@ public:
             std::size_t index = kv.second;
             if (index < data_.size())
             {
-                if (data_[kv.second] == mapnik::value_null())
+                value_type const& val = get(index);
+                if (val == mapnik::value_null())
                 {
                     ss << "  " << kv.first  << ":null" << std::endl;
                 }
                 else
                 {
-                    ss << "  " << kv.first  << ":" <<  data_[kv.second] << std::endl;
+                    ss << "  " << kv.first  << ":" <<  val << std::endl;
                 }
             }
         }
@@ -259,9 +328,13 @@ public:
 private:
     mapnik::value_integer id_;
     context_ptr ctx_;
-    cont_type data_;
+    mutable cont_type data_;
     geometry::geometry<double> geom_;
     raster_ptr raster_;
+    attribute_decoder_ptr decoder_;
+    char const* record_;
+    // attributes still to be decoded
+    mutable std::vector<bool> pending_;
 };
 
 
@@ -0,0 +1,116 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_FEATURE_CACHE_HPP
+#define MAPNIK_FEATURE_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/box2d.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/lru_cache.hpp>
+
+// stl
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+class layer;
+
+struct feature_cache_key
+{
+    std::string layer;
+    std::size_t query_hash;
+    box2d<double> bbox;
+
+    std::size_t hash() const;
+    bool operator==(feature_cache_key const& other) const
+    {
+        return query_hash == other.query_hash &&
+            bbox == other.bbox &&
+            layer == other.layer;
+    }
+};
+
+struct feature_cache_key_hash
+{
+    std::size_t operator()(feature_cache_key const& key) const noexcept
+    {
+        return key.hash();
+    }
+};
+
+// Decoded features of one datasource query with their envelopes.
+struct cached_features
+{
+    using clock = std::chrono::steady_clock;
+
+    std::vector<feature_ptr> features;
+    std::vector<box2d<double>> envelopes;
+    clock::time_point created;
+};
+
+using cached_features_ptr = std::shared_ptr<const cached_features>;
+
+// Process wide cache of decoded features shared between renders, used by
+// layers with cache-features="true". Query extents are expanded to a grid
+// of power of two cells, so queries of neighbouring tiles at the same
+// zoom level resolve to the same entry; features are then filtered by the
+// original query extent. The cache is disabled until a capacity
+// (approximate size in bytes) is set.
+class MAPNIK_DECL feature_cache :
+        public singleton<feature_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<feature_cache>;
+    using cache_type = util::sharded_lru_cache<feature_cache_key, cached_features_ptr, feature_cache_key_hash>;
+    cache_type cache_;
+    std::atomic<std::chrono::steady_clock::rep> ttl_;
+    feature_cache();
+public:
+    static void set_capacity(std::size_t bytes);
+    // Entries older than ttl are queried again, zero disables expiration.
+    static void set_ttl(std::chrono::steady_clock::duration ttl);
+    bool enabled() const { return cache_.enabled(); }
+    featureset_ptr features(layer const& lay,
+                            datasource const& ds,
+                            query const& q,
+                            processor_context_ptr const& ctx);
+    // Drops all entries of the layer, e.g. after its data was updated.
+    std::size_t invalidate(std::string const& layer_name);
+    void clear();
+    util::lru_cache_stats stats() const;
+};
+
+extern template class MAPNIK_DECL singleton<feature_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_FEATURE_CACHE_HPP
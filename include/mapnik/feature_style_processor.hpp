@@ -35,6 +35,7 @@
 
 // stl
 #include <deque>
+#include <memory>
 #include <set>
 #include <string>
 #ifdef MAPNIK_STATS_RENDER
@@ -52,6 +53,9 @@ class proj_transform;
 class feature_type_style;
 class rule_cache;
 struct layer_rendering_material;
+struct prepared_layer;
+
+using prepared_layer_ptr = std::shared_ptr<prepared_layer>;
 
 enum eAttributeCollectionPolicy
 {
@@ -105,6 +109,29 @@ public:
                         int buffer_size,
                         std::set<std::string>& names);
 
+    /*!
+     * \brief query datasources of a layer without rendering it.
+     *        With buffer_features all features are read into memory.
+     *        The layer is rendered later by render_prepared_layer().
+     */
+    prepared_layer_ptr prepare_to_layer(layer const& lay,
+                                        Processor & p,
+                                        projection const& proj0,
+                                        double scale,
+                                        double scale_denom,
+                                        unsigned width,
+                                        unsigned height,
+                                        box2d<double> const& extent,
+                                        int buffer_size,
+                                        std::set<std::string>& names,
+                                        bool buffer_features = false);
+
+    /*!
+     * \brief render a layer queried by prepare_to_layer().
+     */
+    void render_prepared_layer(prepared_layer const& prepared,
+                               Processor & p);
+
 private:
     /*!
      * \brief renders a featureset with the given styles.
@@ -43,6 +43,7 @@
 #include <mapnik/projection.hpp>
 #include <mapnik/proj_transform.hpp>
 #include <mapnik/util/featureset_buffer.hpp>
+#include <mapnik/feature_cache.hpp>
 #include <mapnik/util/variant.hpp>
 #include <mapnik/symbolizer_dispatch.hpp>
 
@@ -163,6 +164,43 @@ struct layer_rendering_material
     layer_rendering_material(layer_rendering_material && rhs) = default;
 };
 
+// Layer queried by feature_style_processor::prepare_to_layer()
+struct prepared_layer
+{
+    prepared_layer(layer const& lay, projection const& proj0)
+        : proj0_(proj0),
+          ctx_map_(),
+          mat_(lay, proj0_) {}
+
+    projection proj0_;
+    feature_style_context_map ctx_map_;
+    layer_rendering_material mat_;
+};
+
+// Read all features of a material into memory
+void buffer_material_features(layer_rendering_material & mat)
+{
+    for (featureset_ptr & features : mat.featureset_ptr_list_)
+    {
+        if (!features)
+        {
+            continue;
+        }
+        std::shared_ptr<featureset_buffer> cache = std::make_shared<featureset_buffer>();
+        feature_ptr feature;
+        while ((feature = features->next()))
+        {
+            cache->push(feature);
+        }
+        cache->prepare();
+        features = cache;
+    }
+    for (layer_rendering_material & sub_mat : mat.materials_)
+    {
+        buffer_material_features(sub_mat);
+    }
+}
+
 template <typename Processor>
 feature_style_processor<Processor>::feature_style_processor(Map const& m, double scale_factor)
     : m_(m)
@@ -314,11 +352,37 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay,
                                                         int buffer_size,
                                                         std::set<std::string>& names)
 {
-    feature_style_context_map ctx_map;
-    layer_rendering_material  mat(lay, proj0);
+    prepared_layer_ptr prepared = prepare_to_layer(lay,
+                                                   p,
+                                                   proj0,
+                                                   scale,
+                                                   scale_denom,
+                                                   width,
+                                                   height,
+                                                   extent,
+                                                   buffer_size,
+                                                   names);
+    render_prepared_layer(*prepared, p);
+}
+
+template <typename Processor>
+prepared_layer_ptr feature_style_processor<Processor>::prepare_to_layer(layer const& lay,
+                                                                        Processor & p,
+                                                                        projection const& proj0,
+                                                                        double scale,
+                                                                        double scale_denom,
+                                                                        unsigned width,
+                                                                        unsigned height,
+                                                                        box2d<double> const& extent,
+                                                                        int buffer_size,
+                                                                        std::set<std::string>& names,
+                                                                        bool buffer_features)
+{
+    prepared_layer_ptr prepared = std::make_shared<prepared_layer>(lay, proj0);
+    layer_rendering_material & mat = prepared->mat_;
 
     prepare_layer(mat,
-                  ctx_map,
+                  prepared->ctx_map_,
                   p,
                   scale,
                   scale_denom,
@@ -330,7 +394,7 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay,
 
     prepare_layers(mat,
                    lay.layers(),
-                   ctx_map,
+                   prepared->ctx_map_,
                    p,
                    scale,
                    scale_denom,
@@ -339,6 +403,20 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay,
                    extent,
                    buffer_size);
 
+    if (buffer_features)
+    {
+        buffer_material_features(mat);
+    }
+
+    return prepared;
+}
+
+template <typename Processor>
+void feature_style_processor<Processor>::render_prepared_layer(prepared_layer const& prepared,
+                                                               Processor & p)
+{
+    layer_rendering_material const& mat = prepared.mat_;
+
     if (!mat.empty())
     {
         p.start_layer_processing(mat.lay_, mat.layer_ext2_);
@@ -614,10 +692,19 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
 
     bool cache_features = lay.cache_features() && active_styles.size() > 1;
 
+    // features of cached layers may be reused from previous renders
+    feature_cache & shared_cache = feature_cache::instance();
+    bool use_shared_cache = lay.cache_features() && shared_cache.enabled();
+    auto query_features = [&]() {
+        return use_shared_cache ?
+            shared_cache.features(lay, *ds, q, current_ctx) :
+            ds->features_with_context(q, current_ctx);
+    };
+
     std::vector<featureset_ptr> & featureset_ptr_list = mat.featureset_ptr_list_;
     if (!group_by.empty() || cache_features)
     {
-        featureset_ptr_list.push_back(ds->features_with_context(q,current_ctx));
+        featureset_ptr_list.push_back(query_features());
 #ifdef MAPNIK_STATS_RENDER
         featureset_ptr_list.back()->stats_stream_ = &sink_.stream_;
 #endif
@@ -626,7 +713,7 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
     {
         for(std::size_t i = 0; i < active_styles.size(); ++i)
         {
-            featureset_ptr_list.push_back(ds->features_with_context(q,current_ctx));
+            featureset_ptr_list.push_back(query_features());
 #ifdef MAPNIK_STATS_RENDER
         featureset_ptr_list.back()->stats_stream_ = &sink_.stream_;
 #endif
@@ -820,6 +907,9 @@ void feature_style_processor<Processor>::render_style(
         return;
     }
     mapnik::attributes vars = p.variables();
+    filter_evaluator filters(rc.get_filter_program(), vars);
+    std::vector<rule const*> const& if_rules = rc.get_if_rules();
+    std::vector<std::size_t> const& if_filters = rc.get_if_filters();
     feature_ptr feature;
     bool was_painted = false;
     while ((feature = features->next()))
@@ -829,11 +919,11 @@ void feature_style_processor<Processor>::render_style(
 #endif
         bool do_else = true;
         bool do_also = false;
-        for (rule const* r : rc.get_if_rules() )
+        filters.set_feature(*feature);
+        for (std::size_t i = 0; i < if_rules.size(); ++i)
         {
-            expression_ptr const& expr = r->get_filter();
-            value_type result = util::apply_visitor(evaluate<feature_impl,value_type,attributes>(*feature,vars),*expr);
-            if (result.to_bool())
+            rule const* r = if_rules[i];
+            if (filters.test(if_filters[i]))
             {
                 was_painted = true;
 #ifdef MAPNIK_STATS_RENDER
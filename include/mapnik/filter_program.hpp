@@ -0,0 +1,161 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_FILTER_PROGRAM_HPP
+#define MAPNIK_FILTER_PROGRAM_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/expression_node_types.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace mapnik
+{
+
+// Expressions compiled into a flat array of instructions. Identical
+// sub-expressions of all expressions compiled into a program share one
+// instruction, its result is computed once per feature by filter_evaluator.
+class MAPNIK_DECL filter_program
+{
+public:
+    enum opcode : std::uint8_t
+    {
+        op_constant = 0,
+        op_attribute,
+        op_variable,
+        op_geometry_type,
+        op_negate,
+        op_plus,
+        op_minus,
+        op_mult,
+        op_div,
+        op_mod,
+        op_less,
+        op_less_equal,
+        op_greater,
+        op_greater_equal,
+        op_equal_to,
+        op_not_equal_to,
+        op_logical_not,
+        op_logical_and,
+        op_logical_or,
+        op_regex_match,
+        op_regex_replace,
+        op_unary_function,
+        op_binary_function
+    };
+
+    struct instruction
+    {
+        opcode code;
+        // result is kept for the current feature
+        bool shared;
+        // operands, or index of the constant, attribute or variable
+        std::uint32_t arg1;
+        std::uint32_t arg2;
+        // regex and function call nodes, they have to outlive the program
+        void const* node;
+    };
+
+    filter_program();
+
+    // Returns the index of the instruction evaluating expr
+    std::size_t compile(expr_node const& expr);
+
+    std::vector<instruction> const& code() const
+    {
+        return code_;
+    }
+
+    std::vector<value> const& constants() const
+    {
+        return constants_;
+    }
+
+    std::vector<std::string> const& attributes() const
+    {
+        return attributes_;
+    }
+
+    std::vector<std::string> const& variables() const
+    {
+        return variables_;
+    }
+
+private:
+    friend struct filter_compiler;
+    std::uint32_t add(opcode code, std::uint32_t arg1, std::uint32_t arg2 = 0, void const* node = nullptr);
+    std::uint32_t add_constant(value const& val);
+    std::uint32_t add_name(std::vector<std::string> & names, std::string const& name);
+    void use(std::uint32_t index);
+
+    std::vector<instruction> code_;
+    std::vector<value> constants_;
+    std::vector<std::string> attributes_;
+    std::vector<std::string> variables_;
+    std::vector<std::uint32_t> uses_;
+    std::map<std::tuple<int, std::uint32_t, std::uint32_t, void const*>, std::uint32_t> instructions_;
+};
+
+// Evaluates a filter_program for one feature at a time. Attribute names are
+// resolved to indices when the context of the feature changes, values are
+// compared by reference and nothing is allocated per feature except by
+// string operations.
+class MAPNIK_DECL filter_evaluator : private util::noncopyable
+{
+public:
+    filter_evaluator(filter_program const& program, attributes const& vars);
+
+    void set_feature(feature_impl const& feature);
+
+    bool test(std::size_t index);
+
+    value const& eval(std::size_t index);
+
+private:
+    void bind(feature_impl const& feature);
+
+    filter_program const& program_;
+    std::vector<value const*> variables_;
+    std::vector<std::size_t> indices_;
+    context_ptr context_;
+    std::size_t context_size_;
+    feature_impl const* feature_;
+    std::vector<value> results_;
+    std::vector<std::uint64_t> stamps_;
+    std::uint64_t epoch_;
+};
+
+}
+
+#endif // MAPNIK_FILTER_PROGRAM_HPP
@@ -35,6 +35,9 @@
 #include <map>
 #include <utility> // pair
 #include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
 
 namespace boost { template <class T> class optional; }
 
@@ -74,6 +77,9 @@ public:
                                 freetype_engine::font_memory_cache_type const& font_cache,
                                 font_file_mapping_type const& global_font_file_mapping,
                                 freetype_engine::font_memory_cache_type & global_memory_fonts);
+    // Number identifying face face_index of the font file, the same
+    // for all faces opened from it during the life of the process
+    static std::size_t face_id(std::string const& file_name, int face_index);
 private:
     bool is_font_file_impl(std::string const& file_name);
     std::vector<std::string> face_names_impl();
@@ -101,8 +107,13 @@ private:
                              font_library & libary,
                              font_file_mapping_type & font_file_mapping,
                              bool recurse = false);
+    std::size_t face_id_impl(std::string const& file_name, int face_index);
     font_file_mapping_type global_font_file_mapping_;
     font_memory_cache_type global_memory_fonts_;
+    std::map<std::pair<std::string, int>, std::size_t> face_ids_;
+#ifdef MAPNIK_THREADSAFE
+    std::mutex face_ids_mutex_;
+#endif
 };
 
 class MAPNIK_DECL face_manager
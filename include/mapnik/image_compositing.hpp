@@ -25,6 +25,7 @@
 
 #include <mapnik/config.hpp>
 #include <mapnik/image.hpp>
+#include <mapnik/box2d.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -97,5 +98,23 @@ MAPNIK_DECL void composite(T & dst, T const& src,
 #endif
                      );
 
+// True if compositing a fully transparent source pixel
+// leaves the destination pixel unchanged.
+MAPNIK_DECL bool composite_preserves_dst(composite_mode_e mode);
+
+// Composites only the src_area part of src (max coordinates exclusive),
+// equivalent to a full composite when the rest of src is transparent
+// and composite_preserves_dst(mode) holds.
+MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src,
+                           composite_mode_e mode,
+                           float opacity,
+                           int dx,
+                           int dy,
+                           box2d<int> const& src_area
+#ifdef MAPNIK_STATS_RENDER
+                           , std::ostream * log_stream = nullptr
+#endif
+                     );
+
 }
 #endif // MAPNIK_IMAGE_COMPOSITING_HPP
@@ -26,7 +26,9 @@
 
 //mapnik
 #include <mapnik/image_filter_types.hpp>
+#include <mapnik/box2d.hpp>
 #include <mapnik/image_util.hpp>
+#include <mapnik/image_pool.hpp>
 #include <mapnik/util/hsl.hpp>
 #include <mapnik/safe_cast.hpp>
 #include <mapnik/util/parallelize.hpp>
@@ -52,8 +54,10 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
 #include <cmath>
 #include <thread>
+#include <vector>
 
 // 8-bit YUV
 //Y = ( (  66 * R + 129 * G +  25 * B + 128) >> 8) +  16
@@ -152,21 +156,24 @@ boost::gil::rgba8_view_t rgba8_view(Image & img)
                             img.width() * sizeof(rgba8_pixel_t));
 }
 
+// every pixel of dst_view is written by the filters, so the borrowed
+// buffer does not need clearing
 template <typename Image>
 struct double_buffer
 {
-    boost::gil::rgba8_image_t   dst_buffer;
+    image_rgba8                 dst_buffer;
     boost::gil::rgba8_view_t    dst_view;
     boost::gil::rgba8_view_t    src_view;
 
     explicit double_buffer(Image & src)
-        : dst_buffer(src.width(), src.height())
-        , dst_view(view(dst_buffer))
+        : dst_buffer(image_pool_rgba8::acquire(src.width(), src.height(), false))
+        , dst_view(rgba8_view(dst_buffer))
         , src_view(rgba8_view(src)) {}
 
     ~double_buffer()
     {
         copy_pixels(dst_view, src_view);
+        image_pool_rgba8::release(std::move(dst_buffer));
     }
 };
 
@@ -971,6 +978,123 @@ struct filter_radius_visitor
     }
 };
 
+// How far filters spread painted pixels into transparent neighbours.
+// Filters painting transparent pixels anywhere clear the local flag.
+struct filter_spread_visitor
+{
+    int & spread_;
+    bool & local_;
+    double scale_factor_;
+    filter_spread_visitor(int & spread, bool & local, double scale_factor)
+        : spread_(spread), local_(local), scale_factor_(scale_factor) {}
+
+    // per pixel filters keep transparent pixels transparent
+    template <typename T>
+    void operator () (T const& /*filter*/) const {}
+
+    void operator () (blur const&) const { spread_ += 1; }
+    void operator () (emboss const&) const { spread_ += 1; }
+    void operator () (sharpen const&) const { spread_ += 1; }
+    void operator () (edge_detect const&) const { spread_ += 1; }
+    void operator () (sobel const&) const { spread_ += 1; }
+
+    void operator () (agg_stack_blur const& op) const
+    {
+        spread_ += safe_cast<int>(std::max(op.rx, op.ry) * scale_factor_);
+    }
+
+    void operator () (x_gradient const&) const { local_ = false; }
+    void operator () (y_gradient const&) const { local_ = false; }
+    void operator () (fill const&) const { local_ = false; }
+};
+
+// Applies filters followed by premultiply_alpha() to src, pixels outside of
+// region (max coordinates exclusive) must be transparent. Local filters only
+// process the region padded by their spread. Returns the part of src which
+// may hold painted pixels afterwards.
+template <typename Src>
+box2d<int> apply_filters(Src & src, std::vector<filter_type> const& filters,
+                         box2d<int> const& region, double scale_factor = 1.0
+#ifdef MAPNIK_STATS_RENDER
+                         , std::ostream * stats_stream = nullptr
+#endif
+                         )
+{
+    int spread = 0;
+    bool local = true;
+    filter_spread_visitor spread_visitor(spread, local, scale_factor);
+    for (filter_type const& filter_tag : filters)
+    {
+        util::apply_visitor(spread_visitor, filter_tag);
+    }
+
+    box2d<int> full(0, 0, safe_cast<int>(src.width()), safe_cast<int>(src.height()));
+    box2d<int> area(full);
+    box2d<int> painted(full);
+    if (local)
+    {
+        if (!region.valid() || region.width() <= 0 || region.height() <= 0)
+        {
+            // nothing to spread
+            return box2d<int>();
+        }
+        painted = box2d<int>(region.minx() - spread, region.miny() - spread,
+                             region.maxx() + spread, region.maxy() + spread);
+        painted.clip(full);
+        if (painted.width() <= 0 || painted.height() <= 0)
+        {
+            return box2d<int>();
+        }
+        // one more transparent pixel keeps edge handling of the
+        // convolutions and blurs identical to the full image
+        area = box2d<int>(painted.minx() - 1, painted.miny() - 1,
+                          painted.maxx() + 1, painted.maxy() + 1);
+        area.clip(full);
+    }
+
+    if (area == full)
+    {
+        filter_visitor<Src> visitor(src, scale_factor);
+#ifdef MAPNIK_STATS_RENDER
+        visitor.stats_stream_ = stats_stream;
+#endif
+        for (filter_type const& filter_tag : filters)
+        {
+            util::apply_visitor(visitor, filter_tag);
+        }
+        premultiply_alpha(src);
+        return painted;
+    }
+
+    using pool_type = image_pool<typename Src::pixel>;
+    // all pixels of the crop are copied from src
+    Src crop(pool_type::acquire(safe_cast<std::size_t>(area.width()),
+                                safe_cast<std::size_t>(area.height()), false));
+    set_premultiplied_alpha(crop, src.get_premultiplied());
+    for (int y = 0; y < area.height(); ++y)
+    {
+        auto const* row = src.get_row(area.miny() + y) + area.minx();
+        std::copy(row, row + area.width(), crop.get_row(y));
+    }
+    filter_visitor<Src> visitor(crop, scale_factor);
+#ifdef MAPNIK_STATS_RENDER
+    visitor.stats_stream_ = stats_stream;
+#endif
+    for (filter_type const& filter_tag : filters)
+    {
+        util::apply_visitor(visitor, filter_tag);
+    }
+    premultiply_alpha(crop);
+    for (int y = 0; y < area.height(); ++y)
+    {
+        auto const* row = crop.get_row(y);
+        std::copy(row, row + area.width(), src.get_row(area.miny() + y) + area.minx());
+    }
+    pool_type::release(std::move(crop));
+    set_premultiplied_alpha(src, true);
+    return painted;
+}
+
 template<typename Src>
 void filter_image(Src & src, std::string const& filter, double scale_factor=1)
 {
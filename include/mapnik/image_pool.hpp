@@ -0,0 +1,124 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_IMAGE_POOL_HPP
+#define MAPNIK_IMAGE_POOL_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/box2d.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/lru_cache.hpp>
+
+// stl
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace mapnik
+{
+
+// Process wide pool of image buffers of one pixel type. Released images
+// are kept in free lists keyed by their dimensions, the size class of an
+// image, and handed out again instead of allocating and zeroing a new
+// buffer. Each thread keeps a few images in its own free list, others
+// are shared. Images of both kinds of lists count towards the capacity
+// (approximate size in bytes). An image is
+// returned with the extent it was painted in, only that part is cleared
+// when it is acquired again. The pool is disabled until a capacity is set.
+template <typename T>
+class MAPNIK_DECL image_pool :
+        public singleton<image_pool<T>, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<image_pool<T>>;
+
+public:
+    using image_type = image<T>;
+
+    struct entry
+    {
+        image_type img;
+        box2d<int> dirty;
+        // order of release to the shared lists, oldest are evicted first
+        std::size_t sequence = 0;
+    };
+
+    // Images held in thread local lists, shared with the lists which
+    // may outlive the pool
+    struct local_usage
+    {
+        std::atomic<std::size_t> bytes{0};
+        std::atomic<std::size_t> entries{0};
+    };
+
+private:
+    // free lists by size class, see size_class()
+    std::unordered_map<std::size_t, std::vector<entry>> free_;
+    mutable std::mutex mutex_;
+    std::atomic<std::size_t> capacity_;
+    std::atomic<std::size_t> generation_;
+    // written with the mutex held
+    std::atomic<std::size_t> bytes_;
+    std::size_t entries_;
+    // release counter of the shared lists, guarded by the mutex
+    std::size_t sequence_;
+    std::shared_ptr<local_usage> local_usage_;
+    std::atomic<std::size_t> hits_;
+    std::atomic<std::size_t> misses_;
+    std::atomic<std::size_t> evictions_;
+    image_pool();
+
+    bool take_shared(std::size_t width, std::size_t height, entry & result);
+    void put_shared(entry && e);
+    bool reserve_local(std::size_t size, std::size_t capacity);
+    void evict_shared(std::size_t size, std::size_t capacity);
+
+public:
+    static void set_capacity(std::size_t bytes);
+    bool enabled() const { return capacity_.load(std::memory_order_relaxed) > 0; }
+    // Borrows an image, all pixels are zero if clear is set, otherwise
+    // the content is undefined. The flags of the image are reset.
+    static image_type acquire(std::size_t width, std::size_t height, bool clear = true);
+    // Gives an image back to the pool, all of it is cleared on reuse.
+    static void release(image_type && img);
+    // Gives an image back to the pool whose pixels outside of the dirty
+    // extent are zero, an invalid extent means the image is transparent.
+    static void release(image_type && img, box2d<int> const& dirty);
+    void clear();
+    util::lru_cache_stats stats() const;
+    void reset_stats();
+};
+
+extern template class MAPNIK_DECL singleton<image_pool<rgba8_t>, CreateStatic>;
+extern template class MAPNIK_DECL image_pool<rgba8_t>;
+
+using image_pool_rgba8 = image_pool<rgba8_t>;
+
+}
+
+#endif // MAPNIK_IMAGE_POOL_HPP
@@ -24,26 +24,43 @@
 #define MAPNIK_JSON_FEATURE_PARSER_HPP
 
 // mapnik
+#include <mapnik/box2d.hpp>
 #include <mapnik/feature.hpp>
-#include <mapnik/json/feature_grammar.hpp>
+#include <mapnik/unicode.hpp>
 
-// boost
-#include <boost/spirit/include/qi.hpp>
-#include <boost/spirit/include/phoenix_core.hpp>
+// stl
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace mapnik { namespace json {
 
-inline bool from_geojson(std::string const& json, mapnik::feature_impl & feature)
-{
-    static const mapnik::transcoder tr("utf8");
-    using iterator_type = char const*;
-    static const mapnik::json::feature_grammar<iterator_type,mapnik::feature_impl> g(tr);
-    using namespace boost::spirit;
-    standard::space_type space;
-    iterator_type start = json.c_str();
-    iterator_type end = start + json.length();
-    return qi::phrase_parse(start, end, (g)(boost::phoenix::ref(feature)), space);
-}
+// Parses a GeoJSON Feature object at start without building a generic JSON
+// tree, coordinates are read straight into the geometry and property keys
+// are added to the context of feature. Arrays and objects in properties
+// are stored as strings like by feature_grammar. Returns false if the input
+// is not a Feature, start is moved past the parsed object and whitespace.
+bool parse_feature(char const*& start, char const* end,
+                   mapnik::feature_impl & feature, mapnik::transcoder const& tr);
+
+// Parses a GeoJSON FeatureCollection at start, features share ctx and are
+// numbered from start_id. Returns false if the input is not a
+// FeatureCollection, features parsed until the error are kept.
+bool parse_feature_collection(char const*& start, char const* end,
+                              mapnik::context_ptr const& ctx, std::size_t & start_id,
+                              std::vector<mapnik::feature_ptr> & features,
+                              mapnik::transcoder const& tr);
+
+// Reads a GeoJSON FeatureCollection from file in blocks and calls callback
+// with the bounding box, offset and size of each feature, properties are
+// skipped and no geometry is built. At most max_feature_size bytes are kept
+// in memory, returns false if the input is not a FeatureCollection or a
+// feature doesn't fit. Features without coordinates get an invalid box.
+bool scan_feature_collection(std::FILE * file, std::size_t max_feature_size,
+                             std::function<void(mapnik::box2d<double> const&, std::size_t, std::size_t)> const& callback);
+
+bool from_geojson(std::string const& json, mapnik::feature_impl & feature);
 
 }}
 
@@ -25,6 +25,7 @@
 
 // mapnik
 #include <mapnik/quad_tree.hpp>
+#include <mapnik/util/hilbert.hpp>
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/value_types.hpp>
 #include <mapnik/geometry_adapters.hpp>
@@ -35,7 +36,14 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
 #include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include <boost/geometry/index/rtree.hpp>
 
@@ -374,6 +382,403 @@ public:
 #endif
 };
 
+namespace detail {
+
+// True if any of boxes [begin, end) given by coordinate arrays intersects the box
+inline bool any_box_intersects(double const* minx, double const* miny,
+                               double const* maxx, double const* maxy,
+                               std::size_t begin, std::size_t end,
+                               box2d<double> const& box)
+{
+    std::size_t i = begin;
+#if defined(__SSE2__)
+    const __m128d q_minx = _mm_set1_pd(box.minx());
+    const __m128d q_miny = _mm_set1_pd(box.miny());
+    const __m128d q_maxx = _mm_set1_pd(box.maxx());
+    const __m128d q_maxy = _mm_set1_pd(box.maxy());
+    for (; i + 2 <= end; i += 2)
+    {
+        __m128d disjoint = _mm_or_pd(
+            _mm_or_pd(_mm_cmpgt_pd(_mm_loadu_pd(minx + i), q_maxx),
+                      _mm_cmplt_pd(_mm_loadu_pd(maxx + i), q_minx)),
+            _mm_or_pd(_mm_cmpgt_pd(_mm_loadu_pd(miny + i), q_maxy),
+                      _mm_cmplt_pd(_mm_loadu_pd(maxy + i), q_miny)));
+        if (_mm_movemask_pd(disjoint) != 0x3)
+        {
+            return true;
+        }
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        if (!(minx[i] > box.maxx() || maxx[i] < box.minx() ||
+              miny[i] > box.maxy() || maxy[i] < box.miny()))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct unicode_string_hash
+{
+    std::size_t operator()(value_unicode_string const& text) const
+    {
+        return static_cast<std::size_t>(text.hashCode());
+    }
+};
+
+}
+
+// Collision detector keeping boxes in flat coordinate arrays indexed
+// by a packed Hilbert R-tree. Inserted boxes go to an unindexed tail
+// which is merged into the packed part when it grows over tail_size.
+// Texts for repeat distance checks are interned into integer ids.
+// clear() keeps allocated memory, so the detector can be reused
+// without allocations between renders.
+class label_collision_detector_packed : util::noncopyable
+{
+public:
+    using value_type = std::pair<box2d<double>, std::uint32_t>;
+    using const_iterator = std::vector<value_type>::const_iterator;
+
+private:
+    static constexpr std::size_t node_size = 16;
+    static constexpr std::size_t tail_size = 128;
+    // Id of empty text, boxes inserted without text have it too
+    static constexpr std::uint32_t empty_text = 0;
+    // Matches boxes regardless of their text
+    static constexpr std::uint32_t any_text = 0xFFFFFFFF;
+
+    struct coords
+    {
+        std::vector<double> minx;
+        std::vector<double> miny;
+        std::vector<double> maxx;
+        std::vector<double> maxy;
+
+        void push_back(box2d<double> const& box)
+        {
+            minx.push_back(box.minx());
+            miny.push_back(box.miny());
+            maxx.push_back(box.maxx());
+            maxy.push_back(box.maxy());
+        }
+
+        void clear()
+        {
+            minx.clear();
+            miny.clear();
+            maxx.clear();
+            maxy.clear();
+        }
+
+        bool intersects(std::size_t i, box2d<double> const& box) const
+        {
+            return !(minx[i] > box.maxx() || maxx[i] < box.minx() ||
+                     miny[i] > box.maxy() || maxy[i] < box.miny());
+        }
+
+        bool any_intersects(std::size_t begin, std::size_t end, box2d<double> const& box) const
+        {
+            return detail::any_box_intersects(minx.data(), miny.data(),
+                                              maxx.data(), maxy.data(),
+                                              begin, end, box);
+        }
+    };
+
+    box2d<double> extent_;
+    // Boxes sorted by Hilbert index up to packed_, followed by the tail
+    std::vector<value_type> items_;
+    std::vector<std::uint32_t> hilbert_;
+    coords item_coords_;
+    std::size_t packed_;
+    // Tree nodes of all levels, leaf level first
+    coords node_coords_;
+    std::vector<std::size_t> level_bounds_;
+    std::unordered_map<value_unicode_string, std::uint32_t, detail::unicode_string_hash> text_ids_;
+    // Reused buffers
+    std::vector<value_type> merge_items_;
+    std::vector<std::uint32_t> merge_hilbert_;
+    std::vector<std::size_t> tail_order_;
+    mutable std::vector<std::pair<std::size_t, std::size_t>> stack_;
+
+public:
+    explicit label_collision_detector_packed(box2d<double> const& extent)
+        : extent_(extent),
+          packed_(0)
+#ifdef MAPNIK_STATS_RENDER
+          , query_count_(0)
+#endif
+    {
+    }
+
+    bool has_placement(box2d<double> const& box)
+    {
+#ifdef MAPNIK_STATS_RENDER
+        ++query_count_;
+#endif
+        return !query(box, any_text);
+    }
+
+    bool has_placement(box2d<double> const& box, double margin)
+    {
+        box2d<double> const& margin_box = (margin > 0
+                                               ? box2d<double>(box.minx() - margin, box.miny() - margin,
+                                                               box.maxx() + margin, box.maxy() + margin)
+                                               : box);
+        return has_placement(margin_box);
+    }
+
+    bool has_placement(box2d<double> const& box, double margin, value_unicode_string const& text, double repeat_distance)
+    {
+        // Don't bother with any of the repeat checking unless the repeat distance is greater than the margin
+        if (repeat_distance <= margin)
+        {
+            return has_placement(box, margin);
+        }
+
+        if (!has_placement(box, margin))
+        {
+            return false;
+        }
+
+        std::uint32_t text_id = empty_text;
+        if (!text.isEmpty())
+        {
+            auto itr = text_ids_.find(text);
+            if (itr == text_ids_.end())
+            {
+                // No label with the same text has been placed yet
+                return true;
+            }
+            text_id = itr->second;
+        }
+
+        box2d<double> repeat_box(box.minx() - repeat_distance, box.miny() - repeat_distance,
+                                 box.maxx() + repeat_distance, box.maxy() + repeat_distance);
+
+        return !query(repeat_box, text_id);
+    }
+
+    void insert(box2d<double> const& box)
+    {
+        if (extent_.intersects(box))
+        {
+            push(box, empty_text);
+        }
+    }
+
+    void insert(box2d<double> const& box, mapnik::value_unicode_string const& text)
+    {
+        if (extent_.intersects(box))
+        {
+            if (text.isEmpty())
+            {
+                push(box, empty_text);
+                return;
+            }
+            auto text_id = text_ids_.emplace(text, text_ids_.size() + 1).first;
+            push(box, text_id->second);
+        }
+    }
+
+    void clear()
+    {
+        items_.clear();
+        hilbert_.clear();
+        item_coords_.clear();
+        packed_ = 0;
+        node_coords_.clear();
+        level_bounds_.clear();
+        text_ids_.clear();
+    }
+
+    box2d<double> const& extent() const
+    {
+        return extent_;
+    }
+
+    const_iterator begin() const { return items_.begin(); }
+    const_iterator end() const { return items_.end(); }
+
+    std::size_t size() const
+    {
+        return items_.size();
+    }
+
+#ifdef MAPNIK_STATS_RENDER
+public:
+    unsigned long query_count_;
+
+    int count_items() const
+    {
+        return items_.size();
+    }
+#endif
+
+private:
+    void push(box2d<double> const& box, std::uint32_t text_id)
+    {
+        items_.emplace_back(box, text_id);
+        hilbert_.push_back(util::hilbert_index(box, extent_));
+        item_coords_.push_back(box);
+        if (items_.size() - packed_ > tail_size)
+        {
+            pack();
+        }
+    }
+
+    // Merges sorted tail into the packed items and rebuilds the tree
+    void pack()
+    {
+        const std::size_t size = items_.size();
+        tail_order_.clear();
+        for (std::size_t i = packed_; i < size; ++i)
+        {
+            tail_order_.push_back(i);
+        }
+        std::sort(tail_order_.begin(), tail_order_.end(),
+            [this](std::size_t a, std::size_t b) { return hilbert_[a] < hilbert_[b]; });
+
+        merge_items_.clear();
+        merge_hilbert_.clear();
+        std::size_t i = 0;
+        auto tail_itr = tail_order_.begin();
+        while (i < packed_ || tail_itr != tail_order_.end())
+        {
+            std::size_t next;
+            if (tail_itr == tail_order_.end() ||
+                (i < packed_ && hilbert_[i] <= hilbert_[*tail_itr]))
+            {
+                next = i++;
+            }
+            else
+            {
+                next = *tail_itr++;
+            }
+            merge_items_.push_back(items_[next]);
+            merge_hilbert_.push_back(hilbert_[next]);
+        }
+        items_.swap(merge_items_);
+        hilbert_.swap(merge_hilbert_);
+        packed_ = size;
+
+        item_coords_.clear();
+        for (value_type const& item : items_)
+        {
+            item_coords_.push_back(item.first);
+        }
+
+        build_nodes();
+    }
+
+    void build_nodes()
+    {
+        node_coords_.clear();
+        level_bounds_.clear();
+
+        // Leaf nodes
+        for (std::size_t i = 0; i < packed_; i += node_size)
+        {
+            box2d<double> node_box(items_[i].first);
+            for (std::size_t j = i + 1; j < std::min(i + node_size, packed_); ++j)
+            {
+                node_box.expand_to_include(items_[j].first);
+            }
+            node_coords_.push_back(node_box);
+        }
+        level_bounds_.push_back(node_coords_.minx.size());
+
+        // Upper levels up to the single root node
+        std::size_t level_begin = 0;
+        while (level_bounds_.back() - level_begin > 1)
+        {
+            std::size_t level_end = level_bounds_.back();
+            for (std::size_t i = level_begin; i < level_end; i += node_size)
+            {
+                box2d<double> node_box(node_coords_.minx[i], node_coords_.miny[i],
+                                       node_coords_.maxx[i], node_coords_.maxy[i]);
+                for (std::size_t j = i + 1; j < std::min(i + node_size, level_end); ++j)
+                {
+                    node_box.expand_to_include(box2d<double>(
+                        node_coords_.minx[j], node_coords_.miny[j],
+                        node_coords_.maxx[j], node_coords_.maxy[j]));
+                }
+                node_coords_.push_back(node_box);
+            }
+            level_begin = level_end;
+            level_bounds_.push_back(node_coords_.minx.size());
+        }
+    }
+
+    bool match(std::size_t begin, std::size_t end, box2d<double> const& box, std::uint32_t text_id) const
+    {
+        if (text_id == any_text)
+        {
+            return item_coords_.any_intersects(begin, end, box);
+        }
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            if (items_[i].second == text_id && item_coords_.intersects(i, box))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // True if a box intersecting the query box (and with the given
+    // text, unless text_id is any_text) has been inserted.
+    bool query(box2d<double> const& box, std::uint32_t text_id) const
+    {
+        if (match(packed_, items_.size(), box, text_id))
+        {
+            return true;
+        }
+        if (level_bounds_.empty())
+        {
+            return false;
+        }
+
+        // Stack of (level, node) pairs, starting from the root
+        stack_.clear();
+        stack_.emplace_back(level_bounds_.size() - 1, node_coords_.minx.size() - 1);
+        while (!stack_.empty())
+        {
+            std::size_t level = stack_.back().first;
+            std::size_t node = stack_.back().second;
+            stack_.pop_back();
+
+            if (!node_coords_.intersects(node, box))
+            {
+                continue;
+            }
+
+            std::size_t level_begin = level == 0 ? 0 : level_bounds_[level - 1];
+            std::size_t first_child = (node - level_begin) * node_size;
+            if (level == 0)
+            {
+                if (match(first_child, std::min(first_child + node_size, packed_), box, text_id))
+                {
+                    return true;
+                }
+                continue;
+            }
+
+            std::size_t child_level_begin = level == 1 ? 0 : level_bounds_[level - 2];
+            std::size_t child_level_end = level_bounds_[level - 1];
+            first_child += child_level_begin;
+            std::size_t last_child = std::min(first_child + node_size, child_level_end);
+            for (std::size_t child = first_child; child < last_child; ++child)
+            {
+                stack_.emplace_back(level - 1, child);
+            }
+        }
+        return false;
+    }
+};
+
 }
 
 #endif // MAPNIK_LABEL_COLLISION_DETECTOR_HPP
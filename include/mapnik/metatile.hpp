@@ -0,0 +1,108 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_METATILE_HPP
+#define MAPNIK_METATILE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/box2d.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/image_view.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+class Map;
+class rgba_palette;
+
+// Grid of columns x rows tiles of tile_size pixels covering the extent.
+struct metatile_grid
+{
+    box2d<double> extent;
+    unsigned columns;
+    unsigned rows;
+    unsigned tile_size;
+
+    unsigned width() const { return columns * tile_size; }
+    unsigned height() const { return rows * tile_size; }
+    // Extent of a single tile in map coordinates, row 0 is the top row.
+    box2d<double> tile_extent(unsigned column, unsigned row) const;
+};
+
+enum class tile_content
+{
+    empty,    // fully transparent
+    uniform,  // every pixel has the same color
+    painted
+};
+
+struct encoded_tile
+{
+    unsigned column;
+    unsigned row;
+    tile_content content;
+    std::string data; // empty for tiles of empty content
+};
+
+// Renders a metatile in a single pass and slices it into tiles.
+// Labels are placed once for the whole metatile, so they are continuous
+// across the inner tile edges, and the map's buffer-size is applied
+// only around the outer edges.
+class MAPNIK_DECL metatile : private util::noncopyable
+{
+public:
+    explicit metatile(metatile_grid const& grid);
+
+    void render(Map const& map, double scale_factor = 1.0);
+    void render(Map const& map, attributes const& vars, double scale_factor = 1.0);
+
+    metatile_grid const& grid() const { return grid_; }
+    image_rgba8 const& image() const { return image_; }
+
+    // View of a rendered tile, valid while the metatile is alive.
+    image_view_rgba8 tile(unsigned column, unsigned row) const;
+    tile_content content(unsigned column, unsigned row) const;
+
+    // Encodes all tiles in parallel on the global thread pool. Empty tiles
+    // are not encoded and uniform tiles of the same color are encoded once.
+    std::vector<encoded_tile> encode(std::string const& format) const;
+    std::vector<encoded_tile> encode(std::string const& format,
+                                     rgba_palette const& palette) const;
+
+private:
+    std::vector<encoded_tile> encode_impl(std::string const& format,
+                                          rgba_palette const* palette) const;
+
+    metatile_grid grid_;
+    image_rgba8 image_;
+};
+
+}
+
+#endif // MAPNIK_METATILE_HPP
@@ -0,0 +1,162 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_PACKED_HILBERT_TREE_HPP
+#define MAPNIK_PACKED_HILBERT_TREE_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+#include <mapnik/util/hilbert.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+namespace mapnik
+{
+
+// Builds a static packed Hilbert R-tree and writes it in the format
+// described in util/packed_spatial_index.hpp. Unlike quad_tree the layout
+// does not depend on insertion order, every item is stored in a leaf.
+template <typename T>
+class packed_hilbert_tree : util::noncopyable
+{
+public:
+    using value_type = T;
+
+    explicit packed_hilbert_tree(unsigned node_size = 16)
+        : node_size_(std::max(node_size, 2u)),
+          values_(),
+          boxes_(),
+          extent_() {}
+
+    void insert(value_type const& data, box2d<double> const& box)
+    {
+        if (boxes_.empty())
+        {
+            extent_ = box;
+        }
+        else
+        {
+            extent_.expand_to_include(box);
+        }
+        values_.push_back(data);
+        boxes_.push_back(box);
+    }
+
+    box2d<double> const& extent() const
+    {
+        return extent_;
+    }
+
+    std::size_t count() const
+    {
+        std::size_t nodes = boxes_.size();
+        std::size_t count = nodes;
+        while (nodes > 1)
+        {
+            nodes = (nodes + node_size_ - 1) / node_size_;
+            count += nodes;
+        }
+        return count;
+    }
+
+    std::size_t count_items() const
+    {
+        return values_.size();
+    }
+
+    template <typename OutputStream>
+    void write(OutputStream & out) const
+    {
+        static_assert(std::is_standard_layout<value_type>::value,
+                      "Values stored in packed Hilbert tree must be standard layout types to allow serialisation");
+        using header_type = util::packed_index_header;
+
+        // leaves ordered along the Hilbert curve
+        std::vector<std::uint32_t> hilbert(boxes_.size());
+        for (std::size_t i = 0; i < boxes_.size(); ++i)
+        {
+            hilbert[i] = util::hilbert_index(boxes_[i], extent_);
+        }
+        std::vector<std::size_t> order(boxes_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&hilbert](std::size_t a, std::size_t b) { return hilbert[a] < hilbert[b]; });
+
+        header_type header;
+        header.value_size = sizeof(value_type);
+        header.node_size = static_cast<std::uint32_t>(node_size_);
+        header.num_items = values_.size();
+        header.level_bounds = header_type::make_level_bounds(values_.size(), node_size_);
+        header.num_levels = static_cast<std::uint32_t>(header.level_bounds.size() - 1);
+        header.extent = extent_;
+        std::vector<std::uint64_t> const& level_bounds = header.level_bounds;
+
+        std::vector<box2d<double>> boxes;
+        boxes.reserve(count());
+        for (std::size_t i : order)
+        {
+            boxes.push_back(boxes_[i]);
+        }
+        // parents of each level until there is a single root
+        for (std::size_t level = 2; level < level_bounds.size(); ++level)
+        {
+            std::size_t begin = level_bounds[level - 2];
+            std::size_t end = level_bounds[level - 1];
+            for (std::size_t i = begin; i < end; i += node_size_)
+            {
+                box2d<double> box = boxes[i];
+                for (std::size_t j = i + 1; j < std::min(i + node_size_, end); ++j)
+                {
+                    box.expand_to_include(boxes[j]);
+                }
+                boxes.push_back(box);
+            }
+        }
+
+        char fixed[header_type::fixed_size];
+        header.write_fixed(fixed);
+        out.write(fixed, header_type::fixed_size);
+        out.write(reinterpret_cast<char const*>(level_bounds.data()), 8 * level_bounds.size());
+        out.write(reinterpret_cast<char const*>(boxes.data()), header_type::box_size * boxes.size());
+        for (std::size_t i : order)
+        {
+            out.write(reinterpret_cast<char const*>(&values_[i]), sizeof(value_type));
+        }
+    }
+
+private:
+    std::size_t node_size_;
+    std::vector<value_type> values_;
+    std::vector<box2d<double>> boxes_;
+    box2d<double> extent_;
+};
+
+}
+
+#endif // MAPNIK_PACKED_HILBERT_TREE_HPP
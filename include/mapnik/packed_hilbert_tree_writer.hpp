@@ -0,0 +1,347 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_PACKED_HILBERT_TREE_WRITER_HPP
+#define MAPNIK_PACKED_HILBERT_TREE_WRITER_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+#include <mapnik/util/hilbert.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace mapnik
+{
+
+// Writes the same index as packed_hilbert_tree with a bounded amount of
+// memory. Items are spilled to temporary files, sorted in runs of
+// memory_limit bytes and merged, levels of the tree are built from the
+// previous level while it's copied to the output.
+template <typename T>
+class packed_hilbert_tree_writer : util::noncopyable
+{
+public:
+    using value_type = T;
+
+    explicit packed_hilbert_tree_writer(std::size_t memory_limit, unsigned node_size = 16)
+        : node_size_(std::max(node_size, 2u)),
+          capacity_(std::max(memory_limit / sizeof(item), std::size_t(1024))),
+          items_(),
+          spilled_(nullptr, std::fclose),
+          num_spilled_(0),
+          extent_() {}
+
+    void insert(value_type const& data, box2d<double> const& box)
+    {
+        if (count_items() == 0)
+        {
+            extent_ = box;
+        }
+        else
+        {
+            extent_.expand_to_include(box);
+        }
+        items_.push_back(item{box, data, count_items(), 0});
+        if (items_.size() == capacity_)
+        {
+            spill();
+        }
+    }
+
+    box2d<double> const& extent() const
+    {
+        return extent_;
+    }
+
+    std::size_t count_items() const
+    {
+        return num_spilled_ + items_.size();
+    }
+
+    // Writes the index, can be called once.
+    template <typename OutputStream>
+    void write(OutputStream & out)
+    {
+        static_assert(std::is_standard_layout<value_type>::value,
+                      "Values stored in packed Hilbert tree must be standard layout types to allow serialisation");
+        using header_type = util::packed_index_header;
+
+        header_type header;
+        header.value_size = sizeof(value_type);
+        header.node_size = static_cast<std::uint32_t>(node_size_);
+        header.num_items = count_items();
+        header.level_bounds = header_type::make_level_bounds(header.num_items, node_size_);
+        header.num_levels = static_cast<std::uint32_t>(header.level_bounds.size() - 1);
+        header.extent = extent_;
+        char fixed[header_type::fixed_size];
+        header.write_fixed(fixed);
+        out.write(fixed, header_type::fixed_size);
+        out.write(reinterpret_cast<char const*>(header.level_bounds.data()), 8 * header.level_bounds.size());
+
+        file_ptr values = temporary_file();
+        file_ptr parents = temporary_file();
+        level_writer<OutputStream> leaves(out, parents.get(), node_size_);
+        auto emit = [&](item const& i)
+        {
+            leaves.add(i.box);
+            write_file(values.get(), &i.value, sizeof(value_type));
+        };
+        if (num_spilled_ == 0)
+        {
+            sort_items();
+            for (item const& i : items_) emit(i);
+        }
+        else
+        {
+            spill();
+            merge_runs(make_runs(), emit);
+        }
+        leaves.finish();
+
+        // parents of each level until there is a single root
+        for (std::size_t level = 2; level < header.level_bounds.size(); ++level)
+        {
+            file_ptr next = temporary_file();
+            level_writer<OutputStream> nodes(out, next.get(), node_size_);
+            std::rewind(parents.get());
+            box2d<double> box;
+            for (std::uint64_t i = header.level_bounds[level - 1]; i < header.level_bounds[level]; ++i)
+            {
+                read_file(parents.get(), &box, sizeof(box));
+                nodes.add(box);
+            }
+            nodes.finish();
+            parents = std::move(next);
+        }
+        std::rewind(values.get());
+        copy_file(values.get(), out, header.num_items * sizeof(value_type));
+    }
+
+private:
+    using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE*)>;
+
+    struct item
+    {
+        box2d<double> box;
+        value_type value;
+        std::uint64_t sequence;
+        std::uint32_t hilbert;
+    };
+
+    static bool item_less(item const& a, item const& b)
+    {
+        return a.hilbert < b.hilbert || (a.hilbert == b.hilbert && a.sequence < b.sequence);
+    }
+
+    // Writes boxes of a level to the output and their parents to a file
+    template <typename OutputStream>
+    struct level_writer
+    {
+        level_writer(OutputStream & out, std::FILE * parents, std::size_t node_size)
+            : out_(out),
+              parents_(parents),
+              node_size_(node_size),
+              count_(0),
+              parent_() {}
+
+        void add(box2d<double> const& box)
+        {
+            out_.write(reinterpret_cast<char const*>(&box), sizeof(box));
+            if (count_ == 0) parent_ = box;
+            else parent_.expand_to_include(box);
+            if (++count_ == node_size_) finish();
+        }
+
+        void finish()
+        {
+            if (count_ > 0)
+            {
+                write_file(parents_, &parent_, sizeof(parent_));
+                count_ = 0;
+            }
+        }
+
+        OutputStream & out_;
+        std::FILE * parents_;
+        std::size_t node_size_;
+        std::size_t count_;
+        box2d<double> parent_;
+    };
+
+    // Sorted items stored at offset of the runs file
+    struct run
+    {
+        long offset;
+        std::size_t remaining;
+        std::vector<item> buffer;
+        std::size_t position;
+    };
+
+    static file_ptr temporary_file()
+    {
+        file_ptr file(std::tmpfile(), std::fclose);
+        if (!file)
+        {
+            throw std::runtime_error("packed_hilbert_tree_writer: can't create temporary file");
+        }
+        return file;
+    }
+
+    static void write_file(std::FILE * file, void const* data, std::size_t size)
+    {
+        if (size > 0 && std::fwrite(data, size, 1, file) != 1)
+        {
+            throw std::runtime_error("packed_hilbert_tree_writer: can't write temporary file");
+        }
+    }
+
+    static void read_file(std::FILE * file, void * data, std::size_t size)
+    {
+        if (size > 0 && std::fread(data, size, 1, file) != 1)
+        {
+            throw std::runtime_error("packed_hilbert_tree_writer: can't read temporary file");
+        }
+    }
+
+    template <typename OutputStream>
+    static void copy_file(std::FILE * file, OutputStream & out, std::uint64_t size)
+    {
+        char buffer[65536];
+        while (size > 0)
+        {
+            std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(size, sizeof(buffer)));
+            read_file(file, buffer, chunk);
+            out.write(buffer, chunk);
+            size -= chunk;
+        }
+    }
+
+    void sort_items()
+    {
+        for (item & i : items_)
+        {
+            i.hilbert = util::hilbert_index(i.box, extent_);
+        }
+        std::sort(items_.begin(), items_.end(), item_less);
+    }
+
+    void spill()
+    {
+        if (!spilled_)
+        {
+            spilled_ = temporary_file();
+        }
+        write_file(spilled_.get(), items_.data(), items_.size() * sizeof(item));
+        num_spilled_ += items_.size();
+        items_.clear();
+    }
+
+    // Sorts the spilled items in runs of capacity_ items, hilbert indices
+    // depend on the extent of all items.
+    std::pair<file_ptr, std::vector<run>> make_runs()
+    {
+        file_ptr runs_file = temporary_file();
+        std::vector<run> runs;
+        std::rewind(spilled_.get());
+        for (std::size_t offset = 0; offset < num_spilled_; offset += capacity_)
+        {
+            std::size_t count = std::min(capacity_, num_spilled_ - offset);
+            items_.resize(count);
+            read_file(spilled_.get(), items_.data(), count * sizeof(item));
+            sort_items();
+            runs.push_back(run{std::ftell(runs_file.get()), count, std::vector<item>(), 0});
+            write_file(runs_file.get(), items_.data(), count * sizeof(item));
+        }
+        items_.clear();
+        items_.shrink_to_fit();
+        spilled_.reset();
+        return std::make_pair(std::move(runs_file), std::move(runs));
+    }
+
+    template <typename Emit>
+    void merge_runs(std::pair<file_ptr, std::vector<run>> runs_data, Emit emit)
+    {
+        std::FILE * file = runs_data.first.get();
+        std::vector<run> & runs = runs_data.second;
+        std::size_t block = std::max(capacity_ / runs.size(), std::size_t(64));
+        auto refill = [&](run & r)
+        {
+            std::size_t count = std::min(block, r.remaining);
+            r.buffer.resize(count);
+            if (std::fseek(file, r.offset, SEEK_SET) != 0)
+            {
+                throw std::runtime_error("packed_hilbert_tree_writer: can't read temporary file");
+            }
+            read_file(file, r.buffer.data(), count * sizeof(item));
+            r.offset += static_cast<long>(count * sizeof(item));
+            r.remaining -= count;
+            r.position = 0;
+        };
+        auto greater = [&runs](std::size_t a, std::size_t b)
+        {
+            return item_less(runs[b].buffer[runs[b].position], runs[a].buffer[runs[a].position]);
+        };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heads(greater);
+        for (std::size_t i = 0; i < runs.size(); ++i)
+        {
+            refill(runs[i]);
+            heads.push(i);
+        }
+        while (!heads.empty())
+        {
+            std::size_t i = heads.top();
+            heads.pop();
+            run & r = runs[i];
+            emit(r.buffer[r.position]);
+            if (++r.position == r.buffer.size())
+            {
+                if (r.remaining == 0)
+                {
+                    r.buffer = std::vector<item>();
+                    continue;
+                }
+                refill(r);
+            }
+            heads.push(i);
+        }
+    }
+
+    std::size_t node_size_;
+    std::size_t capacity_;
+    std::vector<item> items_;
+    file_ptr spilled_;
+    std::size_t num_spilled_;
+    box2d<double> extent_;
+};
+
+}
+
+#endif // MAPNIK_PACKED_HILBERT_TREE_WRITER_HPP
@@ -28,6 +28,7 @@
 #include <mapnik/octree.hpp>
 #include <mapnik/hextree.hpp>
 #include <mapnik/image.hpp>
+#include <mapnik/util/parallelize.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -39,7 +40,11 @@ extern "C"
 {
 #include <png.h>
 }
+#include <algorithm>
+#include <cstring>
 #include <set>
+#include <stdexcept>
+#include <vector>
 #pragma GCC diagnostic pop
 
 #define MAX_OCTREE_LEVELS 4
@@ -54,6 +59,7 @@ struct png_options {
     double gamma;
     bool paletted;
     bool use_hextree;
+    unsigned threads;
     png_options() :
         colors(256),
         compression(Z_DEFAULT_COMPRESSION),
@@ -61,9 +67,137 @@ struct png_options {
         trans_mode(-1),
         gamma(-1),
         paletted(true),
-        use_hextree(true) {}
+        use_hextree(true),
+        threads(1) {}
 };
 
+namespace detail {
+
+// Image data is split into bands of at least this many bytes, smaller
+// bands would spend more time priming the dictionary than compressing.
+constexpr std::size_t png_min_band_size = 128 * 1024;
+constexpr std::size_t png_window_size = 32 * 1024;
+constexpr std::size_t png_max_idat_size = 256 * 1024;
+
+struct png_band
+{
+    std::vector<png_byte> data;
+    uLong adler;
+};
+
+inline unsigned png_band_count(unsigned height, std::size_t row_bytes, png_options const& opts)
+{
+    std::size_t size = height * (row_bytes + 1);
+    std::size_t bands = std::min<std::size_t>(opts.threads, size / png_min_band_size);
+    return static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(bands, height)));
+}
+
+// Compresses scanlines [begin, end) as a raw deflate stream. The window
+// preceding the band is set as dictionary so matches may reach back into
+// the previous band, every band but the last ends with a sync flush on
+// a byte boundary and the bands concatenate into a single stream.
+inline void png_deflate_band(png_band & band,
+                             std::vector<png_byte> const& scanlines,
+                             std::size_t begin,
+                             std::size_t end,
+                             png_options const& opts)
+{
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, opts.compression, Z_DEFLATED, -15, 8, opts.strategy) != Z_OK)
+    {
+        throw std::runtime_error("png: failed to initialize deflate stream");
+    }
+    if (begin > 0)
+    {
+        std::size_t dict_begin = begin > png_window_size ? begin - png_window_size : 0;
+        deflateSetDictionary(&strm, &scanlines[dict_begin], static_cast<uInt>(begin - dict_begin));
+    }
+    bool last = end == scanlines.size();
+    std::size_t size = end - begin;
+    band.data.resize(deflateBound(&strm, size) + 16);
+    strm.next_in = const_cast<png_bytep>(&scanlines[begin]);
+    strm.avail_in = static_cast<uInt>(size);
+    int status;
+    do
+    {
+        if (strm.total_out == band.data.size())
+        {
+            band.data.resize(band.data.size() * 2);
+        }
+        strm.next_out = &band.data[strm.total_out];
+        strm.avail_out = static_cast<uInt>(band.data.size() - strm.total_out);
+        status = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+    }
+    while (status == Z_OK && (last || strm.avail_out == 0));
+    band.data.resize(strm.total_out);
+    deflateEnd(&strm);
+    if (status != Z_STREAM_END && status != Z_OK && status != Z_BUF_ERROR)
+    {
+        throw std::runtime_error("png: failed to deflate image data");
+    }
+    band.adler = adler32(adler32(0, nullptr, 0), &scanlines[begin], static_cast<uInt>(size));
+}
+
+// Writes image data compressed in parallel bands (pigz style) as IDAT
+// chunks followed by IEND. Rows are stored unfiltered like in libpng path.
+// row(y, out) copies row_bytes of row y into out.
+template <typename RowFunc>
+void png_write_image_parallel(png_structp png_ptr,
+                              unsigned height,
+                              std::size_t row_bytes,
+                              unsigned bands,
+                              RowFunc row,
+                              png_options const& opts)
+{
+    std::vector<png_byte> scanlines(height * (row_bytes + 1));
+    for (unsigned y = 0; y < height; ++y)
+    {
+        png_bytep out = &scanlines[y * (row_bytes + 1)];
+        out[0] = PNG_FILTER_VALUE_NONE;
+        row(y, out + 1);
+    }
+
+    std::vector<png_band> result(bands);
+    unsigned rows_per_band = height / bands;
+    util::parallelize([&](unsigned band_begin, unsigned band_end) {
+        for (unsigned i = band_begin; i < band_end; ++i)
+        {
+            std::size_t begin = i * rows_per_band * (row_bytes + 1);
+            std::size_t end = (i + 1 == bands) ? scanlines.size() : (i + 1) * rows_per_band * (row_bytes + 1);
+            png_deflate_band(result[i], scanlines, begin, end, opts);
+        }
+    }, bands, bands);
+
+    int level = opts.compression == Z_DEFAULT_COMPRESSION ? 6 : opts.compression;
+    png_byte cmf = 0x78; // deflate, 32K window
+    png_byte flg = static_cast<png_byte>((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+    flg |= 31 - ((cmf << 8) | flg) % 31;
+
+    std::vector<png_byte> idat{cmf, flg};
+    uLong adler = adler32(0, nullptr, 0);
+    for (unsigned i = 0; i < bands; ++i)
+    {
+        std::size_t begin = i * rows_per_band * (row_bytes + 1);
+        std::size_t end = (i + 1 == bands) ? scanlines.size() : (i + 1) * rows_per_band * (row_bytes + 1);
+        adler = adler32_combine(adler, result[i].adler, static_cast<z_off_t>(end - begin));
+        idat.insert(idat.end(), result[i].data.begin(), result[i].data.end());
+    }
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        idat.push_back(static_cast<png_byte>((adler >> shift) & 0xff));
+    }
+
+    for (std::size_t pos = 0; pos < idat.size(); pos += png_max_idat_size)
+    {
+        std::size_t size = std::min(png_max_idat_size, idat.size() - pos);
+        png_write_chunk(png_ptr, reinterpret_cast<png_const_bytep>("IDAT"), &idat[pos], size);
+    }
+    png_write_chunk(png_ptr, reinterpret_cast<png_const_bytep>("IEND"), nullptr, 0);
+}
+
+}
+
 template <typename T>
 void write_data (png_structp png_ptr, png_bytep data, png_size_t length)
 {
@@ -119,6 +253,31 @@ void save_as_png(T1 & file,
     png_set_IHDR(png_ptr, info_ptr,image.width(),image.height(),8,
                  (opts.trans_mode == 0) ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGB_ALPHA,PNG_INTERLACE_NONE,
                  PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
+    std::size_t row_bytes = image.width() * ((opts.trans_mode == 0) ? 3 : 4);
+    unsigned bands = detail::png_band_count(image.height(), row_bytes, opts);
+    if (bands > 1)
+    {
+        png_write_info(png_ptr, info_ptr);
+        detail::png_write_image_parallel(png_ptr, image.height(), row_bytes, bands,
+            [&image, &opts](unsigned y, png_bytep out) {
+                png_byte const* in = reinterpret_cast<png_byte const*>(image.get_row(y));
+                if (opts.trans_mode == 0)
+                {
+                    for (unsigned x = 0; x < image.width(); ++x, in += 4)
+                    {
+                        *out++ = in[0];
+                        *out++ = in[1];
+                        *out++ = in[2];
+                    }
+                }
+                else
+                {
+                    std::memcpy(out, in, image.width() * 4);
+                }
+            }, opts);
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        return;
+    }
     const std::unique_ptr<png_bytep[]> row_pointers(new png_bytep[image.height()]);
     for (unsigned int i = 0; i < image.height(); i++)
     {
@@ -317,6 +476,17 @@ void save_as_png(T & file, std::vector<mapnik::rgb> const& palette,
     }
 
     png_write_info(png_ptr, info_ptr);
+    std::size_t row_bytes = (width * color_depth + 7) / 8;
+    unsigned bands = detail::png_band_count(height, row_bytes, opts);
+    if (bands > 1)
+    {
+        detail::png_write_image_parallel(png_ptr, height, row_bytes, bands,
+            [&image, row_bytes](unsigned y, png_bytep out) {
+                std::memcpy(out, image.get_row(y), row_bytes);
+            }, opts);
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        return;
+    }
     for (unsigned i=0;i<height;i++)
     {
         png_write_row(png_ptr,const_cast<png_bytep>(image.get_row(i)));
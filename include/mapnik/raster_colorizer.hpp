@@ -219,6 +219,9 @@ public:
     inline float get_epsilon() const { return epsilon_; }
 
 private:
+    //! \brief Translate a value which falls into the given stop, -1 before the first stop
+    unsigned get_color(int stop_idx, float value) const;
+
     colorizer_stops stops_;         //!< The vector of stops
 
     colorizer_mode default_mode_;   //!< The default mode inherited by stops
@@ -48,7 +48,7 @@ namespace collision {
 struct layout_generator : util::noncopyable
 {
     using params_type = label_placement::placement_params;
-    using detector_type = keyed_collision_cache<label_collision_detector_boost>;
+    using detector_type = keyed_collision_cache<label_collision_detector_packed>;
 
     layout_generator(
         params_type const & params,
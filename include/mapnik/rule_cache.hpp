@@ -25,6 +25,7 @@
 
 // mapnik
 #include <mapnik/rule.hpp>
+#include <mapnik/filter_program.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
 // stl
@@ -41,12 +42,16 @@ public:
     rule_cache()
         : if_rules_(),
           else_rules_(),
-          also_rules_() {}
+          also_rules_(),
+          filters_(),
+          program_() {}
 
     rule_cache(rule_cache && rhs) // move ctor
         :  if_rules_(std::move(rhs.if_rules_)),
            else_rules_(std::move(rhs.else_rules_)),
-           also_rules_(std::move(rhs.also_rules_))
+           also_rules_(std::move(rhs.also_rules_)),
+           filters_(std::move(rhs.filters_)),
+           program_(std::move(rhs.program_))
     {}
 
     rule_cache& operator=(rule_cache && rhs) // move assign
@@ -54,6 +59,8 @@ public:
         std::swap(if_rules_, rhs.if_rules_);
         std::swap(else_rules_,rhs.else_rules_);
         std::swap(also_rules_, rhs.also_rules_);
+        std::swap(filters_, rhs.filters_);
+        std::swap(program_, rhs.program_);
         return *this;
     }
 
@@ -70,6 +77,7 @@ public:
         else
         {
             if_rules_.push_back(&r);
+            filters_.push_back(program_.compile(*r.get_filter()));
         }
     }
 
@@ -78,6 +86,18 @@ public:
         return if_rules_;
     }
 
+    // Filters of if rules compiled into one program, the program refers
+    // to the expressions of rules.
+    std::vector<std::size_t> const& get_if_filters() const
+    {
+        return filters_;
+    }
+
+    filter_program const& get_filter_program() const
+    {
+        return program_;
+    }
+
     rule_ptrs const& get_else_rules() const
     {
         return else_rules_;
@@ -92,6 +112,8 @@ private:
     rule_ptrs if_rules_;
     rule_ptrs else_rules_;
     rule_ptrs also_rules_;
+    std::vector<std::size_t> filters_;
+    filter_program program_;
 };
 
 }
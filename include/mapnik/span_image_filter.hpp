@@ -24,6 +24,7 @@
 #define MAPNIK_SPAN_IMAGE_FILTER_INCLUDED
 
 #include <mapnik/safe_cast.hpp>
+#include <mapnik/util/simd_resample.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -37,6 +38,7 @@
 #pragma GCC diagnostic pop
 
 #include <limits>
+#include <vector>
 
 namespace mapnik
 {
@@ -258,6 +260,120 @@ public:
     }
 };
 
+// Subpixel coordinates of one span, reused by the vectorized span generators.
+struct span_coordinates
+{
+    std::vector<int> xs;
+    std::vector<int> ys;
+
+    void resize(unsigned len)
+    {
+        if (xs.size() < len)
+        {
+            xs.resize(len);
+            ys.resize(len);
+        }
+    }
+};
+
+// Same output as agg::span_image_filter_rgba_bilinear, pixels are sampled
+// by a vectorized kernel from util/simd_resample.hpp.
+template<class Source, class Interpolator>
+class span_image_filter_rgba_bilinear_simd : public agg::span_image_filter<Source, Interpolator>
+{
+public:
+    using source_type = Source;
+    using color_type = typename source_type::color_type;
+    using interpolator_type = Interpolator;
+    using base_type = agg::span_image_filter<source_type, interpolator_type>;
+
+    span_image_filter_rgba_bilinear_simd(source_type & src,
+                                         interpolator_type & inter,
+                                         util::rgba8_source const& pixels,
+                                         util::bilinear_kernel kernel,
+                                         span_coordinates & coords) :
+        base_type(src, inter, 0),
+        pixels_(pixels),
+        kernel_(kernel),
+        coords_(coords)
+    {}
+
+    void generate(color_type* span, int x, int y, unsigned len)
+    {
+        base_type::interpolator().begin(x + base_type::filter_dx_dbl(),
+                                        y + base_type::filter_dy_dbl(), len);
+        coords_.resize(len);
+        int * xs = coords_.xs.data();
+        int * ys = coords_.ys.data();
+        for (unsigned i = 0; i < len; ++i)
+        {
+            base_type::interpolator().coordinates(xs + i, ys + i);
+            xs[i] -= base_type::filter_dx_int();
+            ys[i] -= base_type::filter_dy_int();
+            ++base_type::interpolator();
+        }
+        kernel_(reinterpret_cast<std::uint8_t*>(span), pixels_, xs, ys, len);
+    }
+
+private:
+    util::rgba8_source pixels_;
+    util::bilinear_kernel kernel_;
+    span_coordinates & coords_;
+};
+
+// Same output as agg::span_image_resample_rgba_affine, pixels are sampled
+// by a vectorized kernel from util/simd_resample.hpp.
+template<class Source>
+class span_image_resample_rgba_affine_simd : public agg::span_image_resample_affine<Source>
+{
+public:
+    using source_type = Source;
+    using color_type = typename source_type::color_type;
+    using base_type = agg::span_image_resample_affine<source_type>;
+    using interpolator_type = typename base_type::interpolator_type;
+
+    span_image_resample_rgba_affine_simd(source_type & src,
+                                         interpolator_type & inter,
+                                         agg::image_filter_lut const & filter,
+                                         util::rgba8_source const& pixels,
+                                         util::resample_kernel kernel,
+                                         span_coordinates & coords) :
+        base_type(src, inter, filter),
+        pixels_(pixels),
+        kernel_(kernel),
+        coords_(coords)
+    {}
+
+    void generate(color_type* span, int x, int y, unsigned len)
+    {
+        base_type::interpolator().begin(x + base_type::filter_dx_dbl(),
+                                        y + base_type::filter_dy_dbl(), len);
+        int diameter = base_type::filter().diameter();
+        int radius_x = (diameter * base_type::m_rx) >> 1;
+        int radius_y = (diameter * base_type::m_ry) >> 1;
+        util::resample_params params{diameter,
+                                     base_type::m_rx, base_type::m_ry,
+                                     base_type::m_rx_inv, base_type::m_ry_inv,
+                                     base_type::filter().weight_array()};
+        coords_.resize(len);
+        int * xs = coords_.xs.data();
+        int * ys = coords_.ys.data();
+        for (unsigned i = 0; i < len; ++i)
+        {
+            base_type::interpolator().coordinates(xs + i, ys + i);
+            xs[i] += base_type::filter_dx_int() - radius_x;
+            ys[i] += base_type::filter_dy_int() - radius_y;
+            ++base_type::interpolator();
+        }
+        kernel_(reinterpret_cast<std::uint8_t*>(span), pixels_, params, xs, ys, len);
+    }
+
+private:
+    util::rgba8_source pixels_;
+    util::resample_kernel kernel_;
+    span_coordinates & coords_;
+};
+
 }
 
 #endif
@@ -51,7 +51,7 @@ namespace mapnik
 class MAPNIK_DECL font_face : util::noncopyable
 {
 public:
-    font_face(FT_Face face);
+    font_face(FT_Face face, std::size_t id);
 
     std::string family_name() const
     {
@@ -75,6 +75,11 @@ public:
 
     inline bool is_color() const { return color_font_;}
 
+    // Identifies the font rather than this object, faces opened
+    // from the same font by different renderers share the id.
+    // See freetype_engine::face_id.
+    std::size_t id() const { return id_; }
+
     ~font_face();
 
 private:
@@ -84,6 +89,7 @@ private:
     FT_Face face_;
     const bool color_font_;
     const double unscaled_ascender_;
+    const std::size_t id_;
 };
 using face_ptr = std::shared_ptr<font_face>;
 
@@ -0,0 +1,158 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+#ifndef MAPNIK_GLYPH_CACHE_HPP
+#define MAPNIK_GLYPH_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/lru_cache.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+
+extern "C"
+{
+#include <ft2build.h>
+#include FT_FREETYPE_H
+}
+
+#pragma GCC diagnostic pop
+
+#include <boost/container_hash/hash.hpp>
+
+// stl
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace mapnik
+{
+
+// Identifies a rasterized glyph independently of its integer pixel position:
+// the bitmap of a glyph translated by whole pixels only moves, so only
+// the fractional part of the pen position is a part of the key.
+struct glyph_cache_key
+{
+    std::size_t face_id; // font_face::id(), distinct for each font file and face index
+    unsigned glyph_index;
+    FT_F26Dot6 size;
+    FT_Fixed xx, xy, yx, yy;
+    FT_Pos frac_x, frac_y;
+    FT_Int32 load_flags;
+    int render_mode;
+    FT_Fixed stroke_radius; // 0 unless the glyph is stroked for a halo
+
+    std::size_t hash() const
+    {
+        std::size_t h = face_id;
+        boost::hash_combine(h, glyph_index);
+        boost::hash_combine(h, size);
+        boost::hash_combine(h, xx);
+        boost::hash_combine(h, xy);
+        boost::hash_combine(h, yx);
+        boost::hash_combine(h, yy);
+        boost::hash_combine(h, frac_x);
+        boost::hash_combine(h, frac_y);
+        boost::hash_combine(h, load_flags);
+        boost::hash_combine(h, render_mode);
+        boost::hash_combine(h, stroke_radius);
+        return h;
+    }
+
+    bool operator==(glyph_cache_key const& other) const
+    {
+        return face_id == other.face_id &&
+            glyph_index == other.glyph_index &&
+            size == other.size &&
+            xx == other.xx && xy == other.xy &&
+            yx == other.yx && yy == other.yy &&
+            frac_x == other.frac_x && frac_y == other.frac_y &&
+            load_flags == other.load_flags &&
+            render_mode == other.render_mode &&
+            stroke_radius == other.stroke_radius;
+    }
+};
+
+struct glyph_cache_key_hash
+{
+    std::size_t operator()(glyph_cache_key const& key) const noexcept
+    {
+        return key.hash();
+    }
+};
+
+// Coverage bitmap of a glyph, left and top are relative to the
+// integer part of the pen position.
+struct glyph_bitmap : private util::noncopyable
+{
+    glyph_bitmap(FT_Bitmap const& src, int left, int top);
+
+    // FT_Bitmap view of the cached pixels for compositing functions.
+    FT_Bitmap bitmap() const;
+    std::size_t memory_size() const { return sizeof(glyph_bitmap) + buffer.size(); }
+
+    int left;
+    int top;
+    unsigned width;
+    unsigned rows;
+    int pitch;
+    unsigned char pixel_mode;
+    unsigned short num_grays;
+    std::vector<unsigned char> buffer;
+};
+
+using glyph_bitmap_ptr = std::shared_ptr<const glyph_bitmap>;
+
+// Process wide cache of rasterized glyphs and stroked halos shared by all
+// renderers. It is disabled until a capacity (approximate size in bytes)
+// is set. Pen positions are snapped to 1/subpixel_steps of a pixel for
+// cached glyphs, the default of 64 keeps FreeType's full 26.6 precision
+// so the output is identical to uncached rendering.
+class MAPNIK_DECL glyph_cache :
+        public singleton<glyph_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<glyph_cache>;
+    using cache_type = util::sharded_lru_cache<glyph_cache_key, glyph_bitmap_ptr, glyph_cache_key_hash>;
+    cache_type cache_;
+    std::atomic<unsigned> subpixel_steps_;
+    glyph_cache();
+public:
+    static void set_capacity(std::size_t bytes);
+    static bool set_subpixel_steps(unsigned steps);
+    bool enabled() const { return cache_.enabled(); }
+    unsigned subpixel_steps() const { return subpixel_steps_; }
+    // Rounds a 26.6 position to the nearest subpixel step.
+    FT_Pos snap(FT_Pos pos) const;
+    glyph_bitmap_ptr find(glyph_cache_key const& key);
+    void insert(glyph_cache_key const& key, glyph_bitmap_ptr const& bitmap);
+    void clear();
+    util::lru_cache_stats stats() const;
+};
+
+extern template class MAPNIK_DECL singleton<glyph_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_GLYPH_CACHE_HPP
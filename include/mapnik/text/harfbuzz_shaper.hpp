@@ -35,6 +35,7 @@
 
 // stl
 #include <list>
+#include <memory>
 #include <type_traits>
 
 #pragma GCC diagnostic push
@@ -67,6 +68,50 @@ static inline const uint16_t * uchar_to_utf16(const UChar* src)
 
 struct harfbuzz_shaper
 {
+static std::size_t features_hash(font_feature_settings const& ff_settings)
+{
+    std::size_t h = 0;
+    for (auto const& feature : ff_settings.features())
+    {
+        boost::hash_combine(h, feature.tag);
+        boost::hash_combine(h, feature.value);
+        boost::hash_combine(h, feature.start);
+        boost::hash_combine(h, feature.end);
+    }
+    return h;
+}
+
+static shaped_run_ptr shape_run(shaper_cache_key const& key,
+                                font_face const& face,
+                                font_feature_settings const& ff_settings)
+{
+    std::unique_ptr<hb_buffer_t, decltype(&hb_buffer_destroy)> buffer(hb_buffer_create(), &hb_buffer_destroy);
+    hb_buffer_pre_allocate(buffer.get(), key.text.length());
+
+    hb_buffer_clear_contents(buffer.get());
+    hb_buffer_add_utf16(buffer.get(), uchar_to_utf16(key.text.getBuffer()), key.text.length(), 0, key.text.length());
+    hb_buffer_set_direction(buffer.get(), (key.dir == UBIDI_RTL)?HB_DIRECTION_RTL:HB_DIRECTION_LTR);
+    hb_buffer_set_script(buffer.get(), _icu_script_to_script(key.script));
+    hb_font_t *font(hb_ft_font_create(face.get_face(), nullptr));
+    // https://github.com/mapnik/test-data-visual/pull/25
+    #if HB_VERSION_MAJOR > 0
+     #if HB_VERSION_ATLEAST(1, 0 , 5)
+    FT_Int32 ft_load_flags = FT_LOAD_DEFAULT | FT_LOAD_NO_HINTING;
+    hb_ft_font_set_load_flags(font, ft_load_flags);
+     #endif
+    #endif
+    hb_shape(font, buffer.get(), ff_settings.get_features(), safe_cast<int>(ff_settings.count()));
+    hb_font_destroy(font);
+
+    const unsigned num_glyphs = hb_buffer_get_length(buffer.get());
+    hb_glyph_info_t const* glyphs = hb_buffer_get_glyph_infos(buffer.get(), nullptr);
+    hb_glyph_position_t const* positions = hb_buffer_get_glyph_positions(buffer.get(), nullptr);
+    auto run = std::make_shared<shaped_run>();
+    run->glyphs.assign(glyphs, glyphs + num_glyphs);
+    run->positions.assign(positions, positions + num_glyphs);
+    return run;
+}
+
 static void shape_text(text_line & line,
                        shaper_cache & s_cache,
                        text_itemizer & itemizer,
@@ -84,6 +129,7 @@ static void shape_text(text_line & line,
     line.reserve(length);
 
     mapnik::value_unicode_string const& text = itemizer.text();
+    shaped_run_cache & shared_cache = shaped_run_cache::instance();
 
     for (auto const& text_item : list)
     {
@@ -93,7 +139,7 @@ static void shape_text(text_line & line,
         std::size_t num_faces = face_set->size();
         std::size_t pos = 0;
         font_feature_settings const& ff_settings = text_item.format_->ff_settings;
-        int ff_count = safe_cast<int>(ff_settings.count());
+        std::size_t features = features_hash(ff_settings);
 
         // rendering information for a single glyph
         struct glyph_face_info
@@ -111,35 +157,23 @@ static void shape_text(text_line & line,
         {
             ++pos;
 
-            shaper_cache_key cache_key{text_item.script, text_item.dir, *face,
+            shaper_cache_key cache_key{text_item.script, text_item.dir, face->id(), features,
                 value_unicode_string(text, text_item.start, static_cast<int>(text_item.end - text_item.start)) };
-            hb_buffer_t * buffer = s_cache.find(cache_key);
+            shaped_run const* run = s_cache.find(cache_key);
 
-            if (!buffer)
+            if (!run)
             {
-                std::unique_ptr<hb_buffer_t, decltype(&hb_buffer_destroy)> new_buff(hb_buffer_create(),&hb_buffer_destroy);
-                hb_buffer_pre_allocate(new_buff.get(), cache_key.text.length());
-
-                hb_buffer_clear_contents(new_buff.get());
-                hb_buffer_add_utf16(new_buff.get(), uchar_to_utf16(cache_key.text.getBuffer()), cache_key.text.length(), 0, cache_key.text.length());
-                hb_buffer_set_direction(new_buff.get(), (text_item.dir == UBIDI_RTL)?HB_DIRECTION_RTL:HB_DIRECTION_LTR);
-                hb_buffer_set_script(new_buff.get(), _icu_script_to_script(text_item.script));
-                hb_font_t *font(hb_ft_font_create(face->get_face(), nullptr));
-                // https://github.com/mapnik/test-data-visual/pull/25
-                #if HB_VERSION_MAJOR > 0
-                 #if HB_VERSION_ATLEAST(1, 0 , 5)
-                FT_Int32 ft_load_flags = FT_LOAD_DEFAULT | FT_LOAD_NO_HINTING;
-                hb_ft_font_set_load_flags(font, ft_load_flags);
-                 #endif
-                #endif
-                hb_shape(font, new_buff.get(), ff_settings.get_features(), ff_count);
-                hb_font_destroy(font);
-
-                buffer = new_buff.get();
-                s_cache.insert(std::move(cache_key), std::move(new_buff));
+                shaped_run_ptr new_run = shared_cache.find(cache_key);
+                if (!new_run)
+                {
+                    new_run = shape_run(cache_key, *face, ff_settings);
+                    shared_cache.insert(cache_key, new_run);
+                }
+                run = new_run.get();
+                s_cache.insert(cache_key, new_run);
             }
 
-            const unsigned num_glyphs = hb_buffer_get_length(buffer);
+            const unsigned num_glyphs = static_cast<unsigned>(run->size());
 
             // if the number of rendered glyphs has increased, we need to resize the table 
             if (num_glyphs > glyphinfos.size())
@@ -147,8 +181,8 @@ static void shape_text(text_line & line,
                 glyphinfos.resize(num_glyphs);
             }
 
-            hb_glyph_info_t *glyphs = hb_buffer_get_glyph_infos(buffer, nullptr);
-            hb_glyph_position_t *positions = hb_buffer_get_glyph_positions(buffer, nullptr);
+            hb_glyph_info_t const* glyphs = run->glyphs.data();
+            hb_glyph_position_t const* positions = run->positions.data();
 
             // Check if all glyphs are valid.
             for (unsigned i=0; i<num_glyphs; ++i)
@@ -171,8 +205,8 @@ static void shape_text(text_line & line,
 
             for (unsigned i=0; i<num_glyphs; ++i)
             {
-                auto& gpos = positions[i];
-                auto& glyph = glyphs[i];
+                hb_glyph_position_t gpos = positions[i];
+                hb_glyph_info_t glyph = glyphs[i];
                 face_ptr theface = face;
                 if (glyphinfos[i].glyph.codepoint)
                 {
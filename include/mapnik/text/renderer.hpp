@@ -29,8 +29,10 @@
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/font_engine_freetype.hpp>
 #include <mapnik/text/glyph_positions.hpp>
+#include <mapnik/text/glyph_cache.hpp>
 #include <mapnik/value_types.hpp>
 #include <mapnik/pixel_position.hpp>
+#include <mapnik/box2d.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -59,23 +61,32 @@ struct rasterizer;
 struct glyph_t
 {
     glyph_info const& info;
-    FT_Glyph image;
+    FT_Glyph image; // null when the glyph is rasterized through glyph_cache
     pixel_position pos;
     rotation rot;
     double size;
     box2d<double> bbox;
+    FT_Matrix matrix;
+    FT_Vector pen;
+    FT_Int32 load_flags;
     glyph_t(glyph_info const& info_,
             FT_Glyph image_,
             pixel_position const& pos_,
             rotation const& rot_,
             double size_,
-            box2d<double> const& bbox_)
+            box2d<double> const& bbox_,
+            FT_Matrix const& matrix_,
+            FT_Vector const& pen_,
+            FT_Int32 load_flags_)
         : info(info_),
           image(image_),
           pos(pos_),
           rot(rot_),
           size(size_),
-          bbox(bbox_) {}
+          bbox(bbox_),
+          matrix(matrix_),
+          pen(pen_),
+          load_flags(load_flags_) {}
 };
 
 class text_renderer : private util::noncopyable
@@ -119,6 +130,14 @@ protected:
     using glyph_vector = std::vector<glyph_t>;
     void prepare_glyphs(glyph_positions const& positions, bool is_mono);
     FT_Error select_closest_size(glyph_info const& glyph, FT_Face & face) const;
+    FT_Error load_glyph(glyph_t const& glyph, FT_Glyph & image) const;
+    // Bitmap of the glyph translated by offset (26.6) from glyph_cache,
+    // rasterized on a miss. Halo glyphs are stroked by stroke_radius.
+    glyph_bitmap_ptr cached_bitmap(glyph_t const& glyph,
+                                   FT_Vector const& offset,
+                                   FT_Render_Mode mode,
+                                   double stroke_radius,
+                                   FT_Vector & origin) const;
     halo_rasterizer_e rasterizer_;
 
     composite_mode_e comp_op_;
@@ -133,8 +152,7 @@ protected:
 class halo_cache
 {
 public:
-    using key_type = std::tuple<std::string, // family
-                                std::string, // face
+    using key_type = std::tuple<std::size_t, // face id
                                 unsigned, // glyph index
                                 unsigned, // glyph height
                                 int>; // halo radius
@@ -167,10 +185,15 @@ public:
                        double scale_factor = 1.0,
                        stroker_ptr stroker = stroker_ptr());
     void render(glyph_positions const& positions);
+    // pixels touched by all glyphs rendered so far, max coordinates exclusive
+    box2d<int> const& painted_extent() const { return painted_extent_; }
 private:
     pixmap_type & pixmap_;
     halo_cache halo_cache_;
     rasterizer const & ras_;
+    box2d<int> painted_extent_;
+
+    void mark_painted(int x, int y, int width, int height);
 
     void render_halo(unsigned char *buffer,
                      unsigned width,
@@ -22,11 +22,15 @@
 #pragma once
 
 #include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/lru_cache.hpp>
 #include <mapnik/config.hpp>
 #include <mapnik/value.hpp>
 #include <mapnik/text/face.hpp>
 
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -45,7 +49,8 @@ struct shaper_cache_key
 {
     UScriptCode script;
     UBiDiDirection dir;
-    font_face const & face;
+    std::size_t face_id;
+    std::size_t features;
     value_unicode_string text;
 
     std::size_t hash() const
@@ -53,7 +58,8 @@ struct shaper_cache_key
         std::size_t h = text.hashCode();
         boost::hash_combine(h, script);
         boost::hash_combine(h, dir);
-        boost::hash_combine(h, &face);
+        boost::hash_combine(h, face_id);
+        boost::hash_combine(h, features);
         return h;
     }
 
@@ -62,12 +68,23 @@ struct shaper_cache_key
         return text == other.text &&
             script == other.script &&
             dir == other.dir &&
-            &face == &other.face;
+            face_id == other.face_id &&
+            features == other.features;
     }
+};
 
-    shaper_cache_key(shaper_cache_key &&) = default;
+// Glyphs and positions produced by HarfBuzz for one text item and face.
+// Runs are immutable once cached, so they can be shared between threads.
+struct shaped_run
+{
+    std::vector<hb_glyph_info_t> glyphs;
+    std::vector<hb_glyph_position_t> positions;
+
+    std::size_t size() const { return glyphs.size(); }
 };
 
+using shaped_run_ptr = std::shared_ptr<const shaped_run>;
+
 struct glyph_metrics_cache_key
 {
     unsigned glyph_index;
@@ -115,9 +132,32 @@ namespace std
 namespace mapnik
 {
 
+// Process wide cache of shaped runs shared by all renderers and threads,
+// so labels repeating across tiles are shaped only once. It is disabled
+// until a capacity (approximate size in bytes) is set.
+class MAPNIK_DECL shaped_run_cache :
+        public singleton<shaped_run_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<shaped_run_cache>;
+    using cache_type = util::sharded_lru_cache<shaper_cache_key, shaped_run_ptr>;
+    cache_type cache_;
+public:
+    static void set_capacity(std::size_t bytes);
+    bool enabled() const { return cache_.enabled(); }
+    shaped_run_ptr find(shaper_cache_key const& key);
+    void insert(shaper_cache_key const& key, shaped_run_ptr const& run);
+    void clear();
+    util::lru_cache_stats stats() const;
+};
+
+extern template class MAPNIK_DECL singleton<shaped_run_cache, CreateStatic>;
+
+// Per renderer cache, shaped runs are backed by the process wide
+// shaped_run_cache when it is enabled.
 class shaper_cache : private util::noncopyable
 {
-    using value_type = std::unique_ptr<hb_buffer_t, decltype(&hb_buffer_destroy)>;
+    using value_type = shaped_run_ptr;
 
     using cache_type = std::unordered_map<shaper_cache_key, value_type>;
     cache_type cache_;
@@ -126,7 +166,7 @@ class shaper_cache : private util::noncopyable
     glyph_metrics_cache_type metrics_cache_;
 
 public:
-    hb_buffer_t * find(shaper_cache_key const & key) const
+    shaped_run const* find(shaper_cache_key const & key) const
     {
         auto it = cache_.find(key);
         if (it != cache_.end()) {
@@ -135,12 +175,9 @@ public:
         return nullptr;
     }
 
-    bool insert(shaper_cache_key && key, value_type && value)
+    bool insert(shaper_cache_key const & key, value_type const & value)
     {
-        auto result = cache_.emplace(
-            std::piecewise_construct,
-            std::forward_as_tuple(std::move(key)),
-            std::forward_as_tuple(std::move(value)));
+        auto result = cache_.emplace(key, value);
         return result.second;
     }
 
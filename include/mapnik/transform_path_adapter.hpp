@@ -27,6 +27,7 @@
 #include <mapnik/vertex.hpp>
 #include <mapnik/config.hpp>
 
+#include <array>
 #include <cstddef>
 
 namespace mapnik  {
@@ -61,12 +62,16 @@ struct transform_path_adapter
                            proj_transform const& prj_trans)
         : t_(&_t),
           geom_(_geom),
-          prj_trans_(&prj_trans)  {}
+          prj_trans_(&prj_trans),
+          size_(0),
+          pos_(0) {}
 
     explicit transform_path_adapter(Geometry & _geom)
         : t_(0),
           geom_(_geom),
-          prj_trans_(0)  {}
+          prj_trans_(0),
+          size_(0),
+          pos_(0) {}
 
     void set_proj_trans(proj_transform const& prj_trans)
     {
@@ -81,20 +86,26 @@ struct transform_path_adapter
     unsigned vertex(double *x, double *y) const
     {
         unsigned command;
-        bool ok = false;
         bool skipped_points = false;
-        while (!ok)
+        while (true)
         {
-            command = geom_.vertex(x,y);
+            if (pos_ == size_)
+            {
+                fill();
+            }
+            std::size_t i = pos_++;
+            command = commands_[i];
+            *x = xs_[i];
+            *y = ys_[i];
             if (command == SEG_END || command == SEG_CLOSE)
             {
                 return command;
             }
-            double z=0;
-            ok = prj_trans_->backward(*x, *y, z);
-            if (!ok) {
-                skipped_points = true;
+            if (ok_[i])
+            {
+                break;
             }
+            skipped_points = true;
         }
         if (skipped_points && (command == SEG_LINETO))
         {
@@ -107,6 +118,8 @@ struct transform_path_adapter
     void rewind(unsigned pos) const
     {
         geom_.rewind(pos);
+        size_ = 0;
+        pos_ = 0;
     }
 
     unsigned type() const
@@ -120,9 +133,78 @@ struct transform_path_adapter
     }
 
 private:
+    // Vertices are read ahead and reprojected in batches, proj4 transforms
+    // have a large cost per call.
+    static constexpr std::size_t batch_size = 64;
+
+    void fill() const
+    {
+        size_ = 0;
+        pos_ = 0;
+        while (size_ < batch_size)
+        {
+            unsigned command = geom_.vertex(&xs_[size_], &ys_[size_]);
+            commands_[size_++] = command;
+            if (command == SEG_END) break;
+        }
+        if (prj_trans_->equal())
+        {
+            ok_.fill(true);
+            return;
+        }
+        std::array<double, batch_size> xs;
+        std::array<double, batch_size> ys;
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < size_; ++i)
+        {
+            if (commands_[i] != SEG_END && commands_[i] != SEG_CLOSE)
+            {
+                xs[count] = xs_[i];
+                ys[count] = ys_[i];
+                ++count;
+            }
+        }
+        if (count == 0)
+        {
+            return;
+        }
+        if (prj_trans_->backward(xs.data(), ys.data(), nullptr, static_cast<int>(count)))
+        {
+            count = 0;
+            for (std::size_t i = 0; i < size_; ++i)
+            {
+                if (commands_[i] != SEG_END && commands_[i] != SEG_CLOSE)
+                {
+                    xs_[i] = xs[count];
+                    ys_[i] = ys[count];
+                    ok_[i] = true;
+                    ++count;
+                }
+            }
+        }
+        else
+        {
+            // find the vertices which can't be reprojected
+            for (std::size_t i = 0; i < size_; ++i)
+            {
+                if (commands_[i] != SEG_END && commands_[i] != SEG_CLOSE)
+                {
+                    double z = 0;
+                    ok_[i] = prj_trans_->backward(xs_[i], ys_[i], z);
+                }
+            }
+        }
+    }
+
     Transform const* t_;
     Geometry & geom_;
     proj_transform const* prj_trans_;
+    mutable std::array<double, batch_size> xs_;
+    mutable std::array<double, batch_size> ys_;
+    mutable std::array<unsigned, batch_size> commands_;
+    mutable std::array<bool, batch_size> ok_;
+    mutable std::size_t size_;
+    mutable std::size_t pos_;
 };
 
 
@@ -42,6 +42,9 @@ MAPNIK_DECL std::string make_absolute(std::string const& filepath, std::string c
 MAPNIK_DECL std::string dirname(std::string const& value);
 MAPNIK_DECL std::string basename(std::string const& value);
 MAPNIK_DECL std::vector<std::string> list_directory(std::string const& value);
+// Creates a new empty file named after model with each '%' replaced by
+// a random hexadecimal digit, returns its name. Throws if none could be created.
+MAPNIK_DECL std::string create_unique_file(std::string const& model);
 
 }}
 
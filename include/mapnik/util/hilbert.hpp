@@ -0,0 +1,100 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_HILBERT_HPP
+#define MAPNIK_UTIL_HILBERT_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+
+// stl
+#include <algorithm>
+#include <cstdint>
+
+namespace mapnik { namespace util {
+
+// Position of (x, y) on the Hilbert curve filling 2^16 x 2^16 grid.
+// Branchless algorithm by http://threadlocalmutex.com/?p=126
+inline std::uint32_t hilbert_index(std::uint32_t x, std::uint32_t y)
+{
+    std::uint32_t a = x ^ y;
+    std::uint32_t b = 0xFFFF ^ a;
+    std::uint32_t c = 0xFFFF ^ (x | y);
+    std::uint32_t d = x & (y ^ 0xFFFF);
+
+    std::uint32_t A = a | (b >> 1);
+    std::uint32_t B = (a >> 1) ^ a;
+    std::uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    std::uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    std::uint32_t i0 = x ^ y;
+    std::uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+// Hilbert index of the box center within the extent,
+// centers outside of the extent are clamped to its border.
+inline std::uint32_t hilbert_index(box2d<double> const& box, box2d<double> const& extent)
+{
+    const double max_coord = 0xFFFF;
+    double width = extent.width() > 0 ? extent.width() : 1.0;
+    double height = extent.height() > 0 ? extent.height() : 1.0;
+    double x = max_coord * ((box.minx() + box.maxx()) / 2.0 - extent.minx()) / width;
+    double y = max_coord * ((box.miny() + box.maxy()) / 2.0 - extent.miny()) / height;
+    x = x > 0.0 ? std::min(x, max_coord) : 0.0;
+    y = y > 0.0 ? std::min(y, max_coord) : 0.0;
+    return hilbert_index(static_cast<std::uint32_t>(x), static_cast<std::uint32_t>(y));
+}
+
+}}
+
+#endif // MAPNIK_UTIL_HILBERT_HPP
@@ -0,0 +1,246 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_LRU_CACHE_HPP
+#define MAPNIK_UTIL_LRU_CACHE_HPP
+
+// mapnik
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mapnik { namespace util {
+
+struct lru_cache_stats
+{
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t cost = 0;
+};
+
+// Size bounded LRU cache split into independently locked shards.
+// Every entry carries a cost (e.g. its size in bytes), the least recently
+// used entries of a shard are evicted once the shard exceeds its share
+// of the capacity. Capacity 0 disables the cache.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class sharded_lru_cache : private util::noncopyable
+{
+public:
+    explicit sharded_lru_cache(std::size_t capacity = 0, std::size_t shards = 16)
+        : shards_(std::max<std::size_t>(shards, 1)),
+          capacity_(capacity),
+          hits_(0),
+          misses_(0),
+          evictions_(0)
+    {
+        for (auto & s : shards_)
+        {
+            s.reset(new shard);
+        }
+    }
+
+    bool enabled() const
+    {
+        return capacity_.load(std::memory_order_relaxed) > 0;
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_.load(std::memory_order_relaxed);
+    }
+
+    // Shrinking the capacity evicts entries lazily on next insertion.
+    void set_capacity(std::size_t capacity)
+    {
+        capacity_ = capacity;
+        if (capacity == 0)
+        {
+            clear();
+        }
+    }
+
+    bool find(Key const& key, Value & value)
+    {
+        if (!enabled()) return false;
+        std::size_t h = Hash()(key);
+        shard & s = shard_for(h);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto itr = s.index.find(key);
+        if (itr == s.index.end())
+        {
+            ++misses_;
+            return false;
+        }
+        s.entries.splice(s.entries.begin(), s.entries, itr->second);
+        value = itr->second->value;
+        ++hits_;
+        return true;
+    }
+
+    void insert(Key const& key, Value const& value, std::size_t cost)
+    {
+        std::size_t limit = capacity() / shards_.size();
+        if (cost > limit) return;
+        std::size_t h = Hash()(key);
+        shard & s = shard_for(h);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto itr = s.index.find(key);
+        if (itr != s.index.end())
+        {
+            s.cost -= itr->second->cost;
+            s.entries.erase(itr->second);
+            s.index.erase(itr);
+        }
+        s.entries.push_front(entry{key, value, cost});
+        s.index.emplace(key, s.entries.begin());
+        s.cost += cost;
+        while (s.cost > limit)
+        {
+            entry const& last = s.entries.back();
+            s.cost -= last.cost;
+            s.index.erase(last.key);
+            s.entries.pop_back();
+            ++evictions_;
+        }
+    }
+
+    bool erase(Key const& key)
+    {
+        std::size_t h = Hash()(key);
+        shard & s = shard_for(h);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto itr = s.index.find(key);
+        if (itr == s.index.end())
+        {
+            return false;
+        }
+        s.cost -= itr->second->cost;
+        s.entries.erase(itr->second);
+        s.index.erase(itr);
+        return true;
+    }
+
+    // Removes all entries for which pred(key, value) holds.
+    template <typename Predicate>
+    std::size_t erase_if(Predicate pred)
+    {
+        std::size_t count = 0;
+        for (auto & s : shards_)
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            for (auto itr = s->entries.begin(); itr != s->entries.end();)
+            {
+                if (pred(itr->key, itr->value))
+                {
+                    s->cost -= itr->cost;
+                    s->index.erase(itr->key);
+                    itr = s->entries.erase(itr);
+                    ++count;
+                }
+                else
+                {
+                    ++itr;
+                }
+            }
+        }
+        return count;
+    }
+
+    void clear()
+    {
+        for (auto & s : shards_)
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            s->index.clear();
+            s->entries.clear();
+            s->cost = 0;
+        }
+    }
+
+    lru_cache_stats stats() const
+    {
+        lru_cache_stats result;
+        result.hits = hits_.load(std::memory_order_relaxed);
+        result.misses = misses_.load(std::memory_order_relaxed);
+        result.evictions = evictions_.load(std::memory_order_relaxed);
+        for (auto const& s : shards_)
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            result.entries += s->index.size();
+            result.cost += s->cost;
+        }
+        return result;
+    }
+
+    void reset_stats()
+    {
+        hits_ = 0;
+        misses_ = 0;
+        evictions_ = 0;
+    }
+
+private:
+    struct entry
+    {
+        Key key;
+        Value value;
+        std::size_t cost;
+    };
+
+    using entry_list = std::list<entry>;
+
+    struct shard
+    {
+        std::mutex mutex;
+        entry_list entries;
+        std::unordered_map<Key, typename entry_list::iterator, Hash> index;
+        std::size_t cost = 0;
+    };
+
+    shard & shard_for(std::size_t hash)
+    {
+        // Low bits select the bucket inside the shard's map.
+        return *shards_[(hash >> 16) % shards_.size()];
+    }
+
+    std::vector<std::unique_ptr<shard>> shards_;
+    std::atomic<std::size_t> capacity_;
+    std::atomic<std::size_t> hits_;
+    std::atomic<std::size_t> misses_;
+    std::atomic<std::size_t> evictions_;
+};
+
+}}
+
+#endif // MAPNIK_UTIL_LRU_CACHE_HPP
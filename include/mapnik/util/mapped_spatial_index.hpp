@@ -0,0 +1,215 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_MAPPED_SPATIAL_INDEX_HPP
+#define MAPNIK_UTIL_MAPPED_SPATIAL_INDEX_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/box2d.hpp>
+#include <mapnik/mapped_memory_cache.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
+
+// stl
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mapnik { namespace util {
+
+// Quadtree node of an index file written by shapeindex or mapnik-index,
+// read in place. Children of a node follow each other, the first one
+// starts at children and the next one at the end of the previous one.
+struct MAPNIK_DECL spatial_index_node
+{
+    box2d<double> envelope;
+    char const* values;
+    std::uint32_t num_values;
+    std::uint32_t num_children;
+    char const* children;
+    // end of the node including all of its children
+    char const* end;
+
+    // Throws std::runtime_error if the node does not fit in [data, data_end).
+    static spatial_index_node read(char const* data, char const* data_end, std::size_t value_size);
+};
+
+// Index file mapped into memory and queried without copying nodes. The
+// upper levels of a quadtree are decoded once and shared by all queries,
+// packed Hilbert trees are queried directly; results are the same as of
+// spatial_index::query and query_first_n.
+class MAPNIK_DECL mapped_spatial_index : private util::noncopyable
+{
+public:
+    // Throws std::runtime_error if the region is not an index file.
+    mapped_spatial_index(mapped_region_ptr const& region, std::size_t value_size);
+
+    // Index of the file shared by all callers, it is mapped again once the
+    // file is replaced or modified. Throws std::runtime_error if the file
+    // can't be mapped or is not an index file.
+    static std::shared_ptr<mapped_spatial_index const> open(std::string const& filename,
+                                                            std::size_t value_size);
+    static void clear_cache();
+
+    box2d<double> const& bounding_box() const
+    {
+        return extent_;
+    }
+
+    bool packed() const
+    {
+        return packed_;
+    }
+
+    std::size_t cached_nodes() const
+    {
+        return nodes_.size();
+    }
+
+    template <typename Value, typename Filter>
+    void query(Filter const& filter, std::vector<Value> & results) const
+    {
+        query_first_n(filter, results, std::numeric_limits<std::size_t>::max());
+    }
+
+    template <typename Value, typename Filter>
+    void query_first_n(Filter const& filter, std::vector<Value> & results, std::size_t count) const
+    {
+        static_assert(std::is_standard_layout<Value>::value, "Values stored in quad-tree must be standard layout type");
+        if (sizeof(Value) != value_size_)
+        {
+            throw std::runtime_error("mapped_spatial_index: value size does not match");
+        }
+        if (packed_)
+        {
+            mapped_reader reader{data_, data_end_};
+            query_packed_index(header_, reader, filter, results, count);
+            return;
+        }
+        query_cached(0, filter, results, count);
+    }
+
+private:
+    struct mapped_reader
+    {
+        char const* data;
+        char const* data_end;
+
+        char const* read(std::uint64_t offset, std::size_t size) const
+        {
+            std::size_t available = static_cast<std::size_t>(data_end - data);
+            if (offset > available || size > available - offset)
+            {
+                throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+            }
+            return data + offset;
+        }
+    };
+
+    void init_quadtree();
+    void init_packed();
+
+    struct cached_node
+    {
+        spatial_index_node node;
+        // index of the first decoded child, 0 if children are not decoded
+        std::uint32_t first_child;
+    };
+
+    template <typename Value, typename Filter>
+    static bool add_values(spatial_index_node const& node, Filter const& filter,
+                           std::vector<Value> & results, std::size_t count)
+    {
+        if (results.size() >= count || !filter.pass(node.envelope))
+        {
+            return false;
+        }
+        char const* ptr = node.values;
+        for (std::uint32_t i = 0; i < node.num_values; ++i, ptr += sizeof(Value))
+        {
+            Value item;
+            std::memcpy(reinterpret_cast<char*>(&item), ptr, sizeof(Value));
+            if (results.size() < count) results.push_back(std::move(item));
+        }
+        return true;
+    }
+
+    template <typename Value, typename Filter>
+    void query_cached(std::size_t index, Filter const& filter,
+                      std::vector<Value> & results, std::size_t count) const
+    {
+        cached_node const& cached = nodes_[index];
+        if (!add_values(cached.node, filter, results, count))
+        {
+            return;
+        }
+        if (cached.first_child != 0)
+        {
+            for (std::uint32_t i = 0; i < cached.node.num_children; ++i)
+            {
+                query_cached(cached.first_child + i, filter, results, count);
+            }
+            return;
+        }
+        char const* child = cached.node.children;
+        for (std::uint32_t i = 0; i < cached.node.num_children; ++i)
+        {
+            child = query_mapped(child, filter, results, count);
+        }
+    }
+
+    // Returns the end of the node
+    template <typename Value, typename Filter>
+    char const* query_mapped(char const* data, Filter const& filter,
+                             std::vector<Value> & results, std::size_t count) const
+    {
+        spatial_index_node node = spatial_index_node::read(data, data_end_, value_size_);
+        if (add_values(node, filter, results, count))
+        {
+            char const* child = node.children;
+            for (std::uint32_t i = 0; i < node.num_children; ++i)
+            {
+                child = query_mapped(child, filter, results, count);
+            }
+        }
+        return node.end;
+    }
+
+    mapped_region_ptr region_;
+    char const* data_;
+    char const* data_end_;
+    std::size_t value_size_;
+    bool packed_;
+    box2d<double> extent_;
+    packed_index_header header_;
+    std::vector<cached_node> nodes_;
+};
+
+}}
+
+#endif // MAPNIK_UTIL_MAPPED_SPATIAL_INDEX_HPP
@@ -0,0 +1,251 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_PACKED_SPATIAL_INDEX_HPP
+#define MAPNIK_UTIL_PACKED_SPATIAL_INDEX_HPP
+
+// mapnik
+#include <mapnik/box2d.hpp>
+
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace mapnik { namespace util {
+
+// Static packed Hilbert R-tree written by packed_hilbert_tree. Items are
+// sorted along the Hilbert curve and grouped into nodes of node_size
+// children, every level is stored contiguously. Numbers are stored in
+// native byte order like in the quadtree format:
+//
+//   char[14]        "mapnik-hilbert"
+//   uint16          format version
+//   uint32          value size
+//   uint32          node size
+//   uint64          number of items
+//   uint32          number of levels
+//   uint32          reserved
+//   double[4]       extent
+//   uint64[L + 1]   index of the first node of each level, leaves first
+//   double[4][N]    boxes of all nodes, the leaves are boxes of the items
+//   values[items]   values of the leaves in the same order
+//
+// Children of node i of level l > 0 are the nodes of level l - 1
+// starting at first[l - 1] + (i - first[l]) * node_size.
+struct packed_index_header
+{
+    static constexpr char const* magic = "mapnik-hilbert";
+    static constexpr std::size_t magic_size = 14;
+    static constexpr std::uint16_t version = 1;
+    static constexpr std::size_t fixed_size = 72;
+    static constexpr std::size_t box_size = sizeof(box2d<double>);
+
+    std::uint32_t value_size = 0;
+    std::uint32_t node_size = 0;
+    std::uint64_t num_items = 0;
+    std::uint32_t num_levels = 0;
+    box2d<double> extent;
+    std::vector<std::uint64_t> level_bounds;
+
+    static bool is_packed(char const* header)
+    {
+        std::uint16_t v;
+        std::memcpy(&v, header + magic_size, sizeof(v));
+        return std::memcmp(header, magic, magic_size) == 0 && v == version;
+    }
+
+    // Index of the first node of each level for num_items leaves.
+    static std::vector<std::uint64_t> make_level_bounds(std::uint64_t num_items, std::uint64_t node_size)
+    {
+        std::vector<std::uint64_t> bounds{0};
+        std::uint64_t nodes = num_items;
+        while (nodes > 0)
+        {
+            bounds.push_back(bounds.back() + nodes);
+            if (nodes == 1) break;
+            nodes = (nodes + node_size - 1) / node_size;
+        }
+        return bounds;
+    }
+
+    // Writes the fixed part of fixed_size bytes.
+    void write_fixed(char * data) const
+    {
+        std::memset(data, 0, fixed_size);
+        std::memcpy(data, magic, magic_size);
+        std::uint16_t v = version;
+        std::memcpy(data + 14, &v, 2);
+        std::memcpy(data + 16, &value_size, 4);
+        std::memcpy(data + 20, &node_size, 4);
+        std::memcpy(data + 24, &num_items, 8);
+        std::memcpy(data + 32, &num_levels, 4);
+        std::memcpy(data + 40, reinterpret_cast<char const*>(&extent), box_size);
+    }
+
+    // Reads the fixed part, throws std::runtime_error if it's not a valid index.
+    void read_fixed(char const* data)
+    {
+        if (!is_packed(data))
+        {
+            throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+        }
+        std::memcpy(&value_size, data + 16, 4);
+        std::memcpy(&node_size, data + 20, 4);
+        std::memcpy(&num_items, data + 24, 8);
+        std::memcpy(&num_levels, data + 32, 4);
+        std::memcpy(reinterpret_cast<char*>(&extent), data + 40, box_size);
+        if (value_size == 0 || node_size < 2 || num_levels > 64 || (num_items > 0) != (num_levels > 0))
+        {
+            throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+        }
+    }
+
+    std::size_t levels_size() const
+    {
+        return 8 * (num_levels + 1);
+    }
+
+    // Reads the level bounds following the fixed part.
+    void read_levels(char const* data)
+    {
+        level_bounds.resize(num_levels + 1);
+        std::memcpy(level_bounds.data(), data, levels_size());
+        // leaves are the items, the top level is the root node
+        if (level_bounds.front() != 0 ||
+            (num_levels > 0 && (level_bounds[1] != num_items ||
+                                level_bounds[num_levels] - level_bounds[num_levels - 1] != 1)))
+        {
+            throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+        }
+        for (std::size_t i = 1; i < level_bounds.size(); ++i)
+        {
+            if (level_bounds[i] < level_bounds[i - 1])
+            {
+                throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+            }
+        }
+    }
+
+    std::uint64_t num_nodes() const
+    {
+        return level_bounds.empty() ? 0 : level_bounds.back();
+    }
+
+    std::uint64_t boxes_offset() const
+    {
+        return fixed_size + levels_size();
+    }
+
+    std::uint64_t values_offset() const
+    {
+        return boxes_offset() + box_size * num_nodes();
+    }
+
+    std::uint64_t file_size() const
+    {
+        return values_offset() + value_size * num_items;
+    }
+};
+
+// Queries the tree level by level, so every level is read front to back.
+// Reader::read(offset, size) returns a pointer to size bytes of the index
+// at offset, valid until the next call. Results are the values whose boxes
+// pass the filter, in the order of the Hilbert curve.
+template <typename Value, typename Filter, typename Reader>
+void query_packed_index(packed_index_header const& header, Reader & reader, Filter const& filter,
+                        std::vector<Value> & results, std::size_t count)
+{
+    if (header.value_size != sizeof(Value))
+    {
+        throw std::runtime_error("Index file values do not match the datasource (regenerate the index)");
+    }
+    if (header.num_levels == 0 || results.size() >= count)
+    {
+        return;
+    }
+    std::size_t const box_size = packed_index_header::box_size;
+    std::vector<std::uint64_t> current;
+    std::vector<std::uint64_t> next;
+
+    std::uint64_t root = header.level_bounds[header.num_levels - 1];
+    box2d<double> box;
+    std::memcpy(reinterpret_cast<char*>(&box),
+                reader.read(header.boxes_offset() + root * box_size, box_size), box_size);
+    if (!filter.pass(box))
+    {
+        return;
+    }
+    current.push_back(root);
+
+    for (std::uint32_t level = header.num_levels - 1; level > 0; --level)
+    {
+        std::uint64_t level_begin = header.level_bounds[level];
+        std::uint64_t child_level_begin = header.level_bounds[level - 1];
+        std::uint64_t child_level_end = header.level_bounds[level];
+        next.clear();
+        for (std::uint64_t node : current)
+        {
+            std::uint64_t first = child_level_begin + (node - level_begin) * header.node_size;
+            std::uint64_t last = std::min(first + header.node_size, child_level_end);
+            if (first >= last) continue;
+            char const* boxes = reader.read(header.boxes_offset() + first * box_size, (last - first) * box_size);
+            for (std::uint64_t child = first; child < last; ++child, boxes += box_size)
+            {
+                std::memcpy(reinterpret_cast<char*>(&box), boxes, box_size);
+                if (filter.pass(box))
+                {
+                    next.push_back(child);
+                }
+            }
+        }
+        current.swap(next);
+        if (current.empty())
+        {
+            return;
+        }
+    }
+
+    // read values of consecutive leaves at once
+    for (std::size_t i = 0; i < current.size() && results.size() < count;)
+    {
+        std::size_t j = i + 1;
+        while (j < current.size() && current[j] == current[j - 1] + 1 && j - i < count - results.size())
+        {
+            ++j;
+        }
+        char const* values = reader.read(header.values_offset() + current[i] * sizeof(Value),
+                                         (j - i) * sizeof(Value));
+        for (; i < j; ++i, values += sizeof(Value))
+        {
+            Value item;
+            std::memcpy(reinterpret_cast<char*>(&item), values, sizeof(Value));
+            results.push_back(std::move(item));
+        }
+    }
+}
+
+}}
+
+#endif // MAPNIK_UTIL_PACKED_SPATIAL_INDEX_HPP
@@ -23,8 +23,13 @@
 #ifndef MAPNIK_PARALLELIZE
 #define MAPNIK_PARALLELIZE
 
-#include <vector>
+#include <mapnik/util/thread_pool.hpp>
+
+#include <algorithm>
+#include <exception>
 #include <future>
+#include <thread>
+#include <vector>
 
 namespace mapnik {
 
@@ -43,21 +48,45 @@ void parallelize(Func func, unsigned jobs, unsigned work_size)
         jobs = 1;
     }
 
-    std::vector<std::future<void>> futures(jobs);
-    std::launch launch(jobs == 1 ? std::launch::deferred : std::launch::async);
+    if (jobs == 1)
+    {
+        func(0, work_size);
+        return;
+    }
+
+    thread_pool & pool = global_thread_pool::instance();
+    std::vector<std::future<void>> futures;
+    futures.reserve(jobs - 1);
 
-    for (std::size_t i = 0; i < jobs; i++)
+    for (std::size_t i = 0; i < jobs - 1; i++)
     {
         unsigned chunk_begin = i * chunk_size;
         unsigned chunk_end = (i + 1) * chunk_size;
+        futures.emplace_back(pool.submit(func, chunk_begin, chunk_end));
+    }
+
+    // Last chunk handles remainder of size / jobs and runs
+    // on the calling thread
+    std::exception_ptr error;
+    try
+    {
+        func((jobs - 1) * chunk_size, work_size);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
 
-        // Handle remainder of size / jobs
-        if (i == jobs - 1)
-        {
-            chunk_end = work_size;
-        }
+    // Chunks may reference the caller's data, all of them
+    // have to finish before leaving this function
+    for (auto & f : futures)
+    {
+        pool.wait(f);
+    }
 
-        futures[i] = std::async(launch, func, chunk_begin, chunk_end);
+    if (error)
+    {
+        std::rethrow_exception(error);
     }
 
     for (auto & f : futures)
@@ -0,0 +1,66 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_SIMD_COMPOSITE_HPP
+#define MAPNIK_UTIL_SIMD_COMPOSITE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/image_compositing.hpp>
+
+// stl
+#include <cstddef>
+#include <cstdint>
+
+namespace mapnik { namespace util {
+
+enum class simd_level
+{
+    none,
+    sse41,
+    avx2
+};
+
+// Best instruction set supported by the running CPU.
+MAPNIK_DECL simd_level cpu_simd_level();
+
+// Instruction set used by composite(), defaults to cpu_simd_level().
+// Requests above the CPU capabilities are lowered to them,
+// simd_level::none forces the AGG implementation.
+MAPNIK_DECL simd_level composite_simd_level();
+MAPNIK_DECL void set_composite_simd_level(simd_level level);
+
+// Blends length premultiplied rgba8 pixels of src onto dst,
+// src pixels are scaled by cover (0-255) first. Results are
+// identical to the corresponding agg::comp_op_rgba_* blender.
+using composite_kernel = void (*)(std::uint8_t * dst,
+                                  std::uint8_t const* src,
+                                  std::size_t length,
+                                  unsigned cover);
+
+// Vectorized kernel of the mode, nullptr if the mode is not
+// accelerated or the level is not supported.
+MAPNIK_DECL composite_kernel simd_composite_kernel(composite_mode_e mode, simd_level level);
+
+}}
+
+#endif // MAPNIK_UTIL_SIMD_COMPOSITE_HPP
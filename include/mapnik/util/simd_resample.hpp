@@ -0,0 +1,82 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_SIMD_RESAMPLE_HPP
+#define MAPNIK_UTIL_SIMD_RESAMPLE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/simd_composite.hpp>
+
+// stl
+#include <cstddef>
+#include <cstdint>
+
+namespace mapnik { namespace util {
+
+// Premultiplied rgba8 pixels sampled with coordinates clamped
+// to the edges, like agg::image_accessor_clone does.
+struct rgba8_source
+{
+    std::uint8_t const* data;
+    int width;
+    int height;
+    int stride;
+};
+
+// Samples length pixels at subpixel coordinates (1/256 of a pixel) with
+// the filter offset already subtracted. Results are identical to
+// agg::span_image_filter_rgba_bilinear.
+using bilinear_kernel = void (*)(std::uint8_t * dst,
+                                 rgba8_source const& src,
+                                 int const* xs,
+                                 int const* ys,
+                                 std::size_t length);
+
+// Filter state of agg::span_image_resample_affine after prepare().
+struct resample_params
+{
+    int diameter;
+    int rx;
+    int ry;
+    int rx_inv;
+    int ry_inv;
+    std::int16_t const* weight_array;
+};
+
+// Samples length pixels at subpixel coordinates already moved by the
+// filter offset and radius. Results are identical to
+// agg::span_image_resample_rgba_affine.
+using resample_kernel = void (*)(std::uint8_t * dst,
+                                 rgba8_source const& src,
+                                 resample_params const& params,
+                                 int const* xs,
+                                 int const* ys,
+                                 std::size_t length);
+
+// Vectorized kernels, nullptr if the level is not supported.
+MAPNIK_DECL bilinear_kernel simd_bilinear_kernel(simd_level level);
+MAPNIK_DECL resample_kernel simd_resample_kernel(simd_level level);
+
+}}
+
+#endif // MAPNIK_UTIL_SIMD_RESAMPLE_HPP
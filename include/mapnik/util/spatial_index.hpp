@@ -28,9 +28,12 @@
 #include <mapnik/box2d.hpp>
 #include <mapnik/query.hpp>
 #include <mapnik/geom_util.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
 // stl
 #include <type_traits>
 #include <cstring>
+#include <limits>
+#include <vector>
 
 using mapnik::box2d;
 using mapnik::query;
@@ -38,15 +41,47 @@ using mapnik::query;
 namespace mapnik { namespace util {
 
 
+enum class spatial_index_format
+{
+    invalid,
+    quadtree,
+    packed_hilbert
+};
+
 template <typename InputStream>
-bool check_spatial_index(InputStream& in)
+spatial_index_format read_spatial_index_format(InputStream& in)
 {
-    char header[17]; // mapnik-index
+    char header[17]; // mapnik-index or mapnik-hilbert
     std::memset(header, 0, 17);
     in.read(header,16);
-    return (std::strncmp(header, "mapnik-index",12) == 0);
+    if (std::strncmp(header, "mapnik-index",12) == 0) return spatial_index_format::quadtree;
+    if (packed_index_header::is_packed(header)) return spatial_index_format::packed_hilbert;
+    return spatial_index_format::invalid;
+}
+
+template <typename InputStream>
+bool check_spatial_index(InputStream& in)
+{
+    return read_spatial_index_format(in) != spatial_index_format::invalid;
 }
 
+// Reads parts of a packed index from a stream
+template <typename InputStream>
+struct packed_index_stream_reader
+{
+    InputStream & in;
+    std::vector<char> buffer;
+
+    char const* read(std::uint64_t offset, std::size_t size)
+    {
+        buffer.resize(size);
+        in.seekg(offset, std::ios::beg);
+        in.read(buffer.data(), size);
+        if (!in) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+        return buffer.data();
+    }
+};
+
 template <typename Value, typename Filter, typename InputStream, typename BBox = box2d<double> >
 class spatial_index
 {
@@ -64,13 +99,22 @@ private:
     static void read_envelope(InputStream& in, bbox_type& envelope);
     static void query_node(Filter const& filter, InputStream& in, std::vector<Value> & results);
     static void query_first_n_impl(Filter const& filter, InputStream& in, std::vector<Value> & results, std::size_t count);
+    static packed_index_header read_packed_header(InputStream& in);
+    static void query_packed(Filter const& filter, InputStream& in, std::vector<Value>& results, std::size_t count);
 };
 
 template <typename Value, typename Filter, typename InputStream, typename BBox>
 BBox spatial_index<Value, Filter, InputStream, BBox>::bounding_box(InputStream& in)
 {
     static_assert(std::is_standard_layout<Value>::value, "Values stored in quad-tree must be standard layout type");
-    if (!check_spatial_index(in)) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    spatial_index_format format = read_spatial_index_format(in);
+    if (format == spatial_index_format::packed_hilbert)
+    {
+        packed_index_header header = read_packed_header(in);
+        in.seekg(0, std::ios::beg);
+        return BBox(header.extent.minx(), header.extent.miny(), header.extent.maxx(), header.extent.maxy());
+    }
+    if (format != spatial_index_format::quadtree) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
     in.seekg(16 + 4, std::ios::beg);
     typename spatial_index<Value, Filter, InputStream, BBox>::bbox_type box;
     read_envelope(in, box);
@@ -82,7 +126,13 @@ template <typename Value, typename Filter, typename InputStream, typename BBox>
 void spatial_index<Value, Filter, InputStream, BBox>::query(Filter const& filter, InputStream& in, std::vector<Value>& results)
 {
     static_assert(std::is_standard_layout<Value>::value, "Values stored in quad-tree must be standard layout type");
-    if (!check_spatial_index(in)) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    spatial_index_format format = read_spatial_index_format(in);
+    if (format == spatial_index_format::packed_hilbert)
+    {
+        query_packed(filter, in, results, std::numeric_limits<std::size_t>::max());
+        return;
+    }
+    if (format != spatial_index_format::quadtree) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
     in.seekg(16, std::ios::beg);
     query_node(filter, in, results);
 }
@@ -118,11 +168,35 @@ template <typename Value, typename Filter, typename InputStream, typename BBox>
 void spatial_index<Value, Filter, InputStream, BBox>::query_first_n(Filter const& filter, InputStream& in, std::vector<Value>& results, std::size_t count)
 {
     static_assert(std::is_standard_layout<Value>::value, "Values stored in quad-tree must be standard layout type");
-    if (!check_spatial_index(in)) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    spatial_index_format format = read_spatial_index_format(in);
+    if (format == spatial_index_format::packed_hilbert)
+    {
+        query_packed(filter, in, results, count);
+        return;
+    }
+    if (format != spatial_index_format::quadtree) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
     in.seekg(16, std::ios::beg);
     query_first_n_impl(filter, in, results, count);
 }
 
+template <typename Value, typename Filter, typename InputStream, typename BBox>
+packed_index_header spatial_index<Value, Filter, InputStream, BBox>::read_packed_header(InputStream& in)
+{
+    packed_index_header header;
+    packed_index_stream_reader<InputStream> reader{in, {}};
+    header.read_fixed(reader.read(0, packed_index_header::fixed_size));
+    header.read_levels(reader.read(packed_index_header::fixed_size, header.levels_size()));
+    return header;
+}
+
+template <typename Value, typename Filter, typename InputStream, typename BBox>
+void spatial_index<Value, Filter, InputStream, BBox>::query_packed(Filter const& filter, InputStream& in, std::vector<Value>& results, std::size_t count)
+{
+    packed_index_header header = read_packed_header(in);
+    packed_index_stream_reader<InputStream> reader{in, {}};
+    query_packed_index(header, reader, filter, results, count);
+}
+
 template <typename Value, typename Filter, typename InputStream, typename BBox>
 void spatial_index<Value, Filter, InputStream, BBox>::query_first_n_impl(Filter const& filter, InputStream& in, std::vector<Value>& results, std::size_t count)
 {
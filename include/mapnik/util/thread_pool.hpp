@@ -0,0 +1,150 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_UTIL_THREAD_POOL_HPP
+#define MAPNIK_UTIL_THREAD_POOL_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace mapnik { namespace util {
+
+// Fixed size pool of worker threads with per-worker task queues.
+// Idle workers steal from the front of other queues, tasks submitted
+// from a worker go to its own queue. Threads waiting for a future
+// through wait() execute pending tasks meanwhile, so nested submission
+// (e.g. parallelize() called from a layer job) cannot deadlock the pool.
+class MAPNIK_DECL thread_pool : private util::noncopyable
+{
+public:
+    using task_type = std::function<void()>;
+
+    explicit thread_pool(unsigned size);
+    ~thread_pool();
+
+    template <typename F, typename... Args>
+    auto submit(F && f, Args &&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>
+    {
+        using result_type = typename std::result_of<F(Args...)>::type;
+        auto task = std::make_shared<std::packaged_task<result_type()>>(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<result_type> result(task->get_future());
+        push([task] { (*task)(); });
+        return result;
+    }
+
+    // Blocks until the future is ready. Workers of this pool keep
+    // executing queued tasks while waiting.
+    template <typename T>
+    void wait(std::future<T> const& future)
+    {
+        if (!is_worker())
+        {
+            future.wait();
+            return;
+        }
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!run_pending_task())
+            {
+                future.wait_for(std::chrono::microseconds(100));
+            }
+        }
+    }
+
+    template <typename T>
+    T get(std::future<T> & future)
+    {
+        wait(future);
+        return future.get();
+    }
+
+    // Pops one queued task and executes it on the calling thread.
+    bool run_pending_task();
+
+    // True when called from one of the workers of this pool.
+    bool is_worker() const;
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+    std::size_t queue_depth() const { return queued_.load(std::memory_order_relaxed); }
+    std::size_t steal_count() const { return steals_.load(std::memory_order_relaxed); }
+    std::size_t executed_count() const { return executed_.load(std::memory_order_relaxed); }
+
+private:
+    struct task_queue
+    {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    void push(task_type && task);
+    bool pop(unsigned index, task_type & task);
+    void worker_loop(unsigned index);
+
+    std::vector<std::unique_ptr<task_queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex wakeup_mutex_;
+    std::condition_variable wakeup_;
+    std::atomic<bool> stop_;
+    std::atomic<std::size_t> queued_;
+    std::atomic<std::size_t> steals_;
+    std::atomic<std::size_t> executed_;
+    std::atomic<unsigned> next_queue_;
+};
+
+// Process wide pool used by the parallelizer and parallelize().
+// Its size can be changed with set_concurrency() before first use,
+// by default it equals the number of hardware threads.
+class MAPNIK_DECL global_thread_pool :
+        public singleton<global_thread_pool, CreateStatic>,
+        public thread_pool
+{
+    friend class CreateStatic<global_thread_pool>;
+    global_thread_pool();
+public:
+    static bool set_concurrency(unsigned size);
+    static unsigned concurrency();
+};
+
+} // namespace util
+
+extern template class MAPNIK_DECL singleton<util::global_thread_pool, CreateStatic>;
+
+} // namespace mapnik
+
+#endif // MAPNIK_UTIL_THREAD_POOL_HPP
@@ -34,6 +34,7 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
 #include <cmath>
 
 namespace mapnik {
@@ -63,32 +64,32 @@ boost::optional<well_known_srs_e> is_well_known_srs(std::string const& srs);
 
 boost::optional<bool> is_known_geographic(std::string const& srs);
 
+// Clamping and scaling are done in separate branch free loops which the
+// compiler can vectorize, only the transcendental functions stay scalar.
 static inline bool lonlat2merc(double * x, double * y , int point_count)
 {
-    for(int i=0; i<point_count; ++i)
+    for (int i = 0; i < point_count; ++i)
     {
-        if (x[i] > 180) x[i] = 180;
-        else if (x[i] < -180) x[i] = -180;
-        if (y[i] > MAX_LATITUDE) y[i] = MAX_LATITUDE;
-        else if (y[i] < -MAX_LATITUDE) y[i] = -MAX_LATITUDE;
-        x[i] = x[i] * MAXEXTENTby180;
-        y[i] = std::log(std::tan((90 + y[i]) * M_PIby360)) * R2D;
-        y[i] = y[i] * MAXEXTENTby180;
+        x[i] = std::min(std::max(x[i], -180.0), 180.0) * MAXEXTENTby180;
+        y[i] = (90 + std::min(std::max(y[i], -MAX_LATITUDE), MAX_LATITUDE)) * M_PIby360;
+    }
+    for (int i = 0; i < point_count; ++i)
+    {
+        y[i] = std::log(std::tan(y[i])) * R2D * MAXEXTENTby180;
     }
     return true;
 }
 
 static inline bool merc2lonlat(double * x, double * y , int point_count)
 {
-    for(int i=0; i<point_count; i++)
+    for (int i = 0; i < point_count; ++i)
+    {
+        x[i] = (std::min(std::max(x[i], -MAXEXTENT), MAXEXTENT) / MAXEXTENT) * 180;
+        y[i] = (std::min(std::max(y[i], -MAXEXTENT), MAXEXTENT) / MAXEXTENT) * 180 * D2R;
+    }
+    for (int i = 0; i < point_count; ++i)
     {
-        if (x[i] > MAXEXTENT) x[i] = MAXEXTENT;
-        else if (x[i] < -MAXEXTENT) x[i] = -MAXEXTENT;
-        if (y[i] > MAXEXTENT) y[i] = MAXEXTENT;
-        else if (y[i] < -MAXEXTENT) y[i] = -MAXEXTENT;
-        x[i] = (x[i] / MAXEXTENT) * 180;
-        y[i] = (y[i] / MAXEXTENT) * 180;
-        y[i] = R2D * (2 * std::atan(std::exp(y[i] * D2R)) - M_PI_by2);
+        y[i] = R2D * (2 * std::atan(std::exp(y[i])) - M_PI_by2);
     }
     return true;
 }
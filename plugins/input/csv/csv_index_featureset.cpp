@@ -28,6 +28,7 @@
 #include <mapnik/util/utf_conv_win.hpp>
 #include <mapnik/util/trim.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/util/mapped_spatial_index.hpp>
 #include <mapnik/geometry.hpp>
 // stl
 #include <string>
@@ -73,11 +74,15 @@ csv_index_featureset::csv_index_featureset(std::string const& filename,
 #endif
 
     std::string indexname = filename + ".index";
+#if defined (MAPNIK_MEMORY_MAPPED_FILE)
+    mapnik::util::mapped_spatial_index::open(indexname, sizeof(value_type))->query(filter, positions_);
+#else
     std::ifstream index(indexname.c_str(), std::ios::binary);
     if (!index) throw mapnik::datasource_exception("CSV Plugin: can't open index file " + indexname);
     mapnik::util::spatial_index<value_type,
                                 mapnik::filter_in_box,
                                 std::ifstream>::query(filter, index, positions_);
+#endif
 
     std::sort(positions_.begin(), positions_.end(),
               [](value_type const& lhs, value_type const& rhs) { return lhs.first < rhs.first;});
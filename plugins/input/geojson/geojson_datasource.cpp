@@ -24,6 +24,7 @@
 #include "geojson_featureset.hpp"
 #include "geojson_index_featureset.hpp"
 #include "geojson_memory_index_featureset.hpp"
+#include <cstdio>
 #include <fstream>
 #include <algorithm>
 
@@ -51,9 +52,11 @@
 #include <mapnik/make_unique.hpp>
 #include <mapnik/geometry_adapters.hpp>
 #include <mapnik/json/feature_collection_grammar.hpp>
+#include <mapnik/json/feature_parser.hpp>
 #include <mapnik/json/extract_bounding_box_grammar_impl.hpp>
 #include <mapnik/util/fs.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/packed_hilbert_tree_writer.hpp>
 #include <mapnik/geom_util.hpp>
 
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
@@ -131,6 +134,12 @@ geojson_datasource::geojson_datasource(parameters const& params)
         else
             filename_ = *file;
         has_disk_index_ = mapnik::util::exists(filename_ + ".index");
+        if (!has_disk_index_ && *params.get<mapnik::boolean_type>("create_index", false))
+        {
+            // bytes used by the scanner and by the index writer each
+            mapnik::value_integer memory_limit = *params.get<mapnik::value_integer>("index_memory_limit", 64 << 20);
+            has_disk_index_ = create_disk_index(static_cast<std::size_t>(std::max(memory_limit, mapnik::value_integer(1 << 16))));
+        }
     }
 
     if (inline_string)
@@ -186,9 +195,7 @@ using box_type = box2d<double>;
 using boxes_type = std::vector<std::pair<box_type, std::pair<std::size_t, std::size_t>>>;
 using base_iterator_type = char const*;
 const mapnik::transcoder geojson_datasource_static_tr("utf8");
-const mapnik::json::feature_collection_grammar<base_iterator_type,mapnik::feature_impl> geojson_datasource_static_fc_grammar(geojson_datasource_static_tr);
 const mapnik::json::feature_grammar_callback<base_iterator_type,mapnik::feature_impl> geojson_datasource_static_feature_callback_grammar(geojson_datasource_static_tr);
-const mapnik::json::feature_grammar<base_iterator_type, mapnik::feature_impl> geojson_datasource_static_feature_grammar(geojson_datasource_static_tr);
 const mapnik::json::extract_bounding_box_grammar<base_iterator_type, boxes_type> geojson_datasource_static_bbox_grammar;
 }
 
@@ -233,11 +240,7 @@ void geojson_datasource::initialise_disk_index(std::string const& filename)
         auto const* start = record.data();
         auto const*  end = start + record.size();
         mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, -1));
-        using namespace boost::spirit;
-        standard::space_type space;
-        if (!boost::spirit::qi::phrase_parse(start, end,
-                                             (geojson_datasource_static_feature_grammar)(boost::phoenix::ref(*feature)), space)
-            || start != end)
+        if (!mapnik::json::parse_feature(start, end, *feature, geojson_datasource_static_tr) || start != end)
         {
             throw std::runtime_error("Failed to parse geojson feature");
         }
@@ -246,6 +249,74 @@ void geojson_datasource::initialise_disk_index(std::string const& filename)
     desc_.order_by_name();
 }
 
+namespace {
+void remove_temp_file(std::string const& name)
+{
+    if (name.empty()) return;
+    try
+    {
+        mapnik::util::remove(name);
+    }
+    catch (std::exception const& ex)
+    {
+        MAPNIK_LOG_WARN(geojson) << "geojson_datasource: could not remove '" << name << "': " << ex.what();
+    }
+}
+}
+
+// Writes a packed index next to the file reading it in blocks, features
+// are located again when queried. Returns false and leaves no index if the
+// file is not a FeatureCollection or can't be indexed.
+bool geojson_datasource::create_disk_index(std::size_t memory_limit)
+{
+    using value_type = std::pair<std::size_t, std::size_t>;
+    mapnik::util::file file(filename_);
+    if (!file) throw mapnik::datasource_exception("GeoJSON Plugin: could not open: '" + filename_ + "'");
+    mapnik::packed_hilbert_tree_writer<value_type> tree(memory_limit);
+    bool result = mapnik::json::scan_feature_collection(
+        file.get(), memory_limit,
+        [&tree](box_type const& box, std::size_t offset, std::size_t size)
+        {
+            // features without geometry are not indexed
+            if (box.valid()) tree.insert(value_type(offset, size), box);
+        });
+    if (!result || tree.count_items() == 0)
+    {
+        MAPNIK_LOG_WARN(geojson) << "geojson_datasource: could not create index for '" << filename_ << "'";
+        return false;
+    }
+    std::string index_name = filename_ + ".index";
+    // unique name in the same directory, concurrent writers do not share
+    // the file and the rename is atomic
+    std::string temp_name;
+    try
+    {
+        temp_name = mapnik::util::create_unique_file(index_name + ".%%%%-%%%%-%%%%.tmp");
+        {
+            std::ofstream out(temp_name, std::ios::binary);
+            if (!out) throw std::runtime_error("could not open '" + temp_name + "'");
+            tree.write(out);
+            if (!out) throw std::runtime_error("could not write '" + temp_name + "'");
+        }
+        if (std::rename(temp_name.c_str(), index_name.c_str()) != 0)
+        {
+            throw std::runtime_error("could not rename '" + temp_name + "'");
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        MAPNIK_LOG_WARN(geojson) << "geojson_datasource: " << ex.what();
+        remove_temp_file(temp_name);
+        return false;
+    }
+    catch (...)
+    {
+        remove_temp_file(temp_name);
+        throw;
+    }
+    return true;
+}
+
 template <typename Iterator>
 void geojson_datasource::initialise_index(Iterator start, Iterator end)
 {
@@ -318,9 +389,7 @@ void geojson_datasource::initialise_index(Iterator start, Iterator end)
                 Iterator itr2 = start + geometry_index.first;
                 Iterator end2 = itr2 + geometry_index.second;
                 mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx,-1)); // temp feature
-                if (!boost::spirit::qi::phrase_parse(itr2, end2,
-                                                     (geojson_datasource_static_feature_grammar)(boost::phoenix::ref(*feature)), space)
-                    || itr2 != end2)
+                if (!mapnik::json::parse_feature(itr2, end2, *feature, geojson_datasource_static_tr) || itr2 != end2)
                 {
                     throw std::runtime_error("Failed to parse geojson feature");
                 }
@@ -335,37 +404,20 @@ void geojson_datasource::initialise_index(Iterator start, Iterator end)
 template <typename Iterator>
 void geojson_datasource::parse_geojson(Iterator start, Iterator end)
 {
-    using boost::spirit::qi::expectation_failure;
     boost::spirit::standard::space_type space;
     mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
     std::size_t start_id = 1;
-
-    mapnik::json::default_feature_callback callback(features_);
     Iterator itr = start;
 
-    try
-    {
-        bool result = boost::spirit::qi::phrase_parse(itr, end, (geojson_datasource_static_fc_grammar)
-                                                      (boost::phoenix::ref(ctx), boost::phoenix::ref(start_id), boost::phoenix::ref(callback)),
-                                                      space);
-        if (!result || itr != end)
-        {
-            itr = start;
-            // try parsing as single Feature or single Geometry JSON
-            result = boost::spirit::qi::phrase_parse(itr, end, (geojson_datasource_static_feature_callback_grammar)
-                                                     (boost::phoenix::ref(ctx),boost::phoenix::ref(start_id), boost::phoenix::ref(callback)),
-                                                     space);
-            if (!result || itr != end)
-            {
-                if (from_inline_string_) throw mapnik::datasource_exception("geojson_datasource: Failed parse GeoJSON file from in-memory string");
-                else throw mapnik::datasource_exception("geojson_datasource: Failed parse GeoJSON file '" + filename_ + "'");
-            }
-        }
-    }
-    catch (expectation_failure<char const*> const& ex)
+    if (!mapnik::json::parse_feature_collection(itr, end, ctx, start_id, features_, geojson_datasource_static_tr)
+        || itr != end)
     {
+        features_.clear();
+        ctx = std::make_shared<mapnik::context_type>();
+        start_id = 1;
         itr = start;
         // try parsing as single Feature or single Geometry JSON
+        mapnik::json::default_feature_callback callback(features_);
         bool result = boost::spirit::qi::phrase_parse(itr, end, (geojson_datasource_static_feature_callback_grammar)
                                                       (boost::phoenix::ref(ctx),boost::phoenix::ref(start_id), boost::phoenix::ref(callback)),
                                                       space);
@@ -458,11 +510,7 @@ boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_
             auto const* start = record.data();
             auto const*  end = start + record.size();
             mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, -1)); // temp feature
-            using namespace boost::spirit;
-            standard::space_type space;
-            if (!boost::spirit::qi::phrase_parse(start, end,
-                                                 (geojson_datasource_static_feature_grammar)(boost::phoenix::ref(*feature)), space)
-                || start != end)
+            if (!mapnik::json::parse_feature(start, end, *feature, geojson_datasource_static_tr) || start != end)
             {
                 throw std::runtime_error("Failed to parse geojson feature");
             }
@@ -518,14 +566,10 @@ boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_
             json.resize(size);
             std::fread(json.data(), size, 1, file.get());
 
-            using chr_iterator_type = char const*;
-            chr_iterator_type start2 = json.data();
-            chr_iterator_type end2 = start2 + json.size();
-
-            using namespace boost::spirit;
-            standard::space_type space;
+            char const* start2 = json.data();
+            char const* end2 = start2 + json.size();
             mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, -1)); // temp feature
-            if (!qi::phrase_parse(start2, end2, (geojson_datasource_static_feature_grammar)(boost::phoenix::ref(*feature)), space))
+            if (!mapnik::json::parse_feature(start2, end2, *feature, geojson_datasource_static_tr))
             {
                 throw std::runtime_error("Failed to parse geojson feature");
             }
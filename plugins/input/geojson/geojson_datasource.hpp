@@ -93,6 +93,7 @@ public:
     template <typename Iterator>
     void initialise_index(Iterator start, Iterator end);
     void initialise_disk_index(std::string const& filename);
+    bool create_disk_index(std::size_t memory_limit);
 private:
     void initialise_descriptor(mapnik::feature_ptr const&);
     mapnik::datasource::datasource_t type_;
@@ -23,7 +23,7 @@
 // mapnik
 #include <mapnik/feature.hpp>
 #include <mapnik/feature_factory.hpp>
-#include <mapnik/json/feature_grammar.hpp>
+#include <mapnik/json/feature_parser.hpp>
 #include <mapnik/util/utf_conv_win.hpp>
 #include <mapnik/geometry_is_empty.hpp>
 // stl
@@ -61,15 +61,11 @@ mapnik::feature_ptr geojson_memory_index_featureset::next()
         std::vector<char> json;
         json.resize(size);
         std::fread(json.data(), size, 1, file_.get());
-        using chr_iterator_type = char const*;
-        chr_iterator_type start = json.data();
-        chr_iterator_type end = start + json.size();
+        char const* start = json.data();
+        char const* end = start + json.size();
         static const mapnik::transcoder tr("utf8");
-        static const mapnik::json::feature_grammar<chr_iterator_type,mapnik::feature_impl> grammar(tr);
-        using namespace boost::spirit;
-        standard::space_type space;
         mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, feature_id_++));
-        if (!qi::phrase_parse(start, end, (grammar)(boost::phoenix::ref(*feature)), space) || start != end)
+        if (!mapnik::json::parse_feature(start, end, *feature, tr) || start != end)
         {
             throw std::runtime_error("Failed to parse geojson feature");
         }
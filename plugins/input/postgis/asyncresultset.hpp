@@ -30,6 +30,7 @@
 #include "resultset.hpp"
 #include <queue>
 #include <memory>
+#include <vector>
 
 class postgis_processor_context;
 using postgis_processor_context_ptr = std::shared_ptr<postgis_processor_context>;
@@ -40,11 +41,14 @@ public:
     AsyncResultSet(postgis_processor_context_ptr const& ctx,
                      std::shared_ptr<ConnectionManager::PoolType> const& pool,
                      std::unique_ptr<ConnectionManager::PoolType::handle> && conn_handle,
-                     std::string const& sql)
+                     std::string const& sql,
+                     std::vector<double> const* params = nullptr)
         : ctx_(ctx),
           pool_(pool),
           conn_handle_(std::move(conn_handle)),
           sql_(sql),
+          params_(params ? *params : std::vector<double>()),
+          prepared_(params != nullptr),
           is_closed_(false)
     {
     }
@@ -166,6 +170,8 @@ private:
     std::shared_ptr<ConnectionManager::PoolType> pool_;
     std::unique_ptr<ConnectionManager::PoolType::handle> conn_handle_;
     std::string sql_;
+    std::vector<double> params_;
+    bool prepared_;
     std::shared_ptr<ResultSet> rs_;
     bool is_closed_;
 
@@ -173,7 +179,11 @@ private:
     {
         conn_handle_ = pool_->borrow();
         Connection & conn = conn_handle_->get();
-        if (conn.isOK())
+        if (conn.isOK() && prepared_)
+        {
+            conn.executeAsyncQuery(sql_, params_);
+        }
+        else if (conn.isOK())
         {
             conn.executeAsyncQuery(sql_, 1);
         }
@@ -29,14 +29,29 @@
 #include <mapnik/timer.hpp>
 
 // std
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <memory>
 #include <sstream>
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 extern "C" {
 #include "libpq-fe.h"
 }
 
+#if defined(LIBPQ_HAS_PIPELINING)
+#ifdef _WINDOWS
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+#endif
+
 #include "resultset.hpp"
 
 class Connection
@@ -45,7 +60,9 @@ public:
     Connection(std::string const& connection_str,boost::optional<std::string> const& password)
         : cursorId(0),
           closed_(false),
-          pending_(false)
+          pending_(false),
+          statements_(),
+          statement_id_(0)
     {
         std::string connect_with_pass = connection_str;
         if (password && !password->empty())
@@ -118,28 +135,19 @@ public:
 #ifdef MAPNIK_STATS
         mapnik::progress_timer __stats__(std::clog, std::string("postgis_connection::execute_query ") + sql);
 #endif
-        PGresult* result = 0;
-        if ( executeAsyncQuery(sql, type) ) {
-          // fetch multiple times until NULL is returned,
-          // to handle multi-statement queries
-          while ( PGresult *tmp = getResult() ) {
-            if ( result ) PQclear(result);
-            result = tmp;
-          }
-        }
-
-        if (! result || (PQresultStatus(result) != PGRES_TUPLES_OK))
-        {
-            std::string err_msg = "Postgis Plugin: ";
-            err_msg += status();
-            err_msg += "in executeQuery Full sql was: '";
-            err_msg += sql;
-            err_msg += "'\n";
-            if ( result ) PQclear(result);
-            throw mapnik::datasource_exception(err_msg);
-        }
+        executeAsyncQuery(sql, type);
+        return getQueryResult(sql);
+    }
 
-        return std::make_shared<ResultSet>(result);
+    // Executes the query as a prepared statement with binary float8
+    // parameters, the statement is prepared on first use of the sql.
+    std::shared_ptr<ResultSet> executeQuery(std::string const& sql, std::vector<double> const& params)
+    {
+#ifdef MAPNIK_STATS
+        mapnik::progress_timer __stats__(std::clog, std::string("postgis_connection::execute_prepared ") + sql);
+#endif
+        executeAsyncQuery(sql, params);
+        return getQueryResult(sql);
     }
 
     std::string status() const
@@ -190,6 +198,173 @@ public:
         return result;
     }
 
+    bool executeAsyncQuery(std::string const& sql, std::vector<double> const& params)
+    {
+        std::string const& name = prepare(sql, params.size());
+        binary_params values(params);
+        if (PQsendQueryPrepared(conn_, name.c_str(), values.size(), values.values(),
+                                values.lengths(), values.formats(), 1) != 1)
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in executeAsyncQuery Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            clearAsyncResult(PQgetResult(conn_));
+            close();
+            throw mapnik::datasource_exception(err_msg);
+        }
+        pending_ = true;
+        return true;
+    }
+
+    // Sends the query with results returned row by row, or in chunks of
+    // chunk_size rows when libpq supports it, instead of all at once.
+    void executeStreamingQuery(std::string const& sql, std::vector<double> const* params, int chunk_size)
+    {
+        if (params)
+        {
+            executeAsyncQuery(sql, *params);
+        }
+        else
+        {
+            executeAsyncQuery(sql, 1);
+        }
+#if defined(LIBPQ_HAS_CHUNK_MODE)
+        int result = chunk_size > 1 ? PQsetChunkedRowsMode(conn_, chunk_size) : PQsetSingleRowMode(conn_);
+#else
+        int result = PQsetSingleRowMode(conn_);
+#endif
+        if (result != 1)
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in executeStreamingQuery Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            clearAsyncResult(PQgetResult(conn_));
+            close();
+            throw mapnik::datasource_exception(err_msg);
+        }
+    }
+
+#if defined(LIBPQ_HAS_PIPELINING)
+    // Queries sent in pipeline mode don't wait for results of previous ones,
+    // each is followed by a sync point so an error doesn't abort the next.
+    // The connection is non-blocking meanwhile, a blocking send could wait
+    // forever for the server, which waits for its results to be read.
+    bool enterPipelineMode()
+    {
+        if (PQsetnonblocking(conn_, 1) != 0)
+        {
+            return false;
+        }
+        if (PQenterPipelineMode(conn_) != 1)
+        {
+            PQsetnonblocking(conn_, 0);
+            return false;
+        }
+        return true;
+    }
+
+    bool exitPipelineMode()
+    {
+        if (PQexitPipelineMode(conn_) != 1 || PQsetnonblocking(conn_, 0) != 0)
+        {
+            return false;
+        }
+        segments_.clear();
+        pending_ = false;
+        return true;
+    }
+
+    void sendPipelineQuery(std::string const& sql)
+    {
+        finishPipelineQuery(sql, PQsendQueryParams(conn_, sql.c_str(), 0, 0, 0, 0, 0, 1) == 1, false);
+    }
+
+    // The statement is prepared in the same pipeline segment as the query,
+    // if the prepare fails it will be prepared again under a new name.
+    void sendPipelineQuery(std::string const& sql, std::vector<double> const& params)
+    {
+        binary_params values(params);
+        auto itr = statements_.find(sql);
+        bool ok = true;
+        bool prepared = false;
+        if (itr == statements_.end())
+        {
+            if (statements_.size() >= max_statements)
+            {
+                // no room for more statements, can't deallocate in the pipeline
+                finishPipelineQuery(sql, PQsendQueryParams(conn_, sql.c_str(), values.size(), values.types(),
+                                                         values.values(), values.lengths(), values.formats(), 1) == 1, false);
+                return;
+            }
+            std::string name = "mapnik_statement_" + std::to_string(++statement_id_);
+            ok = PQsendPrepare(conn_, name.c_str(), sql.c_str(), values.size(), values.types()) == 1;
+            itr = statements_.emplace(sql, name).first;
+            prepared = true;
+        }
+        ok = ok && PQsendQueryPrepared(conn_, itr->second.c_str(), values.size(), values.values(),
+                                       values.lengths(), values.formats(), 1) == 1;
+        finishPipelineQuery(sql, ok, prepared);
+    }
+
+    // Returns the result of the next query sent with sendPipelineQuery,
+    // nullptr if the connection is broken.
+    PGresult* getPipelineResult()
+    {
+        PGresult *result = 0;
+        bool idle = false;
+        bool first = true;
+        pipeline_segment segment{std::string(), false};
+        if (!segments_.empty())
+        {
+            segment = std::move(segments_.front());
+            segments_.pop_front();
+        }
+        // results of the segment are separated by NULL and end with the
+        // sync result, two NULLs mean there is nothing more to read
+        while (true)
+        {
+            PGresult *tmp = getResult();
+            if (!tmp)
+            {
+                if (idle) break;
+                idle = true;
+                continue;
+            }
+            idle = false;
+            ExecStatusType tmp_status = PQresultStatus(tmp);
+            if (first && segment.prepared && tmp_status != PGRES_COMMAND_OK)
+            {
+                // the statement does not exist on the server, a statement
+                // which failed only when executed is kept
+                statements_.erase(segment.sql);
+            }
+            first = false;
+            if (tmp_status == PGRES_PIPELINE_SYNC)
+            {
+                PQclear(tmp);
+                return result;
+            }
+            if (result && PQresultStatus(result) != PGRES_COMMAND_OK &&
+                PQresultStatus(result) != PGRES_TUPLES_OK)
+            {
+                // keep the first error of the segment
+                PQclear(tmp);
+            }
+            else
+            {
+                if (result) PQclear(result);
+                result = tmp;
+            }
+        }
+        if (result) PQclear(result);
+        return 0;
+    }
+#endif
+
     PGresult* getResult()
     {
         PGresult *result = PQgetResult(conn_);
@@ -269,6 +444,163 @@ private:
     bool closed_;
     bool pending_;
 
+    // Statements are cached per sql, when the limit is reached they are
+    // deallocated before preparing another one.
+    static const std::size_t max_statements = 256;
+    std::unordered_map<std::string, std::string> statements_;
+    unsigned statement_id_;
+
+#if defined(LIBPQ_HAS_PIPELINING)
+    // Queries sent with sendPipelineQuery whose results were not read yet,
+    // prepared is set when the segment also prepares the statement of sql.
+    struct pipeline_segment
+    {
+        std::string sql;
+        bool prepared;
+    };
+    std::deque<pipeline_segment> segments_;
+#endif
+
+    // float8 query parameters in binary format
+    class binary_params
+    {
+    public:
+        explicit binary_params(std::vector<double> const& params)
+            : data_(params.size()),
+              values_(params.size()),
+              lengths_(params.size(), sizeof(std::uint64_t)),
+              formats_(params.size(), 1),
+              types_(params.size(), 701) // FLOAT8OID
+        {
+            for (std::size_t i = 0; i < params.size(); ++i)
+            {
+                std::uint64_t bits;
+                std::memcpy(&bits, &params[i], sizeof(bits));
+                unsigned char * bytes = reinterpret_cast<unsigned char *>(&data_[i]);
+                for (int b = 7; b >= 0; --b, bits >>= 8)
+                {
+                    bytes[b] = static_cast<unsigned char>(bits & 0xff);
+                }
+                values_[i] = reinterpret_cast<char const*>(&data_[i]);
+            }
+        }
+
+        int size() const { return static_cast<int>(data_.size()); }
+        char const* const* values() const { return values_.data(); }
+        int const* lengths() const { return lengths_.data(); }
+        int const* formats() const { return formats_.data(); }
+        Oid const* types() const { return types_.data(); }
+
+    private:
+        std::vector<std::uint64_t> data_;
+        std::vector<char const*> values_;
+        std::vector<int> lengths_;
+        std::vector<int> formats_;
+        std::vector<Oid> types_;
+    };
+
+    std::string const& prepare(std::string const& sql, std::size_t num_params)
+    {
+        auto itr = statements_.find(sql);
+        if (itr != statements_.end())
+        {
+            return itr->second;
+        }
+        if (statements_.size() >= max_statements)
+        {
+            execute("DEALLOCATE ALL");
+            statements_.clear();
+        }
+        std::string name = "mapnik_statement_" + std::to_string(++statement_id_);
+        std::vector<Oid> types(num_params, 701); // FLOAT8OID
+        PGresult *result = PQprepare(conn_, name.c_str(), sql.c_str(), static_cast<int>(num_params), types.data());
+        bool ok = (result && (PQresultStatus(result) == PGRES_COMMAND_OK));
+        if (!ok)
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in prepare Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            if ( result ) PQclear(result);
+            throw mapnik::datasource_exception(err_msg);
+        }
+        PQclear(result);
+        return statements_.emplace(sql, name).first->second;
+    }
+
+    std::shared_ptr<ResultSet> getQueryResult(std::string const& sql)
+    {
+        PGresult* result = 0;
+        // fetch multiple times until NULL is returned,
+        // to handle multi-statement queries
+        while ( PGresult *tmp = getResult() ) {
+          if ( result ) PQclear(result);
+          result = tmp;
+        }
+
+        if (! result || (PQresultStatus(result) != PGRES_TUPLES_OK))
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in executeQuery Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            if ( result ) PQclear(result);
+            throw mapnik::datasource_exception(err_msg);
+        }
+
+        return std::make_shared<ResultSet>(result);
+    }
+
+#if defined(LIBPQ_HAS_PIPELINING)
+    void finishPipelineQuery(std::string const& sql, bool sent, bool prepared)
+    {
+        if (sent)
+        {
+            segments_.push_back(pipeline_segment{prepared ? sql : std::string(), prepared});
+        }
+        if (!sent || PQpipelineSync(conn_) != 1 || !flushPipeline())
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += status();
+            err_msg += "in sendPipelineQuery Full sql was: '";
+            err_msg += sql;
+            err_msg += "'\n";
+            close();
+            throw mapnik::datasource_exception(err_msg);
+        }
+        pending_ = true;
+    }
+
+    // Sends the buffered queries, results arriving meanwhile are read
+    // into libpq so the server can go on.
+    bool flushPipeline()
+    {
+        int sock = PQsocket(conn_);
+        int ret;
+        while ((ret = PQflush(conn_)) == 1)
+        {
+            fd_set read_fds;
+            fd_set write_fds;
+            FD_ZERO(&read_fds);
+            FD_ZERO(&write_fds);
+            FD_SET(sock, &read_fds);
+            FD_SET(sock, &write_fds);
+            if (select(sock + 1, &read_fds, &write_fds, 0, 0) < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (FD_ISSET(sock, &read_fds) && PQconsumeInput(conn_) != 1)
+            {
+                return false;
+            }
+        }
+        return ret == 0;
+    }
+#endif
+
     void clearAsyncResult(PGresult *result)
     {
         // Clear all pending results
@@ -0,0 +1,288 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef POSTGIS_PIPELINERESULTSET_HPP
+#define POSTGIS_PIPELINERESULTSET_HPP
+
+#include <mapnik/debug.hpp>
+#include <mapnik/datasource.hpp>
+
+#include "connection_manager.hpp"
+#include "resultset.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Queries of all layers of one render using the same database, they are
+// sent on a single connection when the layers are prepared and results are
+// read back in order as the featuresets are consumed.
+class postgis_pipeline_context : public mapnik::IProcessorContext
+{
+public:
+    postgis_pipeline_context(std::shared_ptr<ConnectionManager::PoolType> const& pool, bool preping)
+        : pool_(pool),
+          preping_(preping),
+          requests_(),
+          sent_(0),
+          received_(0),
+          pipeline_(false) {}
+
+    ~postgis_pipeline_context()
+    {
+        if (!conn_handle_)
+        {
+            return;
+        }
+        Connection & conn = conn_handle_->get();
+        if (received_ < sent_)
+        {
+            // results of featuresets which were never read, the connection
+            // is closed so that it is recycled by the pool
+            MAPNIK_LOG_DEBUG(postgis) << "postgis_pipeline_context: closing pending connection - " << &conn;
+            conn.close();
+        }
+#if defined(LIBPQ_HAS_PIPELINING)
+        else if (pipeline_ && conn.isOK() && !conn.exitPipelineMode())
+        {
+            conn.close();
+        }
+#endif
+    }
+
+    // Sends the query, as a prepared statement when params are given, and
+    // returns its index for get_result
+    std::size_t add_request(std::string const& sql, std::vector<double> const* params = nullptr)
+    {
+        Connection & conn = connection();
+        std::size_t index = requests_.size();
+        requests_.push_back(request{sql, params ? *params : std::vector<double>(), params != nullptr,
+                                    std::shared_ptr<ResultSet>(), std::string()});
+#if defined(LIBPQ_HAS_PIPELINING)
+        if (pipeline_)
+        {
+            if (params) conn.sendPipelineQuery(sql, *params);
+            else conn.sendPipelineQuery(sql);
+            ++sent_;
+            return index;
+        }
+#endif
+        // without pipelining the next query is sent once the previous
+        // result has been read
+        if (sent_ == received_)
+        {
+            send(requests_.back());
+        }
+        return index;
+    }
+
+    std::shared_ptr<ResultSet> get_result(std::size_t index)
+    {
+        while (received_ <= index)
+        {
+            receive();
+        }
+        request & req = requests_[index];
+        if (!req.error.empty())
+        {
+            throw mapnik::datasource_exception(req.error);
+        }
+        if (!req.result)
+        {
+            throw mapnik::datasource_exception("Postgis Plugin: result of pipelined query was already read");
+        }
+        return std::move(req.result);
+    }
+
+private:
+    struct request
+    {
+        std::string sql;
+        std::vector<double> params;
+        bool prepared;
+        std::shared_ptr<ResultSet> result;
+        std::string error;
+    };
+
+    Connection & connection()
+    {
+        if (!conn_handle_)
+        {
+            conn_handle_ = pool_->borrow(preping_);
+            if (!conn_handle_ || !conn_handle_->get().isOK())
+            {
+                throw mapnik::datasource_exception("Postgis Plugin: bad connection");
+            }
+#if defined(LIBPQ_HAS_PIPELINING)
+            pipeline_ = conn_handle_->get().enterPipelineMode();
+#endif
+        }
+        return conn_handle_->get();
+    }
+
+    void receive()
+    {
+        Connection & conn = conn_handle_->get();
+        request & req = requests_[received_];
+        PGresult *result = 0;
+        if (conn.isOK())
+        {
+#if defined(LIBPQ_HAS_PIPELINING)
+            if (pipeline_)
+            {
+                result = conn.getPipelineResult();
+            }
+            else
+#endif
+            {
+                result = conn.getResult();
+                while (PGresult *tmp = conn.getResult())
+                {
+                    PQclear(tmp);
+                }
+            }
+        }
+        if (!result)
+        {
+            req.error = "Postgis Plugin: lost connection in pipeline, sql was: '" + req.sql + "'";
+            conn.close();
+        }
+        else if (PQresultStatus(result) != PGRES_TUPLES_OK)
+        {
+            req.error = "Postgis Plugin: ";
+            req.error += PQresultErrorMessage(result);
+            req.error += "in pipeline, sql was: '" + req.sql + "'";
+            PQclear(result);
+        }
+        else
+        {
+            req.result = std::make_shared<ResultSet>(result);
+        }
+        ++received_;
+        if (!pipeline_ && received_ < requests_.size() && conn.isOK())
+        {
+            send(requests_[received_]);
+        }
+    }
+
+    void send(request const& req)
+    {
+        Connection & conn = conn_handle_->get();
+        if (req.prepared) conn.executeAsyncQuery(req.sql, req.params);
+        else conn.executeAsyncQuery(req.sql, 1);
+        ++sent_;
+    }
+
+    std::shared_ptr<ConnectionManager::PoolType> pool_;
+    bool preping_;
+    std::unique_ptr<ConnectionManager::PoolType::handle> conn_handle_;
+    std::vector<request> requests_;
+    std::size_t sent_;
+    std::size_t received_;
+    bool pipeline_;
+};
+
+using postgis_pipeline_context_ptr = std::shared_ptr<postgis_pipeline_context>;
+
+class PipelineResultSet : public IResultSet, private mapnik::util::noncopyable
+{
+public:
+    PipelineResultSet(postgis_pipeline_context_ptr const& ctx, std::size_t index)
+        : ctx_(ctx),
+          index_(index),
+          rs_() {}
+
+    virtual ~PipelineResultSet()
+    {
+        close();
+    }
+
+    virtual void close()
+    {
+        rs_.reset();
+        ctx_.reset();
+    }
+
+    virtual int getNumFields() const
+    {
+        return rs_->getNumFields();
+    }
+
+    virtual bool next()
+    {
+        if (!rs_)
+        {
+            if (!ctx_)
+            {
+                return false;
+            }
+            rs_ = ctx_->get_result(index_);
+        }
+        return rs_->next();
+    }
+
+    virtual const char* getFieldName(int index) const
+    {
+        return rs_->getFieldName(index);
+    }
+
+    virtual int getFieldLength(int index) const
+    {
+        return rs_->getFieldLength(index);
+    }
+
+    virtual int getFieldLength(const char* name) const
+    {
+        return rs_->getFieldLength(name);
+    }
+
+    virtual int getTypeOID(int index) const
+    {
+        return rs_->getTypeOID(index);
+    }
+
+    virtual int getTypeOID(const char* name) const
+    {
+        return rs_->getTypeOID(name);
+    }
+
+    virtual bool isNull(int index) const
+    {
+        return rs_->isNull(index);
+    }
+
+    virtual const char* getValue(int index) const
+    {
+        return rs_->getValue(index);
+    }
+
+    virtual const char* getValue(const char* name) const
+    {
+        return rs_->getValue(name);
+    }
+
+private:
+    postgis_pipeline_context_ptr ctx_;
+    std::size_t index_;
+    std::shared_ptr<ResultSet> rs_;
+};
+
+#endif // POSTGIS_PIPELINERESULTSET_HPP
@@ -24,6 +24,9 @@
 #include "postgis_datasource.hpp"
 #include "postgis_featureset.hpp"
 #include "asyncresultset.hpp"
+#include "pipelineresultset.hpp"
+#include "streamingresultset.hpp"
+#include "threaded_featureset.hpp"
 
 
 // mapnik
@@ -66,6 +69,7 @@ postgis_datasource::postgis_datasource(parameters const& params)
       geometry_field_(*params.get<std::string>("geometry_field", "")),
       key_field_(*params.get<std::string>("key_field", "")),
       cursor_fetch_size_(*params.get<mapnik::value_integer>("cursor_size", 0)),
+      stream_size_(*params.get<mapnik::value_integer>("stream_size", 0)),
       row_limit_(*params.get<mapnik::value_integer>("row_limit", 0)),
       type_(datasource::Vector),
       srid_(*params.get<mapnik::value_integer>("srid", 0)),
@@ -87,6 +91,8 @@ postgis_datasource::postgis_datasource(parameters const& params)
       extent_from_subquery_(*params.get<mapnik::boolean_type>("extent_from_subquery", false)),
       max_async_connections_(*params_.get<mapnik::value_integer>("max_async_connection", 1)),
       asynchronous_request_(false),
+      pipeline_(*params_.get<mapnik::boolean_type>("pipeline", false)),
+      prepared_statements_(*params_.get<mapnik::boolean_type>("prepared_statements", false)),
       twkb_encoding_(false),
       twkb_rounding_adjustment_(*params_.get<mapnik::value_double>("twkb_rounding_adjustment", 0.0)),
       simplify_snap_ratio_(*params_.get<mapnik::value_double>("simplify_snap_ratio", 1.0/40.0)),
@@ -122,7 +128,7 @@ postgis_datasource::postgis_datasource(parameters const& params)
 
     // NOTE: In multithread environment, pool_max_size_ should be
     // max_async_connections_ * num_threads
-    if(max_async_connections_ > 1)
+    if(max_async_connections_ > 1 && !pipeline_)
     {
         if(max_async_connections_ > pool_max_size_)
         {
@@ -547,6 +553,24 @@ std::string postgis_datasource::sql_bbox(box2d<double> const& env) const
     return b.str();
 }
 
+std::string postgis_datasource::sql_bbox(box2d<double> const& env, sql_parameters & params) const
+{
+    if (!params.bind())
+    {
+        return sql_bbox(env);
+    }
+
+    std::ostringstream b;
+    b << "ST_MakeEnvelope(" << params(env.minx()) << "," << params(env.miny()) << ","
+      << params(env.maxx()) << "," << params(env.maxy());
+    if (srid_ > 0)
+    {
+        b << "," << srid_;
+    }
+    b << ")";
+    return b.str();
+}
+
 std::string postgis_datasource::populate_tokens(std::string const& sql) const
 {
     std::string populated_sql = sql;
@@ -594,35 +618,35 @@ std::string postgis_datasource::populate_tokens(
                                 box2d<double> const& env,
                                 double pixel_width,
                                 double pixel_height,
-                                mapnik::attributes const& vars) const
+                                mapnik::attributes const& vars,
+                                sql_parameters & params) const
 {
     std::string populated_sql = sql;
-    std::string box = sql_bbox(env);
 
     if (boost::algorithm::icontains(populated_sql, scale_denom_token_))
     {
         std::ostringstream ss;
-        ss << scale_denom;
+        ss << params(scale_denom);
         boost::algorithm::replace_all(populated_sql, scale_denom_token_, ss.str());
     }
 
     if (boost::algorithm::icontains(sql, pixel_width_token_))
     {
         std::ostringstream ss;
-        ss << pixel_width;
+        ss << params(pixel_width);
         boost::algorithm::replace_all(populated_sql, pixel_width_token_, ss.str());
     }
 
     if (boost::algorithm::icontains(sql, pixel_height_token_))
     {
         std::ostringstream ss;
-        ss << pixel_height;
+        ss << params(pixel_height);
         boost::algorithm::replace_all(populated_sql, pixel_height_token_, ss.str());
     }
 
     if (boost::algorithm::icontains(populated_sql, bbox_token_))
     {
-        boost::algorithm::replace_all(populated_sql, bbox_token_, box);
+        boost::algorithm::replace_all(populated_sql, bbox_token_, sql_bbox(env, params));
     }
     else
     {
@@ -630,7 +654,7 @@ std::string postgis_datasource::populate_tokens(
 
         if (intersect_min_scale_ > 0 && (scale_denom <= intersect_min_scale_))
         {
-            s << " WHERE ST_Intersects(\"" << geometryColumn_ << "\"," << box << ")";
+            s << " WHERE ST_Intersects(\"" << geometryColumn_ << "\"," << sql_bbox(env, params) << ")";
         }
         else if (intersect_max_scale_ > 0 && (scale_denom >= intersect_max_scale_))
         {
@@ -638,7 +662,7 @@ std::string postgis_datasource::populate_tokens(
         }
         else
         {
-            s << " WHERE \"" << geometryColumn_ << "\" && " << box;
+            s << " WHERE \"" << geometryColumn_ << "\" && " << sql_bbox(env, params);
         }
         populated_sql += s.str();
     }
@@ -664,13 +688,20 @@ std::string postgis_datasource::populate_tokens(
 }
 
 
-std::shared_ptr<IResultSet> postgis_datasource::get_resultset(conn_handle_ptr && conn_handle, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx) const
+std::shared_ptr<IResultSet> postgis_datasource::get_resultset(conn_handle_ptr && conn_handle, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx, sql_parameters const* params) const
 {
+    std::vector<double> const* values = params ? &params->values() : nullptr;
+
     if (!ctx)
     {
         // ! asynchronous_request_
         Connection & conn = conn_handle->get();
-        if (cursor_fetch_size_ > 0)
+        if (stream_size_ > 0)
+        {
+            conn.executeStreamingQuery(sql, values, static_cast<int>(stream_size_));
+            return std::make_shared<StreamingResultSet>(std::move(conn_handle));
+        }
+        else if (cursor_fetch_size_ > 0)
         {
             // cursor
             std::ostringstream csql;
@@ -687,12 +718,21 @@ std::shared_ptr<IResultSet> postgis_datasource::get_resultset(conn_handle_ptr &&
             return std::make_shared<CursorResultSet>(std::move(conn_handle), cursor_name, cursor_fetch_size_);
 
         }
+        else if (values)
+        {
+            return conn.executeQuery(sql, *values);
+        }
         else
         {
             // no cursor
             return conn.executeQuery(sql, 1);
         }
     }
+    else if (pipeline_)
+    {
+        postgis_pipeline_context_ptr pipeline_ctx = std::static_pointer_cast<postgis_pipeline_context>(ctx);
+        return std::make_shared<PipelineResultSet>(pipeline_ctx, pipeline_ctx->add_request(sql, values));
+    }
     else
     {   // asynchronous requests
         std::shared_ptr<postgis_processor_context> pgis_ctxt = std::static_pointer_cast<postgis_processor_context>(ctx);
@@ -700,13 +740,20 @@ std::shared_ptr<IResultSet> postgis_datasource::get_resultset(conn_handle_ptr &&
         {
             // lauch async req & create asyncresult with conn
             Connection & conn = conn_handle->get();
-            conn.executeAsyncQuery(sql, 1);
-            return std::make_shared<AsyncResultSet>(pgis_ctxt, pool, std::move(conn_handle), sql);
+            if (values)
+            {
+                conn.executeAsyncQuery(sql, *values);
+            }
+            else
+            {
+                conn.executeAsyncQuery(sql, 1);
+            }
+            return std::make_shared<AsyncResultSet>(pgis_ctxt, pool, std::move(conn_handle), sql, values);
         }
         else
         {
             std::shared_ptr<AsyncResultSet> res = std::make_shared<AsyncResultSet>(
-                pgis_ctxt, pool, conn_handle_ptr(), sql);
+                pgis_ctxt, pool, conn_handle_ptr(), sql, values);
             pgis_ctxt->add_request(res);
             return res;
         }
@@ -715,6 +762,23 @@ std::shared_ptr<IResultSet> postgis_datasource::get_resultset(conn_handle_ptr &&
 
 processor_context_ptr postgis_datasource::get_context(feature_style_context_map & ctx) const
 {
+    if (pipeline_)
+    {
+        // shared by all datasources connecting to the same database
+        std::string key("postgis_pipeline " + creator_.id());
+        feature_style_context_map::const_iterator itr = ctx.find(key);
+        if (itr != ctx.end())
+        {
+            return itr->second;
+        }
+        CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
+        if (!pool)
+        {
+            return processor_context_ptr();
+        }
+        return ctx.emplace(key, std::make_shared<postgis_pipeline_context>(pool, preping_)).first->second;
+    }
+
     if (!asynchronous_request_)
     {
         return processor_context_ptr();
@@ -734,6 +798,11 @@ processor_context_ptr postgis_datasource::get_context(feature_style_context_map
 
 featureset_ptr postgis_datasource::features(query const& q) const
 {
+    if (pipeline_)
+    {
+        feature_style_context_map ctx;
+        return features_with_context(q, get_context(ctx));
+    }
     // if the driver is in asynchronous mode, return the appropriate fetaures
     if (asynchronous_request_ )
     {
@@ -759,8 +828,10 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
     if (pool)
     {
         conn_handle_ptr handle;
+        // pipelined queries are sent on the connection of the pipeline context
+        const bool pipelined = pipeline_ && proc_ctx;
 
-        if ( asynchronous_request_ )
+        if ( asynchronous_request_ && !pipelined )
         {
             // limit use to num_async_request_ => if reached don't borrow the last connexion object
             std::shared_ptr<postgis_processor_context> pgis_ctxt =
@@ -771,7 +842,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
                 pgis_ctxt->num_async_requests_++;
             }
         }
-        else
+        else if ( !pipelined )
         {
             // Always get a connection in synchronous mode
             handle = pool->borrow(preping_);
@@ -806,6 +877,8 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
         }
 
         std::ostringstream s;
+        // cursors are declared with a plain query
+        sql_parameters params(prepared_statements_ && (proc_ctx || stream_size_ > 0 || cursor_fetch_size_ <= 0));
 
         const double px_gw = 1.0 / std::get<0>(q.resolution());
         const double px_gh = 1.0 / std::get<1>(q.resolution());
@@ -836,15 +909,15 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             // ! ST_ClipByBox2D()
             if (simplify_clip_resolution_ > 0.0 && simplify_clip_resolution_ > px_sz)
             {
-                s << "," << sql_bbox(box) << ")";
+                s << "," << sql_bbox(box, params) << ")";
             }
 
             // ! ST_RemoveRepeatedPoints()
-            s << "," << twkb_tolerance << ")";
+            s << "," << params(twkb_tolerance) << ")";
             // ! ST_Simplify(), with parameter to keep collapsed geometries
-            s << "," << twkb_tolerance << ",true)";
+            s << "," << params(twkb_tolerance) << ",true)";
             // ! ST_TWKB()
-            s << "," << twkb_rounding << ") AS geom";
+            s << "," << params(twkb_rounding) << (params.bind() ? "::int" : "") << ") AS geom";
         }
         else
         {
@@ -869,20 +942,20 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             if (simplify_geometries_ && simplify_snap_ratio_ > 0.0)
             {
                 const double tolerance = px_sz * simplify_snap_ratio_;
-                s << "," << tolerance << ")";
+                s << "," << params(tolerance) << ")";
             }
 
             // ! ST_ClipByBox2D()
             if (simplify_clip_resolution_ > 0.0 && simplify_clip_resolution_ > px_sz)
             {
-                s << "," << sql_bbox(box) << ")";
+                s << "," << sql_bbox(box, params) << ")";
             }
 
             // ! ST_Simplify()
             if (simplify_geometries_)
             {
                 const double tolerance = px_sz * simplify_dp_ratio_;
-                s << ", " << tolerance;
+                s << ", " << params(tolerance);
                 // Add parameter to ST_Simplify to keep collapsed geometries
                 if (simplify_dp_preserve_)
                 {
@@ -925,7 +998,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             }
         }
 
-        std::string table_with_bbox = populate_tokens(table_, scale_denom, box, px_gw, px_gh, q.variables());
+        std::string table_with_bbox = populate_tokens(table_, scale_denom, box, px_gw, px_gh, q.variables(), params);
 
         s << " FROM " << table_with_bbox;
 
@@ -934,10 +1007,16 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             s << " LIMIT " << row_limit_;
         }
 
-        std::shared_ptr<IResultSet> rs = get_resultset(std::move(handle), s.str(), pool, proc_ctx);
-        return std::make_shared<postgis_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty(),
-                                                    key_field_as_attribute_, twkb_encoding_);
-
+        std::shared_ptr<IResultSet> rs = get_resultset(std::move(handle), s.str(), pool, proc_ctx,
+                                                      params.bind() ? &params : nullptr);
+        featureset_ptr fs = std::make_shared<postgis_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty(),
+                                                                 key_field_as_attribute_, twkb_encoding_);
+        if (!proc_ctx && stream_size_ > 0)
+        {
+            // decode rows while the previous features are rendered
+            return std::make_shared<threaded_featureset>(fs, static_cast<std::size_t>(stream_size_));
+        }
+        return fs;
     }
 
     return mapnik::make_invalid_featureset();
@@ -1011,7 +1090,8 @@ featureset_ptr postgis_datasource::features_at_point(coord2d const& pt, double t
         }
 
         box2d<double> box(pt.x - tol, pt.y - tol, pt.x + tol, pt.y + tol);
-        std::string table_with_bbox = populate_tokens(table_, FMAX, box, 0, 0, mapnik::attributes());
+        sql_parameters params(false);
+        std::string table_with_bbox = populate_tokens(table_, FMAX, box, 0, 0, mapnik::attributes(), params);
 
         s << " FROM " << table_with_bbox;
 
@@ -41,6 +41,7 @@
 
 // stl
 #include <memory>
+#include <ostream>
 #include <vector>
 #include <string>
 
@@ -62,6 +63,55 @@ using mapnik::coord2d;
 
 using CnxPool_ptr = std::shared_ptr< ConnectionManager::PoolType>;
 
+// Numeric values of a query, written into the sql text or, for prepared
+// statements, replaced by placeholders of binary float8 parameters.
+class sql_parameters
+{
+public:
+    struct value
+    {
+        double number;
+        std::size_t index;
+    };
+
+    explicit sql_parameters(bool bind)
+        : bind_(bind),
+          values_() {}
+
+    value operator()(double number)
+    {
+        if (!bind_)
+        {
+            return value{number, 0};
+        }
+        values_.push_back(number);
+        return value{number, values_.size()};
+    }
+
+    bool bind() const
+    {
+        return bind_;
+    }
+
+    std::vector<double> const& values() const
+    {
+        return values_;
+    }
+
+private:
+    bool bind_;
+    std::vector<double> values_;
+};
+
+inline std::ostream & operator<<(std::ostream & out, sql_parameters::value const& v)
+{
+    if (v.index > 0)
+    {
+        return out << '$' << v.index;
+    }
+    return out << v.number;
+}
+
 class postgis_datasource : public datasource
 {
 public:
@@ -79,14 +129,16 @@ public:
 
 private:
     std::string sql_bbox(box2d<double> const& env) const;
+    std::string sql_bbox(box2d<double> const& env, sql_parameters & params) const;
     std::string populate_tokens(std::string const& sql,
                                 double scale_denom,
                                 box2d<double> const& env,
                                 double pixel_width,
                                 double pixel_height,
-                                mapnik::attributes const& vars) const;
+                                mapnik::attributes const& vars,
+                                sql_parameters & params) const;
     std::string populate_tokens(std::string const& sql) const;
-    std::shared_ptr<IResultSet> get_resultset(conn_handle_ptr && conn_handle, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx= processor_context_ptr()) const;
+    std::shared_ptr<IResultSet> get_resultset(conn_handle_ptr && conn_handle, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx= processor_context_ptr(), sql_parameters const* params = nullptr) const;
     static const std::string GEOMETRY_COLUMNS;
     static const std::string SPATIAL_REF_SYS;
     static const double FMAX;
@@ -100,6 +152,7 @@ private:
     const std::string geometry_field_;
     std::string key_field_;
     mapnik::value_integer cursor_fetch_size_;
+    mapnik::value_integer stream_size_;
     mapnik::value_integer row_limit_;
     std::string geometryColumn_;
     mapnik::datasource::datasource_t type_;
@@ -119,6 +172,8 @@ private:
     bool estimate_extent_;
     int max_async_connections_;
     bool asynchronous_request_;
+    bool pipeline_;
+    bool prepared_statements_;
     bool twkb_encoding_;
     mapnik::value_double twkb_rounding_adjustment_;
     mapnik::value_double simplify_snap_ratio_;
@@ -37,6 +37,7 @@
 #include <mapnik/global.hpp> // for int2net
 
 // stl
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <memory>
@@ -45,6 +46,117 @@ using mapnik::geometry_utils;
 using mapnik::feature_factory;
 using mapnik::context_ptr;
 
+namespace {
+
+// Text of client encodings is ASCII compatible, values which are pure
+// ASCII are widened directly instead of going through the converter.
+mapnik::value_unicode_string decode_string(char const* buf, int size, transcoder const& tr)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        if (static_cast<unsigned char>(buf[i]) >= 0x80)
+        {
+            return tr.transcode(buf, size);
+        }
+    }
+    mapnik::value_unicode_string str;
+    if (size > 0)
+    {
+        UChar * out = str.getBuffer(size);
+        for (int i = 0; i < size; ++i)
+        {
+            out[i] = static_cast<UChar>(buf[i]);
+        }
+        str.releaseBuffer(size);
+    }
+    return str;
+}
+
+bool decode_bool(char const* buf, int, transcoder const&, mapnik::value & val)
+{
+    val = mapnik::value_bool(buf[0] != 0);
+    return true;
+}
+
+bool decode_int2(char const* buf, int, transcoder const&, mapnik::value & val)
+{
+    val = mapnik::value_integer(int2net(buf));
+    return true;
+}
+
+bool decode_int4(char const* buf, int, transcoder const&, mapnik::value & val)
+{
+    val = mapnik::value_integer(int4net(buf));
+    return true;
+}
+
+bool decode_int8(char const* buf, int, transcoder const&, mapnik::value & val)
+{
+    val = mapnik::value_integer(int8net(buf));
+    return true;
+}
+
+bool decode_float4(char const* buf, int, transcoder const&, mapnik::value & val)
+{
+    float f;
+    float4net(f, buf);
+    val = static_cast<mapnik::value_double>(f);
+    return true;
+}
+
+bool decode_float8(char const* buf, int, transcoder const&, mapnik::value & val)
+{
+    double d;
+    float8net(d, buf);
+    val = d;
+    return true;
+}
+
+bool decode_text(char const* buf, int size, transcoder const& tr, mapnik::value & val)
+{
+    val = decode_string(buf, size, tr);
+    return true;
+}
+
+bool decode_bpchar(char const* buf, int size, transcoder const& tr, mapnik::value & val)
+{
+    std::string str = mapnik::util::trim_copy(std::string(buf, size));
+    val = decode_string(str.data(), static_cast<int>(str.size()), tr);
+    return true;
+}
+
+bool decode_numeric(char const* buf, int, transcoder const&, mapnik::value & val)
+{
+    double d;
+    if (numeric2double(buf, d))
+    {
+        val = d;
+        return true;
+    }
+    return false;
+}
+
+column_decoder get_column_decoder(int oid)
+{
+    switch (oid)
+    {
+    case 16:   return decode_bool;    // bool
+    case 23:   return decode_int4;    // int4
+    case 21:   return decode_int2;    // int2
+    case 20:   return decode_int8;    // int8/BigInt
+    case 700:  return decode_float4;  // float4
+    case 701:  return decode_float8;  // float8
+    case 25:                          // text
+    case 1043:                        // varchar
+    case 705:  return decode_text;    // literal
+    case 1042: return decode_bpchar;  // bpchar
+    case 1700: return decode_numeric; // numeric
+    default:   return nullptr;
+    }
+}
+
+}
+
 postgis_featureset::postgis_featureset(std::shared_ptr<IResultSet> const& rs,
                                        context_ptr const& ctx,
                                        std::string const& encoding,
@@ -58,8 +170,39 @@ postgis_featureset::postgis_featureset(std::shared_ptr<IResultSet> const& rs,
       feature_id_(1),
       key_field_(key_field),
       key_field_as_attribute_(key_field_as_attribute),
-      twkb_encoding_(twkb_encoding)
+      twkb_encoding_(twkb_encoding),
+      columns_(),
+      columns_initialized_(false)
+{
+}
+
+void postgis_featureset::init_columns(unsigned pos)
 {
+    unsigned num_attrs = ctx_->size() + 1;
+    if (!key_field_as_attribute_)
+    {
+        num_attrs++;
+    }
+    num_attrs = std::min(num_attrs, static_cast<unsigned>(rs_->getNumFields()));
+    for (; pos < num_attrs; ++pos)
+    {
+        std::string name = rs_->getFieldName(pos);
+        auto itr = ctx_->find(name);
+        if (itr == ctx_->end())
+        {
+            continue;
+        }
+        const int oid = rs_->getTypeOID(pos);
+        if (column_decoder decode = get_column_decoder(oid))
+        {
+            columns_.push_back(column{static_cast<int>(pos), itr->second, decode});
+        }
+        else
+        {
+            MAPNIK_LOG_WARN(postgis) << "postgis_featureset: Unknown type_oid=" << oid;
+        }
+    }
+    columns_initialized_ = true;
 }
 
 feature_ptr postgis_featureset::next()
@@ -135,95 +278,20 @@ feature_ptr postgis_featureset::next()
         }
 
         totalGeomSize_ += size;
-        unsigned num_attrs = ctx_->size() + 1;
-        if (!key_field_as_attribute_)
+        if (!columns_initialized_)
         {
-            num_attrs++;
+            init_columns(pos);
         }
-        for (; pos < num_attrs; ++pos)
+        for (column const& col : columns_)
         {
-            std::string name = rs_->getFieldName(pos);
-
             // NOTE: we intentionally do not store null here
             // since it is equivalent to the attribute not existing
-            if (!rs_->isNull(pos))
+            if (!rs_->isNull(col.pos))
             {
-                const char* buf = rs_->getValue(pos);
-                const int oid = rs_->getTypeOID(pos);
-                switch (oid)
+                mapnik::value val;
+                if (col.decode(rs_->getValue(col.pos), rs_->getFieldLength(col.pos), *tr_, val))
                 {
-                    case 16: //bool
-                    {
-                        feature->put(name, (buf[0] != 0));
-                        break;
-                    }
-
-                    case 23: //int4
-                    {
-                        feature->put<mapnik::value_integer>(name, int4net(buf));
-                        break;
-                    }
-
-                    case 21: //int2
-                    {
-                        feature->put<mapnik::value_integer>(name, int2net(buf));
-                        break;
-                    }
-
-                    case 20: //int8/BigInt
-                    {
-                        feature->put<mapnik::value_integer>(name, int8net(buf));
-                        break;
-                    }
-
-                    case 700: //float4
-                    {
-                        float val;
-                        float4net(val, buf);
-                        feature->put(name, static_cast<double>(val));
-                        break;
-                    }
-
-                    case 701: //float8
-                    {
-                        double val;
-                        float8net(val, buf);
-                        feature->put(name, val);
-                        break;
-                    }
-
-                    case 25:   //text
-                    case 1043: //varchar
-                    case 705:  //literal
-                    {
-                        feature->put(name, tr_->transcode(buf));
-                        break;
-                    }
-
-                    case 1042: //bpchar
-                    {
-                        std::string str = mapnik::util::trim_copy(buf);
-                        feature->put(name, tr_->transcode(str.c_str()));
-                        break;
-                    }
-
-                    case 1700: //numeric
-                    {
-                        double val;
-                        std::string str = numeric2string(buf);
-                        if (mapnik::util::string2double(str, val))
-                        {
-                            feature->put(name, val);
-                        }
-                        break;
-                    }
-
-                    default:
-                    {
-                        MAPNIK_LOG_WARN(postgis) << "postgis_featureset: Unknown type_oid=" << oid;
-
-                        break;
-                    }
+                    feature->put_at(col.index, std::move(val));
                 }
             }
         }
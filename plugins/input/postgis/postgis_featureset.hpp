@@ -29,6 +29,9 @@
 #include <mapnik/feature.hpp>
 #include <mapnik/unicode.hpp>
 
+// stl
+#include <vector>
+
 using mapnik::Featureset;
 using mapnik::box2d;
 using mapnik::feature_ptr;
@@ -37,6 +40,9 @@ using mapnik::context_ptr;
 
 class IResultSet;
 
+// Decodes a binary attribute value, returns false when there is no value
+using column_decoder = bool (*)(char const* buf, int size, mapnik::transcoder const& tr, mapnik::value & val);
+
 class postgis_featureset : public mapnik::Featureset
 {
 public:
@@ -50,6 +56,15 @@ public:
     ~postgis_featureset();
 
 private:
+    struct column
+    {
+        int pos;
+        std::size_t index;
+        column_decoder decode;
+    };
+
+    void init_columns(unsigned pos);
+
     std::shared_ptr<IResultSet> rs_;
     context_ptr ctx_;
     const std::unique_ptr<mapnik::transcoder> tr_;
@@ -58,6 +73,9 @@ private:
     bool key_field_;
     bool key_field_as_attribute_;
     bool twkb_encoding_;
+    // attribute columns of the result set, resolved on the first row
+    std::vector<column> columns_;
+    bool columns_initialized_;
 };
 
 #endif // POSTGIS_FEATURESET_HPP
@@ -0,0 +1,162 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef POSTGIS_STREAMINGRESULTSET_HPP
+#define POSTGIS_STREAMINGRESULTSET_HPP
+
+#include <mapnik/debug.hpp>
+
+#include "connection_manager.hpp"
+#include "resultset.hpp"
+
+// Rows of a query sent with executeStreamingQuery, only the current row
+// or chunk of rows is held in memory.
+class StreamingResultSet : public IResultSet, private mapnik::util::noncopyable
+{
+public:
+    StreamingResultSet(std::unique_ptr<ConnectionManager::PoolType::handle> && conn_handle)
+        : conn_handle_(std::move(conn_handle)),
+          is_done_(false) {}
+
+    virtual ~StreamingResultSet()
+    {
+        close();
+    }
+
+    virtual void close()
+    {
+        rs_.reset();
+        if (conn_handle_)
+        {
+            if (!is_done_)
+            {
+                // remaining rows would have to be read, the connection is
+                // closed instead and recycled by the pool
+                Connection & conn = conn_handle_->get();
+                MAPNIK_LOG_DEBUG(postgis) << "StreamingResultSet: aborting pending connection - " << &conn;
+                conn.close();
+            }
+            conn_handle_.reset();
+        }
+    }
+
+    virtual int getNumFields() const
+    {
+        return rs_->getNumFields();
+    }
+
+    virtual bool next()
+    {
+        while (!rs_ || !rs_->next())
+        {
+            rs_.reset();
+            if (is_done_ || !conn_handle_)
+            {
+                return false;
+            }
+            next_result();
+        }
+        return true;
+    }
+
+    virtual const char* getFieldName(int index) const
+    {
+        return rs_->getFieldName(index);
+    }
+
+    virtual int getFieldLength(int index) const
+    {
+        return rs_->getFieldLength(index);
+    }
+
+    virtual int getFieldLength(const char* name) const
+    {
+        return rs_->getFieldLength(name);
+    }
+
+    virtual int getTypeOID(int index) const
+    {
+        return rs_->getTypeOID(index);
+    }
+
+    virtual int getTypeOID(const char* name) const
+    {
+        return rs_->getTypeOID(name);
+    }
+
+    virtual bool isNull(int index) const
+    {
+        return rs_->isNull(index);
+    }
+
+    virtual const char* getValue(int index) const
+    {
+        return rs_->getValue(index);
+    }
+
+    virtual const char* getValue(const char* name) const
+    {
+        return rs_->getValue(name);
+    }
+
+private:
+    void next_result()
+    {
+        Connection & conn = conn_handle_->get();
+        PGresult *result = conn.getResult();
+        ExecStatusType status = result ? PQresultStatus(result) : PGRES_FATAL_ERROR;
+        if (status == PGRES_SINGLE_TUPLE
+#if defined(LIBPQ_HAS_CHUNK_MODE)
+            || status == PGRES_TUPLES_CHUNK
+#endif
+            )
+        {
+            rs_ = std::make_shared<ResultSet>(result);
+        }
+        else if (status == PGRES_TUPLES_OK)
+        {
+            // empty result ending the rows of the query
+            PQclear(result);
+            while (PGresult *tmp = conn.getResult())
+            {
+                PQclear(tmp);
+            }
+            is_done_ = true;
+            conn_handle_.reset();
+        }
+        else
+        {
+            std::string err_msg = "Postgis Plugin: ";
+            err_msg += conn.status();
+            err_msg += "in StreamingResultSet::next";
+            if (result) PQclear(result);
+            close();
+            throw mapnik::datasource_exception(err_msg);
+        }
+    }
+
+    std::unique_ptr<ConnectionManager::PoolType::handle> conn_handle_;
+    std::shared_ptr<ResultSet> rs_;
+    bool is_done_;
+};
+
+#endif // POSTGIS_STREAMINGRESULTSET_HPP
@@ -0,0 +1,131 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef POSTGIS_THREADED_FEATURESET_HPP
+#define POSTGIS_THREADED_FEATURESET_HPP
+
+// mapnik
+#include <mapnik/feature.hpp>
+#include <mapnik/datasource.hpp>
+
+// stl
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+// Reads features of the source featureset on its own thread into a queue
+// of at most capacity features, rendering of the first features overlaps
+// with receiving and decoding of the rest.
+//
+// A dedicated thread is used rather than the global thread pool, the
+// consumer may be a pool worker blocked on the queue.
+class threaded_featureset : public mapnik::Featureset
+{
+public:
+    threaded_featureset(mapnik::featureset_ptr const& source, std::size_t capacity)
+        : source_(source),
+          capacity_(std::max(capacity, std::size_t(1))),
+          queue_(),
+          done_(false),
+          cancel_(false),
+          error_(),
+          thread_(&threaded_featureset::run, this) {}
+
+    ~threaded_featureset()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancel_ = true;
+        }
+        not_full_.notify_all();
+        thread_.join();
+    }
+
+    mapnik::feature_ptr next()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !queue_.empty() || done_; });
+        if (!queue_.empty())
+        {
+            mapnik::feature_ptr feature = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            not_full_.notify_one();
+            return feature;
+        }
+        if (error_)
+        {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+        return mapnik::feature_ptr();
+    }
+
+private:
+    void run()
+    {
+        try
+        {
+            while (mapnik::feature_ptr feature = source_->next())
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_full_.wait(lock, [this] { return queue_.size() < capacity_ || cancel_; });
+                if (cancel_)
+                {
+                    break;
+                }
+                queue_.push_back(std::move(feature));
+                lock.unlock();
+                not_empty_.notify_one();
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+        }
+        // resources of the source, like its connection, are released here
+        source_.reset();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        not_empty_.notify_all();
+    }
+
+    mapnik::featureset_ptr source_;
+    std::size_t capacity_;
+    std::deque<mapnik::feature_ptr> queue_;
+    bool done_;
+    bool cancel_;
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::thread thread_;
+};
+
+#endif // POSTGIS_THREADED_FEATURESET_HPP
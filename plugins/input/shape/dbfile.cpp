@@ -38,6 +38,7 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <cstring>
@@ -47,7 +48,8 @@ dbf_file::dbf_file()
     : num_records_(0),
       num_fields_(0),
       record_length_(0),
-      record_(0) {}
+      record_(0),
+      current_record_(nullptr) {}
 
 dbf_file::dbf_file(std::string const& file_name)
     :num_records_(0),
@@ -60,7 +62,8 @@ dbf_file::dbf_file(std::string const& file_name)
 #else
      file_(file_name.c_str() ,std::ios::in | std::ios::binary),
 #endif
-     record_(0)
+     record_(0),
+     current_record_(nullptr)
 {
 
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
@@ -111,20 +114,37 @@ int dbf_file::num_fields() const
 
 void dbf_file::move_to(int index)
 {
+    current_record_ = nullptr;
     if (index>0 && index<=num_records_)
     {
         std::streampos pos=(num_fields_<<5)+34+(index-1)*(record_length_+1);
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+        // records are read in place
+        std::size_t offset = static_cast<std::size_t>(pos);
+        if (offset + record_length_ <= mapped_region_->get_size())
+        {
+            current_record_ = static_cast<char const*>(mapped_region_->get_address()) + offset;
+        }
+#else
         file_.seekg(pos,std::ios::beg);
         file_.read(record_,record_length_);
+        current_record_ = record_;
+#endif
     }
 }
 
 
+char const* dbf_file::record() const
+{
+    return current_record_;
+}
+
+
 std::string dbf_file::string_value(int col) const
 {
-    if (col>=0 && col<num_fields_)
+    if (current_record_ && col>=0 && col<num_fields_)
     {
-        return std::string(record_+fields_[col].offset_,fields_[col].length_);
+        return std::string(current_record_+fields_[col].offset_,fields_[col].length_);
     }
     return "";
 }
@@ -139,77 +159,106 @@ const field_descriptor& dbf_file::descriptor(int col) const
 
 void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feature_impl & f) const
 {
-    using namespace boost::spirit;
+    if (current_record_ && col>=0 && col<num_fields_)
+    {
+        mapnik::value val;
+        if (decode_field(fields_[col], current_record_, tr, val))
+        {
+            f.put(fields_[col].name_, std::move(val));
+        }
+    }
+}
 
-    if (col>=0 && col<num_fields_)
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+mapnik::attribute_decoder_ptr dbf_file::decoder(std::vector<int> const& cols, std::string const& encoding) const
+{
+    std::vector<field_descriptor> fields;
+    fields.reserve(cols.size());
+    for (int col : cols)
     {
-        std::string const& name=fields_[col].name_;
+        fields.push_back(descriptor(col));
+    }
+    return std::make_shared<dbf_record_decoder>(mapped_region_, std::move(fields), encoding);
+}
 
-        // NOTE: ensure types handled here are matched in shape_datasource.cpp
-        switch (fields_[col].type_)
-        {
-        case 'C':
-        case 'D':
+dbf_record_decoder::dbf_record_decoder(mapnik::mapped_region_ptr const& region,
+                                       std::vector<field_descriptor> && fields,
+                                       std::string const& encoding)
+    : region_(region),
+      fields_(std::move(fields)),
+      tr_(encoding) {}
+
+void dbf_record_decoder::decode(char const* record, std::size_t index, mapnik::value & val) const
+{
+    if (index < fields_.size())
+    {
+        decode_field(fields_[index], record, tr_, val);
+    }
+}
+#endif
+
+bool decode_field(field_descriptor const& desc, char const* record,
+                  mapnik::transcoder const& tr, mapnik::value & val)
+{
+    using namespace boost::spirit;
+
+    char const* begin = record + desc.offset_;
+    char const* end = begin + desc.length_;
+    // NOTE: ensure types handled here are matched in shape_datasource.cpp
+    switch (desc.type_)
+    {
+    case 'C':
+    case 'D':
+    {
+        // trimmed value up to the first null character
+        while (begin != end && !mapnik::util::not_whitespace(*begin)) ++begin;
+        while (end != begin && !mapnik::util::not_whitespace(*(end - 1))) --end;
+        end = std::find(begin, end, '\0');
+        val = tr.transcode(begin, static_cast<std::int32_t>(end - begin));
+        return true;
+    }
+    case 'L':
+    {
+        char ch = *begin;
+        // NOTE: null logical fields use '?'
+        val = (ch == '1' || ch == 't' || ch == 'T' || ch == 'y' || ch == 'Y');
+        return true;
+    }
+    case 'N': // numeric
+    case 'O': // double
+    case 'F': // float
+    {
+        if (*begin == '*')
         {
-            // FIXME - avoid constructing std::string on stack
-            std::string str(record_+fields_[col].offset_,fields_[col].length_);
-            mapnik::util::trim(str);
-            f.put(name,tr.transcode(str.c_str()));
-            break;
+            // NOTE: we intentionally do not store null here
+            // since it is equivalent to the attribute not existing
+            return false;
         }
-        case 'L':
+        ascii::space_type space;
+        if (desc.dec_>0)
         {
-            char ch = record_[fields_[col].offset_];
-            if ( ch == '1' || ch == 't' || ch == 'T' || ch == 'y' || ch == 'Y')
-            {
-                f.put(name,true);
-            }
-            else
+            double d = 0.0;
+            static qi::double_type double_;
+            if (qi::phrase_parse(begin,end,double_,space,d))
             {
-                // NOTE: null logical fields use '?'
-                f.put(name,false);
+                val = d;
+                return true;
             }
-            break;
         }
-        case 'N': // numeric
-        case 'O': // double
-        case 'F': // float
+        else
         {
-
-            if (record_[fields_[col].offset_] == '*')
-            {
-                // NOTE: we intentionally do not store null here
-                // since it is equivalent to the attribute not existing
-                break;
-            }
-            if ( fields_[col].dec_>0 )
+            mapnik::value_integer i = 0;
+            static qi::int_parser<mapnik::value_integer,10,1,-1> numeric_parser;
+            if (qi::phrase_parse(begin, end, numeric_parser, space, i))
             {
-                double val = 0.0;
-                const char *itr = record_+fields_[col].offset_;
-                const char *end = itr + fields_[col].length_;
-                ascii::space_type space;
-                static qi::double_type double_;
-                if (qi::phrase_parse(itr,end,double_,space,val))
-                {
-                    f.put(name,val);
-                }
+                val = i;
+                return true;
             }
-            else
-            {
-                mapnik::value_integer val = 0;
-                const char *itr = record_+fields_[col].offset_;
-                const char *end = itr + fields_[col].length_;
-                ascii::space_type space;
-                static qi::int_parser<mapnik::value_integer,10,1,-1> numeric_parser;
-                if (qi::phrase_parse(itr, end, numeric_parser, space, val))
-                {
-                    f.put(name,val);
-                }
-            }
-            break;
-        }
         }
+        return false;
     }
+    }
+    return false;
 }
 
 void dbf_file::read_header()
@@ -247,10 +296,12 @@ void dbf_file::read_header()
             fields_.push_back(desc);
         }
         record_length_=offset;
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
         if (record_length_>0)
         {
             record_=static_cast<char*>(::operator new (sizeof(char)*record_length_));
         }
+#endif
     }
 }
 
@@ -41,6 +41,7 @@
 #include <string>
 #include <cassert>
 #include <fstream>
+#include <memory>
 
 struct field_descriptor
 {
@@ -52,6 +53,27 @@ struct field_descriptor
     std::streampos offset_;
 };
 
+// Decodes field of record into val, returns false if the field is null.
+bool decode_field(field_descriptor const& desc, char const* record,
+                  mapnik::transcoder const& tr, mapnik::value & val);
+
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+// Decodes attributes of features pointing into the mapped dbf file, the
+// attribute at index i of the context is the field at index i of fields.
+class dbf_record_decoder : public mapnik::attribute_decoder
+{
+public:
+    dbf_record_decoder(mapnik::mapped_region_ptr const& region,
+                       std::vector<field_descriptor> && fields,
+                       std::string const& encoding);
+    void decode(char const* record, std::size_t index, mapnik::value & val) const;
+private:
+    mapnik::mapped_region_ptr region_;
+    std::vector<field_descriptor> fields_;
+    mapnik::transcoder tr_;
+};
+#endif
+
 
 class dbf_file : private mapnik::util::noncopyable
 {
@@ -67,6 +89,7 @@ private:
     std::ifstream file_;
 #endif
     char* record_;
+    char const* current_record_;
 public:
     dbf_file();
     dbf_file(std::string const& file_name);
@@ -76,8 +99,14 @@ public:
     int num_fields() const;
     field_descriptor const& descriptor(int col) const;
     void move_to(int index);
+    // current record, nullptr if the last move_to was out of range
+    char const* record() const;
     std::string string_value(int col) const;
     void add_attribute(int col, mapnik::transcoder const& tr, mapnik::feature_impl & f) const;
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    // Decoder of the fields at cols, in the order of the feature context.
+    mapnik::attribute_decoder_ptr decoder(std::vector<int> const& cols, std::string const& encoding) const;
+#endif
 private:
     void read_header();
     int read_short();
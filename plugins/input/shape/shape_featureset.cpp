@@ -61,6 +61,12 @@ shape_featureset<filterT>::shape_featureset(filterT const& filter,
     shx_header.skip(6 * 4);
     shx_file_length_ = shx_header.read_xdr_integer();
     setup_attributes(ctx_, attribute_names, shape_name, shape_, attr_ids_);
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    if (!attr_ids_.empty())
+    {
+        decoder_ = shape_.dbf().decoder(attr_ids_, encoding);
+    }
+#endif
 }
 
 template <typename filterT>
@@ -144,6 +150,13 @@ feature_ptr shape_featureset<filterT>::next()
         if (attr_ids_.size())
         {
             shape_.dbf().move_to(shape_.id_);
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+            // fields are decoded from the mapped record when an expression reads them
+            if (shape_.dbf().record())
+            {
+                feature->set_attribute_decoder(decoder_, shape_.dbf().record());
+            }
+#else
             try
             {
                 for (auto id : attr_ids_)
@@ -155,6 +168,7 @@ feature_ptr shape_featureset<filterT>::next()
             {
                 MAPNIK_LOG_ERROR(shape) << "Shape Plugin: error processing attributes";
             }
+#endif
         }
         ++count_;
         return feature;
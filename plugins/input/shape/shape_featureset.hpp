@@ -62,6 +62,9 @@ private:
     const std::unique_ptr<transcoder> tr_;
     long shx_file_length_;
     std::vector<int> attr_ids_;
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    mapnik::attribute_decoder_ptr decoder_;
+#endif
     mapnik::value_integer row_limit_;
     mutable int count_;
     context_ptr ctx_;
@@ -38,6 +38,7 @@
 #include "shape_index_featureset.hpp"
 #include "shape_utils.hpp"
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/util/mapped_spatial_index.hpp>
 
 using mapnik::feature_factory;
 
@@ -61,12 +62,19 @@ shape_index_featureset<filterT>::shape_index_featureset(filterT const& filter,
 {
     shape_ptr_->shp().skip(100);
     setup_attributes(ctx_, attribute_names, shape_name, *shape_ptr_,attr_ids_);
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    if (!attr_ids_.empty())
+    {
+        decoder_ = shape_ptr_->dbf().decoder(attr_ids_, encoding);
+    }
+#endif
 
     auto index = shape_ptr_->index();
     if (index)
     {
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
-        mapnik::util::spatial_index<mapnik::detail::node, filterT,boost::interprocess::ibufferstream>::query(filter, index->file(), offsets_);
+        mapnik::util::mapped_spatial_index::open(shape_name + shape_io::INDEX,
+                                                 sizeof(mapnik::detail::node))->query(filter, offsets_);
 #else
         mapnik::util::spatial_index<mapnik::detail::node, filterT, std::ifstream>::query(filter, index->file(), offsets_);
 #endif
@@ -157,6 +165,13 @@ feature_ptr shape_index_featureset<filterT>::next()
         if (attr_ids_.size())
         {
             shape_ptr_->dbf().move_to(shape_ptr_->id_);
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+            // fields are decoded from the mapped record when an expression reads them
+            if (shape_ptr_->dbf().record())
+            {
+                feature->set_attribute_decoder(decoder_, shape_ptr_->dbf().record());
+            }
+#else
             try
             {
                 for (auto id : attr_ids_)
@@ -168,6 +183,7 @@ feature_ptr shape_index_featureset<filterT>::next()
             {
                 MAPNIK_LOG_ERROR(shape) << "Shape Plugin: error processing attributes";
             }
+#endif
         }
         ++count_;
         return feature;
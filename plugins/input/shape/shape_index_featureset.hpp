@@ -81,6 +81,9 @@ private:
     std::vector<mapnik::detail::node> offsets_;
     std::vector<mapnik::detail::node>::iterator itr_;
     std::vector<int> attr_ids_;
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    mapnik::attribute_decoder_ptr decoder_;
+#endif
     mapnik::value_integer row_limit_;
     mutable int count_;
     mutable box2d<double> feature_bbox_;
@@ -43,6 +43,7 @@
 #include <mapnik/image_filter.hpp>
 #include <mapnik/image_any.hpp>
 #include <mapnik/make_unique.hpp>
+#include <mapnik/safe_cast.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
@@ -63,23 +64,55 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
 #include <cmath>
 
 namespace mapnik
 {
 
+namespace {
+
+bool empty_region(box2d<int> const& region)
+{
+    return !region.valid() || region.width() <= 0 || region.height() <= 0;
+}
+
+template <typename Image>
+box2d<int> image_extent(Image const& image)
+{
+    return box2d<int>(0, 0, safe_cast<int>(image.width()), safe_cast<int>(image.height()));
+}
+
+template <typename Image>
+void clear_region(Image & image, box2d<int> region)
+{
+    if (!region.valid()) return;
+    region.clip(image_extent(image));
+    if (empty_region(region)) return;
+    for (int y = region.miny(); y < region.maxy(); ++y)
+    {
+        typename Image::pixel_type * row = image.get_row(y);
+        std::fill(row + region.minx(), row + region.maxx(), 0);
+    }
+}
+
+}
+
 template <typename T0, typename T1>
 agg_renderer<T0,T1>::agg_renderer(Map const& m, T0 & pixmap, double scale_factor, unsigned offset_x, unsigned offset_y)
     : feature_style_processor<agg_renderer>(m, scale_factor),
       buffers_(),
+      painted_regions_(),
       internal_buffers_(m.width(), m.height()),
       inflated_buffer_(),
+      inflated_painted_(),
       ras_ptr(new rasterizer),
       gamma_method_(GAMMA_POWER),
       gamma_(1.0),
       common_(m, attributes(), offset_x, offset_y, m.width(), m.height(), scale_factor)
 {
     buffers_.emplace(pixmap);
+    painted_regions_.emplace();
 #ifdef MAPNIK_STATS_RENDER
     common_.detector_->stats_stream_ = &this->sink_.stream_;
 #endif
@@ -89,14 +122,17 @@ template <typename T0, typename T1>
 agg_renderer<T0,T1>::agg_renderer(Map const& m, request const& req, attributes const& vars, T0 & pixmap, double scale_factor, unsigned offset_x, unsigned offset_y)
     : feature_style_processor<agg_renderer>(m, scale_factor),
       buffers_(),
+      painted_regions_(),
       internal_buffers_(req.width(), req.height()),
       inflated_buffer_(),
+      inflated_painted_(),
       ras_ptr(new rasterizer),
       gamma_method_(GAMMA_POWER),
       gamma_(1.0),
       common_(m, req, vars, offset_x, offset_y, req.width(), req.height(), scale_factor)
 {
     buffers_.emplace(pixmap);
+    painted_regions_.emplace();
 #ifdef MAPNIK_STATS_RENDER
     common_.detector_->stats_stream_ = &this->sink_.stream_;
 #endif
@@ -107,14 +143,17 @@ agg_renderer<T0,T1>::agg_renderer(Map const& m, T0 & pixmap, std::shared_ptr<T1>
                               double scale_factor, unsigned offset_x, unsigned offset_y)
     : feature_style_processor<agg_renderer>(m, scale_factor),
       buffers_(),
+      painted_regions_(),
       internal_buffers_(m.width(), m.height()),
       inflated_buffer_(),
+      inflated_painted_(),
       ras_ptr(new rasterizer),
       gamma_method_(GAMMA_POWER),
       gamma_(1.0),
       common_(m, attributes(), offset_x, offset_y, m.width(), m.height(), scale_factor, detector)
 {
     buffers_.emplace(pixmap);
+    painted_regions_.emplace();
 #ifdef MAPNIK_STATS_RENDER
     common_.detector_->stats_stream_ = &this->sink_.stream_;
 #endif
@@ -243,6 +282,10 @@ void agg_renderer<T0,T1>::setup(Map const &m, buffer_type & pixmap)
 template <typename T0, typename T1>
 agg_renderer<T0,T1>::~agg_renderer()
 {
+    if (inflated_buffer_)
+    {
+        image_pool<typename buffer_type::pixel>::release(std::move(*inflated_buffer_), inflated_painted_);
+    }
 #ifdef MAPNIK_STATS_RENDER
     common_.detector_->stats_stream_ = nullptr;
 #endif
@@ -282,6 +325,7 @@ void agg_renderer<T0,T1>::start_layer_processing(layer const& lay, box2d<double>
         common_.query_extent_.clip(*maximum_extent);
     }
 
+    painted_region();
     if (lay.comp_op() || lay.get_opacity() < 1.0)
     {
         buffers_.emplace(internal_buffers_.push());
@@ -291,6 +335,7 @@ void agg_renderer<T0,T1>::start_layer_processing(layer const& lay, box2d<double>
     {
         buffers_.emplace(buffers_.top().get());
     }
+    painted_regions_.emplace();
 }
 
 template <typename T0, typename T1>
@@ -299,20 +344,41 @@ void agg_renderer<T0,T1>::end_layer_processing(layer const& lyr)
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: End layer processing";
 
     buffer_type & current_buffer = buffers_.top().get();
+    box2d<int> region = painted_region();
     buffers_.pop();
+    painted_regions_.pop();
     buffer_type & previous_buffer = buffers_.top().get();
 
     if (&current_buffer != &previous_buffer)
     {
+        box2d<int> dirty(region);
         composite_mode_e comp_op = lyr.comp_op() ? *lyr.comp_op() : src_over;
-        composite(previous_buffer, current_buffer,
-                  comp_op, lyr.get_opacity(), 0, 0
+        if (!composite_preserves_dst(comp_op))
+        {
+            composite(previous_buffer, current_buffer,
+                      comp_op, lyr.get_opacity(), 0, 0
+#ifdef MAPNIK_STATS_RENDER
+                      , &this->sink_.stream_
+#endif
+                     );
+            region = image_extent(previous_buffer);
+        }
+        else if (!empty_region(region))
+        {
+            // transparent pixels outside of the region leave previous_buffer untouched
+            composite(previous_buffer, current_buffer,
+                      comp_op, lyr.get_opacity(), 0, 0, region
 #ifdef MAPNIK_STATS_RENDER
-                  , &this->sink_.stream_
+                      , &this->sink_.stream_
 #endif
-                 );
+                     );
+        }
         previous_buffer.painted(previous_buffer.painted() || current_buffer.painted());
-        internal_buffers_.pop();
+        internal_buffers_.pop(dirty);
+    }
+    if (!empty_region(region))
+    {
+        painted_regions_.top().expand_to_include(region);
     }
 
     if (!lyr.direct_image_filters().empty())
@@ -327,6 +393,7 @@ void agg_renderer<T0,T1>::end_layer_processing(layer const& lyr)
             util::apply_visitor(visitor, filter_tag);
         }
         mapnik::premultiply_alpha(previous_buffer);
+        painted_regions_.top() = image_extent(previous_buffer);
     }
 }
 
@@ -335,6 +402,7 @@ void agg_renderer<T0,T1>::start_style_processing(feature_type_style const& st)
 {
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: Start processing style";
 
+    painted_region();
     if (st.comp_op() || st.image_filters().size() > 0 || st.get_opacity() < 1)
     {
         if (st.image_filters_inflate())
@@ -358,12 +426,21 @@ void agg_renderer<T0,T1>::start_style_processing(feature_type_style const& st)
                 (inflated_buffer_->width() < target_width ||
                  inflated_buffer_->height() < target_height))
             {
-                inflated_buffer_ = std::make_unique<buffer_type>(target_width, target_height);
+                using pool_type = image_pool<typename buffer_type::pixel>;
+                if (inflated_buffer_)
+                {
+                    pool_type::release(std::move(*inflated_buffer_), inflated_painted_);
+                }
+                inflated_buffer_ = std::make_unique<buffer_type>(
+                    pool_type::acquire(target_width, target_height));
             }
             else
             {
-                mapnik::fill(*inflated_buffer_, 0); // fill with transparent colour
+                // only the part painted by the previous style needs clearing
+                clear_region(*inflated_buffer_, inflated_painted_);
             }
+            // narrowed down in end_style_processing
+            inflated_painted_ = image_extent(*inflated_buffer_);
             buffers_.emplace(*inflated_buffer_);
         }
         else
@@ -380,13 +457,16 @@ void agg_renderer<T0,T1>::start_style_processing(feature_type_style const& st)
         ras_ptr->clip_box(0,0,common_.width_,common_.height_);
         buffers_.emplace(buffers_.top().get());
     }
+    painted_regions_.emplace();
 }
 
 template <typename T0, typename T1>
 void agg_renderer<T0,T1>::end_style_processing(feature_type_style const& st)
 {
     buffer_type & current_buffer = buffers_.top().get();
+    box2d<int> region = painted_region();
     buffers_.pop();
+    painted_regions_.pop();
     buffer_type & previous_buffer = buffers_.top().get();
     if (&current_buffer != &previous_buffer)
     {
@@ -394,45 +474,65 @@ void agg_renderer<T0,T1>::end_style_processing(feature_type_style const& st)
         if (st.image_filters().size() > 0)
         {
             blend_from = true;
-            mapnik::filter::filter_visitor<buffer_type> visitor(current_buffer, common_.scale_factor_);
+            region = mapnik::filter::apply_filters(current_buffer, st.image_filters(),
+                                                   region, common_.scale_factor_
 #ifdef MAPNIK_STATS_RENDER
-            visitor.stats_stream_ = &this->sink_.stream_;
+                                                   , &this->sink_.stream_
 #endif
-            for (mapnik::filter::filter_type const& filter_tag : st.image_filters())
-            {
-                util::apply_visitor(visitor, filter_tag);
-            }
-            mapnik::premultiply_alpha(current_buffer);
+                                                  );
         }
-        if (st.comp_op())
+        if (&current_buffer == inflated_buffer_.get())
         {
-            composite(previous_buffer, current_buffer,
-                      *st.comp_op(), st.get_opacity(),
-                      -common_.t_.offset(),
-                      -common_.t_.offset()
-#ifdef MAPNIK_STATS_RENDER
-                      , &this->sink_.stream_
-#endif
-                 );
+            inflated_painted_ = region;
         }
-        else if (blend_from || st.get_opacity() < 1.0)
+        int offset = common_.t_.offset();
+        box2d<int> src_area(region);
+        box2d<int> dirty(region);
+        if (!empty_region(region))
         {
-            composite(previous_buffer, current_buffer,
-                      src_over, st.get_opacity(),
-                      -common_.t_.offset(),
-                      -common_.t_.offset()
+            region.move(-offset, -offset);
+            region.clip(image_extent(previous_buffer));
+        }
+        if (st.comp_op() || blend_from || st.get_opacity() < 1.0)
+        {
+            composite_mode_e comp_op = st.comp_op() ? *st.comp_op() : src_over;
+            if (!composite_preserves_dst(comp_op))
+            {
+                composite(previous_buffer, current_buffer,
+                          comp_op, st.get_opacity(),
+                          -offset,
+                          -offset
 #ifdef MAPNIK_STATS_RENDER
-                      , &this->sink_.stream_
+                          , &this->sink_.stream_
+#endif
+                     );
+                region = image_extent(previous_buffer);
+            }
+            else if (!empty_region(region))
+            {
+                // transparent pixels outside of src_area leave previous_buffer untouched
+                composite(previous_buffer, current_buffer,
+                          comp_op, st.get_opacity(),
+                          -offset,
+                          -offset,
+                          src_area
+#ifdef MAPNIK_STATS_RENDER
+                          , &this->sink_.stream_
 #endif
-                 );
+                     );
+            }
         }
         previous_buffer.painted(previous_buffer.painted() || current_buffer.painted());
         if (!internal_buffers_.empty()
             && &current_buffer == &internal_buffers_.top())
         {
-            internal_buffers_.pop();
+            internal_buffers_.pop(dirty);
         }
     }
+    if (!empty_region(region))
+    {
+        painted_regions_.top().expand_to_include(region);
+    }
 
     if (st.direct_image_filters().size() > 0)
     {
@@ -446,10 +546,35 @@ void agg_renderer<T0,T1>::end_style_processing(feature_type_style const& st)
             util::apply_visitor(visitor, filter_tag);
         }
         mapnik::premultiply_alpha(previous_buffer);
+        painted_regions_.top() = image_extent(previous_buffer);
     }
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: End processing style";
 }
 
+template <typename T0, typename T1>
+box2d<int> & agg_renderer<T0,T1>::painted_region()
+{
+    // pixels rendered since the last call belong to the current buffer
+    box2d<int> & region = painted_regions_.top();
+    box2d<int> extent = ras_ptr->painted_extent();
+    ras_ptr->reset_painted_extent();
+    if (extent.valid())
+    {
+        extent.clip(image_extent(buffers_.top().get()));
+        if (!empty_region(extent))
+        {
+            region.expand_to_include(extent);
+        }
+    }
+    return region;
+}
+
+template <typename T0, typename T1>
+void agg_renderer<T0,T1>::mark_painted()
+{
+    ras_ptr->mark_painted(image_extent(buffers_.top().get()));
+}
+
 template <typename buffer_type>
 struct agg_render_marker_visitor
 {
@@ -547,14 +672,15 @@ struct agg_render_marker_visitor
         {
             double cx = 0.5 * width;
             double cy = 0.5 * height;
+            int x = static_cast<int>(std::floor(pos_.x - cx + .5));
+            int y = static_cast<int>(std::floor(pos_.y - cy + .5));
             composite(current_buffer_, marker.get_data(),
-                      comp_op_, opacity_,
-                      std::floor(pos_.x - cx + .5),
-                      std::floor(pos_.y - cy + .5)
+                      comp_op_, opacity_, x, y
 #ifdef MAPNIK_STATS_RENDER
                       , stats_stream_
 #endif
                      );
+            ras_ptr_->mark_painted(box2d<int>(x, y, x + static_cast<int>(width), y + static_cast<int>(height)));
         }
         else
         {
@@ -722,6 +848,8 @@ void agg_renderer<T0,T1>::draw_geo_extent(box2d<double> const& extent, mapnik::c
     double y0 = box.miny();
     double y1 = box.maxy();
     unsigned rgba = color.rgba();
+    ras_ptr->mark_painted(box2d<int>(static_cast<int>(std::floor(x0)), static_cast<int>(std::floor(y0)),
+                                     static_cast<int>(std::ceil(x1)) + 1, static_cast<int>(std::ceil(y1)) + 1));
     for (double x=x0; x<x1; x++)
     {
         mapnik::set_pixel(buffers_.top().get(), x, y0, rgba);
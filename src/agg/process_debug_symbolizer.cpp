@@ -250,12 +250,14 @@ void agg_renderer<T0,T1>::process(debug_symbolizer const& sym,
                 draw_rect(buffers_.top().get(), n.first);
             }
         }
+        mark_painted();
     }
     else if (mode == DEBUG_SYM_MODE_VERTEX)
     {
         using apply_vertex_mode = apply_vertex_mode<buffer_type>;
         apply_vertex_mode apply(buffers_.top().get(), common_.t_, prj_trans);
         util::apply_visitor(geometry::vertex_processor<apply_vertex_mode>(apply), feature.get_geometry());
+        mark_painted();
     }
 }
 
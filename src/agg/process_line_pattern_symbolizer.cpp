@@ -228,6 +228,8 @@ void  agg_renderer<T0,T1>::process(
         {
             warp_pattern pattern(pattern_image, common_, sym, feature, prj_trans);
             render(pattern, current_buffer, *ras_ptr);
+            // rasterizer_outline_aa draws without ras_ptr
+            mark_painted();
             break;
         }
         case LINE_PATTERN_REPEAT:
@@ -192,6 +192,8 @@ void agg_renderer<T0,T1>::process(line_symbolizer const& sym,
         using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
         apply_vertex_converter_type apply(converter, ras);
         mapnik::util::apply_visitor(vertex_processor_type(apply),feature.get_geometry());
+        // rasterizer_outline_aa draws without ras_ptr
+        mark_painted();
     }
     else
     {
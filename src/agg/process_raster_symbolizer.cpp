@@ -61,6 +61,9 @@ void agg_renderer<T0,T1>::process(raster_symbolizer const& sym,
                       , &this->sink_.stream_
 #endif
             );
+            ras_ptr->mark_painted(box2d<int>(start_x, start_y,
+                                             start_x + static_cast<int>(target.width()),
+                                             start_y + static_cast<int>(target.height())));
         }
 #ifdef MAPNIK_STATS_RENDER
        , this->sink_.stream_
@@ -87,6 +87,7 @@ void  agg_renderer<T0,T1>::process(shield_symbolizer const& sym,
             ren.render(*glyphs);
         }
     }
+    ras_ptr->mark_painted(ren.painted_extent());
 }
 
 
@@ -170,6 +170,7 @@ source = Split(
     expression_node.cpp
     expression_string.cpp
     expression.cpp
+    filter_program.cpp
     transform_expression.cpp
     feature_kv_iterator.cpp
     feature_style_processor.cpp
@@ -186,6 +187,7 @@ source = Split(
     image_view.cpp
     image_view_any.cpp
     image_any.cpp
+    image_pool.cpp
     image_options.cpp
     image_util.cpp
     image_util_jpeg.cpp
@@ -216,6 +218,8 @@ source = Split(
     unicode.cpp
     raster_colorizer.cpp
     mapped_memory_cache.cpp
+    metatile.cpp
+    feature_cache.cpp
     marker_cache.cpp
     svg/svg_parser.cpp
     svg/svg_path_parser.cpp
@@ -226,6 +230,8 @@ source = Split(
     vertex_cache.cpp
     vertex_adapters.cpp
     text/font_library.cpp
+    text/shaper_cache.cpp
+    text/glyph_cache.cpp
     text/text_layout.cpp
     text/text_line.cpp
     text/itemizer.cpp
@@ -274,6 +280,10 @@ source = Split(
     map_set_layer_buffer_size.cpp
     parallel_blur.cpp
     util/parallelizer.cpp
+    util/thread_pool.cpp
+    util/simd_composite.cpp
+    util/simd_resample.cpp
+    util/mapped_spatial_index.cpp
     """
     )
 
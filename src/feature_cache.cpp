@@ -0,0 +1,273 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/feature_cache.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/util/variant.hpp>
+
+#include <boost/container_hash/hash.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace mapnik
+{
+
+template class singleton<feature_cache, CreateStatic>;
+
+std::size_t feature_cache_key::hash() const
+{
+    std::size_t h = std::hash<std::string>()(layer);
+    boost::hash_combine(h, query_hash);
+    boost::hash_combine(h, bbox.minx());
+    boost::hash_combine(h, bbox.miny());
+    boost::hash_combine(h, bbox.maxx());
+    boost::hash_combine(h, bbox.maxy());
+    return h;
+}
+
+namespace {
+
+struct value_holder_hasher
+{
+    std::size_t operator()(value_null const&) const
+    {
+        return 0;
+    }
+
+    template <typename T>
+    std::size_t operator()(T const& val) const
+    {
+        return std::hash<T>()(val);
+    }
+};
+
+std::size_t query_hash(datasource const& ds, query const& q)
+{
+    std::size_t h = 0;
+    for (auto const& param : ds.params())
+    {
+        boost::hash_combine(h, param.first);
+        boost::hash_combine(h, util::apply_visitor(value_holder_hasher(), param.second));
+    }
+    for (auto const& name : q.property_names())
+    {
+        boost::hash_combine(h, name);
+    }
+    for (auto const& var : q.variables())
+    {
+        boost::hash_combine(h, var.first);
+        boost::hash_combine(h, std::hash<value>()(var.second));
+    }
+    boost::hash_combine(h, q.scale_denominator());
+    boost::hash_combine(h, std::get<0>(q.resolution()));
+    boost::hash_combine(h, std::get<1>(q.resolution()));
+    boost::hash_combine(h, q.get_filter_factor());
+    return h;
+}
+
+// Expands the box to a grid of power of two cells at least twice as large
+// as the box, so most neighbouring queries of the same size resolve
+// to the same cells.
+box2d<double> quantize(box2d<double> const& box)
+{
+    double size = 2.0 * std::max(box.width(), box.height());
+    double cell = std::exp2(std::ceil(std::log2(size)));
+    return box2d<double>(std::floor(box.minx() / cell) * cell,
+                         std::floor(box.miny() / cell) * cell,
+                         std::ceil(box.maxx() / cell) * cell,
+                         std::ceil(box.maxy() / cell) * cell);
+}
+
+struct geometry_memory_size
+{
+    using point_type = geometry::point<double>;
+
+    std::size_t operator()(geometry::geometry_empty const&) const
+    {
+        return 0;
+    }
+
+    std::size_t operator()(point_type const&) const
+    {
+        return sizeof(point_type);
+    }
+
+    std::size_t operator()(geometry::line_string<double> const& line) const
+    {
+        return line.size() * sizeof(point_type);
+    }
+
+    std::size_t operator()(geometry::polygon<double> const& poly) const
+    {
+        std::size_t size = poly.exterior_ring.size() * sizeof(point_type);
+        for (auto const& ring : poly.interior_rings)
+        {
+            size += ring.size() * sizeof(point_type);
+        }
+        return size;
+    }
+
+    template <typename Multi>
+    std::size_t operator()(Multi const& multi) const
+    {
+        std::size_t size = 0;
+        for (auto const& part : multi)
+        {
+            size += (*this)(part);
+        }
+        return size;
+    }
+
+    std::size_t operator()(geometry::multi_point<double> const& multi) const
+    {
+        return multi.size() * sizeof(point_type);
+    }
+
+    std::size_t operator()(geometry::geometry<double> const& geom) const
+    {
+        return util::apply_visitor(*this, geom);
+    }
+};
+
+std::size_t feature_memory_size(feature_impl const& feature)
+{
+    return sizeof(feature_impl) + sizeof(box2d<double>) +
+        feature.size() * sizeof(value) +
+        geometry_memory_size()(feature.get_geometry());
+}
+
+class cached_featureset : public Featureset
+{
+public:
+    cached_featureset(cached_features_ptr const& cached, box2d<double> const& bbox)
+        : cached_(cached),
+          bbox_(bbox),
+          index_(0) {}
+
+    feature_ptr next()
+    {
+        std::size_t size = cached_->features.size();
+        while (index_ < size)
+        {
+            std::size_t i = index_++;
+            box2d<double> const& env = cached_->envelopes[i];
+            if (!env.valid() || env.intersects(bbox_))
+            {
+                return cached_->features[i];
+            }
+        }
+        return feature_ptr();
+    }
+
+private:
+    cached_features_ptr cached_;
+    const box2d<double> bbox_;
+    std::size_t index_;
+};
+
+}
+
+feature_cache::feature_cache()
+    : cache_(),
+      ttl_(0) {}
+
+void feature_cache::set_capacity(std::size_t bytes)
+{
+    instance().cache_.set_capacity(bytes);
+}
+
+void feature_cache::set_ttl(std::chrono::steady_clock::duration ttl)
+{
+    instance().ttl_ = ttl.count();
+}
+
+featureset_ptr feature_cache::features(layer const& lay,
+                                       datasource const& ds,
+                                       query const& q,
+                                       processor_context_ptr const& ctx)
+{
+    box2d<double> const& bbox = q.get_bbox();
+    if (!enabled() || !bbox.valid() || bbox.width() <= 0 || bbox.height() <= 0)
+    {
+        return ds.features_with_context(q, ctx);
+    }
+
+    feature_cache_key key{lay.name(), query_hash(ds, q), quantize(bbox)};
+    cached_features_ptr cached;
+    if (cache_.find(key, cached))
+    {
+        std::chrono::steady_clock::duration ttl(ttl_.load());
+        if (ttl.count() == 0 || cached_features::clock::now() - cached->created < ttl)
+        {
+            return std::make_shared<cached_featureset>(cached, bbox);
+        }
+        cache_.erase(key);
+    }
+
+    query cell_query(q);
+    cell_query.set_bbox(key.bbox);
+    cell_query.set_unbuffered_bbox(key.bbox);
+
+    auto result = std::make_shared<cached_features>();
+    std::size_t cost = sizeof(cached_features);
+    featureset_ptr fs = ds.features_with_context(cell_query, ctx);
+    if (fs)
+    {
+        while (feature_ptr feature = fs->next())
+        {
+            // cached features are read by several renderers at once
+            feature->decode_attributes();
+            result->envelopes.push_back(feature->envelope());
+            result->features.push_back(feature);
+            cost += feature_memory_size(*feature);
+        }
+    }
+    result->created = cached_features::clock::now();
+    cache_.insert(key, result, cost);
+    return std::make_shared<cached_featureset>(result, bbox);
+}
+
+std::size_t feature_cache::invalidate(std::string const& layer_name)
+{
+    return cache_.erase_if([&layer_name](feature_cache_key const& key, cached_features_ptr const&) {
+        return key.layer == layer_name;
+    });
+}
+
+void feature_cache::clear()
+{
+    cache_.clear();
+}
+
+util::lru_cache_stats feature_cache::stats() const
+{
+    return cache_.stats();
+}
+
+}
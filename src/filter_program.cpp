@@ -0,0 +1,396 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/filter_program.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/util/variant.hpp>
+
+// stl
+#include <limits>
+
+namespace mapnik
+{
+
+namespace {
+
+template <typename Tag> struct opcode_of;
+template <> struct opcode_of<tags::negate> { static const filter_program::opcode value = filter_program::op_negate; };
+template <> struct opcode_of<tags::plus> { static const filter_program::opcode value = filter_program::op_plus; };
+template <> struct opcode_of<tags::minus> { static const filter_program::opcode value = filter_program::op_minus; };
+template <> struct opcode_of<tags::mult> { static const filter_program::opcode value = filter_program::op_mult; };
+template <> struct opcode_of<tags::div> { static const filter_program::opcode value = filter_program::op_div; };
+template <> struct opcode_of<tags::mod> { static const filter_program::opcode value = filter_program::op_mod; };
+template <> struct opcode_of<tags::less> { static const filter_program::opcode value = filter_program::op_less; };
+template <> struct opcode_of<tags::less_equal> { static const filter_program::opcode value = filter_program::op_less_equal; };
+template <> struct opcode_of<tags::greater> { static const filter_program::opcode value = filter_program::op_greater; };
+template <> struct opcode_of<tags::greater_equal> { static const filter_program::opcode value = filter_program::op_greater_equal; };
+template <> struct opcode_of<tags::equal_to> { static const filter_program::opcode value = filter_program::op_equal_to; };
+template <> struct opcode_of<tags::not_equal_to> { static const filter_program::opcode value = filter_program::op_not_equal_to; };
+template <> struct opcode_of<tags::logical_not> { static const filter_program::opcode value = filter_program::op_logical_not; };
+template <> struct opcode_of<tags::logical_and> { static const filter_program::opcode value = filter_program::op_logical_and; };
+template <> struct opcode_of<tags::logical_or> { static const filter_program::opcode value = filter_program::op_logical_or; };
+
+// number of operands which are instructions
+unsigned operands(filter_program::opcode code)
+{
+    switch (code)
+    {
+    case filter_program::op_constant:
+    case filter_program::op_attribute:
+    case filter_program::op_variable:
+    case filter_program::op_geometry_type:
+        return 0;
+    case filter_program::op_negate:
+    case filter_program::op_logical_not:
+    case filter_program::op_regex_match:
+    case filter_program::op_regex_replace:
+    case filter_program::op_unary_function:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+constexpr std::size_t unknown_attribute = std::numeric_limits<std::size_t>::max();
+
+}
+
+struct filter_compiler
+{
+    explicit filter_compiler(filter_program & program)
+        : program_(program) {}
+
+    std::uint32_t operator() (value_null const& val) const
+    {
+        return constant(val);
+    }
+
+    std::uint32_t operator() (value_bool val) const
+    {
+        return constant(val);
+    }
+
+    std::uint32_t operator() (value_integer val) const
+    {
+        return constant(val);
+    }
+
+    std::uint32_t operator() (value_double val) const
+    {
+        return constant(val);
+    }
+
+    std::uint32_t operator() (value_unicode_string const& val) const
+    {
+        return constant(val);
+    }
+
+    std::uint32_t operator() (attribute const& attr) const
+    {
+        return program_.add(filter_program::op_attribute, program_.add_name(program_.attributes_, attr.name()));
+    }
+
+    std::uint32_t operator() (global_attribute const& attr) const
+    {
+        return program_.add(filter_program::op_variable, program_.add_name(program_.variables_, attr.name));
+    }
+
+    std::uint32_t operator() (geometry_type_attribute const&) const
+    {
+        return program_.add(filter_program::op_geometry_type, 0);
+    }
+
+    template <typename Tag>
+    std::uint32_t operator() (binary_node<Tag> const& x) const
+    {
+        std::uint32_t left = util::apply_visitor(*this, x.left);
+        std::uint32_t right = util::apply_visitor(*this, x.right);
+        return program_.add(opcode_of<Tag>::value, left, right);
+    }
+
+    template <typename Tag>
+    std::uint32_t operator() (unary_node<Tag> const& x) const
+    {
+        return program_.add(opcode_of<Tag>::value, util::apply_visitor(*this, x.expr));
+    }
+
+    std::uint32_t operator() (regex_match_node const& x) const
+    {
+        return program_.add(filter_program::op_regex_match, util::apply_visitor(*this, x.expr), 0, &x);
+    }
+
+    std::uint32_t operator() (regex_replace_node const& x) const
+    {
+        return program_.add(filter_program::op_regex_replace, util::apply_visitor(*this, x.expr), 0, &x);
+    }
+
+    std::uint32_t operator() (unary_function_call const& call) const
+    {
+        return program_.add(filter_program::op_unary_function, util::apply_visitor(*this, call.arg), 0, &call);
+    }
+
+    std::uint32_t operator() (binary_function_call const& call) const
+    {
+        std::uint32_t arg1 = util::apply_visitor(*this, call.arg1);
+        std::uint32_t arg2 = util::apply_visitor(*this, call.arg2);
+        return program_.add(filter_program::op_binary_function, arg1, arg2, &call);
+    }
+
+private:
+    std::uint32_t constant(value const& val) const
+    {
+        return program_.add(filter_program::op_constant, program_.add_constant(val));
+    }
+
+    filter_program & program_;
+};
+
+filter_program::filter_program()
+    : code_(),
+      constants_(),
+      attributes_(),
+      variables_(),
+      uses_(),
+      instructions_() {}
+
+std::size_t filter_program::compile(expr_node const& expr)
+{
+    return util::apply_visitor(filter_compiler(*this), expr);
+}
+
+// Every call is one more use of the instruction, operands of an existing
+// instruction were counted when it was added.
+std::uint32_t filter_program::add(opcode code, std::uint32_t arg1, std::uint32_t arg2, void const* node)
+{
+    auto key = std::make_tuple(static_cast<int>(code), arg1, arg2, node);
+    auto itr = instructions_.find(key);
+    if (itr != instructions_.end())
+    {
+        unsigned count = operands(code);
+        if (count > 0) --uses_[arg1];
+        if (count > 1) --uses_[arg2];
+        if (count > 0) code_[arg1].shared = uses_[arg1] > 1;
+        if (count > 1) code_[arg2].shared = uses_[arg2] > 1;
+        use(itr->second);
+        return itr->second;
+    }
+    std::uint32_t index = static_cast<std::uint32_t>(code_.size());
+    code_.push_back(instruction{code, false, arg1, arg2, node});
+    uses_.push_back(0);
+    instructions_.emplace(key, index);
+    use(index);
+    return index;
+}
+
+std::uint32_t filter_program::add_constant(value const& val)
+{
+    for (std::size_t i = 0; i < constants_.size(); ++i)
+    {
+        if (constants_[i].which() == val.which() && constants_[i] == val)
+        {
+            return static_cast<std::uint32_t>(i);
+        }
+    }
+    constants_.push_back(val);
+    return static_cast<std::uint32_t>(constants_.size() - 1);
+}
+
+std::uint32_t filter_program::add_name(std::vector<std::string> & names, std::string const& name)
+{
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        if (names[i] == name) return static_cast<std::uint32_t>(i);
+    }
+    names.push_back(name);
+    return static_cast<std::uint32_t>(names.size() - 1);
+}
+
+void filter_program::use(std::uint32_t index)
+{
+    code_[index].shared = ++uses_[index] > 1;
+}
+
+filter_evaluator::filter_evaluator(filter_program const& program, attributes const& vars)
+    : program_(program),
+      variables_(),
+      indices_(program.attributes().size(), unknown_attribute),
+      context_(),
+      context_size_(0),
+      feature_(nullptr),
+      results_(program.code().size()),
+      stamps_(program.code().size(), 0),
+      epoch_(0)
+{
+    for (std::string const& name : program.variables())
+    {
+        auto itr = vars.find(name);
+        variables_.push_back(itr != vars.end() ? &itr->second : &default_feature_value);
+    }
+}
+
+void filter_evaluator::set_feature(feature_impl const& feature)
+{
+    feature_ = &feature;
+    ++epoch_;
+    // contexts are shared by features of a featureset and only grow
+    context_type const& ctx = feature.get_context();
+    if (&ctx != context_.get() || ctx.size() != context_size_)
+    {
+        bind(feature);
+    }
+}
+
+void filter_evaluator::bind(feature_impl const& feature)
+{
+    context_ = feature.context();
+    context_size_ = context_->size();
+    std::vector<std::string> const& names = program_.attributes();
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        auto itr = context_->find(names[i]);
+        indices_[i] = (itr != context_->end()) ? itr->second : unknown_attribute;
+    }
+}
+
+bool filter_evaluator::test(std::size_t index)
+{
+    filter_program::instruction const& ins = program_.code()[index];
+    if (!ins.shared)
+    {
+        switch (ins.code)
+        {
+        case filter_program::op_less:
+            return eval(ins.arg1) < eval(ins.arg2);
+        case filter_program::op_less_equal:
+            return eval(ins.arg1) <= eval(ins.arg2);
+        case filter_program::op_greater:
+            return eval(ins.arg1) > eval(ins.arg2);
+        case filter_program::op_greater_equal:
+            return eval(ins.arg1) >= eval(ins.arg2);
+        case filter_program::op_equal_to:
+            return eval(ins.arg1) == eval(ins.arg2);
+        case filter_program::op_not_equal_to:
+            return eval(ins.arg1) != eval(ins.arg2);
+        case filter_program::op_logical_not:
+            return !test(ins.arg1);
+        case filter_program::op_logical_and:
+            return test(ins.arg1) && test(ins.arg2);
+        case filter_program::op_logical_or:
+            return test(ins.arg1) || test(ins.arg2);
+        default:
+            break;
+        }
+    }
+    return eval(index).to_bool();
+}
+
+value const& filter_evaluator::eval(std::size_t index)
+{
+    filter_program::instruction const& ins = program_.code()[index];
+    switch (ins.code)
+    {
+    case filter_program::op_constant:
+        return program_.constants()[ins.arg1];
+    case filter_program::op_attribute:
+        return feature_->get(indices_[ins.arg1]);
+    case filter_program::op_variable:
+        return *variables_[ins.arg1];
+    default:
+        break;
+    }
+    value & result = results_[index];
+    if (ins.shared && stamps_[index] == epoch_)
+    {
+        return result;
+    }
+    switch (ins.code)
+    {
+    case filter_program::op_geometry_type:
+        result = geometry_type_attribute().value<value, feature_impl>(*feature_);
+        break;
+    case filter_program::op_negate:
+        result = -eval(ins.arg1);
+        break;
+    case filter_program::op_plus:
+        result = eval(ins.arg1) + eval(ins.arg2);
+        break;
+    case filter_program::op_minus:
+        result = eval(ins.arg1) - eval(ins.arg2);
+        break;
+    case filter_program::op_mult:
+        result = eval(ins.arg1) * eval(ins.arg2);
+        break;
+    case filter_program::op_div:
+        result = eval(ins.arg1) / eval(ins.arg2);
+        break;
+    case filter_program::op_mod:
+        result = eval(ins.arg1) % eval(ins.arg2);
+        break;
+    case filter_program::op_less:
+        result = value_bool(eval(ins.arg1) < eval(ins.arg2));
+        break;
+    case filter_program::op_less_equal:
+        result = value_bool(eval(ins.arg1) <= eval(ins.arg2));
+        break;
+    case filter_program::op_greater:
+        result = value_bool(eval(ins.arg1) > eval(ins.arg2));
+        break;
+    case filter_program::op_greater_equal:
+        result = value_bool(eval(ins.arg1) >= eval(ins.arg2));
+        break;
+    case filter_program::op_equal_to:
+        result = value_bool(eval(ins.arg1) == eval(ins.arg2));
+        break;
+    case filter_program::op_not_equal_to:
+        result = value_bool(eval(ins.arg1) != eval(ins.arg2));
+        break;
+    case filter_program::op_logical_not:
+        result = value_bool(!test(ins.arg1));
+        break;
+    case filter_program::op_logical_and:
+        result = value_bool(test(ins.arg1) && test(ins.arg2));
+        break;
+    case filter_program::op_logical_or:
+        result = value_bool(test(ins.arg1) || test(ins.arg2));
+        break;
+    case filter_program::op_regex_match:
+        result = static_cast<regex_match_node const*>(ins.node)->apply(eval(ins.arg1));
+        break;
+    case filter_program::op_regex_replace:
+        result = static_cast<regex_replace_node const*>(ins.node)->apply(eval(ins.arg1));
+        break;
+    case filter_program::op_unary_function:
+        result = static_cast<unary_function_call const*>(ins.node)->fun(eval(ins.arg1));
+        break;
+    case filter_program::op_binary_function:
+        result = static_cast<binary_function_call const*>(ins.node)->fun(eval(ins.arg1), eval(ins.arg2));
+        break;
+    default:
+        break;
+    }
+    stamps_[index] = epoch_;
+    return result;
+}
+
+}
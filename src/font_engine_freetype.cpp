@@ -335,7 +335,7 @@ face_ptr freetype_engine::create_face_impl(std::string const& family_name,
                                                 static_cast<FT_Long>(mem_font_itr->second.second), // size
                                                 itr->second.first, // face index
                                                 &face);
-            if (!error) return std::make_shared<font_face>(face);
+            if (!error) return std::make_shared<font_face>(face, face_id_impl(itr->second.second, itr->second.first));
         }
         // we don't add to cache here because the map and its font_cache
         // must be immutable during rendering for predictable thread safety
@@ -357,7 +357,7 @@ face_ptr freetype_engine::create_face_impl(std::string const& family_name,
                                                     static_cast<FT_Long>(mem_font_itr->second.second), // size
                                                     itr->second.first, // face index
                                                     &face);
-                if (!error) return std::make_shared<font_face>(face);
+                if (!error) return std::make_shared<font_face>(face, face_id_impl(itr->second.second, itr->second.first));
             }
             found_font_file = true;
         }
@@ -368,6 +368,7 @@ face_ptr freetype_engine::create_face_impl(std::string const& family_name,
         mapnik::util::file file(itr->second.second);
         if (file)
         {
+            std::size_t id = face_id_impl(itr->second.second, itr->second.first);
 #ifdef MAPNIK_THREADSAFE
             std::lock_guard<std::mutex> lock(mutex_);
 #endif
@@ -384,12 +385,25 @@ face_ptr freetype_engine::create_face_impl(std::string const& family_name,
                 global_memory_fonts.erase(result.first);
                 return face_ptr();
             }
-            return std::make_shared<font_face>(face);
+            return std::make_shared<font_face>(face, id);
         }
     }
     return face_ptr();
 }
 
+std::size_t freetype_engine::face_id(std::string const& file_name, int face_index)
+{
+    return instance().face_id_impl(file_name, face_index);
+}
+
+std::size_t freetype_engine::face_id_impl(std::string const& file_name, int face_index)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(face_ids_mutex_);
+#endif
+    return face_ids_.emplace(std::make_pair(file_name, face_index), face_ids_.size()).first->second;
+}
+
 face_ptr freetype_engine::create_face(std::string const& family_name,
                                       font_library & library,
                                       freetype_engine::font_file_mapping_type const& font_file_mapping,
@@ -32,6 +32,8 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <cerrno>
+#include <cstdio>
 #include <stdexcept>
 
 namespace mapnik {
@@ -137,6 +139,30 @@ namespace util {
         return listing;
     }
 
+    std::string create_unique_file(std::string const& model)
+    {
+        for (int attempt = 0; attempt < 100; ++attempt)
+        {
+            std::string path = boost::filesystem::unique_path(model).string();
+            // "x" fails if the file exists, the name is not reused
+#ifdef _WINDOWS
+            std::FILE * file = _wfopen(mapnik::utf8_to_utf16(path).c_str(), L"wbx");
+#else
+            std::FILE * file = std::fopen(path.c_str(), "wbx");
+#endif
+            if (file)
+            {
+                std::fclose(file);
+                return path;
+            }
+            if (errno != EEXIST)
+            {
+                break;
+            }
+        }
+        throw std::runtime_error("could not create unique file '" + model + "'");
+    }
+
 
 } // end namespace util
 
@@ -28,6 +28,7 @@
 #include <mapnik/util/const_rendering_buffer.hpp>
 #include <mapnik/util/parallelize.hpp>
 #include <mapnik/util/fast_src_over.hpp>
+#include <mapnik/util/simd_composite.hpp>
 #ifdef MAPNIK_STATS_RENDER
 #include <mapnik/log_render.hpp>
 #endif
@@ -49,6 +50,9 @@
 #include "agg_color_rgba.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <algorithm>
+
 namespace mapnik
 {
 
@@ -139,6 +143,7 @@ struct composite_functor
     float opacity;
     int dx;
     int dy;
+    agg::rect_i area;
 
     void operator()(unsigned begin, unsigned end)
     {
@@ -161,11 +166,38 @@ struct composite_functor
                                      const_rendering_buffer,
                                      agg::pixel32_type> pixf_mask(src_buffer);
         renderer_type ren(pixf);
-        agg::rect_i src_area(0, begin, src.width() - 1, end - 1);
+        agg::rect_i src_area(area.x1, area.y1 + begin, area.x2, area.y1 + end - 1);
         ren.blend_from(pixf_mask, &src_area, dx, dy, safe_cast<agg::cover_type>(255 * opacity));
     }
 };
 
+struct simd_composite_functor
+{
+    image_rgba8 & dst;
+    image_rgba8 const& src;
+    util::composite_kernel kernel;
+    unsigned cover;
+    int dx;
+    int dy;
+    agg::rect_i area;
+
+    void operator()(unsigned begin, unsigned end)
+    {
+        // same clipping as agg::renderer_base::blend_from
+        int x0 = std::max(area.x1, -dx);
+        int x1 = std::min(area.x2 + 1, safe_cast<int>(dst.width()) - dx);
+        if (x1 <= x0) return;
+        int y0 = std::max(area.y1 + safe_cast<int>(begin), -dy);
+        int y1 = std::min(area.y1 + safe_cast<int>(end), safe_cast<int>(dst.height()) - dy);
+        for (int y = y0; y < y1; ++y)
+        {
+            kernel(reinterpret_cast<std::uint8_t*>(dst.get_row(y + dy) + x0 + dx),
+                   reinterpret_cast<std::uint8_t const*>(src.get_row(y) + x0),
+                   x1 - x0, cover);
+        }
+    }
+};
+
 struct blend_functor
 {
     util::rgba_pixel * dst;
@@ -177,23 +209,25 @@ struct blend_functor
     }
 };
 
-template <>
-MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src, composite_mode_e mode,
-               float opacity,
-               int dx,
-               int dy
+namespace {
+
+// area is inclusive and must lie within src
+void composite_rgba8(image_rgba8 & dst, image_rgba8 const& src, composite_mode_e mode,
+                     float opacity, int dx, int dy, agg::rect_i const& area
 #ifdef MAPNIK_STATS_RENDER
-               , std::ostream * log_stream
+                     , std::ostream * log_stream
 #endif
                      )
 {
+    unsigned width = safe_cast<unsigned>(area.x2 - area.x1 + 1);
+    unsigned height = safe_cast<unsigned>(area.y2 - area.y1 + 1);
 #ifdef MAPNIK_STATS_RENDER
     boost::optional<std::string> mode_name = comp_op_to_string(mode);
     std::stringstream ss;
     ss << "comp-op" << ' '
         << (mode_name ? *mode_name : "unknown") << ' '
-        << std::to_string(src.width()) << "x"
-        << std::to_string(src.height()) << " -> "
+        << std::to_string(width) << "x"
+        << std::to_string(height) << " -> "
         << std::to_string(dst.width()) << "x"
         << std::to_string(dst.height());
     log_render lr(ss.str(), log_stream ? *log_stream : std::clog);
@@ -210,11 +244,19 @@ MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src, composite_
     }
 #endif
 
-    unsigned jobs = util::jobs_by_image_size(src.width(), src.height());
+    unsigned jobs = util::jobs_by_image_size(width, height);
 
-    if (mode == src_over &&
+    util::composite_kernel kernel = util::simd_composite_kernel(mode, util::composite_simd_level());
+    if (kernel)
+    {
+        simd_composite_functor simd_func{ dst, src, kernel, safe_cast<agg::cover_type>(255 * opacity), dx, dy, area };
+        util::parallelize(simd_func, jobs, height);
+    }
+    else if (mode == src_over &&
         src.width() == dst.width() &&
         src.height() == dst.height() &&
+        width == src.width() &&
+        height == src.height() &&
         dx == 0 && dy == 0 &&
         opacity >= 1.0)
     {
@@ -225,8 +267,87 @@ MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src, composite_
     }
     else
     {
-        composite_functor comp_func{ dst, src, mode, opacity, dx, dy };
-        util::parallelize(comp_func, jobs, src.height());
+        composite_functor comp_func{ dst, src, mode, opacity, dx, dy, area };
+        util::parallelize(comp_func, jobs, height);
+    }
+}
+
+}
+
+template <>
+MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src, composite_mode_e mode,
+               float opacity,
+               int dx,
+               int dy
+#ifdef MAPNIK_STATS_RENDER
+               , std::ostream * log_stream
+#endif
+                     )
+{
+    if (src.width() == 0 || src.height() == 0) return;
+    agg::rect_i area(0, 0, safe_cast<int>(src.width()) - 1, safe_cast<int>(src.height()) - 1);
+    composite_rgba8(dst, src, mode, opacity, dx, dy, area
+#ifdef MAPNIK_STATS_RENDER
+                    , log_stream
+#endif
+                   );
+}
+
+MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src, composite_mode_e mode,
+               float opacity,
+               int dx,
+               int dy,
+               box2d<int> const& src_area
+#ifdef MAPNIK_STATS_RENDER
+               , std::ostream * log_stream
+#endif
+                     )
+{
+    int x0 = std::max(src_area.minx(), 0);
+    int y0 = std::max(src_area.miny(), 0);
+    int x1 = std::min(src_area.maxx(), safe_cast<int>(src.width()));
+    int y1 = std::min(src_area.maxy(), safe_cast<int>(src.height()));
+    if (x1 <= x0 || y1 <= y0) return;
+    composite_rgba8(dst, src, mode, opacity, dx, dy, agg::rect_i(x0, y0, x1 - 1, y1 - 1)
+#ifdef MAPNIK_STATS_RENDER
+                    , log_stream
+#endif
+                   );
+}
+
+MAPNIK_DECL bool composite_preserves_dst(composite_mode_e mode)
+{
+    switch (mode)
+    {
+    case dst:
+    case src_over:
+    case dst_over:
+    case src_atop:
+    case _xor:
+    case plus:
+    case minus:
+    case multiply:
+    case screen:
+    case overlay:
+    case darken:
+    case lighten:
+    case color_dodge:
+    case color_burn:
+    case hard_light:
+    case soft_light:
+    case difference:
+    case exclusion:
+    case invert:
+    case invert_rgb:
+    case grain_merge:
+    case linear_dodge:
+    case grain_merge_gimp:
+    case grain_merge_gimp_darker:
+        return true;
+    default:
+        // dst_out and a few others round the destination
+        // even for transparent sources
+        return false;
     }
 }
 
@@ -0,0 +1,365 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/image_pool.hpp>
+#include <mapnik/image_impl.hpp>
+
+// stl
+#include <algorithm>
+
+namespace mapnik
+{
+
+namespace {
+
+// images kept by each thread outside of the shared free lists
+constexpr std::size_t local_entries = 2;
+
+// dimensions of images are limited to 65535
+std::size_t size_class(std::size_t width, std::size_t height)
+{
+    return (width << 16) | height;
+}
+
+// Thread local lists are accounted to the capacity through the usage
+// counters of the pool, they are dropped once the pool is cleared, by
+// the next acquire or release of their thread.
+// They never refer to the pool itself, threads may outlive it.
+template <typename T>
+struct local_free_list
+{
+    using usage_ptr = std::shared_ptr<typename image_pool<T>::local_usage>;
+
+    std::size_t generation = 0;
+    std::vector<typename image_pool<T>::entry> entries;
+    usage_ptr usage;
+
+    ~local_free_list()
+    {
+        drop();
+    }
+
+    void sync(std::size_t current, usage_ptr const& pool_usage)
+    {
+        if (generation != current)
+        {
+            drop();
+            generation = current;
+            usage = pool_usage;
+        }
+    }
+
+    void push(typename image_pool<T>::entry && e)
+    {
+        entries.push_back(std::move(e));
+        ++usage->entries;
+    }
+
+    bool holds(std::size_t width, std::size_t height) const
+    {
+        for (auto const& e : entries)
+        {
+            if (e.img.width() == width && e.img.height() == height)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Takes the entry, its size is already released from usage
+    typename image_pool<T>::entry take(std::size_t index)
+    {
+        typename image_pool<T>::entry e(std::move(entries[index]));
+        entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(index));
+        usage->bytes -= e.img.size();
+        --usage->entries;
+        return e;
+    }
+
+    void drop()
+    {
+        for (auto const& e : entries)
+        {
+            usage->bytes -= e.img.size();
+            --usage->entries;
+        }
+        entries.clear();
+    }
+};
+
+template <typename T>
+local_free_list<T> & local_list()
+{
+    thread_local local_free_list<T> list;
+    return list;
+}
+
+template <typename Image>
+void clear_dirty(Image & img, box2d<int> dirty)
+{
+    if (!dirty.valid())
+    {
+        return;
+    }
+    dirty.clip(box2d<int>(0, 0, static_cast<int>(img.width()), static_cast<int>(img.height())));
+    if (!dirty.valid() || dirty.width() <= 0 || dirty.height() <= 0)
+    {
+        return;
+    }
+    for (int y = dirty.miny(); y < dirty.maxy(); ++y)
+    {
+        typename Image::pixel_type * row = img.get_row(y);
+        std::fill(row + dirty.minx(), row + dirty.maxx(), 0);
+    }
+}
+
+}
+
+template class singleton<image_pool<rgba8_t>, CreateStatic>;
+
+template <typename T>
+image_pool<T>::image_pool()
+    : free_(),
+      mutex_(),
+      capacity_(0),
+      generation_(1),
+      bytes_(0),
+      entries_(0),
+      sequence_(0),
+      local_usage_(std::make_shared<local_usage>()),
+      hits_(0),
+      misses_(0),
+      evictions_(0) {}
+
+template <typename T>
+void image_pool<T>::set_capacity(std::size_t bytes)
+{
+    image_pool & pool = image_pool::instance();
+    // shrinking the capacity evicts entries lazily on next release
+    pool.capacity_ = bytes;
+    if (bytes == 0)
+    {
+        pool.clear();
+    }
+}
+
+template <typename T>
+typename image_pool<T>::image_type image_pool<T>::acquire(std::size_t width, std::size_t height, bool clear)
+{
+    image_pool & pool = image_pool::instance();
+    local_free_list<T> & local = local_list<T>();
+    // a disabled or cleared pool drops the images of this thread too
+    local.sync(pool.generation_.load(std::memory_order_relaxed), pool.local_usage_);
+    if (!pool.enabled() || width == 0 || height == 0)
+    {
+        return image_type(static_cast<int>(width), static_cast<int>(height), clear);
+    }
+
+    entry result;
+    bool found = false;
+    for (std::size_t i = local.entries.size(); i-- > 0;)
+    {
+        if (local.entries[i].img.width() == width && local.entries[i].img.height() == height)
+        {
+            result = local.take(i);
+            found = true;
+            break;
+        }
+    }
+    if (!found && !pool.take_shared(width, height, result))
+    {
+        ++pool.misses_;
+        return image_type(static_cast<int>(width), static_cast<int>(height), clear);
+    }
+    ++pool.hits_;
+
+    image_type & img = result.img;
+    if (clear)
+    {
+        clear_dirty(img, result.dirty);
+    }
+    img.set_offset(0.0);
+    img.set_scaling(1.0);
+    img.set_premultiplied(false);
+    img.painted(false);
+    return std::move(img);
+}
+
+template <typename T>
+void image_pool<T>::release(image_type && img)
+{
+    box2d<int> dirty(0, 0, static_cast<int>(img.width()), static_cast<int>(img.height()));
+    release(std::move(img), dirty);
+}
+
+template <typename T>
+void image_pool<T>::release(image_type && img, box2d<int> const& dirty)
+{
+    image_pool & pool = image_pool::instance();
+    local_free_list<T> & local = local_list<T>();
+    local.sync(pool.generation_.load(std::memory_order_relaxed), pool.local_usage_);
+    std::size_t capacity = pool.capacity_.load(std::memory_order_relaxed);
+    if (img.size() == 0 || img.size() > capacity)
+    {
+        return;
+    }
+    entry e{std::move(img), dirty};
+    if (local.entries.size() == local_entries && !local.holds(e.img.width(), e.img.height()))
+    {
+        // a new size replaces the oldest local one, sizes this thread does
+        // not request again (e.g. filter crops) end up in the shared lists
+        pool.put_shared(local.take(0));
+    }
+    if (local.entries.size() < local_entries && pool.reserve_local(e.img.size(), capacity))
+    {
+        local.push(std::move(e));
+        return;
+    }
+    pool.put_shared(std::move(e));
+}
+
+template <typename T>
+bool image_pool<T>::reserve_local(std::size_t size, std::size_t capacity)
+{
+    std::size_t local_bytes = local_usage_->bytes.fetch_add(size) + size;
+    if (local_bytes + bytes_.load(std::memory_order_relaxed) <= capacity)
+    {
+        return true;
+    }
+    // shared images give way to the thread local ones
+    std::lock_guard<std::mutex> lock(mutex_);
+    evict_shared(0, capacity);
+    if (local_usage_->bytes.load() + bytes_ <= capacity)
+    {
+        return true;
+    }
+    local_usage_->bytes -= size;
+    return false;
+}
+
+template <typename T>
+void image_pool<T>::evict_shared(std::size_t size, std::size_t capacity)
+{
+    // make room by dropping the oldest images of any size class, each
+    // list is in release order so its front is the oldest of the class
+    while (bytes_ + local_usage_->bytes.load() + size > capacity)
+    {
+        auto oldest = free_.end();
+        for (auto itr = free_.begin(); itr != free_.end();)
+        {
+            if (itr->second.empty())
+            {
+                itr = free_.erase(itr);
+                continue;
+            }
+            if (oldest == free_.end() || itr->second.front().sequence < oldest->second.front().sequence)
+            {
+                oldest = itr;
+            }
+            ++itr;
+        }
+        if (oldest == free_.end())
+        {
+            return;
+        }
+        std::vector<entry> & list = oldest->second;
+        bytes_ -= list.front().img.size();
+        --entries_;
+        ++evictions_;
+        list.erase(list.begin());
+    }
+}
+
+template <typename T>
+bool image_pool<T>::take_shared(std::size_t width, std::size_t height, entry & result)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto itr = free_.find(size_class(width, height));
+    if (itr == free_.end() || itr->second.empty())
+    {
+        return false;
+    }
+    result = std::move(itr->second.back());
+    itr->second.pop_back();
+    bytes_ -= result.img.size();
+    --entries_;
+    return true;
+}
+
+template <typename T>
+void image_pool<T>::put_shared(entry && e)
+{
+    std::size_t size = e.img.size();
+    std::size_t capacity = capacity_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    evict_shared(size, capacity);
+    if (bytes_ + local_usage_->bytes.load() + size > capacity)
+    {
+        ++evictions_;
+        return;
+    }
+    e.sequence = ++sequence_;
+    free_[size_class(e.img.width(), e.img.height())].push_back(std::move(e));
+    bytes_ += size;
+    ++entries_;
+}
+
+template <typename T>
+void image_pool<T>::clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.clear();
+        bytes_ = 0;
+        entries_ = 0;
+        ++generation_;
+    }
+    // lists of other threads are dropped when they use the pool again
+    local_list<T>().sync(generation_.load(), local_usage_);
+}
+
+template <typename T>
+util::lru_cache_stats image_pool<T>::stats() const
+{
+    util::lru_cache_stats result;
+    result.hits = hits_.load(std::memory_order_relaxed);
+    result.misses = misses_.load(std::memory_order_relaxed);
+    result.evictions = evictions_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    result.entries = entries_ + local_usage_->entries.load();
+    result.cost = bytes_ + local_usage_->bytes.load();
+    return result;
+}
+
+template <typename T>
+void image_pool<T>::reset_stats()
+{
+    hits_ = 0;
+    misses_ = 0;
+    evictions_ = 0;
+}
+
+template class image_pool<rgba8_t>;
+
+}
@@ -102,6 +102,15 @@ void handle_png_options(std::string const& type,
                 throw image_writer_exception("invalid trans_mode parameter: " + to_string(val));
             }
         }
+        else if (key == "j")
+        {
+            int threads = 0;
+            if (!val || !mapnik::util::string2int(*val, threads) || threads < 1)
+            {
+                throw image_writer_exception("invalid threads parameter: " + to_string(val));
+            }
+            opts.threads = static_cast<unsigned>(threads);
+        }
         else if (key == "g")
         {
             set_gamma = true;
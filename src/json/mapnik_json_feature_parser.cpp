@@ -0,0 +1,1163 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/json/feature_parser.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry_correct.hpp>
+#include <mapnik/util/conversions.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/spirit/include/qi.hpp>
+#pragma GCC diagnostic pop
+
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace mapnik { namespace json {
+
+namespace {
+
+namespace qi = boost::spirit::qi;
+
+using point_type = mapnik::geometry::point<double>;
+
+enum geometry_type_tag
+{
+    unknown_geometry = 0,
+    point_tag,
+    line_string_tag,
+    polygon_tag,
+    multi_point_tag,
+    multi_line_string_tag,
+    multi_polygon_tag,
+    geometry_collection_tag
+};
+
+// Steps of scan_feature_collection, each step is parsed as a whole and
+// retried with more input when it doesn't fit in the buffer.
+enum scan_state
+{
+    scan_collection = 0,
+    scan_member,
+    scan_feature,
+    scan_next_member,
+    scan_done
+};
+
+void push_utf8(std::string & out, std::uint32_t code_point)
+{
+    if (code_point < 0x80)
+    {
+        out += static_cast<char>(code_point);
+    }
+    else if (code_point < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+// Exact for up to 15 significant digits and small exponents, where both
+// the mantissa and the power of ten are exact doubles (Clinger's fast path).
+// Returns false to let qi::double_ parse other numbers.
+bool parse_simple_double(char const*& first, char const* last, double & d)
+{
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                                     1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+                                     1e20, 1e21, 1e22 };
+    char const* itr = first;
+    bool negative = false;
+    if (itr != last && (*itr == '-' || *itr == '+'))
+    {
+        negative = (*itr == '-');
+        ++itr;
+    }
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int scale = 0;
+    char const* start = itr;
+    while (itr != last && *itr >= '0' && *itr <= '9')
+    {
+        mantissa = mantissa * 10 + (*itr++ - '0');
+        if (mantissa != 0) ++digits;
+    }
+    bool has_integer = (itr != start);
+    if (itr != last && *itr == '.')
+    {
+        ++itr;
+        start = itr;
+        while (itr != last && *itr >= '0' && *itr <= '9')
+        {
+            mantissa = mantissa * 10 + (*itr++ - '0');
+            if (mantissa != 0) ++digits;
+            ++scale;
+        }
+        if (!has_integer && itr == start) return false;
+    }
+    else if (!has_integer)
+    {
+        return false;
+    }
+    if (digits > 15) return false;
+    if (itr != last && (*itr == 'e' || *itr == 'E'))
+    {
+        ++itr;
+        bool negative_exponent = false;
+        if (itr != last && (*itr == '-' || *itr == '+'))
+        {
+            negative_exponent = (*itr == '-');
+            ++itr;
+        }
+        start = itr;
+        int exponent = 0;
+        while (itr != last && *itr >= '0' && *itr <= '9' && exponent < 1000)
+        {
+            exponent = exponent * 10 + (*itr++ - '0');
+        }
+        if (itr == start || (itr != last && *itr >= '0' && *itr <= '9')) return false;
+        scale += negative_exponent ? exponent : -exponent;
+    }
+    if (scale < -22 || scale > 22) return false;
+    double value = static_cast<double>(mantissa);
+    value = scale < 0 ? value * powers[-scale] : value / powers[scale];
+    d = negative ? -value : value;
+    first = itr;
+    return true;
+}
+
+int hex_digit(char ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// Recursive descent parser reading the input once. Strings without escapes
+// are transcoded in place, scratch buffers are reused between features of
+// the same thread.
+class feature_parser
+{
+public:
+    feature_parser(char const* start, char const* end, mapnik::transcoder const& tr)
+        : cur_(start),
+          end_(end),
+          tr_(tr) {}
+
+    char const* position() const
+    {
+        return cur_;
+    }
+
+    void skip_whitespace()
+    {
+        while (cur_ != end_ && (*cur_ == ' ' || *cur_ == '\n' || *cur_ == '\r' ||
+                                *cur_ == '\t' || *cur_ == '\f' || *cur_ == '\v'))
+        {
+            ++cur_;
+        }
+    }
+
+    bool parse_feature(mapnik::feature_impl & feature)
+    {
+        bool is_feature = false;
+        if (!lit('{')) return false;
+        do
+        {
+            string_span key;
+            if (!parse_key(key)) return false;
+            if (key.equals("type"))
+            {
+                string_span type;
+                if (!parse_string(type) || !type.equals("Feature")) return false;
+                is_feature = true;
+            }
+            else if (key.equals("geometry"))
+            {
+                mapnik::geometry::geometry<double> geom;
+                if (!parse_geometry(geom)) return false;
+                feature.set_geometry(std::move(geom));
+            }
+            else if (key.equals("properties"))
+            {
+                if (!parse_properties(feature)) return false;
+            }
+            else if (!skip_value())
+            {
+                return false;
+            }
+        }
+        while (lit(','));
+        return lit('}') && is_feature;
+    }
+
+    bool parse_feature_collection(mapnik::context_ptr const& ctx, std::size_t & start_id,
+                                  std::vector<mapnik::feature_ptr> & features)
+    {
+        if (!lit('{')) return false;
+        do
+        {
+            string_span key;
+            if (!parse_key(key)) return false;
+            if (key.equals("type"))
+            {
+                string_span type;
+                if (!parse_string(type) || !type.equals("FeatureCollection")) return false;
+            }
+            else if (key.equals("features"))
+            {
+                if (!lit('[')) return false;
+                if (lit(']')) continue;
+                do
+                {
+                    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, start_id));
+                    if (!parse_feature(*feature)) return false;
+                    features.push_back(feature);
+                    ++start_id;
+                }
+                while (lit(','));
+                if (!lit(']')) return false;
+            }
+            else if (!skip_value())
+            {
+                return false;
+            }
+        }
+        while (lit(','));
+        return lit('}');
+    }
+
+    // Parses one step of a FeatureCollection. A step ends with a delimiter
+    // so a number cut by the end of input is never accepted. Returns true
+    // and sets feature_begin/feature_end if a feature was scanned.
+    bool scan_step(scan_state & state, mapnik::box2d<double> & box,
+                   char const*& feature_begin, char const*& feature_end)
+    {
+        switch (state)
+        {
+        case scan_collection:
+            if (!lit('{')) return false;
+            state = scan_member;
+            return true;
+        case scan_member:
+        {
+            string_span key;
+            if (!parse_key(key)) return false;
+            if (key.equals("features"))
+            {
+                if (!lit('[')) return false;
+                skip_whitespace();
+                if (cur_ == end_) return false;
+                state = lit(']') ? scan_next_member : scan_feature;
+                return true;
+            }
+            if (key.equals("type"))
+            {
+                string_span type;
+                if (!parse_string(type) || !type.equals("FeatureCollection")) return false;
+            }
+            else if (!skip_value())
+            {
+                return false;
+            }
+            return scan_delimiter(state);
+        }
+        case scan_feature:
+            skip_whitespace();
+            feature_begin = cur_;
+            box = mapnik::box2d<double>();
+            if (!parse_feature_box(box)) return false;
+            feature_end = cur_;
+            if (lit(',')) return true;
+            if (!lit(']')) return false;
+            state = scan_next_member;
+            return true;
+        case scan_next_member:
+            return scan_delimiter(state);
+        default:
+            return false;
+        }
+    }
+
+private:
+    struct string_span
+    {
+        char const* begin = nullptr;
+        char const* end = nullptr;
+        bool escaped = false;
+
+        // keys are matched before unescaping like literals of the grammar
+        bool equals(char const* str) const
+        {
+            std::size_t size = std::strlen(str);
+            return !escaped && static_cast<std::size_t>(end - begin) == size &&
+                std::memcmp(begin, str, size) == 0;
+        }
+    };
+
+    bool scan_delimiter(scan_state & state)
+    {
+        if (lit(',')) state = scan_member;
+        else if (lit('}')) state = scan_done;
+        else return false;
+        return true;
+    }
+
+    bool lit(char ch)
+    {
+        skip_whitespace();
+        if (cur_ != end_ && *cur_ == ch)
+        {
+            ++cur_;
+            return true;
+        }
+        return false;
+    }
+
+    bool lit(char const* str)
+    {
+        skip_whitespace();
+        std::size_t size = std::strlen(str);
+        if (static_cast<std::size_t>(end_ - cur_) >= size && std::memcmp(cur_, str, size) == 0)
+        {
+            cur_ += size;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char ch)
+    {
+        skip_whitespace();
+        return cur_ != end_ && *cur_ == ch;
+    }
+
+    bool parse_string(string_span & str)
+    {
+        if (!lit('"')) return false;
+        str.begin = cur_;
+        str.escaped = false;
+        while (cur_ != end_ && *cur_ != '"')
+        {
+            if (*cur_ == '\\')
+            {
+                str.escaped = true;
+                if (++cur_ == end_) return false;
+            }
+            ++cur_;
+        }
+        if (cur_ == end_) return false;
+        str.end = cur_++;
+        return true;
+    }
+
+    bool parse_key(string_span & key)
+    {
+        return parse_string(key) && lit(':');
+    }
+
+    // Same escapes as unicode_string, surrogate pairs are combined
+    static bool unescape(string_span const& str, std::string & out)
+    {
+        out.clear();
+        char const* itr = str.begin;
+        while (itr != str.end)
+        {
+            char ch = *itr++;
+            if (ch != '\\')
+            {
+                out += ch;
+                continue;
+            }
+            if (itr == str.end) return false;
+            ch = *itr++;
+            switch (ch)
+            {
+            case 'x':
+            case 'u':
+            case 'U':
+            {
+                std::size_t digits = (ch == 'u') ? 4 : (ch == 'U') ? 8 : 0;
+                std::uint32_t code_point = 0;
+                std::size_t count = 0;
+                while (itr != str.end && (digits == 0 || count < digits) && hex_digit(*itr) >= 0)
+                {
+                    code_point = (code_point << 4) | hex_digit(*itr++);
+                    ++count;
+                }
+                if (count == 0 || (digits != 0 && count != digits)) return false;
+                if (ch == 'u' && code_point >= 0xD800 && code_point < 0xDC00 &&
+                    str.end - itr >= 6 && itr[0] == '\\' && itr[1] == 'u')
+                {
+                    std::uint32_t low = 0;
+                    bool valid = true;
+                    for (int i = 2; i < 6; ++i)
+                    {
+                        int digit = hex_digit(itr[i]);
+                        if (digit < 0) valid = false;
+                        low = (low << 4) | (digit & 0xF);
+                    }
+                    if (valid && low >= 0xDC00 && low < 0xE000)
+                    {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                        itr += 6;
+                    }
+                }
+                push_utf8(out, code_point);
+                break;
+            }
+            case '0': out += char(0); break;
+            case 'a': out += char(0x7); break;
+            case 'b': out += char(0x8); break;
+            case 't': out += char(0x9); break;
+            case 'n': out += char(0xA); break;
+            case 'v': out += char(0xB); break;
+            case 'f': out += char(0xC); break;
+            case 'r': out += char(0xD); break;
+            case 'e': out += char(0x1B); break;
+            case '"': out += '"'; break;
+            case '/': out += '/'; break;
+            case '\\': out += '\\'; break;
+            case ' ': out += ' '; break;
+            case '\t': out += '\t'; break;
+            case '_': push_utf8(out, 0xA0); break;
+            case 'N': push_utf8(out, 0x85); break;
+            case 'L': push_utf8(out, 0x2028); break;
+            case 'P': push_utf8(out, 0x2029); break;
+            case '\r':
+                // continue to next line
+                if (itr != str.end && *itr == '\n') ++itr;
+                break;
+            case '\n':
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Numbers with a fraction or exponent are doubles, like strict_double
+    // of generic_json.
+    bool parse_number(mapnik::value & val)
+    {
+        skip_whitespace();
+        char const* begin = cur_;
+        bool real = false;
+        while (cur_ != end_)
+        {
+            char ch = *cur_;
+            if (ch == '.' || ch == 'e' || ch == 'E') real = true;
+            else if (!((ch >= '0' && ch <= '9') || ch == '-' || ch == '+')) break;
+            ++cur_;
+        }
+        if (begin == cur_) return false;
+        char const* itr = begin;
+        if (!real)
+        {
+            static const qi::int_parser<mapnik::value_integer, 10, 1, -1> integer;
+            mapnik::value_integer i;
+            if (qi::parse(itr, cur_, integer, i) && itr == cur_)
+            {
+                val = i;
+                return true;
+            }
+            // out of range integers are kept as doubles
+            itr = begin;
+        }
+        double d;
+        if ((parse_simple_double(itr, cur_, d) || qi::parse(itr, cur_, qi::double_, d)) && itr == cur_)
+        {
+            val = d;
+            return true;
+        }
+        return false;
+    }
+
+    bool parse_double(double & d)
+    {
+        skip_whitespace();
+        return parse_simple_double(cur_, end_, d) || qi::parse(cur_, end_, qi::double_, d);
+    }
+
+    mapnik::value transcode(string_span const& str)
+    {
+        if (!str.escaped)
+        {
+            return mapnik::value(tr_.transcode(str.begin, static_cast<std::int32_t>(str.end - str.begin)));
+        }
+        return mapnik::value(tr_.transcode(text_.c_str()));
+    }
+
+    bool parse_properties(mapnik::feature_impl & feature)
+    {
+        if (lit("null")) return true;
+        if (!lit('{')) return false;
+        if (lit('}')) return true;
+        do
+        {
+            string_span key;
+            if (!parse_key(key)) return false;
+            if (key.escaped)
+            {
+                if (!unescape(key, key_)) return false;
+            }
+            else
+            {
+                key_.assign(key.begin, key.end);
+            }
+            mapnik::value val;
+            if (!parse_value(val)) return false;
+            feature.put_new(key_, std::move(val));
+        }
+        while (lit(','));
+        return lit('}');
+    }
+
+    bool parse_value(mapnik::value & val)
+    {
+        skip_whitespace();
+        if (cur_ == end_) return false;
+        switch (*cur_)
+        {
+        case '"':
+        {
+            string_span str;
+            if (!parse_string(str)) return false;
+            if (str.escaped && !unescape(str, text_)) return false;
+            val = transcode(str);
+            return true;
+        }
+        case '[':
+        case '{':
+            text_.clear();
+            if (!stringify(text_)) return false;
+            val = mapnik::value(tr_.transcode(text_.c_str()));
+            return true;
+        case 't':
+            val = true;
+            return lit("true");
+        case 'f':
+            val = false;
+            return lit("false");
+        case 'n':
+            val = mapnik::value_null();
+            return lit("null");
+        default:
+            return parse_number(val);
+        }
+    }
+
+    // Writes arrays and objects in the form of stringifier
+    bool stringify(std::string & out)
+    {
+        skip_whitespace();
+        if (cur_ == end_) return false;
+        switch (*cur_)
+        {
+        case '"':
+        {
+            string_span str;
+            if (!parse_string(str)) return false;
+            out += '"';
+            if (str.escaped)
+            {
+                std::string unescaped;
+                if (!unescape(str, unescaped)) return false;
+                out += unescaped;
+            }
+            else
+            {
+                out.append(str.begin, str.end);
+            }
+            out += '"';
+            return true;
+        }
+        case '[':
+        {
+            ++cur_;
+            out += '[';
+            if (!lit(']'))
+            {
+                do
+                {
+                    if (!stringify(out)) return false;
+                    if (peek(',')) out += ',';
+                }
+                while (lit(','));
+                if (!lit(']')) return false;
+            }
+            out += ']';
+            return true;
+        }
+        case '{':
+        {
+            ++cur_;
+            out += '{';
+            if (!lit('}'))
+            {
+                do
+                {
+                    string_span key;
+                    if (!parse_key(key)) return false;
+                    out += '"';
+                    if (key.escaped)
+                    {
+                        std::string unescaped;
+                        if (!unescape(key, unescaped)) return false;
+                        out += unescaped;
+                    }
+                    else
+                    {
+                        out.append(key.begin, key.end);
+                    }
+                    out += "\":";
+                    if (!stringify(out)) return false;
+                    if (peek(',')) out += ',';
+                }
+                while (lit(','));
+                if (!lit('}')) return false;
+            }
+            out += '}';
+            return true;
+        }
+        default:
+        {
+            mapnik::value val;
+            if (!parse_value(val)) return false;
+            if (val.is<mapnik::value_null>()) out += "null";
+            else if (val.is<mapnik::value_bool>()) out += val.get<mapnik::value_bool>() ? "true" : "false";
+            else if (val.is<mapnik::value_integer>())
+            {
+                std::string str;
+                util::to_string(str, val.get<mapnik::value_integer>());
+                out += str;
+            }
+            else
+            {
+                std::string str;
+                util::to_string(str, val.get<mapnik::value_double>());
+                out += str;
+            }
+            return true;
+        }
+        }
+    }
+
+    bool skip_value()
+    {
+        skip_whitespace();
+        if (cur_ == end_) return false;
+        switch (*cur_)
+        {
+        case '"':
+        {
+            string_span str;
+            return parse_string(str);
+        }
+        case '[':
+            ++cur_;
+            if (lit(']')) return true;
+            do
+            {
+                if (!skip_value()) return false;
+            }
+            while (lit(','));
+            return lit(']');
+        case '{':
+            ++cur_;
+            if (lit('}')) return true;
+            do
+            {
+                string_span key;
+                if (!parse_key(key) || !skip_value()) return false;
+            }
+            while (lit(','));
+            return lit('}');
+        default:
+        {
+            mapnik::value val;
+            return parse_value(val);
+        }
+        }
+    }
+
+    geometry_type_tag parse_geometry_type()
+    {
+        string_span type;
+        if (!parse_string(type)) return unknown_geometry;
+        if (type.equals("Point")) return point_tag;
+        if (type.equals("LineString")) return line_string_tag;
+        if (type.equals("Polygon")) return polygon_tag;
+        if (type.equals("MultiPoint")) return multi_point_tag;
+        if (type.equals("MultiLineString")) return multi_line_string_tag;
+        if (type.equals("MultiPolygon")) return multi_polygon_tag;
+        if (type.equals("GeometryCollection")) return geometry_collection_tag;
+        return unknown_geometry;
+    }
+
+    bool parse_geometry(mapnik::geometry::geometry<double> & geom)
+    {
+        if (lit("null")) return true;
+        if (!lit('{')) return false;
+        geometry_type_tag type = unknown_geometry;
+        char const* coordinates = nullptr;
+        do
+        {
+            string_span key;
+            if (!parse_key(key)) return false;
+            if (key.equals("type"))
+            {
+                type = parse_geometry_type();
+                if (type == unknown_geometry) return false;
+            }
+            else if (key.equals("coordinates"))
+            {
+                // coordinates before type are parsed once the type is known
+                skip_whitespace();
+                coordinates = cur_;
+                if (type != unknown_geometry && type != geometry_collection_tag)
+                {
+                    if (!parse_coordinates(type, geom)) return false;
+                }
+                else if (!skip_value())
+                {
+                    return false;
+                }
+            }
+            else if (key.equals("geometries"))
+            {
+                mapnik::geometry::geometry_collection<double> collection;
+                if (!lit('[')) return false;
+                if (!lit(']'))
+                {
+                    do
+                    {
+                        mapnik::geometry::geometry<double> part;
+                        if (!peek('{') || !parse_geometry(part)) return false;
+                        collection.push_back(std::move(part));
+                    }
+                    while (lit(','));
+                    if (!lit(']')) return false;
+                }
+                geom = std::move(collection);
+            }
+            else if (!skip_value())
+            {
+                return false;
+            }
+        }
+        while (lit(','));
+        if (!lit('}')) return false;
+
+        if (type == unknown_geometry || type == geometry_collection_tag)
+        {
+            return true;
+        }
+        if (coordinates == nullptr)
+        {
+            return false;
+        }
+        if (geom.is<mapnik::geometry::geometry_empty>())
+        {
+            char const* next = cur_;
+            cur_ = coordinates;
+            bool result = parse_coordinates(type, geom);
+            cur_ = next;
+            return result;
+        }
+        return true;
+    }
+
+    // Same members as parse_feature, only the extent of coordinates is kept.
+    bool parse_feature_box(mapnik::box2d<double> & box)
+    {
+        bool is_feature = false;
+        if (!lit('{')) return false;
+        do
+        {
+            string_span key;
+            if (!parse_key(key)) return false;
+            if (key.equals("type"))
+            {
+                string_span type;
+                if (!parse_string(type) || !type.equals("Feature")) return false;
+                is_feature = true;
+            }
+            else if (key.equals("geometry"))
+            {
+                if (!parse_geometry_box(box)) return false;
+            }
+            else if (!skip_value())
+            {
+                return false;
+            }
+        }
+        while (lit(','));
+        return lit('}') && is_feature;
+    }
+
+    bool parse_geometry_box(mapnik::box2d<double> & box)
+    {
+        if (lit("null")) return true;
+        if (!lit('{')) return false;
+        do
+        {
+            string_span key;
+            if (!parse_key(key)) return false;
+            if (key.equals("type"))
+            {
+                if (parse_geometry_type() == unknown_geometry) return false;
+            }
+            else if (key.equals("coordinates"))
+            {
+                if (!parse_coordinates_box(box)) return false;
+            }
+            else if (key.equals("geometries"))
+            {
+                if (!lit('[')) return false;
+                if (!lit(']'))
+                {
+                    do
+                    {
+                        if (!peek('{') || !parse_geometry_box(box)) return false;
+                    }
+                    while (lit(','));
+                    if (!lit(']')) return false;
+                }
+            }
+            else if (!skip_value())
+            {
+                return false;
+            }
+        }
+        while (lit(','));
+        return lit('}');
+    }
+
+    // Nested arrays of positions of any depth
+    bool parse_coordinates_box(mapnik::box2d<double> & box)
+    {
+        if (!lit('[')) return false;
+        if (lit(']')) return true;
+        if (!peek('['))
+        {
+            double x, y, ignored;
+            if (!parse_double(x) || !lit(',') || !parse_double(y)) return false;
+            while (lit(','))
+            {
+                if (!parse_double(ignored)) return false;
+            }
+            if (!lit(']')) return false;
+            box.expand_to_include(x, y);
+            return true;
+        }
+        do
+        {
+            if (!parse_coordinates_box(box)) return false;
+        }
+        while (lit(','));
+        return lit(']');
+    }
+
+    bool parse_position(point_type & pt)
+    {
+        if (!lit('[') || !parse_double(pt.x) || !lit(',') || !parse_double(pt.y)) return false;
+        double ignored;
+        while (lit(','))
+        {
+            if (!parse_double(ignored)) return false;
+        }
+        return lit(']');
+    }
+
+    // Positions are collected in a scratch vector and copied into a
+    // container of the final size.
+    template <typename Container>
+    bool parse_positions(Container & container)
+    {
+        points_.clear();
+        if (!lit('[')) return false;
+        if (!lit(']'))
+        {
+            do
+            {
+                point_type pt;
+                if (!parse_position(pt)) return false;
+                points_.push_back(pt);
+            }
+            while (lit(','));
+            if (!lit(']')) return false;
+        }
+        container.assign(points_.begin(), points_.end());
+        return true;
+    }
+
+    bool parse_polygon(mapnik::geometry::polygon<double> & poly)
+    {
+        if (!lit('[')) return false;
+        if (lit(']')) return true;
+        bool exterior = true;
+        do
+        {
+            mapnik::geometry::linear_ring<double> ring;
+            if (!parse_positions(ring)) return false;
+            if (exterior) poly.set_exterior_ring(std::move(ring));
+            else poly.add_hole(std::move(ring));
+            exterior = false;
+        }
+        while (lit(','));
+        return lit(']');
+    }
+
+    template <typename Container, typename Parse>
+    bool parse_array(Container & container, Parse parse)
+    {
+        if (!lit('[')) return false;
+        if (lit(']')) return true;
+        do
+        {
+            typename Container::value_type item;
+            if (!(this->*parse)(item)) return false;
+            container.push_back(std::move(item));
+        }
+        while (lit(','));
+        return lit(']');
+    }
+
+    bool parse_line_string(mapnik::geometry::line_string<double> & line)
+    {
+        return parse_positions(line);
+    }
+
+    bool parse_coordinates(geometry_type_tag type, mapnik::geometry::geometry<double> & geom)
+    {
+        switch (type)
+        {
+        case point_tag:
+        {
+            point_type pt;
+            if (!parse_position(pt)) return false;
+            geom = pt;
+            return true;
+        }
+        case line_string_tag:
+        {
+            mapnik::geometry::line_string<double> line;
+            if (!parse_positions(line)) return false;
+            geom = std::move(line);
+            return true;
+        }
+        case polygon_tag:
+        {
+            mapnik::geometry::polygon<double> poly;
+            if (!parse_polygon(poly)) return false;
+            geom = std::move(poly);
+            mapnik::geometry::correct(geom);
+            return true;
+        }
+        case multi_point_tag:
+        {
+            mapnik::geometry::multi_point<double> multi_point;
+            if (!parse_positions(multi_point)) return false;
+            geom = std::move(multi_point);
+            return true;
+        }
+        case multi_line_string_tag:
+        {
+            mapnik::geometry::multi_line_string<double> multi_line;
+            if (!parse_array(multi_line, &feature_parser::parse_line_string)) return false;
+            geom = std::move(multi_line);
+            return true;
+        }
+        case multi_polygon_tag:
+        {
+            mapnik::geometry::multi_polygon<double> multi_poly;
+            if (!parse_array(multi_poly, &feature_parser::parse_polygon)) return false;
+            geom = std::move(multi_poly);
+            mapnik::geometry::correct(geom);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    char const* cur_;
+    char const* end_;
+    mapnik::transcoder const& tr_;
+    static thread_local std::string key_;
+    static thread_local std::string text_;
+    static thread_local std::vector<point_type> points_;
+};
+
+thread_local std::string feature_parser::key_;
+thread_local std::string feature_parser::text_;
+thread_local std::vector<point_type> feature_parser::points_;
+
+}
+
+bool parse_feature(char const*& start, char const* end,
+                   mapnik::feature_impl & feature, mapnik::transcoder const& tr)
+{
+    feature_parser parser(start, end, tr);
+    bool result = parser.parse_feature(feature);
+    parser.skip_whitespace();
+    start = parser.position();
+    return result;
+}
+
+bool parse_feature_collection(char const*& start, char const* end,
+                              mapnik::context_ptr const& ctx, std::size_t & start_id,
+                              std::vector<mapnik::feature_ptr> & features,
+                              mapnik::transcoder const& tr)
+{
+    feature_parser parser(start, end, tr);
+    bool result = parser.parse_feature_collection(ctx, start_id, features);
+    parser.skip_whitespace();
+    start = parser.position();
+    return result;
+}
+
+namespace {
+
+// Sliding window over a file, consumed input is dropped when more is read.
+class file_window
+{
+public:
+    file_window(std::FILE * file, std::size_t max_size)
+        : file_(file),
+          max_size_(max_size),
+          block_size_(std::min(max_size_, std::size_t(1) << 20)),
+          buffer_(),
+          offset_(0),
+          pos_(0),
+          eof_(false) {}
+
+    char const* begin() const
+    {
+        return buffer_.data() + pos_;
+    }
+
+    char const* end() const
+    {
+        return buffer_.data() + buffer_.size();
+    }
+
+    // file offset of ptr in the window
+    std::size_t offset(char const* ptr) const
+    {
+        return offset_ + static_cast<std::size_t>(ptr - buffer_.data());
+    }
+
+    void consume(char const* ptr)
+    {
+        pos_ = static_cast<std::size_t>(ptr - buffer_.data());
+    }
+
+    // Returns false if nothing was read
+    bool fill()
+    {
+        if (eof_) return false;
+        if (pos_ > 0)
+        {
+            buffer_.erase(buffer_.begin(), buffer_.begin() + pos_);
+            offset_ += pos_;
+            pos_ = 0;
+        }
+        std::size_t size = buffer_.size();
+        if (size >= max_size_) return false;
+        std::size_t count = std::min(block_size_, max_size_ - size);
+        buffer_.resize(size + count);
+        std::size_t read = std::fread(buffer_.data() + size, 1, count, file_);
+        buffer_.resize(size + read);
+        if (read < count) eof_ = true;
+        return read > 0;
+    }
+
+private:
+    std::FILE * file_;
+    std::size_t max_size_;
+    std::size_t block_size_;
+    std::vector<char> buffer_;
+    std::size_t offset_;
+    std::size_t pos_;
+    bool eof_;
+};
+
+}
+
+bool scan_feature_collection(std::FILE * file, std::size_t max_feature_size,
+                             std::function<void(mapnik::box2d<double> const&, std::size_t, std::size_t)> const& callback)
+{
+    static const mapnik::transcoder tr("utf8");
+    file_window window(file, max_feature_size);
+    scan_state state = scan_collection;
+    while (state != scan_done)
+    {
+        feature_parser parser(window.begin(), window.end(), tr);
+        scan_state next = state;
+        mapnik::box2d<double> box;
+        char const* feature_begin = nullptr;
+        char const* feature_end = nullptr;
+        if (!parser.scan_step(next, box, feature_begin, feature_end))
+        {
+            if (!window.fill()) return false;
+            continue;
+        }
+        if (feature_end != nullptr)
+        {
+            callback(box, window.offset(feature_begin), static_cast<std::size_t>(feature_end - feature_begin));
+        }
+        window.consume(parser.position());
+        state = next;
+    }
+    return true;
+}
+
+bool from_geojson(std::string const& json, mapnik::feature_impl & feature)
+{
+    static const mapnik::transcoder tr("utf8");
+    char const* start = json.c_str();
+    char const* end = start + json.length();
+    return parse_feature(start, end, feature, tr);
+}
+
+}}
@@ -0,0 +1,175 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/metatile.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/request.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/palette.hpp>
+#include <mapnik/util/thread_pool.hpp>
+
+// stl
+#include <exception>
+#include <future>
+#include <map>
+#include <stdexcept>
+
+namespace mapnik
+{
+
+box2d<double> metatile_grid::tile_extent(unsigned column, unsigned row) const
+{
+    double dx = extent.width() / columns;
+    double dy = extent.height() / rows;
+    return box2d<double>(extent.minx() + column * dx,
+                         extent.maxy() - (row + 1) * dy,
+                         extent.minx() + (column + 1) * dx,
+                         extent.maxy() - row * dy);
+}
+
+metatile::metatile(metatile_grid const& grid)
+    : grid_(grid),
+      image_(grid.width(), grid.height()) {}
+
+void metatile::render(Map const& map, double scale_factor)
+{
+    render(map, attributes(), scale_factor);
+}
+
+void metatile::render(Map const& map, attributes const& vars, double scale_factor)
+{
+    request req(grid_.width(), grid_.height(), grid_.extent);
+    req.set_buffer_size(map.buffer_size());
+    agg_renderer<image_rgba8> ren(map, req, vars, image_, scale_factor);
+    ren.apply();
+}
+
+image_view_rgba8 metatile::tile(unsigned column, unsigned row) const
+{
+    if (column >= grid_.columns || row >= grid_.rows)
+    {
+        throw std::out_of_range("metatile: tile out of the grid");
+    }
+    return image_view_rgba8(column * grid_.tile_size, row * grid_.tile_size,
+                            grid_.tile_size, grid_.tile_size, image_);
+}
+
+namespace {
+
+tile_content classify(image_view_rgba8 const& view)
+{
+    if (!is_solid(view))
+    {
+        return tile_content::painted;
+    }
+    if (view.width() == 0 || view.height() == 0 || (view(0, 0) >> 24) == 0)
+    {
+        return tile_content::empty;
+    }
+    return tile_content::uniform;
+}
+
+std::string encode_view(image_view_rgba8 const& view,
+                        std::string const& format,
+                        rgba_palette const* palette)
+{
+    return palette ? save_to_string(view, format, *palette) : save_to_string(view, format);
+}
+
+}
+
+tile_content metatile::content(unsigned column, unsigned row) const
+{
+    return classify(tile(column, row));
+}
+
+std::vector<encoded_tile> metatile::encode(std::string const& format) const
+{
+    return encode_impl(format, nullptr);
+}
+
+std::vector<encoded_tile> metatile::encode(std::string const& format,
+                                           rgba_palette const& palette) const
+{
+    return encode_impl(format, &palette);
+}
+
+std::vector<encoded_tile> metatile::encode_impl(std::string const& format,
+                                                rgba_palette const* palette) const
+{
+    util::thread_pool & pool = util::global_thread_pool::instance();
+    std::vector<std::future<encoded_tile>> futures;
+    futures.reserve(grid_.columns * grid_.rows);
+    for (unsigned row = 0; row < grid_.rows; ++row)
+    {
+        for (unsigned column = 0; column < grid_.columns; ++column)
+        {
+            futures.emplace_back(pool.submit([this, column, row, &format, palette] {
+                image_view_rgba8 view = tile(column, row);
+                encoded_tile result{column, row, classify(view), std::string()};
+                if (result.content == tile_content::painted)
+                {
+                    result.data = encode_view(view, format, palette);
+                }
+                return result;
+            }));
+        }
+    }
+
+    // all tasks reference this metatile, wait for them before rethrowing
+    std::vector<encoded_tile> tiles;
+    tiles.reserve(futures.size());
+    std::exception_ptr error;
+    for (auto & future : futures)
+    {
+        try
+        {
+            tiles.emplace_back(pool.get(future));
+        }
+        catch (...)
+        {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    std::map<image_rgba8::pixel_type, std::string> uniform;
+    for (auto & t : tiles)
+    {
+        if (t.content != tile_content::uniform) continue;
+        image_view_rgba8 view = tile(t.column, t.row);
+        auto itr = uniform.find(view(0, 0));
+        if (itr == uniform.end())
+        {
+            itr = uniform.emplace(view(0, 0), encode_view(view, format, palette)).first;
+        }
+        t.data = itr->second;
+    }
+    return tiles;
+}
+
+}
@@ -219,7 +219,7 @@ bool proj_transform::forward (double * x, double * y , double * z, int point_cou
     }
 
     for(int j=0; j<point_count; j++) {
-        if (x[j] == HUGE_VAL || y[j] == HUGE_VAL)
+        if (x[j * offset] == HUGE_VAL || y[j * offset] == HUGE_VAL)
         {
             return false;
         }
@@ -269,7 +269,7 @@ bool proj_transform::backward (double * x, double * y , double * z, int point_co
 
     for (int j = 0; j < point_count; ++j)
     {
-        if (x[j] == HUGE_VAL || y[j] == HUGE_VAL)
+        if (x[j * offset] == HUGE_VAL || y[j * offset] == HUGE_VAL)
         {
             return false;
         }
@@ -28,10 +28,14 @@
 #include <mapnik/raster.hpp>
 #include <mapnik/raster_colorizer.hpp>
 #include <mapnik/enumeration.hpp>
+#include <mapnik/util/parallelize.hpp>
 
 // stl
-#include <limits>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
 
 namespace mapnik
 {
@@ -124,6 +128,70 @@ bool raster_colorizer::add_stop(colorizer_stop const& stop)
     return true;
 }
 
+namespace {
+
+// Index of the stop a value falls into, -1 before the first stop.
+// Stops added by add_stop are increasing, for those the stop is found by
+// binary search, others use the same linear search as get_color.
+class stop_finder
+{
+public:
+    explicit stop_finder(colorizer_stops const& stops)
+        : values_(),
+          sorted_(true)
+    {
+        values_.reserve(stops.size());
+        for (colorizer_stop const& stop : stops)
+        {
+            if (!values_.empty() && !(values_.back() < stop.get_value()))
+            {
+                sorted_ = false;
+            }
+            values_.push_back(stop.get_value());
+        }
+    }
+
+    int operator() (float value) const
+    {
+        if (sorted_)
+        {
+            auto itr = std::upper_bound(values_.begin(), values_.end(), value);
+            return static_cast<int>(itr - values_.begin()) - 1;
+        }
+        int count = static_cast<int>(values_.size());
+        for (int i = 0; i < count; ++i)
+        {
+            if (value < values_[i])
+            {
+                return i - 1;
+            }
+        }
+        return count - 1;
+    }
+
+private:
+    std::vector<float> values_;
+    bool sorted_;
+};
+
+// Integer inputs spanning no more values than there are pixels are
+// colorized through a table of all values in their range.
+template <typename PixelType>
+bool lut_range(PixelType const* data, std::size_t len, PixelType & min, PixelType & max)
+{
+    if (!std::is_integral<PixelType>::value || sizeof(PixelType) > 4 || len == 0)
+    {
+        return false;
+    }
+    auto range = std::minmax_element(data, data + len);
+    min = *range.first;
+    max = *range.second;
+    std::int64_t size = static_cast<std::int64_t>(max) - static_cast<std::int64_t>(min) + 1;
+    return size <= static_cast<std::int64_t>(len);
+}
+
+}
+
 template <typename T>
 void raster_colorizer::colorize(image_rgba8 & out, T const& in,
                                 boost::optional<double> const& nodata,
@@ -134,19 +202,64 @@ void raster_colorizer::colorize(image_rgba8 & out, T const& in,
     // TODO: assuming in/out have the same width/height for now
     std::uint32_t * out_data = out.data();
     pixel_type const* in_data = in.data();
-    int len = out.width() * out.height();
-    for (int i=0; i<len; ++i)
+    std::size_t width = out.width();
+    std::size_t height = out.height();
+    unsigned jobs = util::jobs_by_image_size(width, height);
+
+    if (stops_.empty())
     {
-        pixel_type value = in_data[i];
+        std::uint32_t default_color = default_color_.rgba();
+        util::parallelize([&](unsigned begin, unsigned end) {
+            for (std::size_t i = begin * width; i < end * width; ++i)
+            {
+                pixel_type value = in_data[i];
+                if (nodata && (std::fabs(value - *nodata) < epsilon_))
+                {
+                    out_data[i] = 0; // rgba(0,0,0,0)
+                }
+                else
+                {
+                    out_data[i] = default_color;
+                }
+            }
+        }, jobs, height);
+        return;
+    }
+
+    stop_finder find_stop(stops_);
+    auto color_of = [&](pixel_type value) -> std::uint32_t {
         if (nodata && (std::fabs(value - *nodata) < epsilon_))
         {
-            out_data[i] = 0; // rgba(0,0,0,0)
+            return 0; // rgba(0,0,0,0)
         }
-        else
+        return get_color(find_stop(value), value);
+    };
+
+    pixel_type min = 0;
+    pixel_type max = 0;
+    if (lut_range(in_data, width * height, min, max))
+    {
+        std::vector<std::uint32_t> lut(static_cast<std::size_t>(
+            static_cast<std::int64_t>(max) - static_cast<std::int64_t>(min) + 1));
+        for (std::size_t k = 0; k < lut.size(); ++k)
         {
-            out_data[i] = get_color(value);
+            lut[k] = color_of(static_cast<pixel_type>(min + k));
         }
+        util::parallelize([&](unsigned begin, unsigned end) {
+            for (std::size_t i = begin * width; i < end * width; ++i)
+            {
+                out_data[i] = lut[static_cast<std::size_t>(static_cast<std::int64_t>(in_data[i]) - min)];
+            }
+        }, jobs, height);
+        return;
     }
+
+    util::parallelize([&](unsigned begin, unsigned end) {
+        for (std::size_t i = begin * width; i < end * width; ++i)
+        {
+            out_data[i] = color_of(in_data[i]);
+        }
+    }, jobs, height);
 }
 
 inline unsigned interpolate(unsigned start, unsigned end, float fraction)
@@ -183,6 +296,13 @@ unsigned raster_colorizer::get_color(float value) const
         stopIdx = stopCount-1;
     }
 
+    return get_color(stopIdx, value);
+}
+
+unsigned raster_colorizer::get_color(int stopIdx, float value) const
+{
+    int stopCount = stops_.size();
+
     //2 - Find the next stop
     int nextStopIdx = stopIdx + 1;
     if(nextStopIdx >= stopCount)
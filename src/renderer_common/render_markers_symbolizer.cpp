@@ -316,7 +316,7 @@ void render_marker(
     std::string const & filename,
     std::shared_ptr<marker const> const & mark)
 {
-    using Detector = label_collision_detector_boost;
+    using Detector = label_collision_detector_packed;
     using RendererType = renderer_common;
     using ContextType = markers_renderer_context;
     using VisitorType = detail::render_marker_symbolizer_visitor<Detector,
@@ -64,10 +64,11 @@ const char * ft_translate_error_code(int err_code)
     return "Unknown error";
 }
 
-font_face::font_face(FT_Face face)
+font_face::font_face(FT_Face face, std::size_t id)
     : face_(face),
       color_font_(init_color_font()),
-      unscaled_ascender_(get_ascender())
+      unscaled_ascender_(get_ascender()),
+      id_(id)
 {
 }
 
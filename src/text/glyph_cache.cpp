@@ -0,0 +1,123 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/text/glyph_cache.hpp>
+
+// stl
+#include <algorithm>
+#include <cstdlib>
+
+namespace mapnik
+{
+
+template class singleton<glyph_cache, CreateStatic>;
+
+glyph_bitmap::glyph_bitmap(FT_Bitmap const& src, int left_, int top_)
+    : left(left_),
+      top(top_),
+      width(src.width),
+      rows(src.rows),
+      pitch(src.pitch),
+      pixel_mode(src.pixel_mode),
+      num_grays(src.num_grays),
+      buffer()
+{
+    std::size_t size = static_cast<std::size_t>(std::abs(pitch)) * rows;
+    if (size > 0 && src.buffer)
+    {
+        buffer.assign(src.buffer, src.buffer + size);
+    }
+}
+
+FT_Bitmap glyph_bitmap::bitmap() const
+{
+    FT_Bitmap result;
+    result.rows = rows;
+    result.width = width;
+    result.pitch = pitch;
+    // compositing functions take non-const bitmaps but only read them
+    result.buffer = const_cast<unsigned char*>(buffer.data());
+    result.num_grays = num_grays;
+    result.pixel_mode = pixel_mode;
+    result.palette_mode = 0;
+    result.palette = nullptr;
+    return result;
+}
+
+glyph_cache::glyph_cache()
+    : cache_(),
+      subpixel_steps_(64) {}
+
+void glyph_cache::set_capacity(std::size_t bytes)
+{
+    instance().cache_.set_capacity(bytes);
+}
+
+bool glyph_cache::set_subpixel_steps(unsigned steps)
+{
+    // steps have to divide the 1/64 pixel units of FreeType
+    if (steps == 0 || steps > 64 || (64 % steps) != 0)
+    {
+        return false;
+    }
+    glyph_cache & cache = instance();
+    if (cache.subpixel_steps_.exchange(steps) != steps)
+    {
+        cache.clear();
+    }
+    return true;
+}
+
+FT_Pos glyph_cache::snap(FT_Pos pos) const
+{
+    FT_Pos step = 64 / subpixel_steps_;
+    if (step == 1) return pos;
+    FT_Pos q = pos + step / 2;
+    FT_Pos rem = ((q % step) + step) % step;
+    return q - rem;
+}
+
+glyph_bitmap_ptr glyph_cache::find(glyph_cache_key const& key)
+{
+    glyph_bitmap_ptr bitmap;
+    cache_.find(key, bitmap);
+    return bitmap;
+}
+
+void glyph_cache::insert(glyph_cache_key const& key, glyph_bitmap_ptr const& bitmap)
+{
+    if (!cache_.enabled() || !bitmap) return;
+    cache_.insert(key, bitmap, bitmap->memory_size());
+}
+
+void glyph_cache::clear()
+{
+    cache_.clear();
+}
+
+util::lru_cache_stats glyph_cache::stats() const
+{
+    return cache_.stats();
+}
+
+}
@@ -47,6 +47,10 @@
 #include "agg_renderer_scanline.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <algorithm>
+#include <cmath>
+
 namespace mapnik
 {
 
@@ -89,6 +93,15 @@ FT_Error text_renderer::select_closest_size(glyph_info const& glyph, FT_Face & f
     return FT_Select_Size(face, best_match);
 }
 
+namespace {
+
+bool is_identity(agg::trans_affine const& tr)
+{
+    return tr.sx == 1.0 && tr.shy == 0.0 && tr.shx == 0.0 && tr.sy == 1.0;
+}
+
+}
+
 void text_renderer::prepare_glyphs(glyph_positions const& positions, bool is_mono)
 {
     FT_Matrix matrix;
@@ -98,6 +111,11 @@ void text_renderer::prepare_glyphs(glyph_positions const& positions, bool is_mon
     glyphs_.clear();
     glyphs_.reserve(positions.size());
 
+    // Rasterizing through glyph_cache relies on the final outline being
+    // a pure translation of the loaded one.
+    bool use_cache = glyph_cache::instance().enabled() &&
+        is_identity(transform_) && is_identity(halo_transform_);
+
     for (auto const& glyph_pos : positions)
     {
         glyph_info const& glyph = glyph_pos.glyph;
@@ -114,12 +132,13 @@ void text_renderer::prepare_glyphs(glyph_positions const& positions, bool is_mon
             load_flags |= FT_LOAD_COLOR;
         }
 
+        bool cached = use_cache && face->num_fixed_sizes == 0 && !glyph.face->is_color();
         if (face->num_fixed_sizes > 0)
         {
             error = select_closest_size(glyph, face);
             if (error) continue;
         }
-        else
+        else if (!cached)
         {
             glyph.face->set_character_sizes(glyph.format.text_size * scale_factor_);
         }
@@ -139,15 +158,87 @@ void text_renderer::prepare_glyphs(glyph_positions const& positions, bool is_mon
         pen.x = static_cast<FT_Pos>(pos.x * 64);
         pen.y = static_cast<FT_Pos>(pos.y * 64);
 
+        box2d<double> bbox(0, glyph_pos.glyph.ymin, 1, glyph_pos.glyph.ymax);
+        if (cached)
+        {
+            // loaded on a glyph_cache miss only
+            glyphs_.emplace_back(glyph, nullptr, pos, glyph_pos.rot, size, bbox, matrix, pen, load_flags);
+            continue;
+        }
+
         FT_Set_Transform(face, &matrix, &pen);
         error = FT_Load_Glyph(face, glyph.glyph_index, load_flags);
         if (error) continue;
         FT_Glyph image;
         error = FT_Get_Glyph(face->glyph, &image);
         if (error) continue;
-        box2d<double> bbox(0, glyph_pos.glyph.ymin, 1, glyph_pos.glyph.ymax);
-        glyphs_.emplace_back(glyph, image, pos, glyph_pos.rot, size, bbox);
+        glyphs_.emplace_back(glyph, image, pos, glyph_pos.rot, size, bbox, matrix, pen, load_flags);
+    }
+}
+
+FT_Error text_renderer::load_glyph(glyph_t const& glyph, FT_Glyph & image) const
+{
+    FT_Face face = glyph.info.face->get_face();
+    glyph.info.face->set_character_sizes(glyph.size);
+    FT_Matrix matrix = glyph.matrix;
+    FT_Vector pen = glyph.pen;
+    FT_Set_Transform(face, &matrix, &pen);
+    FT_Error error = FT_Load_Glyph(face, glyph.info.glyph_index, glyph.load_flags);
+    if (error) return error;
+    return FT_Get_Glyph(face->glyph, &image);
+}
+
+glyph_bitmap_ptr text_renderer::cached_bitmap(glyph_t const& glyph,
+                                              FT_Vector const& offset,
+                                              FT_Render_Mode mode,
+                                              double stroke_radius,
+                                              FT_Vector & origin) const
+{
+    glyph_cache & cache = glyph_cache::instance();
+    FT_Pos x = cache.snap(glyph.pen.x + offset.x);
+    FT_Pos y = cache.snap(glyph.pen.y + offset.y);
+    origin.x = x >> 6;
+    origin.y = y >> 6;
+
+    glyph_cache_key key{glyph.info.face->id(), glyph.info.glyph_index,
+        static_cast<FT_F26Dot6>(glyph.size * (1 << 6)),
+        glyph.matrix.xx, glyph.matrix.xy, glyph.matrix.yx, glyph.matrix.yy,
+        x & 63, y & 63, glyph.load_flags, static_cast<int>(mode),
+        static_cast<FT_Fixed>(stroke_radius * (1 << 6))};
+    if (glyph_bitmap_ptr bitmap = cache.find(key))
+    {
+        return bitmap;
+    }
+
+    FT_Glyph image;
+    if (load_glyph(glyph, image)) return glyph_bitmap_ptr();
+    if (image->format != FT_GLYPH_FORMAT_OUTLINE)
+    {
+        // embedded bitmaps are rendered by the uncached path
+        FT_Done_Glyph(image);
+        return glyph_bitmap_ptr();
+    }
+    FT_Vector delta;
+    delta.x = x - glyph.pen.x;
+    delta.y = y - glyph.pen.y;
+    FT_Glyph_Transform(image, nullptr, &delta);
+    if (stroke_radius > 0)
+    {
+        stroker_->init(stroke_radius);
+        FT_Glyph_Stroke(&image, stroker_->get(), 1);
+    }
+    if (FT_Glyph_To_Bitmap(&image, mode, 0, 1))
+    {
+        FT_Done_Glyph(image);
+        return glyph_bitmap_ptr();
     }
+    FT_BitmapGlyph bit = reinterpret_cast<FT_BitmapGlyph>(image);
+    auto bitmap = std::make_shared<glyph_bitmap>(bit->bitmap,
+        bit->left - static_cast<int>(origin.x),
+        bit->top - static_cast<int>(origin.y));
+    FT_Done_Glyph(image);
+    cache.insert(key, bitmap);
+    return bitmap;
 }
 
 template<class PixFmt> class image_accessor_halo
@@ -334,8 +425,7 @@ image_gray8 const& halo_cache::get(glyph_info const & glyph,
                                    pixfmt_type const& bitmap,
                                    double halo_radius)
 {
-    key_type key(glyph.face->family_name(), glyph.face->style_name(),
-        glyph.glyph_index, glyph.height, halo_radius);
+    key_type key(glyph.face->id(), glyph.glyph_index, glyph.height, halo_radius);
     value_type & halo_img_ptr = cache_[key];
 
     if (halo_img_ptr)
@@ -394,9 +484,16 @@ agg_text_renderer<T>::agg_text_renderer (pixmap_type & pixmap,
     : text_renderer(halo_rasterizer, comp_op, halo_comp_op,
                     scale_factor, stroker),
       pixmap_(pixmap),
-      ras_(ras)
+      ras_(ras),
+      painted_extent_()
 {}
 
+template <typename T>
+void agg_text_renderer<T>::mark_painted(int x, int y, int width, int height)
+{
+    painted_extent_.expand_to_include(box2d<int>(x, y, x + width, y + height));
+}
+
 template <typename T>
 void agg_text_renderer<T>::render(glyph_positions const& pos)
 {
@@ -440,13 +537,39 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
     double text_opacity = 1.0;
     double halo_opacity = 1.0;
 
-    for (auto const& glyph : glyphs_)
+    for (auto & glyph : glyphs_)
     {
         halo_fill = glyph.info.format.halo_fill.rgba();
         halo_opacity = glyph.info.format.halo_opacity;
         halo_radius = glyph.info.format.halo_radius * scale_factor_;
         // make sure we've got reasonable values.
         if (halo_radius <= 0.0 || halo_radius > 1024.0) continue;
+        if (!glyph.image)
+        {
+            bool full = rasterizer_ == HALO_RASTERIZER_FULL;
+            FT_Vector origin;
+            glyph_bitmap_ptr bitmap = cached_bitmap(glyph, start_halo, FT_RENDER_MODE_NORMAL,
+                                                    full ? halo_radius : 0.0, origin);
+            if (bitmap)
+            {
+                FT_Bitmap bm = bitmap->bitmap();
+                int left = bitmap->left + static_cast<int>(origin.x);
+                int top = bitmap->top + static_cast<int>(origin.y);
+                if (full)
+                {
+                    composite_bitmap(pixmap_, &bm, halo_fill, left, height - top,
+                                     halo_opacity, halo_comp_op_, ras_);
+                    mark_painted(left, height - top, bm.width, bm.rows);
+                }
+                else
+                {
+                    render_halo(bm.buffer, bm.width, bm.rows, 1, halo_fill,
+                                left, height - top, halo_radius, halo_opacity, halo_comp_op_);
+                }
+                continue;
+            }
+            if (load_glyph(glyph, glyph.image)) continue;
+        }
         FT_Glyph g;
         error = FT_Glyph_Copy(glyph.image, &g);
         if (!error)
@@ -476,6 +599,8 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
                                          halo_opacity,
                                          halo_comp_op_,
                                          ras_);
+                        mark_painted(bit->left, height - bit->top,
+                                     bit->bitmap.width, bit->bitmap.rows);
                     }
                 }
             }
@@ -506,6 +631,7 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
                                                comp_op_,
                                                glyph.info,
                                                halo_cache_);
+                    mark_painted(0, 0, pixmap_.width(), pixmap_.height());
                 }
                 else
                 {
@@ -531,6 +657,33 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
         fill = glyph.info.format.fill.rgba();
         text_opacity = glyph.info.format.text_opacity;
 
+        if (!glyph.image)
+        {
+            FT_Render_Mode mode = (glyph.info.format.text_mode == TEXT_MODE_DEFAULT)
+                ? FT_RENDER_MODE_NORMAL : FT_RENDER_MODE_MONO;
+            FT_Vector origin;
+            if (glyph_bitmap_ptr bitmap = cached_bitmap(glyph, start, mode, 0.0, origin))
+            {
+                FT_Bitmap bm = bitmap->bitmap();
+                int left = bitmap->left + static_cast<int>(origin.x);
+                int top = bitmap->top + static_cast<int>(origin.y);
+                mark_painted(left, height - top, bm.width, bm.rows);
+                switch (bm.pixel_mode)
+                {
+                    case FT_PIXEL_MODE_GRAY:
+                        composite_bitmap(pixmap_, &bm, fill, left, height - top,
+                                         text_opacity, comp_op_, ras_);
+                        break;
+                    case FT_PIXEL_MODE_MONO:
+                        composite_bitmap_mono(pixmap_, &bm, fill, left, height - top,
+                                              text_opacity, comp_op_);
+                        break;
+                }
+                continue;
+            }
+            if (load_glyph(glyph, glyph.image)) continue;
+        }
+
         FT_Glyph_Transform(glyph.image, &matrix, &start);
         error = 0;
         if (glyph.image->format == FT_GLYPH_FORMAT_BITMAP)
@@ -549,6 +702,8 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
                                           glyph.bbox,
                                           text_opacity,
                                           comp_op_);
+                    // scaled and rotated around (x, y)
+                    mark_painted(0, 0, pixmap_.width(), pixmap_.height());
                     break;
                 case FT_PIXEL_MODE_MONO:
                     composite_bitmap_mono(pixmap_,
@@ -557,6 +712,7 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
                                      x, y,
                                      text_opacity,
                                      comp_op_);
+                    mark_painted(x, y, bit->bitmap.width, bit->bitmap.rows);
                     break;
             }
         }
@@ -568,6 +724,7 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
             if (error == 0)
             {
                 FT_BitmapGlyph bit = reinterpret_cast<FT_BitmapGlyph>(glyph.image);
+                mark_painted(bit->left, height - bit->top, bit->bitmap.width, bit->bitmap.rows);
                 switch (bit->bitmap.pixel_mode)
                 {
                     case FT_PIXEL_MODE_GRAY:
@@ -608,6 +765,8 @@ void agg_text_renderer<T>::render_halo(unsigned char *buffer,
                                        double opacity,
                                        composite_mode_e comp_op)
 {
+    int pad = std::max(1, static_cast<int>(std::ceil(halo_radius)));
+    mark_painted(x1 - pad, y1 - pad, width + 2 * pad, height + 2 * pad);
     int x, y;
     if (halo_radius < 1.0)
     {
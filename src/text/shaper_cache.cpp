@@ -0,0 +1,70 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/text/shaper_cache.hpp>
+
+namespace mapnik
+{
+
+template class singleton<shaped_run_cache, CreateStatic>;
+
+namespace {
+
+std::size_t run_cost(shaper_cache_key const& key, shaped_run const& run)
+{
+    return sizeof(shaper_cache_key) + sizeof(shaped_run) +
+        static_cast<std::size_t>(key.text.length()) * sizeof(UChar) +
+        run.size() * (sizeof(hb_glyph_info_t) + sizeof(hb_glyph_position_t));
+}
+
+}
+
+void shaped_run_cache::set_capacity(std::size_t bytes)
+{
+    instance().cache_.set_capacity(bytes);
+}
+
+shaped_run_ptr shaped_run_cache::find(shaper_cache_key const& key)
+{
+    shaped_run_ptr run;
+    cache_.find(key, run);
+    return run;
+}
+
+void shaped_run_cache::insert(shaper_cache_key const& key, shaped_run_ptr const& run)
+{
+    if (!cache_.enabled() || !run) return;
+    cache_.insert(key, run, run_cost(key, *run));
+}
+
+void shaped_run_cache::clear()
+{
+    cache_.clear();
+}
+
+util::lru_cache_stats shaped_run_cache::stats() const
+{
+    return cache_.stats();
+}
+
+}
@@ -0,0 +1,266 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+
+// mapnik
+#include <mapnik/util/mapped_spatial_index.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#ifdef _WINDOWS
+#include <mapnik/util/utf_conv_win.hpp>
+#include <boost/filesystem/operations.hpp>
+#endif
+#pragma GCC diagnostic pop
+
+#ifndef _WINDOWS
+#include <sys/stat.h>
+#endif
+
+// stl
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace mapnik { namespace util {
+
+namespace {
+
+// "mapnik-index" header followed by the root node of a quadtree
+constexpr std::size_t header_size = 16;
+// levels of the tree decoded when the index is opened
+constexpr unsigned cached_levels = 5;
+constexpr std::size_t max_cached_nodes = 4096;
+
+std::int32_t read_ndr_integer(char const* data)
+{
+    unsigned char const* b = reinterpret_cast<unsigned char const*>(data);
+    return static_cast<std::int32_t>(b[0] | b[1] << 8 | b[2] << 16 | static_cast<std::uint32_t>(b[3]) << 24);
+}
+
+// Identifies the content of a file, a file replaced or modified in
+// place gets another stamp
+struct file_stamp
+{
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint64_t size;
+    std::int64_t mtime;
+
+    bool operator==(file_stamp const& other) const
+    {
+        return device == other.device && inode == other.inode &&
+            size == other.size && mtime == other.mtime;
+    }
+};
+
+bool read_file_stamp(std::string const& filename, file_stamp & stamp)
+{
+#ifdef _WINDOWS
+    boost::system::error_code ec;
+    boost::filesystem::path path(mapnik::utf8_to_utf16(filename));
+    std::uintmax_t size = boost::filesystem::file_size(path, ec);
+    if (ec) return false;
+    std::time_t mtime = boost::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    stamp = file_stamp{0, 0, static_cast<std::uint64_t>(size), static_cast<std::int64_t>(mtime)};
+#else
+    struct stat st;
+    if (::stat(filename.c_str(), &st) != 0) return false;
+    stamp = file_stamp{static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino),
+                       static_cast<std::uint64_t>(st.st_size), static_cast<std::int64_t>(st.st_mtime)};
+#endif
+    return true;
+}
+
+struct index_registry
+{
+    struct entry
+    {
+        std::size_t value_size;
+        file_stamp stamp;
+        std::shared_ptr<mapped_spatial_index const> index;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, entry> entries;
+};
+
+index_registry & registry()
+{
+    static index_registry instance;
+    return instance;
+}
+
+}
+
+spatial_index_node spatial_index_node::read(char const* data, char const* data_end, std::size_t value_size)
+{
+    constexpr std::size_t node_header = 4 + sizeof(box2d<double>) + 4;
+    if (data > data_end || static_cast<std::size_t>(data_end - data) < node_header + 4)
+    {
+        throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    }
+    spatial_index_node node;
+    std::int32_t offset = read_ndr_integer(data);
+    std::memcpy(reinterpret_cast<char*>(&node.envelope), data + 4, sizeof(box2d<double>));
+    std::int32_t num_values = read_ndr_integer(data + 4 + sizeof(box2d<double>));
+    node.values = data + node_header;
+    std::size_t available = static_cast<std::size_t>(data_end - node.values) - 4;
+    if (offset < 0 || num_values < 0 || static_cast<std::size_t>(num_values) > available / value_size)
+    {
+        throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    }
+    node.num_values = static_cast<std::uint32_t>(num_values);
+    char const* values_end = node.values + node.num_values * value_size;
+    std::int32_t num_children = read_ndr_integer(values_end);
+    node.children = values_end + 4;
+    if (num_children < 0 || static_cast<std::size_t>(offset) > static_cast<std::size_t>(data_end - node.children))
+    {
+        throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    }
+    node.num_children = static_cast<std::uint32_t>(num_children);
+    node.end = node.children + offset;
+    return node;
+}
+
+mapped_spatial_index::mapped_spatial_index(mapped_region_ptr const& region, std::size_t value_size)
+    : region_(region),
+      data_(static_cast<char const*>(region->get_address())),
+      data_end_(data_ + region->get_size()),
+      value_size_(value_size),
+      packed_(false),
+      extent_(),
+      header_(),
+      nodes_()
+{
+    if (value_size_ == 0 || region_->get_size() < header_size)
+    {
+        throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    }
+    if (std::strncmp(data_, "mapnik-index", 12) == 0)
+    {
+        init_quadtree();
+    }
+    else if (packed_index_header::is_packed(data_))
+    {
+        init_packed();
+    }
+    else
+    {
+        throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    }
+}
+
+void mapped_spatial_index::init_packed()
+{
+    mapped_reader reader{data_, data_end_};
+    header_.read_fixed(reader.read(0, packed_index_header::fixed_size));
+    header_.read_levels(reader.read(packed_index_header::fixed_size, header_.levels_size()));
+    // nodes and values have to fit in the file
+    reader.read(0, header_.file_size());
+    packed_ = true;
+    extent_ = header_.extent;
+}
+
+void mapped_spatial_index::init_quadtree()
+{
+    // Decode upper levels breadth first, children of a node are kept together
+    nodes_.push_back(cached_node{spatial_index_node::read(data_ + header_size, data_end_, value_size_), 0});
+    extent_ = nodes_.front().node.envelope;
+    std::size_t level_begin = 0;
+    std::size_t level_end = 1;
+    for (unsigned level = 1; level < cached_levels && nodes_.size() < max_cached_nodes; ++level)
+    {
+        for (std::size_t i = level_begin; i < level_end; ++i)
+        {
+            std::uint32_t first_child = static_cast<std::uint32_t>(nodes_.size());
+            char const* child = nodes_[i].node.children;
+            for (std::uint32_t j = 0; j < nodes_[i].node.num_children; ++j)
+            {
+                spatial_index_node node = spatial_index_node::read(child, data_end_, value_size_);
+                child = node.end;
+                nodes_.push_back(cached_node{node, 0});
+            }
+            if (nodes_[i].node.num_children > 0)
+            {
+                nodes_[i].first_child = first_child;
+            }
+        }
+        level_begin = level_end;
+        level_end = nodes_.size();
+        if (level_begin == level_end) break;
+    }
+}
+
+std::shared_ptr<mapped_spatial_index const> mapped_spatial_index::open(std::string const& filename,
+                                                                       std::size_t value_size)
+{
+    file_stamp stamp;
+    bool exists = read_file_stamp(filename, stamp);
+    index_registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto itr = reg.entries.find(filename);
+    if (itr != reg.entries.end())
+    {
+        if (exists && itr->second.stamp == stamp && itr->second.value_size == value_size)
+        {
+            return itr->second.index;
+        }
+        // the file was replaced or removed, its old mapping is released
+        // once the last query using it finishes
+        reg.entries.erase(itr);
+    }
+    if (!exists)
+    {
+        throw std::runtime_error("could not create file mapping for " + filename);
+    }
+    // mapped here rather than through mapped_memory_cache,
+    // which would keep the content of a replaced file
+    mapped_region_ptr region;
+    try
+    {
+        boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+        region = std::make_shared<boost::interprocess::mapped_region>(mapping, boost::interprocess::read_only);
+    }
+    catch (boost::interprocess::interprocess_exception const& ex)
+    {
+        throw std::runtime_error("could not create file mapping for " + filename + ": " + ex.what());
+    }
+    auto index = std::make_shared<mapped_spatial_index const>(region, value_size);
+    reg.entries.emplace(filename, index_registry::entry{value_size, stamp, index});
+    return index;
+}
+
+void mapped_spatial_index::clear_cache()
+{
+    index_registry & reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.entries.clear();
+}
+
+}}
+
+#endif
@@ -26,8 +26,17 @@
 #include <mapnik/agg_renderer.hpp>
 #include <mapnik/layer.hpp>
 #include <mapnik/image_scaling.hpp>
+#include <mapnik/image_pool.hpp>
+#include <mapnik/uses_collision_detector.hpp>
+#include <mapnik/feature_style_processor.hpp>
+#include <mapnik/util/thread_pool.hpp>
+#include <mapnik/util/noncopyable.hpp>
 
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <future>
+#include <mutex>
 
 #ifdef MAPNIK_STATS_RENDER
 struct log_operation
@@ -85,70 +94,133 @@ bool is_layer_scale_factor_active(layer const& lyr, double scale_denom)
     return !((min && scale_denom < *min) || (max && scale_denom > *max));
 }
 
-image_rgba8 render_layer(Map map,
-                         layer const& lay,
-                         projection proj,
-                         double scale_denom,
-                         double scale_factor,
-                         std::size_t width,
-                         std::size_t height,
-                         std::size_t index)
+bool has_own_scale_factor(layer const& lay, double scale_denom, double scale_factor)
 {
     boost::optional<value_double> lay_scale_factor = layer_scale_factor(lay);
-    if (lay_scale_factor &&
+    return lay_scale_factor &&
         std::abs(*lay_scale_factor - scale_factor) > 0.1 &&
-        is_layer_scale_factor_active(lay, scale_denom))
-    {
-        double scale_factor_ratio = *lay_scale_factor / scale_factor;
-        width = std::round(scale_factor_ratio * width);
-        height = std::round(scale_factor_ratio * height);
-        scale_factor = *lay_scale_factor;
-        map.resize(width, height);
-    }
+        is_layer_scale_factor_active(lay, scale_denom);
+}
 
-    image_rgba8 img(width, height);
-    mapnik::agg_renderer<image_rgba8> ren(map, img, scale_factor);
+bool is_label_ordering_enabled(Map const& map)
+{
+    parameters const & params = map.get_extra_parameters();
+    boost::optional<value_bool> labels = params.get<value_bool>("parallel-labels");
+    return labels && *labels;
+}
 
-    if (index == 0)
+using detector_ptr = renderer_common::detector_ptr;
+
+// Renders one layer into its own image, optionally in two steps:
+// prepare() queries datasources, render() does the actual rendering.
+struct layer_renderer : util::noncopyable
+{
+    layer_renderer(Map const& map,
+                   layer const& lay,
+                   projection const& proj,
+                   double scale_factor,
+                   std::size_t width,
+                   std::size_t height,
+                   std::size_t index,
+                   detector_ptr detector = detector_ptr())
+        : map_(map),
+          lay_(lay),
+          proj_(proj),
+          width_(width),
+          height_(height),
+          img_(image_pool_rgba8::acquire(width, height)),
+          ren_(detector ?
+               new agg_renderer<image_rgba8>(map, img_, detector, scale_factor) :
+               new agg_renderer<image_rgba8>(map, img_, scale_factor))
     {
-        ren.start_map_processing(map);
+        if (index == 0)
+        {
+            ren_->start_map_processing(map);
+        }
+        else
+        {
+            mapnik::set_premultiplied_alpha(img_, true);
+        }
+
+        lay_.reset_comp_op();
+        lay_.set_opacity(1.0);
     }
-    else
+
+    void prepare(double scale_denom, bool buffer_features)
     {
-        mapnik::set_premultiplied_alpha(img, true);
+        std::set<std::string> names;
+        prepared_ = ren_->prepare_to_layer(lay_,
+                                           *ren_,
+                                           proj_,
+                                           map_.scale(),
+                                           scale_denom,
+                                           width_,
+                                           height_,
+                                           map_.get_current_extent(),
+                                           map_.buffer_size(),
+                                           names,
+                                           buffer_features);
     }
 
-    layer lay_copy(lay);
-    lay_copy.reset_comp_op();
-    lay_copy.set_opacity(1.0);
+    image_rgba8 render()
+    {
+        ren_->render_prepared_layer(*prepared_, *ren_);
+        prepared_.reset();
+        ren_.reset();
+        return std::move(img_);
+    }
 
-    std::set<std::string> names;
-    ren.apply_to_layer(lay_copy,
-                       ren,
-                       proj,
-                       map.scale(),
-                       scale_denom,
-                       width,
-                       height,
-                       map.get_current_extent(),
-                       map.buffer_size(),
-                       names);
+    Map const& map_;
+    layer lay_;
+    projection proj_;
+    std::size_t width_;
+    std::size_t height_;
+    image_rgba8 img_;
+    std::unique_ptr<agg_renderer<image_rgba8>> ren_;
+    prepared_layer_ptr prepared_;
+};
 
-    return img;
+image_rgba8 render_layer(Map const& map,
+                         layer const& lay,
+                         projection const& proj,
+                         double scale_denom,
+                         double scale_factor,
+                         std::size_t width,
+                         std::size_t height,
+                         std::size_t index)
+{
+    layer_renderer renderer(map, lay, proj, scale_factor, width, height, index);
+    renderer.prepare(scale_denom, false);
+    return renderer.render();
 }
 
-struct layer_job
+// All jobs of one render share the caller's map, it is not modified
+// and outlives the jobs. A private copy is made only for layers
+// rendered with their own scale factor, because the map is resized.
+image_rgba8 render_layer_job(Map const& map,
+                             layer const& lay,
+                             projection proj,
+                             double scale_denom,
+                             double scale_factor,
+                             std::size_t width,
+                             std::size_t height,
+                             std::size_t index)
 {
-    using future_type = std::future<image_rgba8>;
-
-    layer_job(future_type && future, layer const& lay)
-        : future(std::move(future)), lay(lay)
+    if (has_own_scale_factor(lay, scale_denom, scale_factor))
     {
+        double lay_scale_factor = *layer_scale_factor(lay);
+        double scale_factor_ratio = lay_scale_factor / scale_factor;
+        width = std::round(scale_factor_ratio * width);
+        height = std::round(scale_factor_ratio * height);
+        Map scaled_map(map);
+        scaled_map.resize(width, height);
+        return render_layer(scaled_map, lay, proj, scale_denom,
+                            lay_scale_factor, width, height, index);
     }
 
-    future_type future;
-    layer const& lay;
-};
+    return render_layer(map, lay, proj, scale_denom,
+                        scale_factor, width, height, index);
+}
 
 void scale_if_needed(layer const& lay,
                      image_rgba8 & layer_img,
@@ -158,7 +230,8 @@ void scale_if_needed(layer const& lay,
     if (layer_img.width() != width ||
         layer_img.height() != height)
     {
-        image_rgba8 scaled(width, height, true, true);
+        image_rgba8 scaled(image_pool_rgba8::acquire(width, height));
+        scaled.set_premultiplied(true);
         scaling_method_e scaling_method = layer_scaling_method(lay);
 #ifdef MAPNIK_STATS_RENDER
         log_operation log;
@@ -172,8 +245,348 @@ void scale_if_needed(layer const& lay,
 #endif
             );
         scaled.painted(layer_img.painted());
-        layer_img = std::move(scaled);
+        layer_img.swap(scaled);
+        image_pool_rgba8::release(std::move(scaled));
+    }
+}
+
+bool is_premerge_enabled(Map const& map)
+{
+    parameters const & params = map.get_extra_parameters();
+    boost::optional<value_bool> premerge = params.get<value_bool>("parallel-premerge");
+    return premerge && *premerge;
+}
+
+// Folds layer images into the destination in layer order as soon as
+// all preceding layers are done. Images of finished layers which cannot
+// be folded yet are optionally merged with their finished neighbours
+// when both use src-over, so they do not stay alive one by one.
+// Layer jobs only deliver images, all compositing runs on the thread
+// calling run().
+class layer_compositor : util::noncopyable
+{
+    struct slot
+    {
+        explicit slot(layer const& lay)
+            : comp_op(lay.comp_op() ? *lay.comp_op() : src_over),
+              opacity(lay.get_opacity()),
+              end(0),
+              ready(false)
+        {
+        }
+
+        boost::optional<image_rgba8> img;
+        std::exception_ptr error;
+        composite_mode_e comp_op;
+        float opacity;
+        // Index one past the last layer merged into this slot
+        std::size_t end;
+        bool ready;
+    };
+
+public:
+    explicit layer_compositor(bool premerge)
+        : premerge_(premerge)
+    {
+    }
+
+    std::size_t add(layer const& lay)
+    {
+        slots_.emplace_back(lay);
+        slots_.back().end = slots_.size();
+        return slots_.size() - 1;
+    }
+
+    void finished(std::size_t index, image_rgba8 && img)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slots_[index].img = std::move(img);
+            slots_[index].ready = true;
+        }
+        ready_cv_.notify_one();
+    }
+
+    void failed(std::size_t index, std::exception_ptr error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slots_[index].error = error;
+            slots_[index].ready = true;
+        }
+        ready_cv_.notify_one();
+    }
+
+    // When called from a worker of the pool, queued jobs are executed
+    // while waiting, the layers may be queued behind the caller.
+    void run(image_rgba8 & dst, util::thread_pool & pool)
+    {
+        const bool worker = pool.is_worker();
+        std::size_t next = 0;
+        while (next < slots_.size())
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (worker)
+            {
+                while (!has_work(next))
+                {
+                    lock.unlock();
+                    if (!pool.run_pending_task())
+                    {
+                        lock.lock();
+                        ready_cv_.wait_for(lock, std::chrono::microseconds(100));
+                        continue;
+                    }
+                    lock.lock();
+                }
+            }
+            else
+            {
+                ready_cv_.wait(lock, [&] { return has_work(next); });
+            }
+
+            slot & first = slots_[next];
+            if (first.ready)
+            {
+                if (first.error)
+                {
+                    std::rethrow_exception(first.error);
+                }
+                image_rgba8 layer_img(std::move(*first.img));
+                first.img = boost::none;
+                composite_mode_e comp_op = first.comp_op;
+                float opacity = first.opacity;
+                next = first.end;
+                lock.unlock();
+                fold(dst, layer_img, comp_op, opacity);
+                image_pool_rgba8::release(std::move(layer_img));
+                continue;
+            }
+
+            std::size_t lower = find_mergeable(next);
+            slot & low = slots_[lower];
+            slot & high = slots_[low.end];
+            if (high.error)
+            {
+                std::rethrow_exception(high.error);
+            }
+            image_rgba8 low_img(std::move(*low.img));
+            image_rgba8 high_img(std::move(*high.img));
+            low.img = boost::none;
+            high.img = boost::none;
+            low.ready = false;
+            float opacity = high.opacity;
+            lock.unlock();
+
+            fold(low_img, high_img, src_over, opacity);
+            image_pool_rgba8::release(std::move(high_img));
+
+            lock.lock();
+            low.img = std::move(low_img);
+            low.end = high.end;
+            low.ready = true;
+        }
+    }
+
+private:
+    bool mergeable(slot const& low, slot const& high) const
+    {
+        return low.ready && high.ready && !low.error &&
+            low.comp_op == src_over && low.opacity >= 1.0 &&
+            high.comp_op == src_over;
+    }
+
+    // Returns index of a slot which can absorb the following one,
+    // or slots_.size() if there is none.
+    std::size_t find_mergeable(std::size_t next) const
+    {
+        if (!premerge_)
+        {
+            return slots_.size();
+        }
+        for (std::size_t i = next; i < slots_.size(); i = slots_[i].end)
+        {
+            std::size_t j = slots_[i].end;
+            if (j < slots_.size() && mergeable(slots_[i], slots_[j]))
+            {
+                return i;
+            }
+        }
+        return slots_.size();
+    }
+
+    bool has_work(std::size_t next) const
+    {
+        return slots_[next].ready || find_mergeable(next) < slots_.size();
+    }
+
+    static void fold(image_rgba8 & dst,
+                     image_rgba8 const& src,
+                     composite_mode_e comp_op,
+                     float opacity)
+    {
+#ifdef MAPNIK_STATS_RENDER
+        log_operation log;
+#endif
+        composite(dst, src, comp_op, opacity, 0, 0
+#ifdef MAPNIK_STATS_RENDER
+                  , &log.log_stream
+#endif
+                 );
+        dst.painted(dst.painted() || src.painted());
+    }
+
+    const bool premerge_;
+    std::vector<slot> slots_;
+    std::mutex mutex_;
+    std::condition_variable ready_cv_;
+};
+
+void layer_job(layer_compositor & compositor,
+               Map const& map,
+               layer const& lay,
+               projection proj,
+               double scale_denom,
+               double scale_factor,
+               std::size_t width,
+               std::size_t height,
+               std::size_t index)
+{
+    try
+    {
+        image_rgba8 layer_img(render_layer_job(map, lay, proj, scale_denom,
+                                               scale_factor, width, height, index));
+        scale_if_needed(lay, layer_img, width, height);
+        compositor.finished(index, std::move(layer_img));
+    }
+    catch (...)
+    {
+        compositor.failed(index, std::current_exception());
+    }
+}
+
+// Layers using the collision detector share one detector and are
+// rendered one by one in layer order, so label placement is the same
+// as in sequential rendering. Their datasources are queried and
+// features read in parallel, a prepared layer is rendered by the thread
+// which finishes the preceding one in order.
+class label_sequencer : util::noncopyable
+{
+    struct entry
+    {
+        explicit entry(std::size_t index)
+            : index(index),
+              ready(false)
+        {
+        }
+
+        std::size_t index;
+        std::unique_ptr<layer_renderer> renderer;
+        std::exception_ptr error;
+        bool ready;
+    };
+
+public:
+    label_sequencer(layer_compositor & compositor, Map const& map)
+        : compositor_(compositor),
+          detector_(std::make_shared<renderer_common::detector_type>(
+              box2d<double>(-map.buffer_size(), -map.buffer_size(),
+                            map.width() + map.buffer_size(),
+                            map.height() + map.buffer_size()))),
+          turn_(0)
+    {
+    }
+
+    // Must not be called once jobs are submitted, prepared() keeps
+    // references to the entries
+    std::size_t add(std::size_t index)
+    {
+        entries_.emplace_back(index);
+        return entries_.size() - 1;
+    }
+
+    detector_ptr const& detector() const
+    {
+        return detector_;
+    }
+
+    void prepared(std::size_t label_index,
+                  std::unique_ptr<layer_renderer> && renderer,
+                  std::exception_ptr error)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        entry & prepared_entry = entries_[label_index];
+        prepared_entry.renderer = std::move(renderer);
+        prepared_entry.error = error;
+        prepared_entry.ready = true;
+
+        if (turn_ != label_index)
+        {
+            // Thread finishing the preceding layer continues with this one
+            return;
+        }
+
+        while (turn_ < entries_.size() && entries_[turn_].ready)
+        {
+            entry & current = entries_[turn_];
+            lock.unlock();
+            render(current);
+            lock.lock();
+            ++turn_;
+        }
+    }
+
+private:
+    void render(entry & e)
+    {
+        if (e.error)
+        {
+            compositor_.failed(e.index, e.error);
+            return;
+        }
+        try
+        {
+            compositor_.finished(e.index, e.renderer->render());
+        }
+        catch (...)
+        {
+            compositor_.failed(e.index, std::current_exception());
+        }
+        e.renderer.reset();
+    }
+
+    layer_compositor & compositor_;
+    detector_ptr detector_;
+    std::vector<entry> entries_;
+    std::size_t turn_;
+    std::mutex mutex_;
+};
+
+void label_layer_job(label_sequencer & sequencer,
+                     std::size_t label_index,
+                     Map const& map,
+                     layer const& lay,
+                     projection proj,
+                     double scale_denom,
+                     double scale_factor,
+                     std::size_t width,
+                     std::size_t height,
+                     std::size_t index)
+{
+    std::unique_ptr<layer_renderer> renderer;
+    std::exception_ptr error;
+    try
+    {
+        renderer.reset(new layer_renderer(map, lay, proj, scale_factor,
+                                          width, height, index,
+                                          sequencer.detector()));
+        renderer->prepare(scale_denom, true);
     }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    sequencer.prepared(label_index, std::move(renderer), error);
 }
 
 MAPNIK_DECL void render(Map const& map,
@@ -183,9 +596,6 @@ MAPNIK_DECL void render(Map const& map,
 {
     mapnik::set_premultiplied_alpha(img, true);
 
-    std::vector<layer_job> layer_jobs;
-    layer_jobs.reserve(map.layers().size());
-
     projection proj(map.srs(), true);
     if (scale_denom <= 0.0)
     {
@@ -193,43 +603,90 @@ MAPNIK_DECL void render(Map const& map,
     }
     scale_denom *= scale_factor;
 
-    std::size_t index = 0;
+    layer_compositor compositor(is_premerge_enabled(map));
+    label_sequencer sequencer(compositor, map);
+    const bool order_labels = is_label_ordering_enabled(map);
+    std::vector<layer const*> visible_layers;
+    // Index of the layer in the sequencer, or -1 for other layers
+    std::vector<int> label_layers;
 
+    // All layers are registered before the first job is submitted,
+    // running jobs access the entries concurrently
     for (auto const& lay : map.layers())
     {
-        if (!lay.visible(scale_denom))
+        if (lay.visible(scale_denom))
         {
-            continue;
+            std::size_t index = compositor.add(lay);
+            visible_layers.push_back(&lay);
+            // Layers rendered in other scale factor cannot share the detector
+            if (order_labels &&
+                !has_own_scale_factor(lay, scale_denom, scale_factor) &&
+                uses_collision_detector(map, lay))
+            {
+                label_layers.push_back(static_cast<int>(sequencer.add(index)));
+            }
+            else
+            {
+                label_layers.push_back(-1);
+            }
         }
+    }
 
-        layer_jobs.emplace_back(std::async(std::launch::async,
-                                           render_layer,
-                                           map,
-                                           std::cref(lay),
-                                           proj,
-                                           scale_denom,
-                                           scale_factor,
-                                           img.width(),
-                                           img.height(),
-                                           index), lay);
-        ++index;
+    util::thread_pool & pool = util::global_thread_pool::instance();
+    std::vector<std::future<void>> layer_jobs;
+    layer_jobs.reserve(visible_layers.size());
+
+    for (std::size_t index = 0; index < visible_layers.size(); ++index)
+    {
+        if (label_layers[index] >= 0)
+        {
+            layer_jobs.emplace_back(pool.submit(label_layer_job,
+                                                std::ref(sequencer),
+                                                static_cast<std::size_t>(label_layers[index]),
+                                                std::cref(map),
+                                                std::cref(*visible_layers[index]),
+                                                proj,
+                                                scale_denom,
+                                                scale_factor,
+                                                img.width(),
+                                                img.height(),
+                                                index));
+        }
+        else
+        {
+            layer_jobs.emplace_back(pool.submit(layer_job,
+                                                std::ref(compositor),
+                                                std::cref(map),
+                                                std::cref(*visible_layers[index]),
+                                                proj,
+                                                scale_denom,
+                                                scale_factor,
+                                                img.width(),
+                                                img.height(),
+                                                index));
+        }
     }
 
-    for (auto & lj : layer_jobs)
+    std::exception_ptr error;
+    try
     {
-        layer const& lay = lj.lay;
-        image_rgba8 layer_img(std::move(lj.future.get()));
-        scale_if_needed(lay, layer_img, img.width(), img.height());
-        composite_mode_e comp_op = lay.comp_op() ? *lay.comp_op() : src_over;
-#ifdef MAPNIK_STATS_RENDER
-        log_operation log;
-#endif
-        composite(img, layer_img, comp_op, lay.get_opacity(), 0, 0
-#ifdef MAPNIK_STATS_RENDER
-                  , &log.log_stream
-#endif
-                 );
-        img.painted(img.painted() || layer_img.painted());
+        compositor.run(img, pool);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    // Jobs reference the map, the compositor and the sequencer,
+    // do not leave before they finish
+    for (auto & job : layer_jobs)
+    {
+        pool.wait(job);
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
     }
 
     mapnik::demultiply_alpha(img);
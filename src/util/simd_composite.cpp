@@ -0,0 +1,395 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/util/simd_composite.hpp>
+
+// stl
+#include <algorithm>
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MAPNIK_SIMD_COMPOSITE
+#include <immintrin.h>
+#endif
+
+namespace mapnik { namespace util {
+
+namespace {
+
+// Scalar versions of the AGG blenders, used for the pixels
+// left over by the vector loops.
+
+inline void scale_cover(unsigned & sr, unsigned & sg, unsigned & sb, unsigned & sa, unsigned cover)
+{
+    if (cover < 255)
+    {
+        sr = (sr * cover + 255) >> 8;
+        sg = (sg * cover + 255) >> 8;
+        sb = (sb * cover + 255) >> 8;
+        sa = (sa * cover + 255) >> 8;
+    }
+}
+
+struct src_over_op
+{
+    static void blend_pix(std::uint8_t * p, unsigned sr, unsigned sg, unsigned sb, unsigned sa, unsigned cover)
+    {
+        scale_cover(sr, sg, sb, sa, cover);
+        unsigned s1a = 255 - sa;
+        p[0] = static_cast<std::uint8_t>(sr + ((p[0] * s1a + 255) >> 8));
+        p[1] = static_cast<std::uint8_t>(sg + ((p[1] * s1a + 255) >> 8));
+        p[2] = static_cast<std::uint8_t>(sb + ((p[2] * s1a + 255) >> 8));
+        p[3] = static_cast<std::uint8_t>(sa + ((p[3] * s1a + 255) >> 8));
+    }
+};
+
+struct dst_out_op
+{
+    static void blend_pix(std::uint8_t * p, unsigned sr, unsigned sg, unsigned sb, unsigned sa, unsigned cover)
+    {
+        scale_cover(sr, sg, sb, sa, cover);
+        sa = 255 - sa;
+        // rounding term is 8 rather than 255 in AGG
+        p[0] = static_cast<std::uint8_t>((p[0] * sa + 8) >> 8);
+        p[1] = static_cast<std::uint8_t>((p[1] * sa + 8) >> 8);
+        p[2] = static_cast<std::uint8_t>((p[2] * sa + 8) >> 8);
+        p[3] = static_cast<std::uint8_t>((p[3] * sa + 8) >> 8);
+    }
+};
+
+struct multiply_op
+{
+    static void blend_pix(std::uint8_t * p, unsigned sr, unsigned sg, unsigned sb, unsigned sa, unsigned cover)
+    {
+        scale_cover(sr, sg, sb, sa, cover);
+        if (sa)
+        {
+            unsigned s1a = 255 - sa;
+            unsigned d1a = 255 - p[3];
+            unsigned dr = p[0];
+            unsigned dg = p[1];
+            unsigned db = p[2];
+            p[0] = static_cast<std::uint8_t>((sr * dr + sr * d1a + dr * s1a + 255) >> 8);
+            p[1] = static_cast<std::uint8_t>((sg * dg + sg * d1a + dg * s1a + 255) >> 8);
+            p[2] = static_cast<std::uint8_t>((sb * db + sb * d1a + db * s1a + 255) >> 8);
+            p[3] = static_cast<std::uint8_t>(sa + p[3] - ((sa * p[3] + 255) >> 8));
+        }
+    }
+};
+
+struct screen_op
+{
+    static void blend_pix(std::uint8_t * p, unsigned sr, unsigned sg, unsigned sb, unsigned sa, unsigned cover)
+    {
+        scale_cover(sr, sg, sb, sa, cover);
+        if (sa)
+        {
+            unsigned dr = p[0];
+            unsigned dg = p[1];
+            unsigned db = p[2];
+            unsigned da = p[3];
+            p[0] = static_cast<std::uint8_t>(sr + dr - ((sr * dr + 255) >> 8));
+            p[1] = static_cast<std::uint8_t>(sg + dg - ((sg * dg + 255) >> 8));
+            p[2] = static_cast<std::uint8_t>(sb + db - ((sb * db + 255) >> 8));
+            p[3] = static_cast<std::uint8_t>(sa + da - ((sa * da + 255) >> 8));
+        }
+    }
+};
+
+template <typename Op>
+void blend_scalar(std::uint8_t * dst, std::uint8_t const* src, std::size_t length, unsigned cover)
+{
+    for (std::size_t i = 0; i < length; ++i, dst += 4, src += 4)
+    {
+        Op::blend_pix(dst, src[0], src[1], src[2], src[3], cover);
+    }
+}
+
+#if defined(MAPNIK_SIMD_COMPOSITE)
+
+// Vector kernels widen channels to 16 bit lanes, every 128 bit lane
+// holds two pixels. Results are masked to 8 bits to match the
+// truncating casts of AGG on non-premultiplied input.
+
+#define MAPNIK_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define MAPNIK_TARGET_AVX2 __attribute__((target("avx2")))
+
+MAPNIK_TARGET_SSE41
+inline __m128i sse41_alpha(__m128i v)
+{
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15));
+}
+
+MAPNIK_TARGET_SSE41
+inline __m128i sse41_mul_255(__m128i a, __m128i b)
+{
+    // (a * b + 255) >> 8
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(255)), 8);
+}
+
+MAPNIK_TARGET_SSE41
+inline __m128i sse41_src_over(__m128i s, __m128i d, __m128i cover, bool scale)
+{
+    if (scale) s = sse41_mul_255(s, cover);
+    __m128i s1a = _mm_sub_epi16(_mm_set1_epi16(255), sse41_alpha(s));
+    return _mm_and_si128(_mm_add_epi16(s, sse41_mul_255(d, s1a)), _mm_set1_epi16(255));
+}
+
+MAPNIK_TARGET_SSE41
+inline __m128i sse41_dst_out(__m128i s, __m128i d, __m128i cover, bool scale)
+{
+    if (scale) s = sse41_mul_255(s, cover);
+    __m128i s1a = _mm_sub_epi16(_mm_set1_epi16(255), sse41_alpha(s));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(d, s1a), _mm_set1_epi16(8)), 8);
+}
+
+MAPNIK_TARGET_SSE41
+inline __m128i sse41_screen(__m128i s, __m128i d, __m128i cover, bool scale)
+{
+    if (scale) s = sse41_mul_255(s, cover);
+    __m128i r = _mm_sub_epi16(_mm_add_epi16(s, d), sse41_mul_255(s, d));
+    r = _mm_and_si128(r, _mm_set1_epi16(255));
+    __m128i keep = _mm_cmpeq_epi16(sse41_alpha(s), _mm_setzero_si128());
+    return _mm_blendv_epi8(r, d, keep);
+}
+
+MAPNIK_TARGET_SSE41
+inline __m128i sse41_multiply(__m128i s, __m128i d, __m128i cover, bool scale)
+{
+    if (scale) s = sse41_mul_255(s, cover);
+    __m128i c255 = _mm_set1_epi16(255);
+    __m128i sa = sse41_alpha(s);
+    __m128i s1a = _mm_sub_epi16(c255, sa);
+    __m128i d1a = _mm_sub_epi16(c255, sse41_alpha(d));
+    // Sca.Dca + Sca.(1 - Da) + Dca.(1 - Sa) exceeds 16 bits, evaluated
+    // as Sca.(Dca + 1 - Da) + Dca.(1 - Sa) with 32 bit multiply-add
+    __m128i a = _mm_add_epi16(d, d1a);
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(s, d), _mm_unpacklo_epi16(a, s1a));
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(s, d), _mm_unpackhi_epi16(a, s1a));
+    __m128i c255_32 = _mm_set1_epi32(255);
+    lo = _mm_srli_epi32(_mm_add_epi32(lo, c255_32), 8);
+    hi = _mm_srli_epi32(_mm_add_epi32(hi, c255_32), 8);
+    __m128i color = _mm_packs_epi32(lo, hi);
+    __m128i alpha = _mm_sub_epi16(_mm_add_epi16(s, d), sse41_mul_255(s, d));
+    __m128i r = _mm_and_si128(_mm_blend_epi16(color, alpha, 0x88), c255);
+    __m128i keep = _mm_cmpeq_epi16(sa, _mm_setzero_si128());
+    return _mm_blendv_epi8(r, d, keep);
+}
+
+template <typename Op, typename Scalar>
+MAPNIK_TARGET_SSE41
+void blend_sse41(std::uint8_t * dst, std::uint8_t const* src, std::size_t length, unsigned cover)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i c = _mm_set1_epi16(static_cast<short>(cover));
+    bool scale = cover < 255;
+    std::size_t i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 4));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(dst + i * 4));
+        __m128i lo = Op::apply(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), c, scale);
+        __m128i hi = Op::apply(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), c, scale);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    blend_scalar<Scalar>(dst + i * 4, src + i * 4, length - i, cover);
+}
+
+MAPNIK_TARGET_AVX2
+inline __m256i avx2_alpha(__m256i v)
+{
+    return _mm256_shuffle_epi8(v, _mm256_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15,
+                                                   6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15));
+}
+
+MAPNIK_TARGET_AVX2
+inline __m256i avx2_mul_255(__m256i a, __m256i b)
+{
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(255)), 8);
+}
+
+MAPNIK_TARGET_AVX2
+inline __m256i avx2_src_over(__m256i s, __m256i d, __m256i cover, bool scale)
+{
+    if (scale) s = avx2_mul_255(s, cover);
+    __m256i s1a = _mm256_sub_epi16(_mm256_set1_epi16(255), avx2_alpha(s));
+    return _mm256_and_si256(_mm256_add_epi16(s, avx2_mul_255(d, s1a)), _mm256_set1_epi16(255));
+}
+
+MAPNIK_TARGET_AVX2
+inline __m256i avx2_dst_out(__m256i s, __m256i d, __m256i cover, bool scale)
+{
+    if (scale) s = avx2_mul_255(s, cover);
+    __m256i s1a = _mm256_sub_epi16(_mm256_set1_epi16(255), avx2_alpha(s));
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(d, s1a), _mm256_set1_epi16(8)), 8);
+}
+
+MAPNIK_TARGET_AVX2
+inline __m256i avx2_screen(__m256i s, __m256i d, __m256i cover, bool scale)
+{
+    if (scale) s = avx2_mul_255(s, cover);
+    __m256i r = _mm256_sub_epi16(_mm256_add_epi16(s, d), avx2_mul_255(s, d));
+    r = _mm256_and_si256(r, _mm256_set1_epi16(255));
+    __m256i keep = _mm256_cmpeq_epi16(avx2_alpha(s), _mm256_setzero_si256());
+    return _mm256_blendv_epi8(r, d, keep);
+}
+
+MAPNIK_TARGET_AVX2
+inline __m256i avx2_multiply(__m256i s, __m256i d, __m256i cover, bool scale)
+{
+    if (scale) s = avx2_mul_255(s, cover);
+    __m256i c255 = _mm256_set1_epi16(255);
+    __m256i sa = avx2_alpha(s);
+    __m256i s1a = _mm256_sub_epi16(c255, sa);
+    __m256i d1a = _mm256_sub_epi16(c255, avx2_alpha(d));
+    __m256i a = _mm256_add_epi16(d, d1a);
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(s, d), _mm256_unpacklo_epi16(a, s1a));
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(s, d), _mm256_unpackhi_epi16(a, s1a));
+    __m256i c255_32 = _mm256_set1_epi32(255);
+    lo = _mm256_srli_epi32(_mm256_add_epi32(lo, c255_32), 8);
+    hi = _mm256_srli_epi32(_mm256_add_epi32(hi, c255_32), 8);
+    __m256i color = _mm256_packs_epi32(lo, hi);
+    __m256i alpha = _mm256_sub_epi16(_mm256_add_epi16(s, d), avx2_mul_255(s, d));
+    __m256i r = _mm256_and_si256(_mm256_blend_epi16(color, alpha, 0x88), c255);
+    __m256i keep = _mm256_cmpeq_epi16(sa, _mm256_setzero_si256());
+    return _mm256_blendv_epi8(r, d, keep);
+}
+
+template <typename Op, typename Scalar>
+MAPNIK_TARGET_AVX2
+void blend_avx2(std::uint8_t * dst, std::uint8_t const* src, std::size_t length, unsigned cover)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i c = _mm256_set1_epi16(static_cast<short>(cover));
+    bool scale = cover < 255;
+    std::size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i * 4));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(dst + i * 4));
+        // unpack and pack work within 128 bit lanes, pixel order is preserved
+        __m256i lo = Op::apply(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero), c, scale);
+        __m256i hi = Op::apply(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero), c, scale);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_packus_epi16(lo, hi));
+    }
+    blend_sse41<typename Op::half, Scalar>(dst + i * 4, src + i * 4, length - i, cover);
+}
+
+#define MAPNIK_SIMD_OP(name)                                                   \
+    struct sse41_##name##_op                                                   \
+    {                                                                          \
+        MAPNIK_TARGET_SSE41                                                    \
+        static __m128i apply(__m128i s, __m128i d, __m128i c, bool scale)      \
+        {                                                                      \
+            return sse41_##name(s, d, c, scale);                               \
+        }                                                                      \
+    };                                                                         \
+    struct avx2_##name##_op                                                    \
+    {                                                                          \
+        using half = sse41_##name##_op;                                        \
+        MAPNIK_TARGET_AVX2                                                     \
+        static __m256i apply(__m256i s, __m256i d, __m256i c, bool scale)      \
+        {                                                                      \
+            return avx2_##name(s, d, c, scale);                                \
+        }                                                                      \
+    };
+
+MAPNIK_SIMD_OP(src_over)
+MAPNIK_SIMD_OP(dst_out)
+MAPNIK_SIMD_OP(multiply)
+MAPNIK_SIMD_OP(screen)
+
+#undef MAPNIK_SIMD_OP
+
+simd_level detect_simd_level()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return simd_level::avx2;
+    if (__builtin_cpu_supports("sse4.1")) return simd_level::sse41;
+    return simd_level::none;
+}
+
+#else
+
+simd_level detect_simd_level()
+{
+    return simd_level::none;
+}
+
+#endif
+
+std::atomic<simd_level> & current_level()
+{
+    static std::atomic<simd_level> level(cpu_simd_level());
+    return level;
+}
+
+} // anonymous ns
+
+simd_level cpu_simd_level()
+{
+    static const simd_level level = detect_simd_level();
+    return level;
+}
+
+simd_level composite_simd_level()
+{
+    return current_level().load(std::memory_order_relaxed);
+}
+
+void set_composite_simd_level(simd_level level)
+{
+    current_level() = std::min(level, cpu_simd_level());
+}
+
+composite_kernel simd_composite_kernel(composite_mode_e mode, simd_level level)
+{
+#if defined(MAPNIK_SIMD_COMPOSITE)
+    if (level > cpu_simd_level()) return nullptr;
+    if (level == simd_level::avx2)
+    {
+        switch (mode)
+        {
+        case src_over: return &blend_avx2<avx2_src_over_op, src_over_op>;
+        case dst_out: return &blend_avx2<avx2_dst_out_op, dst_out_op>;
+        case multiply: return &blend_avx2<avx2_multiply_op, multiply_op>;
+        case screen: return &blend_avx2<avx2_screen_op, screen_op>;
+        default: return nullptr;
+        }
+    }
+    if (level == simd_level::sse41)
+    {
+        switch (mode)
+        {
+        case src_over: return &blend_sse41<sse41_src_over_op, src_over_op>;
+        case dst_out: return &blend_sse41<sse41_dst_out_op, dst_out_op>;
+        case multiply: return &blend_sse41<sse41_multiply_op, multiply_op>;
+        case screen: return &blend_sse41<sse41_screen_op, screen_op>;
+        default: return nullptr;
+        }
+    }
+#endif
+    return nullptr;
+}
+
+}}
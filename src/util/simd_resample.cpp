@@ -0,0 +1,181 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/util/simd_resample.hpp>
+
+// stl
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MAPNIK_SIMD_RESAMPLE
+#include <immintrin.h>
+#endif
+
+namespace mapnik { namespace util {
+
+namespace {
+
+#if defined(MAPNIK_SIMD_RESAMPLE)
+
+#define MAPNIK_TARGET_SSE41 __attribute__((target("sse4.1")))
+
+// same as agg::image_subpixel_* and agg::image_filter_*
+constexpr int subpixel_shift = 8;
+constexpr int subpixel_scale = 1 << subpixel_shift;
+constexpr int subpixel_mask = subpixel_scale - 1;
+constexpr int filter_shift = 14;
+constexpr int filter_scale = 1 << filter_shift;
+
+inline int clamp(int v, int size)
+{
+    return v < 0 ? 0 : (v >= size ? size - 1 : v);
+}
+
+inline std::uint8_t const* pixel(rgba8_source const& src, int x, int y)
+{
+    return src.data + clamp(y, src.height) * src.stride + clamp(x, src.width) * 4;
+}
+
+// One pixel in four 32 bit lanes.
+MAPNIK_TARGET_SSE41
+inline __m128i sse41_load(std::uint8_t const* p)
+{
+    std::int32_t v;
+    std::memcpy(&v, p, 4);
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+}
+
+MAPNIK_TARGET_SSE41
+inline void sse41_store(std::uint8_t * dst, __m128i v)
+{
+    v = _mm_packus_epi16(_mm_packus_epi32(v, v), v);
+    std::int32_t out = _mm_cvtsi128_si32(v);
+    std::memcpy(dst, &out, 4);
+}
+
+MAPNIK_TARGET_SSE41
+void bilinear_sse41(std::uint8_t * dst, rgba8_source const& src,
+                    int const* xs, int const* ys, std::size_t length)
+{
+    const __m128i half = _mm_set1_epi32(subpixel_scale * subpixel_scale / 2);
+    for (std::size_t i = 0; i < length; ++i, dst += 4)
+    {
+        int x_hr = xs[i];
+        int y_hr = ys[i];
+        int x_lr = x_hr >> subpixel_shift;
+        int y_lr = y_hr >> subpixel_shift;
+        x_hr &= subpixel_mask;
+        y_hr &= subpixel_mask;
+
+        __m128i fg = half;
+        fg = _mm_add_epi32(fg, _mm_mullo_epi32(sse41_load(pixel(src, x_lr, y_lr)),
+            _mm_set1_epi32((subpixel_scale - x_hr) * (subpixel_scale - y_hr))));
+        fg = _mm_add_epi32(fg, _mm_mullo_epi32(sse41_load(pixel(src, x_lr + 1, y_lr)),
+            _mm_set1_epi32(x_hr * (subpixel_scale - y_hr))));
+        fg = _mm_add_epi32(fg, _mm_mullo_epi32(sse41_load(pixel(src, x_lr, y_lr + 1)),
+            _mm_set1_epi32((subpixel_scale - x_hr) * y_hr)));
+        fg = _mm_add_epi32(fg, _mm_mullo_epi32(sse41_load(pixel(src, x_lr + 1, y_lr + 1)),
+            _mm_set1_epi32(x_hr * y_hr)));
+        sse41_store(dst, _mm_srli_epi32(fg, subpixel_shift * 2));
+    }
+}
+
+MAPNIK_TARGET_SSE41
+void resample_sse41(std::uint8_t * dst, rgba8_source const& src, resample_params const& params,
+                    int const* xs, int const* ys, std::size_t length)
+{
+    const int diameter_scale = params.diameter << subpixel_shift;
+    std::int16_t const* weight_array = params.weight_array;
+    for (std::size_t i = 0; i < length; ++i, dst += 4)
+    {
+        int x = xs[i];
+        int y = ys[i];
+        __m128i fg = _mm_set1_epi32(filter_scale / 2);
+        int total_weight = 0;
+
+        int y_lr = y >> subpixel_shift;
+        int y_hr = ((subpixel_mask - (y & subpixel_mask)) * params.ry_inv) >> subpixel_shift;
+        int x_lr = x >> subpixel_shift;
+        int x_hr_start = ((subpixel_mask - (x & subpixel_mask)) * params.rx_inv) >> subpixel_shift;
+
+        for (int row = y_lr; ; ++row)
+        {
+            std::uint8_t const* row_ptr = src.data + clamp(row, src.height) * src.stride;
+            int weight_y = weight_array[y_hr];
+            int x_hr = x_hr_start;
+            for (int col = x_lr; ; ++col)
+            {
+                int weight = (weight_y * weight_array[x_hr] + filter_scale / 2) >> filter_shift;
+                fg = _mm_add_epi32(fg, _mm_mullo_epi32(sse41_load(row_ptr + clamp(col, src.width) * 4),
+                                                       _mm_set1_epi32(weight)));
+                total_weight += weight;
+                x_hr += params.rx_inv;
+                if (x_hr >= diameter_scale) break;
+            }
+            y_hr += params.ry_inv;
+            if (y_hr >= diameter_scale) break;
+        }
+
+        // integer division truncating toward zero as in AGG
+        alignas(16) std::int32_t c[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(c), fg);
+        for (int k = 0; k < 4; ++k)
+        {
+            c[k] /= total_weight;
+            if (c[k] < 0) c[k] = 0;
+        }
+        if (c[3] > 255) c[3] = 255;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (c[k] > c[3]) c[k] = c[3];
+        }
+        dst[0] = static_cast<std::uint8_t>(c[0]);
+        dst[1] = static_cast<std::uint8_t>(c[1]);
+        dst[2] = static_cast<std::uint8_t>(c[2]);
+        dst[3] = static_cast<std::uint8_t>(c[3]);
+    }
+}
+
+#endif
+
+} // anonymous ns
+
+bilinear_kernel simd_bilinear_kernel(simd_level level)
+{
+#if defined(MAPNIK_SIMD_RESAMPLE)
+    if (level > cpu_simd_level()) return nullptr;
+    if (level >= simd_level::sse41) return &bilinear_sse41;
+#endif
+    return nullptr;
+}
+
+resample_kernel simd_resample_kernel(simd_level level)
+{
+#if defined(MAPNIK_SIMD_RESAMPLE)
+    if (level > cpu_simd_level()) return nullptr;
+    if (level >= simd_level::sse41) return &resample_sse41;
+#endif
+    return nullptr;
+}
+
+}}
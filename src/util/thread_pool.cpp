@@ -0,0 +1,212 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2015 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#include <mapnik/util/thread_pool.hpp>
+
+#include <algorithm>
+
+namespace mapnik { namespace util {
+
+namespace {
+
+struct worker_identity
+{
+    thread_pool const* pool = nullptr;
+    unsigned index = 0;
+};
+
+thread_local worker_identity current_worker;
+
+}
+
+thread_pool::thread_pool(unsigned size)
+    : stop_(false),
+      queued_(0),
+      steals_(0),
+      executed_(0),
+      next_queue_(0)
+{
+    size = std::max(size, 1u);
+    queues_.reserve(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        queues_.emplace_back(new task_queue);
+    }
+    workers_.reserve(size);
+    for (unsigned i = 0; i < size; ++i)
+    {
+        workers_.emplace_back(&thread_pool::worker_loop, this, i);
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeup_mutex_);
+        stop_ = true;
+    }
+    wakeup_.notify_all();
+    for (auto & worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+bool thread_pool::is_worker() const
+{
+    return current_worker.pool == this;
+}
+
+void thread_pool::push(task_type && task)
+{
+    unsigned index = is_worker() ?
+        current_worker.index :
+        next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    {
+        task_queue & queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.emplace_back(std::move(task));
+    }
+    {
+        // Taking the lock orders the increment with a worker going to sleep.
+        std::lock_guard<std::mutex> lock(wakeup_mutex_);
+        ++queued_;
+    }
+    wakeup_.notify_one();
+}
+
+bool thread_pool::pop(unsigned index, task_type & task)
+{
+    {
+        // Own queue is processed LIFO to keep caches warm.
+        task_queue & queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            --queued_;
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < queues_.size(); ++i)
+    {
+        task_queue & queue = *queues_[(index + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            --queued_;
+            ++steals_;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool thread_pool::run_pending_task()
+{
+    unsigned index = is_worker() ? current_worker.index : 0;
+    task_type task;
+    if (!pop(index, task))
+    {
+        return false;
+    }
+    task();
+    ++executed_;
+    return true;
+}
+
+void thread_pool::worker_loop(unsigned index)
+{
+    current_worker.pool = this;
+    current_worker.index = index;
+
+    while (true)
+    {
+        task_type task;
+        if (pop(index, task))
+        {
+            task();
+            ++executed_;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeup_mutex_);
+        wakeup_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_)
+        {
+            return;
+        }
+    }
+}
+
+namespace {
+
+std::atomic<unsigned> & requested_concurrency()
+{
+    static std::atomic<unsigned> size(0);
+    return size;
+}
+
+std::atomic<bool> & global_pool_started()
+{
+    static std::atomic<bool> started(false);
+    return started;
+}
+
+}
+
+global_thread_pool::global_thread_pool()
+    : thread_pool(concurrency())
+{
+    global_pool_started() = true;
+}
+
+bool global_thread_pool::set_concurrency(unsigned size)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    if (global_pool_started())
+    {
+        return false;
+    }
+    requested_concurrency() = size;
+    return true;
+}
+
+unsigned global_thread_pool::concurrency()
+{
+    unsigned size = requested_concurrency();
+    if (size == 0)
+    {
+        size = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return size;
+}
+
+} // namespace util
+
+template class singleton<util::global_thread_pool, CreateStatic>;
+
+} // namespace mapnik
@@ -30,6 +30,9 @@
 #include <mapnik/view_transform.hpp>
 #include <mapnik/raster.hpp>
 #include <mapnik/proj_transform.hpp>
+#include <mapnik/span_image_filter.hpp>
+#include <mapnik/util/parallelize.hpp>
+#include <mapnik/util/simd_resample.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
@@ -48,6 +51,12 @@
 #include "agg_renderer_scanline.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 namespace mapnik {
 
 template <typename T>
@@ -78,6 +87,210 @@ struct pixel_format<image_rgba8>
     using type = agg::pixfmt_custom_blend_rgba<src_blender, agg::rendering_buffer>;
 };
 
+namespace {
+
+// Largest tolerated distance in target pixels between the projected
+// center of a mesh cell and its affine approximation
+constexpr double max_mesh_error = 0.5;
+constexpr unsigned min_mesh_size = 4;
+
+// Mesh vertices projected to target pixels
+struct warp_mesh
+{
+    warp_mesh(std::size_t source_width, std::size_t source_height, unsigned size)
+        : size(size),
+          nx(std::ceil(source_width/double(size) + 1)),
+          ny(std::ceil(source_height/double(size) + 1)),
+          xs(nx, ny, false),
+          ys(nx, ny, false) {}
+
+    // Source pixel rectangle of cell i,j
+    void cell(std::size_t i, std::size_t j, std::size_t source_width, std::size_t source_height,
+              std::size_t & x0, std::size_t & y0, std::size_t & x1, std::size_t & y1) const
+    {
+        x0 = i * size;
+        y0 = j * size;
+        x1 = std::min((i + 1) * size, source_width);
+        y1 = std::min((j + 1) * size, source_height);
+    }
+
+    void polygon(std::size_t i, std::size_t j, double * polygon) const
+    {
+        polygon[0] = xs(i,j);     polygon[1] = ys(i,j);
+        polygon[2] = xs(i+1,j);   polygon[3] = ys(i+1,j);
+        polygon[4] = xs(i+1,j+1); polygon[5] = ys(i+1,j+1);
+        polygon[6] = xs(i,j+1);   polygon[7] = ys(i,j+1);
+    }
+
+    unsigned size;
+    std::size_t nx;
+    std::size_t ny;
+    image_gray64f xs;
+    image_gray64f ys;
+};
+
+warp_mesh project_mesh(std::size_t source_width, std::size_t source_height, unsigned mesh_size,
+                       proj_transform const& prj_trans, view_transform const& ts, view_transform const& tt)
+{
+    warp_mesh mesh(source_width, source_height, mesh_size);
+    for (std::size_t j = 0; j < mesh.ny; ++j)
+    {
+        for (std::size_t i = 0; i < mesh.nx; ++i)
+        {
+            mesh.xs(i,j) = std::min(i*mesh_size,source_width);
+            mesh.ys(i,j) = std::min(j*mesh_size,source_height);
+            ts.backward(&mesh.xs(i,j), &mesh.ys(i,j));
+        }
+    }
+    prj_trans.backward(mesh.xs.data(), mesh.ys.data(), nullptr, mesh.nx*mesh.ny);
+    for (std::size_t j = 0; j < mesh.ny; ++j)
+    {
+        for (std::size_t i = 0; i < mesh.nx; ++i)
+        {
+            tt.forward(&mesh.xs(i,j), &mesh.ys(i,j));
+        }
+    }
+    return mesh;
+}
+
+// Largest distance between exactly projected cell centers and
+// where the affine transform used for rendering puts them
+double mesh_error(warp_mesh const& mesh, std::size_t source_width, std::size_t source_height,
+                  proj_transform const& prj_trans, view_transform const& ts, view_transform const& tt)
+{
+    std::size_t cells_x = mesh.nx - 1;
+    std::size_t cells_y = mesh.ny - 1;
+    std::vector<double> cx(cells_x * cells_y);
+    std::vector<double> cy(cells_x * cells_y);
+    for (std::size_t j = 0; j < cells_y; ++j)
+    {
+        for (std::size_t i = 0; i < cells_x; ++i)
+        {
+            std::size_t x0, y0, x1, y1;
+            mesh.cell(i, j, source_width, source_height, x0, y0, x1, y1);
+            double & x = cx[j * cells_x + i];
+            double & y = cy[j * cells_x + i];
+            x = 0.5 * (x0 + x1);
+            y = 0.5 * (y0 + y1);
+            ts.backward(&x, &y);
+        }
+    }
+    prj_trans.backward(cx.data(), cy.data(), nullptr, cx.size());
+
+    double max_error = 0.0;
+    for (std::size_t j = 0; j < cells_y; ++j)
+    {
+        for (std::size_t i = 0; i < cells_x; ++i)
+        {
+            double x = cx[j * cells_x + i];
+            double y = cy[j * cells_x + i];
+            tt.forward(&x, &y);
+            double polygon[8];
+            mesh.polygon(i, j, polygon);
+            if (!std::isfinite(x) || !std::isfinite(y) ||
+                !std::all_of(polygon, polygon + 8, [](double v) { return std::isfinite(v); }))
+            {
+                continue;
+            }
+            std::size_t x0, y0, x1, y1;
+            mesh.cell(i, j, source_width, source_height, x0, y0, x1, y1);
+            agg::trans_affine tr(polygon, x0, y0, x1, y1);
+            if (!tr.is_valid())
+            {
+                continue;
+            }
+            double ax = 0.5 * (x0 + x1);
+            double ay = 0.5 * (y0 + y1);
+            tr.inverse_transform(&ax, &ay);
+            max_error = std::max(max_error, std::hypot(ax - x, ay - y));
+        }
+    }
+    return max_error;
+}
+
+// Mesh cell ready to be rasterized
+struct warp_quad
+{
+    double polygon[8];
+    agg::trans_affine tr;
+    int min_y;
+    int max_y;
+};
+
+// Same as agg::render_scanlines_bin limited to rows in [y0, y1)
+template <typename Rasterizer, typename Scanline, typename BaseRenderer,
+          typename SpanAllocator, typename SpanGenerator>
+void render_scanlines_band(Rasterizer & ras, Scanline & sl, BaseRenderer & ren,
+                           SpanAllocator & alloc, SpanGenerator & span_gen, int y0, int y1)
+{
+    if (ras.rewind_scanlines())
+    {
+        sl.reset(ras.min_x(), ras.max_x());
+        span_gen.prepare();
+        while (ras.sweep_scanline(sl))
+        {
+            int y = sl.y();
+            if (y >= y1) break;
+            if (y >= y0)
+            {
+                agg::render_scanline_bin(sl, ren, alloc, span_gen);
+            }
+        }
+    }
+}
+
+// Vectorized span generators, only available for rgba8
+template <typename T>
+struct simd_spans
+{
+    explicit simd_spans(T const&) {}
+
+    template <typename Render, typename Accessor, typename Interpolator>
+    bool bilinear(Render, Accessor &, Interpolator &) { return false; }
+
+    template <typename Render, typename Accessor, typename Interpolator>
+    bool resample(Render, Accessor &, Interpolator &, agg::image_filter_lut const&) { return false; }
+};
+
+template <>
+struct simd_spans<image_rgba8>
+{
+    explicit simd_spans(image_rgba8 const& source)
+        : pixels_{source.bytes(),
+                  static_cast<int>(source.width()),
+                  static_cast<int>(source.height()),
+                  static_cast<int>(source.row_size())},
+          bilinear_(util::simd_bilinear_kernel(util::cpu_simd_level())),
+          resample_(util::simd_resample_kernel(util::cpu_simd_level())),
+          coords_() {}
+
+    template <typename Render, typename Accessor, typename Interpolator>
+    bool bilinear(Render render, Accessor & ia, Interpolator & interpolator)
+    {
+        if (!bilinear_) return false;
+        span_image_filter_rgba_bilinear_simd<Accessor, Interpolator> sg(ia, interpolator, pixels_, bilinear_, coords_);
+        render(sg);
+        return true;
+    }
+
+    template <typename Render, typename Accessor, typename Interpolator>
+    bool resample(Render render, Accessor & ia, Interpolator & interpolator, agg::image_filter_lut const& filter)
+    {
+        if (!resample_) return false;
+        span_image_resample_rgba_affine_simd<Accessor> sg(ia, interpolator, filter, pixels_, resample_, coords_);
+        render(sg);
+        return true;
+    }
+
+private:
+    util::rgba8_source pixels_;
+    util::bilinear_kernel bilinear_;
+    util::resample_kernel resample_;
+    span_coordinates coords_;
+};
+
+}
+
 template <typename T>
 MAPNIK_DECL void warp_image (T & target, T const& source, proj_transform const& prj_trans,
                  box2d<double> const& target_ext, box2d<double> const& source_ext,
@@ -99,108 +312,132 @@ MAPNIK_DECL void warp_image (T & target, T const& source, proj_transform const&
     view_transform tt(target.width(), target.height(),
                       target_ext, offset_x, offset_y);
 
-    std::size_t mesh_nx = std::ceil(source.width()/double(mesh_size) + 1);
-    std::size_t mesh_ny = std::ceil(source.height()/double(mesh_size) + 1);
-
-    image_gray64f xs(mesh_nx, mesh_ny, false);
-    image_gray64f ys(mesh_nx, mesh_ny, false);
+    // Precalculate reprojected mesh, refine it while the projection
+    // is not close enough to linear inside of mesh cells
+    warp_mesh mesh = project_mesh(source.width(), source.height(), mesh_size, prj_trans, ts, tt);
+    while (mesh.size / 2 >= min_mesh_size &&
+           mesh_error(mesh, source.width(), source.height(), prj_trans, ts, tt) > max_mesh_error)
+    {
+        mesh = project_mesh(source.width(), source.height(), mesh.size / 2, prj_trans, ts, tt);
+    }
 
-    // Precalculate reprojected mesh
-    for(std::size_t j = 0; j < mesh_ny; ++j)
+    std::vector<warp_quad> quads;
+    quads.reserve((mesh.nx - 1) * (mesh.ny - 1));
+    for (std::size_t j = 0; j < mesh.ny - 1; ++j)
     {
-        for (std::size_t i=0; i<mesh_nx; ++i)
+        for (std::size_t i = 0; i < mesh.nx - 1; ++i)
         {
-            xs(i,j) = std::min(i*mesh_size,source.width());
-            ys(i,j) = std::min(j*mesh_size,source.height());
-            ts.backward(&xs(i,j), &ys(i,j));
+            warp_quad quad;
+            mesh.polygon(i, j, quad.polygon);
+            std::size_t x0, y0, x1, y1;
+            mesh.cell(i, j, source.width(), source.height(), x0, y0, x1, y1);
+            quad.tr = agg::trans_affine(quad.polygon, x0, y0, x1, y1);
+            if (!quad.tr.is_valid())
+            {
+                continue;
+            }
+            double min_y = std::min(std::min(quad.polygon[1], quad.polygon[3]),
+                                    std::min(quad.polygon[5], quad.polygon[7]));
+            double max_y = std::max(std::max(quad.polygon[1], quad.polygon[3]),
+                                    std::max(quad.polygon[5], quad.polygon[7]));
+            // cells with non finite coordinates are kept in every band
+            quad.min_y = min_y > -1e9 ? static_cast<int>(std::floor(min_y)) : std::numeric_limits<int>::min();
+            quad.max_y = max_y < 1e9 ? static_cast<int>(std::floor(max_y)) : std::numeric_limits<int>::max();
+            quads.push_back(quad);
         }
     }
-    prj_trans.backward(xs.data(), ys.data(), nullptr, mesh_nx*mesh_ny);
-
-    agg::rasterizer_scanline_aa<> rasterizer;
-    agg::scanline_bin scanline;
-    agg::rendering_buffer buf(target.bytes(),
-                              target.width(),
-                              target.height(),
-                              target.width() * pixel_size);
-    output_pixfmt_type pixf(buf);
-    renderer_base rb(pixf);
-    rasterizer.clip_box(0, 0, target.width(), target.height());
-    agg::rendering_buffer buf_tile(
-        const_cast<unsigned char*>(source.bytes()),
-        source.width(),
-        source.height(),
-        source.width() * pixel_size);
-
-    pixfmt_pre pixf_tile(buf_tile);
-
-    using img_accessor_type = agg::image_accessor_clone<pixfmt_pre>;
-    img_accessor_type ia(pixf_tile);
-
-    agg::span_allocator<color_type> sa;
-    // Project mesh cells into target interpolating raster inside each one
-    for (std::size_t j = 0; j < mesh_ny - 1; ++j)
+
+    agg::image_filter_lut filter;
+    if (scaling_method != SCALING_NEAR && scaling_method != SCALING_BILINEAR_FAST)
+    {
+        detail::set_scaling_method(filter, scaling_method, filter_factor);
+    }
+
+    // Bands of target rows are rendered independently, every band
+    // sees the cells in the same order as a single pass would
+    auto render_band = [&](unsigned band_begin, unsigned band_end)
     {
-        for (std::size_t i = 0; i < mesh_nx - 1; ++i)
+        int y0 = static_cast<int>(band_begin);
+        int y1 = static_cast<int>(band_end);
+        agg::rasterizer_scanline_aa<> rasterizer;
+        agg::scanline_bin scanline;
+        agg::rendering_buffer buf(target.bytes(),
+                                  target.width(),
+                                  target.height(),
+                                  target.width() * pixel_size);
+        output_pixfmt_type pixf(buf);
+        renderer_base rb(pixf);
+        rasterizer.clip_box(0, 0, target.width(), target.height());
+        agg::rendering_buffer buf_tile(
+            const_cast<unsigned char*>(source.bytes()),
+            source.width(),
+            source.height(),
+            source.width() * pixel_size);
+
+        pixfmt_pre pixf_tile(buf_tile);
+
+        using img_accessor_type = agg::image_accessor_clone<pixfmt_pre>;
+        img_accessor_type ia(pixf_tile);
+
+        agg::span_allocator<color_type> sa;
+        simd_spans<image_type> simd(source);
+        auto render = [&](auto & sg) {
+            render_scanlines_band(rasterizer, scanline, rb, sa, sg, y0, y1);
+        };
+
+        // Project mesh cells into target interpolating raster inside each one
+        for (warp_quad const& quad : quads)
         {
-            double polygon[8] = {xs(i,j), ys(i,j),
-                                 xs(i+1,j), ys(i+1,j),
-                                 xs(i+1,j+1), ys(i+1,j+1),
-                                 xs(i,j+1), ys(i,j+1)};
-            tt.forward(polygon+0, polygon+1);
-            tt.forward(polygon+2, polygon+3);
-            tt.forward(polygon+4, polygon+5);
-            tt.forward(polygon+6, polygon+7);
-
+            if (quad.max_y < y0 || quad.min_y >= y1)
+            {
+                continue;
+            }
+            double const* polygon = quad.polygon;
             rasterizer.reset();
             rasterizer.move_to_d(std::floor(polygon[0]), std::floor(polygon[1]));
             rasterizer.line_to_d(std::floor(polygon[2]), std::floor(polygon[3]));
             rasterizer.line_to_d(std::floor(polygon[4]), std::floor(polygon[5]));
             rasterizer.line_to_d(std::floor(polygon[6]), std::floor(polygon[7]));
 
-            std::size_t x0 = i * mesh_size;
-            std::size_t y0 = j * mesh_size;
-            std::size_t x1 = (i+1) * mesh_size;
-            std::size_t y1 = (j+1) * mesh_size;
-            x1 = std::min(x1, source.width());
-            y1 = std::min(y1, source.height());
-            agg::trans_affine tr(polygon, x0, y0, x1, y1);
-            if (tr.is_valid())
+            interpolator_type interpolator(quad.tr);
+            switch (scaling_method)
             {
-                interpolator_type interpolator(tr);
-                switch (scaling_method)
+                case SCALING_NEAR:
                 {
-                    case SCALING_NEAR:
-                    {
-                        using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter;
-                        span_gen_type sg(ia, interpolator);
-                        agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
-                    }
-                    break;
-                    case SCALING_BILINEAR_FAST:
+                    using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter;
+                    span_gen_type sg(ia, interpolator);
+                    render(sg);
+                }
+                break;
+                case SCALING_BILINEAR_FAST:
+                {
+                    if (!simd.bilinear(render, ia, interpolator))
                     {
                         using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter_bilinear;
                         span_gen_type sg(ia, interpolator);
-                        agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
+                        render(sg);
                     }
-                    break;
-                    default:
+                }
+                break;
+                default:
+                {
+                    if (!simd.resample(render, ia, interpolator, filter))
                     {
                         using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_resample_affine;
-                        agg::image_filter_lut filter;
-                        detail::set_scaling_method(filter, scaling_method, filter_factor);
                         boost::optional<typename span_gen_type::value_type> nodata;
                         if (nodata_value)
                         {
                             nodata = nodata_value;
                         }
                         span_gen_type sg(ia, interpolator, filter, nodata);
-                        agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
+                        render(sg);
                     }
                 }
             }
         }
-    }
+    };
+
+    util::parallelize(render_band, util::jobs_by_image_size(target.width(), target.height()), target.height());
 }
 
 namespace detail {
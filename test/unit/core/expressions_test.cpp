@@ -3,6 +3,7 @@
 #include <mapnik/expression.hpp>
 #include <mapnik/expression_evaluator.hpp>
 #include <mapnik/expression_string.hpp>
+#include <mapnik/filter_program.hpp>
 #include <mapnik/wkt/wkt_factory.hpp>
 #include <mapnik/feature.hpp>
 #include <mapnik/feature_factory.hpp>
@@ -204,3 +205,79 @@ TEST_CASE("expressions")
     // this should evaulate as a combination of an int value and string
     TRY_CHECK(eval("[int]+m") == eval("'123m'"));
 }
+
+TEST_CASE("filter program")
+{
+    using properties_type = std::vector<std::pair<std::string, mapnik::value> > ;
+    mapnik::transcoder tr("utf8");
+
+    std::vector<std::string> filters = {
+        "[foo] = 'bar'",
+        "[int] = 123 and [double] = 1.23456 && [bool] = true and [null] = null && [foo] = 'bar'",
+        "[int] = 456 or [foo].match('b.r') || length([foo]) = 3",
+        "not [foo] = 'bar' and [int] > 100",
+        "[int] > 100 and [int] < 200 and [double] <= 2",
+        "[int] >= 123 or [missing] != null",
+        "[int] * 2 + [double] - 1 % 3",
+        "-[int] / 2",
+        "[foo].replace('a','o') = 'bor'",
+        "pow([int], 2) > 10000",
+        "[mapnik::geometry_type] = point",
+        "@zoom > 10 and [foo] = 'bar'",
+        "@missing",
+        "[foo] = 'bar'",
+        "[int] = 123"
+    };
+    std::vector<mapnik::expression_ptr> exprs;
+    mapnik::filter_program program;
+    std::vector<std::size_t> indices;
+    for (auto const& str : filters)
+    {
+        exprs.push_back(mapnik::parse_expression(str));
+        indices.push_back(program.compile(*exprs.back()));
+    }
+    // identical filters and sub-expressions are compiled once
+    CHECK(indices.front() == indices[13]);
+    CHECK(program.attributes().size() == 6);
+    CHECK(program.variables().size() == 2);
+
+    mapnik::attributes vars = {{"zoom", mapnik::value_integer(12)}};
+    mapnik::filter_evaluator evaluator(program, vars);
+
+    std::vector<properties_type> props = {
+        {{ "foo", tr.transcode("bar") }, { "int", mapnik::value_integer(123)}, { "double", mapnik::value_double(1.23456)},
+         { "bool", mapnik::value_bool(true)}, { "null", mapnik::value_null()}},
+        {{ "int", mapnik::value_integer(456)}, { "foo", tr.transcode("baz") }},
+        {{ "double", mapnik::value_double(0.5)}, { "missing", mapnik::value_integer(1)}}
+    };
+    auto check = [&](mapnik::feature_impl const& feature)
+    {
+        evaluator.set_feature(feature);
+        for (std::size_t i = 0; i < filters.size(); ++i)
+        {
+            INFO(filters[i]);
+            INFO(feature.to_string());
+            auto expected = mapnik::util::apply_visitor(
+                mapnik::evaluate<mapnik::feature_impl, mapnik::value_type, mapnik::attributes>(feature, vars), *exprs[i]);
+            CHECK(evaluator.test(indices[i]) == expected.to_bool());
+            CHECK(evaluator.eval(indices[i]) == expected);
+            CHECK(evaluator.eval(indices[i]).which() == expected.which());
+        }
+    };
+    // features with different contexts
+    for (auto const& prop : props)
+    {
+        check(*make_test_feature(1, "POINT(100 200)", prop));
+    }
+    // features sharing a context which grows while they are evaluated
+    auto ctx = std::make_shared<mapnik::context_type>();
+    for (auto const& prop : props)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        mapnik::geometry::geometry<double> geom;
+        mapnik::from_wkt("LINESTRING(0 0,1 1)", geom);
+        feature->set_geometry(std::move(geom));
+        for (auto const& kv : prop) feature->put_new(kv.first, kv.second);
+        check(*feature);
+    }
+}
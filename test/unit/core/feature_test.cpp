@@ -0,0 +1,63 @@
+#include "catch.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+
+#include <vector>
+
+namespace {
+
+// record is a sequence of fixed size integer fields
+struct counting_decoder : mapnik::attribute_decoder
+{
+    mutable std::vector<int> calls = std::vector<int>(3, 0);
+
+    void decode(char const* record, std::size_t index, mapnik::value & val) const
+    {
+        ++calls[index];
+        if (record[index] != '*')
+        {
+            val = mapnik::value_integer(record[index] - '0');
+        }
+    }
+};
+
+}
+
+TEST_CASE("feature") {
+
+    auto ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("a");
+    ctx->push("b");
+    ctx->push("c");
+    auto decoder = std::make_shared<counting_decoder>();
+    char const* record = "1*3";
+
+SECTION("attributes are decoded once on first access") {
+
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    feature->set_attribute_decoder(decoder, record);
+    CHECK(decoder->calls == std::vector<int>({0, 0, 0}));
+    CHECK(feature->get("c") == mapnik::value_integer(3));
+    CHECK(feature->get("c") == mapnik::value_integer(3));
+    CHECK(decoder->calls == std::vector<int>({0, 0, 1}));
+    CHECK(feature->get("b").is_null());
+    CHECK(feature->get("b").is_null());
+    CHECK(decoder->calls == std::vector<int>({0, 1, 1}));
+    CHECK(feature->get_data().size() == 3);
+    CHECK(feature->get_data()[0] == mapnik::value_integer(1));
+    CHECK(decoder->calls == std::vector<int>({1, 1, 1}));
+}
+
+SECTION("put overrides lazy attributes") {
+
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    feature->set_attribute_decoder(decoder, record);
+    feature->put("a", mapnik::value_integer(7));
+    feature->decode_attributes();
+    CHECK(feature->get("a") == mapnik::value_integer(7));
+    CHECK(feature->get("c") == mapnik::value_integer(3));
+    CHECK(decoder->calls == std::vector<int>({0, 1, 1}));
+}
+
+}
@@ -0,0 +1,99 @@
+#include "catch.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_cache.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/query.hpp>
+
+#include <chrono>
+#include <set>
+#include <thread>
+
+namespace {
+
+std::shared_ptr<mapnik::memory_datasource> grid_datasource()
+{
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    auto ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    mapnik::value_integer id = 1;
+    for (int x = 0; x < 64; ++x)
+    {
+        for (int y = 0; y < 64; ++y)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id++));
+            feature->set_geometry(mapnik::geometry::point<double>(x + 0.5, y + 0.5));
+            ds->push(feature);
+        }
+    }
+    return ds;
+}
+
+std::set<mapnik::value_integer> ids(mapnik::featureset_ptr const& fs)
+{
+    std::set<mapnik::value_integer> result;
+    while (mapnik::feature_ptr feature = fs->next())
+    {
+        result.insert(feature->id());
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("feature_cache") {
+
+    auto ds = grid_datasource();
+    mapnik::layer lay("grid");
+    lay.set_datasource(ds);
+    mapnik::feature_cache & cache = mapnik::feature_cache::instance();
+    mapnik::feature_cache::set_capacity(1 << 24);
+    cache.clear();
+
+SECTION("neighbouring queries share an entry") {
+
+    mapnik::query q1(mapnik::box2d<double>(1, 1, 7, 7));
+    mapnik::query q2(mapnik::box2d<double>(9, 1, 15, 7));
+    auto expected1 = ids(ds->features(q1));
+    auto expected2 = ids(ds->features(q2));
+
+    CHECK(ids(cache.features(lay, *ds, q1, mapnik::processor_context_ptr())) == expected1);
+    CHECK(ids(cache.features(lay, *ds, q2, mapnik::processor_context_ptr())) == expected2);
+    CHECK(ids(cache.features(lay, *ds, q1, mapnik::processor_context_ptr())) == expected1);
+
+    auto stats = cache.stats();
+    CHECK(stats.entries == 1);
+    CHECK(stats.hits >= 2);
+    CHECK(stats.cost > 0);
+}
+
+SECTION("invalidation") {
+
+    mapnik::query q(mapnik::box2d<double>(1, 1, 7, 7));
+    cache.features(lay, *ds, q, mapnik::processor_context_ptr());
+    CHECK(cache.stats().entries == 1);
+    CHECK(cache.invalidate("other") == 0);
+    CHECK(cache.invalidate("grid") == 1);
+    CHECK(cache.stats().entries == 0);
+}
+
+SECTION("expiration") {
+
+    mapnik::feature_cache::set_ttl(std::chrono::milliseconds(1));
+    mapnik::query q(mapnik::box2d<double>(1, 1, 7, 7));
+    auto first = ids(cache.features(lay, *ds, q, mapnik::processor_context_ptr()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ds->clear();
+    CHECK(ids(cache.features(lay, *ds, q, mapnik::processor_context_ptr())).empty());
+    CHECK(!first.empty());
+    CHECK(cache.stats().entries == 1);
+    mapnik::feature_cache::set_ttl(std::chrono::seconds(0));
+}
+
+    mapnik::feature_cache::set_capacity(0);
+}
@@ -502,6 +502,62 @@ TEST_CASE("geojson") {
             }
         }
 
+        SECTION("GeoJSON create_index")
+        {
+            std::string filename("./test/data/json/featurecollection.json");
+
+            // cleanup in the case of a failed previous run
+            if (mapnik::util::exists(filename + ".index"))
+            {
+                mapnik::util::remove(filename + ".index");
+            }
+
+            mapnik::parameters params;
+            params["type"] = "geojson";
+            params["file"] = filename;
+            auto expected_ds = mapnik::datasource_cache::instance().create(params);
+            params["create_index"] = true;
+            params["index_memory_limit"] = mapnik::value_integer(1 << 16);
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            CHECK(mapnik::util::exists(filename + ".index"));
+            CHECK(ds->envelope() == expected_ds->envelope());
+            // the index is written to a temporary file renamed in place
+            for (auto const& path : mapnik::util::list_directory("./test/data/json"))
+            {
+                CHECK(mapnik::util::basename(path).find(".index.") == std::string::npos);
+            }
+
+            auto features = all_features(ds);
+            auto expected_features = all_features(expected_ds);
+            mapnik::value_integer count = 0;
+            while (true)
+            {
+                auto feature = features->next();
+                auto expected = expected_features->next();
+                if (!feature || !expected)
+                {
+                    CHECK(!feature);
+                    CHECK(!expected);
+                    break;
+                }
+                CHECK(feature->envelope() == expected->envelope());
+                CHECK(feature->to_string() == expected->to_string());
+                ++count;
+            }
+            CHECK(count == 3);
+
+            // a single Feature is not indexed
+            mapnik::parameters feature_params(params);
+            feature_params["file"] = "./test/data/json/feature.json";
+            CHECK(bool(mapnik::datasource_cache::instance().create(feature_params)));
+            CHECK(!mapnik::util::exists("./test/data/json/feature.json.index"));
+
+            if (mapnik::util::exists(filename + ".index"))
+            {
+                CHECK(mapnik::util::remove(filename + ".index"));
+            }
+        }
+
         SECTION("GeoJSON extra properties")
         {
             // Create datasource
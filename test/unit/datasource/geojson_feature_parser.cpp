@@ -0,0 +1,203 @@
+#include "catch.hpp"
+#include "../geometry/geometry_equal.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/json/feature_grammar.hpp>
+#include <mapnik/json/feature_parser.hpp>
+#include <mapnik/geometry_envelope.hpp>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool parse_with_grammar(std::string const& json, mapnik::feature_impl & feature)
+{
+    static const mapnik::transcoder tr("utf8");
+    static const mapnik::json::feature_grammar<char const*, mapnik::feature_impl> grammar(tr);
+    boost::spirit::standard::space_type space;
+    char const* start = json.c_str();
+    char const* end = start + json.size();
+    try
+    {
+        return boost::spirit::qi::phrase_parse(start, end, (grammar)(boost::phoenix::ref(feature)), space)
+            && start == end;
+    }
+    catch (std::exception const&)
+    {
+        return false;
+    }
+}
+
+bool parse(std::string const& json, mapnik::feature_impl & feature)
+{
+    static const mapnik::transcoder tr("utf8");
+    char const* start = json.c_str();
+    char const* end = start + json.size();
+    return mapnik::json::parse_feature(start, end, feature, tr) && start == end;
+}
+
+}
+
+TEST_CASE("geojson feature parser") {
+
+SECTION("features match the spirit grammar") {
+
+    std::vector<std::string> features = {
+        R"({"type":"Feature","geometry":{"type":"Point","coordinates":[1.5,-2]},"properties":{"name":"a"}})",
+        R"({ "properties" : { "int" : 12, "neg" : -3, "real" : 1.25, "exp" : 1e3, "t" : true, "f" : false, "n" : null } ,
+             "geometry" : { "coordinates" : [ [0,0], [1, 1, 5], [2,0] ], "type" : "LineString" }, "type" : "Feature", "id" : 7 })",
+        R"({"type":"Feature","geometry":{"type":"Polygon","coordinates":[[[0,0],[0,1],[1,1],[1,0],[0,0]],[[0.2,0.2],[0.8,0.2],[0.8,0.8],[0.2,0.2]]]},"properties":null})",
+        R"({"type":"Feature","geometry":{"type":"MultiPoint","coordinates":[[1,2],[3,4]]},"properties":{}})",
+        R"({"type":"Feature","geometry":{"type":"MultiLineString","coordinates":[[[1,2],[3,4]],[[5,6],[7,8]]]}})",
+        R"({"type":"Feature","geometry":{"type":"MultiPolygon","coordinates":[[[[0,0],[1,0],[1,1],[0,0]]],[[[5,5],[6,5],[6,6],[5,5]]]]}})",
+        R"({"type":"Feature","geometry":{"type":"GeometryCollection","geometries":[{"type":"Point","coordinates":[1,2]},{"type":"LineString","coordinates":[[1,2],[3,4]]}]}})",
+        R"({"type":"Feature","geometry":null,"properties":{"array":[1, 2.5, "x", [true, null]],"object":{"a" : {"b":"c"}, "d":[]}}})",
+        R"({"type":"Feature","geometry":{"type":"Point","coordinates":[0,0],"bbox":[0,0,0,0]},"properties":{"esc":"a\"b\\c\/é\n","key":"v"},"extra":{"nested":[{"x":1}]}})"
+    };
+    for (auto const& json : features)
+    {
+        INFO(json);
+        auto ctx1 = std::make_shared<mapnik::context_type>();
+        auto ctx2 = std::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr expected(mapnik::feature_factory::create(ctx1, 1));
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx2, 1));
+        REQUIRE(parse_with_grammar(json, *expected));
+        REQUIRE(parse(json, *feature));
+        CHECK(feature->to_string() == expected->to_string());
+        assert_g_equal(feature->get_geometry(), expected->get_geometry());
+    }
+}
+
+SECTION("empty geometry collection") {
+
+    auto ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    REQUIRE(parse(R"({"type":"Feature","geometry":{"type":"GeometryCollection","geometries":[ ]}})", *feature));
+    REQUIRE(feature->get_geometry().is<mapnik::geometry::geometry_collection<double>>());
+    CHECK(feature->get_geometry().get<mapnik::geometry::geometry_collection<double>>().empty());
+
+    mapnik::feature_ptr nested(mapnik::feature_factory::create(ctx, 2));
+    REQUIRE(parse(R"({"type":"Feature","geometry":{"type":"GeometryCollection","geometries":[)"
+                  R"({"type":"GeometryCollection","geometries":[]},{"type":"Point","coordinates":[1,2]}]}})", *nested));
+    REQUIRE(nested->get_geometry().is<mapnik::geometry::geometry_collection<double>>());
+    auto const& collection = nested->get_geometry().get<mapnik::geometry::geometry_collection<double>>();
+    REQUIRE(collection.size() == 2);
+    REQUIRE(collection[0].is<mapnik::geometry::geometry_collection<double>>());
+    CHECK(collection[0].get<mapnik::geometry::geometry_collection<double>>().empty());
+    CHECK(collection[1].is<mapnik::geometry::point<double>>());
+}
+
+SECTION("invalid features") {
+
+    std::vector<std::string> features = {
+        R"({"geometry":{"type":"Point","coordinates":[1,2]}})",
+        R"({"type":"FeatureCollection","features":[]})",
+        R"({"type":"Feature","geometry":{"type":"Point","coordinates":[[1,2]]}})",
+        R"({"type":"Feature","geometry":{"type":"Curve","coordinates":[1,2]}})",
+        R"({"type":"Feature","properties":{"a":1,}})",
+        R"({"type":"Feature","properties":{"a":"unterminated}})",
+        R"({"type":"Feature")"
+    };
+    for (auto const& json : features)
+    {
+        INFO(json);
+        auto ctx = std::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        CHECK(!parse(json, *feature));
+    }
+}
+
+SECTION("feature collection") {
+
+    std::string json = R"({"type":"FeatureCollection","features":[
+        {"type":"Feature","geometry":{"type":"Point","coordinates":[1,2]},"properties":{"a":1}},
+        {"type":"Feature","geometry":{"type":"Point","coordinates":[3,4]},"properties":{"b":"x"}}]})";
+    static const mapnik::transcoder tr("utf8");
+    auto ctx = std::make_shared<mapnik::context_type>();
+    std::size_t start_id = 1;
+    std::vector<mapnik::feature_ptr> features;
+    char const* start = json.c_str();
+    REQUIRE(mapnik::json::parse_feature_collection(start, start + json.size(), ctx, start_id, features, tr));
+    CHECK(start == json.c_str() + json.size());
+    REQUIRE(features.size() == 2);
+    CHECK(start_id == 3);
+    CHECK(features[1]->id() == 2);
+    // keys are shared through the context
+    CHECK(ctx->size() == 2);
+    CHECK(features[0]->get("a") == mapnik::value_integer(1));
+    CHECK(features[1]->get("b") == mapnik::value_unicode_string("x"));
+    CHECK(features[1]->get("a").is_null());
+}
+
+SECTION("scan feature collection") {
+
+    std::string json = R"({"type" : "FeatureCollection", "bbox" : [-180, -90, 180, 90], "features" : [)";
+    for (int i = 0; i < 300; ++i)
+    {
+        if (i > 0) json += ",\n";
+        std::string x = std::to_string(i % 360 - 180);
+        std::string y = std::to_string((i % 7) * 10.5);
+        switch (i % 4)
+        {
+        case 0:
+            json += R"({"type":"Feature","properties":{"name":"p)" + std::to_string(i) + R"("},"geometry":{"type":"Point","coordinates":[)" + x + "," + y + "]}}";
+            break;
+        case 1:
+            json += R"({"geometry":{"coordinates":[[)" + x + "," + y + "],[" + y + "," + x + R"(, 12]],"type":"LineString"},"type":"Feature"})";
+            break;
+        case 2:
+            json += R"({"type":"Feature","properties":{"text":")" + std::string(600, 'x') + R"("},"geometry":{"type":"GeometryCollection","geometries":[{"type":"Point","coordinates":[)" + x + R"(,1e1]},{"type":"Polygon","coordinates":[[[0,0],[)" + y + R"(,0],[0,-1.5e-1],[0,0]]]}]}})";
+            break;
+        default:
+            json += R"({"type":"Feature","geometry":null,"properties":{"a":[1,2,{"b":"]"}]}})";
+        }
+    }
+    json += R"(], "crs" : {"type":"name","properties":{"name":"EPSG:4326"}}})";
+
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::tmpfile(), std::fclose);
+    REQUIRE(file);
+    REQUIRE(std::fwrite(json.data(), json.size(), 1, file.get()) == 1);
+
+    std::size_t count = 0;
+    auto check = [&](mapnik::box2d<double> const& box, std::size_t offset, std::size_t size)
+    {
+        ++count;
+        REQUIRE(offset + size <= json.size());
+        std::string feature_json = json.substr(offset, size);
+        INFO(feature_json);
+        auto ctx = std::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        REQUIRE(parse(feature_json, *feature));
+        CHECK(box == mapnik::geometry::envelope(feature->get_geometry()));
+    };
+    // windows of 1KiB, features end at any position of the buffer
+    std::rewind(file.get());
+    CHECK(mapnik::json::scan_feature_collection(file.get(), 1024, check));
+    CHECK(count == 300);
+
+    // features larger than the limit
+    std::rewind(file.get());
+    CHECK(!mapnik::json::scan_feature_collection(file.get(), 512, check));
+
+    std::vector<std::string> invalid = {
+        R"({"type":"Feature","features":[]})",
+        R"({"type":"FeatureCollection","features":[{"type":"Feature","geometry":null},]})",
+        R"({"type":"FeatureCollection","features":[{"type":"Feature","geometry":null}])"
+    };
+    for (auto const& str : invalid)
+    {
+        INFO(str);
+        std::unique_ptr<std::FILE, int (*)(std::FILE*)> f(std::tmpfile(), std::fclose);
+        std::fwrite(str.data(), str.size(), 1, f.get());
+        std::rewind(f.get());
+        CHECK(!mapnik::json::scan_feature_collection(f.get(), 1024,
+                                                     [](mapnik::box2d<double> const&, std::size_t, std::size_t) {}));
+    }
+}
+
+}
@@ -228,6 +228,77 @@ TEST_CASE("postgis") {
             REQUIRE(false == feature->get("col+bool").to_bool());
         }
 
+        SECTION("Postgis pipeline")
+        {
+            mapnik::parameters params(base_params);
+            params["table"] = "test";
+            params["pipeline"] = "true";
+            auto ds1 = mapnik::datasource_cache::instance().create(params);
+            params["table"] = "(SELECT * FROM test LIMIT 3) as data";
+            auto ds2 = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds1 != nullptr);
+            REQUIRE(ds2 != nullptr);
+
+            // queries of both datasources share one context per render
+            mapnik::feature_style_context_map ctx_map;
+            mapnik::processor_context_ptr ctx = ds1->get_context(ctx_map);
+            REQUIRE(ctx != nullptr);
+            CHECK(ds2->get_context(ctx_map) == ctx);
+            CHECK(ctx_map.size() == 1);
+
+            mapnik::query q(ds1->envelope());
+            auto fs1 = ds1->features_with_context(q, ctx);
+            auto fs2 = ds2->features_with_context(q, ctx);
+            auto fs3 = ds1->features_with_context(q, ctx);
+            // results can be read in any order
+            CHECK(count_features(fs2) == 3);
+            CHECK(count_features(fs1) == 8);
+            fs3.reset();
+            CHECK(count_features(all_features(ds1)) == 8);
+        }
+
+        SECTION("Postgis prepared statements")
+        {
+            mapnik::parameters params(base_params);
+            params["table"] = "(SELECT * FROM test WHERE !scale_denominator! > 0 AND !pixel_width! > 0) as data WHERE geom && !bbox!";
+            params["prepared_statements"] = "true";
+            params["simplify_geometries"] = "true";
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds != nullptr);
+            // the statement is prepared once and executed with other values
+            for (int i = 0; i < 2; ++i)
+            {
+                CHECK(count_features(all_features(ds)) == 8);
+            }
+            mapnik::query q(mapnik::box2d<double>(-0.5, -0.5, 0.5, 0.5));
+            CHECK(count_features(ds->features(q)) < 8);
+
+            params["pipeline"] = "true";
+            ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds != nullptr);
+            CHECK(count_features(all_features(ds)) == 8);
+        }
+
+        SECTION("Postgis streaming results")
+        {
+            mapnik::parameters params(base_params);
+            params["table"] = "test";
+            params["stream_size"] = "2";
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds != nullptr);
+            CHECK(count_features(all_features(ds)) == 8);
+
+            // featureset released before all rows were read
+            auto featureset = all_features(ds);
+            REQUIRE(featureset->next() != nullptr);
+            featureset.reset();
+
+            featureset = all_features(ds);
+            require_geometry(featureset->next(), 1, mapnik::geometry::geometry_types::Point);
+            require_geometry(featureset->next(), 1, mapnik::geometry::geometry_types::Point);
+            require_geometry(featureset->next(), 2, mapnik::geometry::geometry_types::MultiPoint);
+        }
+
         SECTION("Postgis cursorresultest")
         {
             mapnik::parameters params(base_params);
@@ -0,0 +1,94 @@
+#include "catch.hpp"
+
+#include "../../../plugins/input/postgis/numeric2string.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Binary NUMERIC value as sent by the server for a decimal string
+std::vector<char> encode_numeric(std::string str)
+{
+    bool negative = !str.empty() && str[0] == '-';
+    if (negative) str = str.substr(1);
+    std::size_t dot = str.find('.');
+    std::string int_part = str.substr(0, dot);
+    std::string frac_part = (dot == std::string::npos) ? "" : str.substr(dot + 1);
+    int dscale = static_cast<int>(frac_part.size());
+    while (int_part.size() % 4) int_part = "0" + int_part;
+    while (frac_part.size() % 4) frac_part += "0";
+    std::string all = int_part + frac_part;
+    int weight = static_cast<int>(int_part.size() / 4) - 1;
+    std::vector<int> digits;
+    for (std::size_t i = 0; i < all.size(); i += 4)
+    {
+        digits.push_back(std::stoi(all.substr(i, 4)));
+    }
+    while (!digits.empty() && digits.front() == 0)
+    {
+        digits.erase(digits.begin());
+        --weight;
+    }
+    while (!digits.empty() && digits.back() == 0)
+    {
+        digits.pop_back();
+    }
+    if (digits.empty()) weight = 0;
+
+    std::vector<char> buf;
+    auto put = [&buf](int value)
+    {
+        buf.push_back(static_cast<char>((value >> 8) & 0xff));
+        buf.push_back(static_cast<char>(value & 0xff));
+    };
+    put(static_cast<int>(digits.size()));
+    put(weight);
+    put(negative ? 0x4000 : 0);
+    put(dscale);
+    for (int digit : digits) put(digit);
+    return buf;
+}
+
+double expected_value(std::vector<char> const& buf)
+{
+    double value = 0;
+    REQUIRE(mapnik::util::string2double(numeric2string(buf.data()), value));
+    return value;
+}
+
+}
+
+TEST_CASE("postgis numeric") {
+
+SECTION("numeric2double matches numeric2string") {
+
+    std::vector<std::string> values = {
+        "0", "0.0", "1", "-1", "9999", "10000", "-10000.5",
+        "0.1", "0.5", "-0.25", "123.456", "-0.0001", "0.00001",
+        "3.14159265", "-2718.28182845", "99999999", "-12345678.9012",
+        "1234567890123456", "9007199254740993", "-90.000001", "180",
+        "0.000000000001234", "-0.00000000000000000001",
+        "123456789012345678901234567890",
+        "100000000000000000000000000000000000000000",
+        "-98765432109876543210.0123456789"
+    };
+    for (auto const& str : values)
+    {
+        INFO(str);
+        std::vector<char> buf = encode_numeric(str);
+        double value = -1;
+        REQUIRE(numeric2double(buf.data(), value));
+        CHECK(value == expected_value(buf));
+    }
+}
+
+SECTION("numeric2double of NaN") {
+
+    // ndigits, weight, sign NUMERIC_NAN, dscale
+    const char buf[] = { 0, 0, 0, 0, char(0xC0), 0, 0, 0 };
+    double value = 0;
+    CHECK(!numeric2double(buf, value));
+}
+
+}
@@ -23,7 +23,16 @@
 #include "catch.hpp"
 
 #include <mapnik/quad_tree.hpp>
+#include <mapnik/packed_hilbert_tree.hpp>
+#include <mapnik/packed_hilbert_tree_writer.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/util/mapped_spatial_index.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
 
 TEST_CASE("spatial_index")
 {
@@ -84,4 +93,204 @@ TEST_CASE("spatial_index")
         REQUIRE(results[3] == 2);
         REQUIRE(results.size() == 4);
     }
+
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    SECTION("mapnik::util::mapped_spatial_index")
+    {
+        using value_type = std::int32_t;
+        using mapnik::filter_in_box;
+        mapnik::box2d<double> extent(0,0,1000,1000);
+        mapnik::quad_tree<value_type> tree(extent);
+        std::mt19937 gen(17);
+        std::uniform_real_distribution<double> coord(0, 990);
+        std::uniform_real_distribution<double> size(0, 10);
+        for (value_type i = 0; i < 5000; ++i)
+        {
+            double x = coord(gen);
+            double y = coord(gen);
+            tree.insert(i, mapnik::box2d<double>(x, y, x + size(gen), y + size(gen)));
+        }
+        tree.trim();
+
+        std::string filename("spatial_index_test.index");
+        {
+            std::ofstream out(filename, std::ios::binary);
+            tree.write(out);
+        }
+        std::string data;
+        {
+            std::ostringstream out(std::ios::binary);
+            tree.write(out);
+            data = out.str();
+        }
+
+        auto index = mapnik::util::mapped_spatial_index::open(filename, sizeof(value_type));
+        REQUIRE(index == mapnik::util::mapped_spatial_index::open(filename, sizeof(value_type)));
+        CHECK(index->cached_nodes() > 1);
+        CHECK(index->bounding_box() == tree.extent());
+
+        for (int i = 0; i < 50; ++i)
+        {
+            double x = coord(gen);
+            double y = coord(gen);
+            filter_in_box filter(mapnik::box2d<double>(x, y, x + 10 * size(gen), y + 10 * size(gen)));
+            std::vector<value_type> expected;
+            std::vector<value_type> results;
+            std::istringstream in(data, std::ios::binary);
+            mapnik::util::spatial_index<value_type, filter_in_box, std::istringstream>::query(filter, in, expected);
+            index->query(filter, results);
+            CHECK(results == expected);
+
+            expected.clear();
+            results.clear();
+            in.seekg(0, std::ios::beg);
+            mapnik::util::spatial_index<value_type, filter_in_box, std::istringstream>::query_first_n(filter, in, expected, 7);
+            index->query_first_n(filter, results, 7);
+            CHECK(results == expected);
+        }
+
+        std::vector<std::int64_t> wrong_type;
+        CHECK_THROWS(index->query(filter_in_box(extent), wrong_type));
+        index.reset();
+        mapnik::util::mapped_spatial_index::clear_cache();
+        mapnik::util::remove(filename);
+    }
+#endif
+
+    SECTION("mapnik::packed_hilbert_tree<T>")
+    {
+        using value_type = std::int32_t;
+        using mapnik::filter_in_box;
+        mapnik::packed_hilbert_tree<value_type> tree(8);
+        std::vector<mapnik::box2d<double>> boxes;
+        std::mt19937 gen(23);
+        std::uniform_real_distribution<double> coord(-500, 500);
+        std::uniform_real_distribution<double> size(0, 20);
+        for (value_type i = 0; i < 3000; ++i)
+        {
+            double x = coord(gen);
+            double y = coord(gen);
+            boxes.emplace_back(x, y, x + size(gen), y + size(gen));
+            tree.insert(i, boxes.back());
+        }
+        REQUIRE(tree.count_items() == 3000);
+        // 3000 + 375 + 47 + 6 + 1
+        REQUIRE(tree.count() == 3429);
+
+        std::ostringstream out(std::ios::binary);
+        tree.write(out);
+        std::string data = out.str();
+        REQUIRE(data.size() == 72 + 8 * 6 + 32 * 3429 + 4 * 3000);
+
+        std::istringstream in(data, std::ios::binary);
+        REQUIRE(mapnik::util::check_spatial_index(in));
+        in.seekg(0, std::ios::beg);
+        auto box = mapnik::util::spatial_index<value_type, filter_in_box, std::istringstream>::bounding_box(in);
+        REQUIRE(box == tree.extent());
+
+        for (int i = 0; i < 50; ++i)
+        {
+            double x = coord(gen);
+            double y = coord(gen);
+            mapnik::box2d<double> query_box(x, y, x + 10 * size(gen), y + 10 * size(gen));
+            filter_in_box filter(query_box);
+            std::vector<value_type> expected;
+            for (value_type j = 0; j < 3000; ++j)
+            {
+                if (boxes[j].intersects(query_box)) expected.push_back(j);
+            }
+            std::vector<value_type> results;
+            in.seekg(0, std::ios::beg);
+            mapnik::util::spatial_index<value_type, filter_in_box, std::istringstream>::query(filter, in, results);
+            std::vector<value_type> sorted(results);
+            std::sort(sorted.begin(), sorted.end());
+            CHECK(sorted == expected);
+
+            std::vector<value_type> first_n;
+            in.seekg(0, std::ios::beg);
+            mapnik::util::spatial_index<value_type, filter_in_box, std::istringstream>::query_first_n(filter, in, first_n, 3);
+            CHECK(first_n.size() == std::min(std::size_t(3), results.size()));
+            CHECK(std::equal(first_n.begin(), first_n.end(), results.begin()));
+        }
+
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+        std::string filename("packed_index_test.index");
+        {
+            std::ofstream file(filename, std::ios::binary);
+            tree.write(file);
+        }
+        auto index = mapnik::util::mapped_spatial_index::open(filename, sizeof(value_type));
+        CHECK(index->packed());
+        CHECK(index->bounding_box() == tree.extent());
+        filter_in_box filter(mapnik::box2d<double>(-100, -100, 100, 100));
+        std::vector<value_type> expected;
+        std::vector<value_type> results;
+        in.seekg(0, std::ios::beg);
+        mapnik::util::spatial_index<value_type, filter_in_box, std::istringstream>::query(filter, in, expected);
+        index->query(filter, results);
+        CHECK(!results.empty());
+        CHECK(results == expected);
+
+        // a replaced file is mapped again, the old index stays usable
+        {
+            mapnik::packed_hilbert_tree<value_type> other(8);
+            other.insert(1, mapnik::box2d<double>(0, 0, 1, 1));
+            other.insert(2, mapnik::box2d<double>(2, 2, 3, 3));
+            std::ofstream file(filename + ".new", std::ios::binary);
+            other.write(file);
+        }
+        REQUIRE(std::rename((filename + ".new").c_str(), filename.c_str()) == 0);
+        auto replaced = mapnik::util::mapped_spatial_index::open(filename, sizeof(value_type));
+        CHECK(replaced != index);
+        CHECK(replaced->bounding_box() == mapnik::box2d<double>(0, 0, 3, 3));
+        CHECK(replaced == mapnik::util::mapped_spatial_index::open(filename, sizeof(value_type)));
+        results.clear();
+        index->query(filter, results);
+        CHECK(results == expected);
+
+        index.reset();
+        replaced.reset();
+        mapnik::util::remove(filename);
+        CHECK_THROWS(mapnik::util::mapped_spatial_index::open(filename, sizeof(value_type)));
+        mapnik::util::mapped_spatial_index::clear_cache();
+#endif
+    }
+
+    SECTION("mapnik::packed_hilbert_tree_writer<T>")
+    {
+        using value_type = std::int64_t;
+        mapnik::packed_hilbert_tree<value_type> tree(16);
+        // smallest limit, items are sorted in runs of 1024
+        mapnik::packed_hilbert_tree_writer<value_type> writer(0, 16);
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<double> coord(-180, 180);
+        for (value_type i = 0; i < 5000; ++i)
+        {
+            double x = coord(gen);
+            double y = coord(gen) / 2;
+            // repeated boxes have the same position on the curve
+            mapnik::box2d<double> box = (i % 10 == 0) ? mapnik::box2d<double>(1, 1, 2, 2)
+                                                      : mapnik::box2d<double>(x, y, x + 1, y + 1);
+            tree.insert(i, box);
+            writer.insert(i, box);
+        }
+        REQUIRE(writer.count_items() == tree.count_items());
+        REQUIRE(writer.extent() == tree.extent());
+
+        std::ostringstream expected(std::ios::binary);
+        tree.write(expected);
+        std::ostringstream out(std::ios::binary);
+        writer.write(out);
+        CHECK(out.str() == expected.str());
+
+        mapnik::packed_hilbert_tree<value_type> small_tree;
+        mapnik::packed_hilbert_tree_writer<value_type> small_writer(1 << 20);
+        small_tree.insert(1, mapnik::box2d<double>(0, 0, 1, 1));
+        small_writer.insert(1, mapnik::box2d<double>(0, 0, 1, 1));
+        std::ostringstream small_expected(std::ios::binary);
+        small_tree.write(small_expected);
+        std::ostringstream small_out(std::ios::binary);
+        small_writer.write(small_out);
+        CHECK(small_out.str() == small_expected.str());
+    }
 }
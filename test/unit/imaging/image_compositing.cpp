@@ -0,0 +1,186 @@
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/box2d.hpp>
+#include <mapnik/image_compositing.hpp>
+#include <mapnik/util/simd_composite.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_pixfmt_rgba.h"
+#pragma GCC diagnostic pop
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<std::uint8_t> random_pixels(std::mt19937 & gen, std::size_t length, bool premultiplied)
+{
+    std::uniform_int_distribution<int> channel(0, 255);
+    std::vector<std::uint8_t> pixels(length * 4);
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        std::uint8_t * p = &pixels[i * 4];
+        // bias towards fully transparent and opaque pixels
+        int a = channel(gen);
+        p[3] = a < 32 ? 0 : a > 224 ? 255 : a;
+        for (int c = 0; c < 3; ++c)
+        {
+            p[c] = premultiplied ? (channel(gen) * p[3] + 127) / 255 : channel(gen);
+        }
+    }
+    return pixels;
+}
+
+void agg_blend(mapnik::composite_mode_e mode, std::uint8_t * dst, std::uint8_t const* src,
+               std::size_t length, unsigned cover)
+{
+    using table = agg::comp_op_table_rgba<agg::rgba8, agg::order_rgba>;
+    for (std::size_t i = 0; i < length; ++i, dst += 4, src += 4)
+    {
+        table::g_comp_op_func[mode](dst, src[0], src[1], src[2], src[3], cover);
+    }
+}
+
+}
+
+TEST_CASE("image_compositing") {
+
+SECTION("simd kernels match agg blenders") {
+
+    std::mt19937 gen(7);
+    bool same = true;
+    unsigned kernels = 0;
+    for (auto level : { mapnik::util::simd_level::sse41, mapnik::util::simd_level::avx2 })
+    {
+        for (auto mode : { mapnik::src_over, mapnik::dst_out, mapnik::multiply, mapnik::screen })
+        {
+            mapnik::util::composite_kernel kernel = mapnik::util::simd_composite_kernel(mode, level);
+            if (level > mapnik::util::cpu_simd_level())
+            {
+                CHECK(kernel == nullptr);
+                continue;
+            }
+            REQUIRE(kernel != nullptr);
+            ++kernels;
+            for (unsigned cover : { 0u, 1u, 128u, 254u, 255u })
+            {
+                for (bool premultiplied : { true, false })
+                {
+                    // odd length exercises the scalar tail
+                    const std::size_t length = 1027;
+                    std::vector<std::uint8_t> src = random_pixels(gen, length, premultiplied);
+                    std::vector<std::uint8_t> expected = random_pixels(gen, length, premultiplied);
+                    std::vector<std::uint8_t> result(expected);
+                    agg_blend(mode, expected.data(), src.data(), length, cover);
+                    kernel(result.data(), src.data(), length, cover);
+                    same = same && result == expected;
+                }
+            }
+        }
+    }
+    CHECK(same);
+    if (mapnik::util::cpu_simd_level() == mapnik::util::simd_level::none)
+    {
+        CHECK(kernels == 0);
+    }
+    CHECK(mapnik::util::simd_composite_kernel(mapnik::hue, mapnik::util::cpu_simd_level()) == nullptr);
+}
+
+SECTION("composite with simd matches agg") {
+
+    std::mt19937 gen(11);
+    const unsigned width = 203;
+    const unsigned height = 101;
+    mapnik::image_rgba8 src(width, height, true, true);
+    mapnik::image_rgba8 dst(width + 17, height + 9, true, true);
+    std::vector<std::uint8_t> src_pixels = random_pixels(gen, src.width() * src.height(), true);
+    std::vector<std::uint8_t> dst_pixels = random_pixels(gen, dst.width() * dst.height(), true);
+    std::memcpy(src.bytes(), src_pixels.data(), src.size());
+    std::memcpy(dst.bytes(), dst_pixels.data(), dst.size());
+
+    mapnik::util::simd_level level = mapnik::util::composite_simd_level();
+    for (auto mode : { mapnik::src_over, mapnik::dst_out, mapnik::multiply, mapnik::screen })
+    {
+        for (float opacity : { 1.0f, 0.5f })
+        {
+            for (int offset : { 0, -13, 21 })
+            {
+                mapnik::image_rgba8 expected(dst);
+                mapnik::util::set_composite_simd_level(mapnik::util::simd_level::none);
+                mapnik::composite(expected, src, mode, opacity, offset, -offset);
+                mapnik::image_rgba8 result(dst);
+                mapnik::util::set_composite_simd_level(level);
+                mapnik::composite(result, src, mode, opacity, offset, -offset);
+                CHECK(std::memcmp(result.bytes(), expected.bytes(), result.size()) == 0);
+            }
+        }
+    }
+}
+
+SECTION("transparent source leaves destination of preserving modes untouched") {
+
+    std::mt19937 gen(13);
+    const std::size_t length = 4096;
+    std::vector<std::uint8_t> src(length * 4, 0);
+    std::vector<std::uint8_t> dst = random_pixels(gen, length, true);
+    unsigned preserving = 0;
+    bool same = true;
+    for (int mode = mapnik::clear; mode <= mapnik::grain_merge_gimp_darker; ++mode)
+    {
+        if (!mapnik::composite_preserves_dst(static_cast<mapnik::composite_mode_e>(mode))) continue;
+        ++preserving;
+        for (unsigned cover : { 0u, 1u, 128u, 255u })
+        {
+            std::vector<std::uint8_t> result(dst);
+            agg_blend(static_cast<mapnik::composite_mode_e>(mode), result.data(), src.data(), length, cover);
+            same = same && result == dst;
+        }
+    }
+    CHECK(same);
+    CHECK(preserving > 0);
+    CHECK(mapnik::composite_preserves_dst(mapnik::src_over));
+    CHECK(!mapnik::composite_preserves_dst(mapnik::dst_out));
+    CHECK(!mapnik::composite_preserves_dst(mapnik::src));
+}
+
+SECTION("composite of a source area matches full composite") {
+
+    std::mt19937 gen(17);
+    const unsigned width = 203;
+    const unsigned height = 101;
+    const mapnik::box2d<int> area(37, 11, 150, 64);
+    mapnik::image_rgba8 src(width, height, true, true);
+    mapnik::image_rgba8 dst(width, height, true, true);
+    std::vector<std::uint8_t> src_pixels = random_pixels(gen, area.width() * area.height(), true);
+    std::vector<std::uint8_t> dst_pixels = random_pixels(gen, dst.width() * dst.height(), true);
+    for (int y = 0; y < area.height(); ++y)
+    {
+        std::memcpy(src.get_row(area.miny() + y) + area.minx(),
+                    &src_pixels[y * area.width() * 4], area.width() * 4);
+    }
+    std::memcpy(dst.bytes(), dst_pixels.data(), dst.size());
+
+    for (auto mode : { mapnik::src_over, mapnik::multiply, mapnik::overlay, mapnik::plus })
+    {
+        for (float opacity : { 1.0f, 0.5f })
+        {
+            for (int offset : { 0, -40, 21 })
+            {
+                mapnik::image_rgba8 expected(dst);
+                mapnik::composite(expected, src, mode, opacity, offset, -offset);
+                mapnik::image_rgba8 result(dst);
+                mapnik::composite(result, src, mode, opacity, offset, -offset, area);
+                CHECK(std::memcmp(result.bytes(), expected.bytes(), result.size()) == 0);
+            }
+        }
+    }
+
+    mapnik::image_rgba8 result(dst);
+    mapnik::composite(result, src, mapnik::src, 1.0f, 0, 0, mapnik::box2d<int>());
+    CHECK(std::memcmp(result.bytes(), dst.bytes(), result.size()) == 0);
+}
+
+}
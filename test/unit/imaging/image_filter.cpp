@@ -11,6 +11,8 @@
 // stl
 #include <sstream>
 #include <array>
+#include <algorithm>
+#include <random>
 
 TEST_CASE("image filter") {
 
@@ -521,4 +523,66 @@ SECTION("test color-blind-tritanope") {
 
 } // END SECTION
 
+SECTION("test filters on a painted region match the full image") {
+
+    const mapnik::box2d<int> region(20, 10, 35, 30);
+    mapnik::image_rgba8 im(64, 48);
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> channel(0, 255);
+    for (int y = region.miny(); y < region.maxy(); ++y)
+    {
+        for (int x = region.minx(); x < region.maxx(); ++x)
+        {
+            // premultiplied
+            std::uint32_t a = channel(gen);
+            std::uint32_t r = channel(gen) * a / 255;
+            std::uint32_t g = channel(gen) * a / 255;
+            std::uint32_t b = channel(gen) * a / 255;
+            im(x, y) = (a << 24) | (b << 16) | (g << 8) | r;
+        }
+    }
+    mapnik::set_premultiplied_alpha(im, true);
+
+    for (char const* filters : { "blur", "agg-stack-blur(3,2)", "emboss,sharpen", "edge-detect,sobel",
+                                 "gray,invert", "scale-hsla(0,1,0,1,0,1,0.5,1)", "color-to-alpha(white)",
+                                 "blur,agg-stack-blur(20,20)", "x-gradient", "fill(red),blur" })
+    {
+        std::vector<mapnik::filter::filter_type> filter_vector;
+        REQUIRE(mapnik::filter::parse_image_filters(filters, filter_vector));
+
+        mapnik::image_rgba8 expected(im);
+        mapnik::filter::filter_visitor<mapnik::image_rgba8> visitor(expected);
+        for (auto const& filter_tag : filter_vector)
+        {
+            mapnik::util::apply_visitor(visitor, filter_tag);
+        }
+        mapnik::premultiply_alpha(expected);
+
+        mapnik::image_rgba8 result(im);
+        mapnik::box2d<int> painted = mapnik::filter::apply_filters(result, filter_vector, region);
+        INFO(filters);
+        CHECK(result.get_premultiplied());
+        CHECK(std::equal(result.begin(), result.end(), expected.begin()));
+        bool inside = true;
+        for (int y = 0; y < static_cast<int>(result.height()); ++y)
+        {
+            for (int x = 0; x < static_cast<int>(result.width()); ++x)
+            {
+                if (result(x, y) != 0)
+                {
+                    inside = inside && x >= painted.minx() && x < painted.maxx()
+                        && y >= painted.miny() && y < painted.maxy();
+                }
+            }
+        }
+        CHECK(inside);
+    }
+
+    mapnik::image_rgba8 empty(16, 16);
+    std::vector<mapnik::filter::filter_type> blur;
+    REQUIRE(mapnik::filter::parse_image_filters("blur", blur));
+    CHECK(!mapnik::filter::apply_filters(empty, blur, mapnik::box2d<int>()).valid());
+
+} // END SECTION
+
 } // END TEST CASE
@@ -1,6 +1,8 @@
 #include "catch.hpp"
 
 #include <cstring>
+#include <string>
+#include <vector>
 #include <mapnik/color.hpp>
 #include <mapnik/image.hpp>
 #include <mapnik/image_reader.hpp>
@@ -233,6 +235,36 @@ SECTION("Quantising small (less than 3 pixel images preserve original colours")
 #endif
 } // END SECTION
 
+SECTION("png writer compressing in parallel bands produces identical pixels")
+{
+#if defined(HAVE_PNG)
+    mapnik::image_rgba8 im(1031, 811);
+    for (unsigned y = 0; y < im.height(); ++y)
+    {
+        for (unsigned x = 0; x < im.width(); ++x)
+        {
+            unsigned v = (x * 7 + y * 13) ^ (x * y);
+            im(x, y) = mapnik::color(v & 0xff, (v >> 3) & 0xff, (x + y) & 0xff, (y * 5) & 0xff).rgba();
+        }
+    }
+    REQUIRE_THROWS(mapnik::save_to_string(im, "png:j=0"));
+    std::vector<std::string> formats = { "png", "png:t=0", "png:z=1:s=rle", "png8", "png8:c=16", "png8:m=o" };
+    for (std::string const& format : formats)
+    {
+        std::string serial = mapnik::save_to_string(im, format);
+        std::string parallel = mapnik::save_to_string(im, format + ":j=4");
+
+        std::unique_ptr<mapnik::image_reader> reader1(mapnik::get_image_reader(serial.data(), serial.size()));
+        std::unique_ptr<mapnik::image_reader> reader2(mapnik::get_image_reader(parallel.data(), parallel.size()));
+        REQUIRE(reader2->width() == im.width());
+        REQUIRE(reader2->height() == im.height());
+        auto im1 = mapnik::util::get<mapnik::image_rgba8>(reader1->read(0, 0, im.width(), im.height()));
+        auto im2 = mapnik::util::get<mapnik::image_rgba8>(reader2->read(0, 0, im.width(), im.height()));
+        CHECK(std::memcmp(im1.bytes(), im2.bytes(), im1.size()) == 0);
+    }
+#endif
+} // END SECTION
+
 SECTION("rgba8_to_cairo_image")
 {
 #if defined(HAVE_CAIRO)
@@ -10,9 +10,65 @@
 #include <mapnik/agg_renderer.hpp>
 #include <mapnik/expression.hpp>
 #include <mapnik/util/fs.hpp>
+#include <mapnik/agg_rasterizer.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_rendering_buffer.h"
+#include "agg_pixfmt_rgba.h"
+#include "agg_renderer_base.h"
+#include "agg_renderer_scanline.h"
+#include "agg_scanline_u.h"
+#pragma GCC diagnostic pop
 
 TEST_CASE("image painted") {
 
+SECTION("rasterizer tracks painted extent") {
+
+    using namespace mapnik;
+
+    image_rgba8 image(100, 80);
+    agg::rendering_buffer buf(image.bytes(), image.width(), image.height(), image.row_size());
+    agg::pixfmt_rgba32_pre pixf(buf);
+    agg::renderer_base<agg::pixfmt_rgba32_pre> renb(pixf);
+    agg::renderer_scanline_aa_solid<agg::renderer_base<agg::pixfmt_rgba32_pre>> ren(renb);
+    ren.color(agg::rgba8_pre(255, 0, 0, 255));
+    agg::scanline_u8 sl;
+
+    rasterizer ras;
+    ras.clip_box(0, 0, image.width(), image.height());
+    CHECK(!ras.painted_extent().valid());
+    ras.move_to_d(10.5, 20.2);
+    ras.line_to_d(30.7, 25.0);
+    ras.line_to_d(18.0, 60.9);
+    agg::render_scanlines(ras, sl, ren);
+
+    box2d<int> const& extent = ras.painted_extent();
+    REQUIRE(extent.valid());
+    bool inside = true;
+    for (int y = 0; y < static_cast<int>(image.height()); ++y)
+    {
+        for (int x = 0; x < static_cast<int>(image.width()); ++x)
+        {
+            if (image(x, y) != 0)
+            {
+                inside = inside && x >= extent.minx() && x < extent.maxx()
+                    && y >= extent.miny() && y < extent.maxy();
+            }
+        }
+    }
+    CHECK(inside);
+    CHECK(extent.minx() == 10);
+    CHECK(extent.miny() == 20);
+    CHECK(extent.maxx() == 31);
+    CHECK(extent.maxy() == 61);
+
+    ras.mark_painted(box2d<int>(70, 5, 90, 10));
+    CHECK(ras.painted_extent() == box2d<int>(10, 5, 90, 61));
+    ras.reset_painted_extent();
+    CHECK(!ras.painted_extent().valid());
+}
+
 SECTION("painted - simple") {
 
     using namespace mapnik;
@@ -0,0 +1,209 @@
+#include "catch.hpp"
+
+#include <mapnik/image_pool.hpp>
+#include <mapnik/image_util.hpp>
+
+#include <future>
+#include <thread>
+
+TEST_CASE("image_pool") {
+
+SECTION("disabled pool allocates") {
+
+    mapnik::image_pool_rgba8 & pool = mapnik::image_pool_rgba8::instance();
+    mapnik::image_pool_rgba8::set_capacity(0);
+    CHECK(!pool.enabled());
+    mapnik::image_rgba8 img(mapnik::image_pool_rgba8::acquire(16, 8));
+    CHECK(img.width() == 16);
+    CHECK(img.height() == 8);
+    CHECK(mapnik::is_solid(img));
+    CHECK(img(0, 0) == 0);
+    mapnik::image_pool_rgba8::release(std::move(img));
+    CHECK(pool.stats().entries == 0);
+}
+
+SECTION("reuses released buffers") {
+
+    mapnik::image_pool_rgba8 & pool = mapnik::image_pool_rgba8::instance();
+    mapnik::image_pool_rgba8::set_capacity(1 << 20);
+    pool.reset_stats();
+
+    mapnik::image_rgba8 img(mapnik::image_pool_rgba8::acquire(32, 32));
+    std::uint8_t const* bytes = img.bytes();
+    img(5, 6) = 0xffffffff;
+    img(20, 30) = 0x80808080;
+    img.set_premultiplied(true);
+    img.painted(true);
+    mapnik::image_pool_rgba8::release(std::move(img));
+
+    mapnik::image_rgba8 other(mapnik::image_pool_rgba8::acquire(16, 32));
+    CHECK(other.width() == 16);
+
+    mapnik::image_rgba8 reused(mapnik::image_pool_rgba8::acquire(32, 32));
+    CHECK(reused.bytes() == bytes);
+    CHECK(mapnik::is_solid(reused));
+    CHECK(reused(5, 6) == 0);
+    CHECK(!reused.get_premultiplied());
+    CHECK(!reused.painted());
+    CHECK(pool.stats().hits == 1);
+    CHECK(pool.stats().misses == 2);
+    mapnik::image_pool_rgba8::set_capacity(0);
+}
+
+SECTION("clears only the dirty extent") {
+
+    mapnik::image_pool_rgba8::set_capacity(1 << 20);
+    mapnik::image_rgba8 img(mapnik::image_pool_rgba8::acquire(32, 32));
+    img(4, 4) = 0xffffffff;
+    img(30, 30) = 0xffffffff;
+    // pixel outside of the dirty extent is kept, the caller broke the contract
+    mapnik::image_pool_rgba8::release(std::move(img), mapnik::box2d<int>(0, 0, 10, 10));
+
+    mapnik::image_rgba8 reused(mapnik::image_pool_rgba8::acquire(32, 32));
+    CHECK(reused(4, 4) == 0);
+    CHECK(reused(30, 30) == 0xffffffff);
+
+    reused(30, 30) = 0xffffffff;
+    mapnik::image_pool_rgba8::release(std::move(reused), mapnik::box2d<int>(0, 0, 10, 10));
+    mapnik::image_rgba8 unclear(mapnik::image_pool_rgba8::acquire(32, 32, false));
+    CHECK(unclear(30, 30) == 0xffffffff);
+    mapnik::image_pool_rgba8::set_capacity(0);
+}
+
+SECTION("respects capacity") {
+
+    mapnik::image_pool_rgba8 & pool = mapnik::image_pool_rgba8::instance();
+    // 64x64 rgba8 is 16kB, the first two go to the thread local list
+    // and fill the capacity
+    mapnik::image_pool_rgba8::set_capacity(40000);
+    std::vector<mapnik::image_rgba8> images;
+    for (int i = 0; i < 6; ++i)
+    {
+        images.emplace_back(mapnik::image_pool_rgba8::acquire(64, 64));
+    }
+    for (auto & img : images)
+    {
+        mapnik::image_pool_rgba8::release(std::move(img));
+    }
+    CHECK(pool.stats().entries == 2);
+    CHECK(pool.stats().cost == 2 * 64 * 64 * 4);
+
+    mapnik::image_rgba8 too_large(mapnik::image_pool_rgba8::acquire(200, 200));
+    mapnik::image_pool_rgba8::release(std::move(too_large));
+    CHECK(pool.stats().entries == 2);
+
+    pool.clear();
+    CHECK(pool.stats().entries == 0);
+    CHECK(pool.stats().cost == 0);
+    mapnik::image_pool_rgba8::set_capacity(0);
+}
+
+SECTION("thread local lists count towards capacity") {
+
+    mapnik::image_pool_rgba8 & pool = mapnik::image_pool_rgba8::instance();
+    // room for one 64x64 image only
+    mapnik::image_pool_rgba8::set_capacity(20000);
+    mapnik::image_rgba8 first(mapnik::image_pool_rgba8::acquire(64, 64));
+    mapnik::image_rgba8 second(mapnik::image_pool_rgba8::acquire(64, 64));
+    mapnik::image_pool_rgba8::release(std::move(first));
+    mapnik::image_pool_rgba8::release(std::move(second));
+    CHECK(pool.stats().entries == 1);
+    CHECK(pool.stats().cost == 64 * 64 * 4);
+
+    // images kept by other threads
+    std::thread other([] {
+        mapnik::image_rgba8 img(mapnik::image_pool_rgba8::acquire(32, 32));
+        mapnik::image_pool_rgba8::release(std::move(img));
+    });
+    other.join();
+    CHECK(pool.stats().entries == 1);
+    CHECK(pool.stats().cost == 64 * 64 * 4);
+
+    mapnik::image_rgba8 reused(mapnik::image_pool_rgba8::acquire(64, 64));
+    CHECK(pool.stats().entries == 0);
+    CHECK(pool.stats().cost == 0);
+    mapnik::image_pool_rgba8::set_capacity(0);
+}
+
+SECTION("evicts the oldest shared images first") {
+
+    mapnik::image_pool_rgba8 & pool = mapnik::image_pool_rgba8::instance();
+    mapnik::image_pool_rgba8::set_capacity(1 << 20);
+    // the thread local images of the other thread are moved to the shared
+    // lists in release order, the last two go away with the thread
+    std::thread other([] {
+        for (std::size_t size : { 32, 30, 31, 29, 28 })
+        {
+            mapnik::image_pool_rgba8::release(mapnik::image_rgba8(size, size));
+        }
+    });
+    other.join();
+    CHECK(pool.stats().entries == 3);
+    // shrinking leaves room for all but the oldest one
+    mapnik::image_pool_rgba8::set_capacity((30 * 30 + 31 * 31 + 16 * 16) * 4);
+    mapnik::image_pool_rgba8::release(mapnik::image_rgba8(16, 16));
+    CHECK(pool.stats().entries == 3);
+    pool.reset_stats();
+    for (std::size_t size : { 30, 31, 32 })
+    {
+        mapnik::image_rgba8 img(mapnik::image_pool_rgba8::acquire(size, size));
+    }
+    CHECK(pool.stats().hits == 2);
+    CHECK(pool.stats().misses == 1);
+    mapnik::image_pool_rgba8::set_capacity(0);
+}
+
+SECTION("new sizes replace the oldest thread local images") {
+
+    mapnik::image_pool_rgba8 & pool = mapnik::image_pool_rgba8::instance();
+    mapnik::image_pool_rgba8::set_capacity(1 << 20);
+    for (std::size_t size : { 64, 48, 40, 32 })
+    {
+        mapnik::image_pool_rgba8::release(mapnik::image_rgba8(size, size));
+    }
+    CHECK(pool.stats().entries == 4);
+    pool.reset_stats();
+    // the older sizes were moved to the shared lists, other threads find them
+    std::thread other([] {
+        for (std::size_t size : { 64, 48 })
+        {
+            mapnik::image_rgba8 img(mapnik::image_pool_rgba8::acquire(size, size));
+            CHECK(img.width() == size);
+        }
+    });
+    other.join();
+    CHECK(pool.stats().hits == 2);
+    CHECK(pool.stats().misses == 0);
+    mapnik::image_pool_rgba8::set_capacity(0);
+}
+
+SECTION("disabling the pool frees images of other threads") {
+
+    mapnik::image_pool_rgba8 & pool = mapnik::image_pool_rgba8::instance();
+    mapnik::image_pool_rgba8::set_capacity(1 << 20);
+    std::promise<void> released;
+    std::promise<void> disabled;
+    std::future<void> disabled_future = disabled.get_future();
+    std::thread other([&] {
+        mapnik::image_rgba8 first(mapnik::image_pool_rgba8::acquire(64, 64));
+        mapnik::image_rgba8 second(mapnik::image_pool_rgba8::acquire(32, 32));
+        mapnik::image_pool_rgba8::release(std::move(first));
+        mapnik::image_pool_rgba8::release(std::move(second));
+        released.set_value();
+        disabled_future.wait();
+        // the thread keeps running, its list goes with its next request
+        mapnik::image_rgba8 img(mapnik::image_pool_rgba8::acquire(64, 64));
+        CHECK(img.width() == 64);
+        mapnik::image_pool_rgba8::release(std::move(img));
+    });
+    released.get_future().wait();
+    CHECK(pool.stats().entries == 2);
+
+    mapnik::image_pool_rgba8::set_capacity(0);
+    disabled.set_value();
+    other.join();
+    CHECK(pool.stats().entries == 0);
+    CHECK(pool.stats().cost == 0);
+}
+
+}
@@ -0,0 +1,120 @@
+#include "catch.hpp"
+
+#include <mapnik/raster_colorizer.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/image.hpp>
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+
+namespace {
+
+mapnik::raster_colorizer make_colorizer()
+{
+    mapnik::raster_colorizer colorizer(mapnik::COLORIZER_LINEAR, mapnik::color(10, 20, 30, 40));
+    colorizer.add_stop(mapnik::colorizer_stop(-100, mapnik::COLORIZER_DISCRETE, mapnik::color(255, 0, 0)));
+    colorizer.add_stop(mapnik::colorizer_stop(0, mapnik::COLORIZER_LINEAR, mapnik::color(0, 255, 0, 128)));
+    colorizer.add_stop(mapnik::colorizer_stop(50, mapnik::COLORIZER_EXACT, mapnik::color(0, 0, 255)));
+    colorizer.add_stop(mapnik::colorizer_stop(60, mapnik::COLORIZER_LINEAR_ALL, mapnik::color(1, 2, 3, 4)));
+    colorizer.add_stop(mapnik::colorizer_stop(120, mapnik::COLORIZER_LINEAR_ALL_BGRA, mapnik::color(200, 100, 50, 255)));
+    colorizer.add_stop(mapnik::colorizer_stop(200, mapnik::COLORIZER_INHERIT, mapnik::color(9, 9, 9)));
+    colorizer.add_stop(mapnik::colorizer_stop(250, mapnik::COLORIZER_LINEAR, mapnik::color(255, 255, 255)));
+    return colorizer;
+}
+
+// colorize has to give the same result as get_color for every pixel
+template <typename Image>
+bool same_as_get_color(mapnik::raster_colorizer const& colorizer,
+                       Image const& in,
+                       boost::optional<double> const& nodata)
+{
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_impl feature(ctx, 1);
+    mapnik::image_rgba8 out(in.width(), in.height());
+    colorizer.colorize(out, in, nodata, feature);
+    for (std::size_t y = 0; y < in.height(); ++y)
+    {
+        for (std::size_t x = 0; x < in.width(); ++x)
+        {
+            auto value = in(x, y);
+            std::uint32_t expected = 0;
+            if (!nodata || !(std::fabs(value - *nodata) < colorizer.get_epsilon()))
+            {
+                expected = colorizer.get_color(value);
+            }
+            if (out(x, y) != expected) return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("raster_colorizer") {
+
+SECTION("integer input matches get_color") {
+
+    mapnik::raster_colorizer colorizer = make_colorizer();
+    mapnik::image_gray8 gray8(64, 32);
+    mapnik::image_gray16s gray16s(300, 300);
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> dist(-150, 280);
+    for (std::size_t y = 0; y < gray8.height(); ++y)
+    {
+        for (std::size_t x = 0; x < gray8.width(); ++x)
+        {
+            gray8(x, y) = static_cast<std::uint8_t>(x * 4 + y);
+        }
+    }
+    for (auto & value : gray16s)
+    {
+        value = static_cast<std::int16_t>(dist(gen));
+    }
+    CHECK(same_as_get_color(colorizer, gray8, boost::optional<double>()));
+    CHECK(same_as_get_color(colorizer, gray8, boost::optional<double>(50)));
+    CHECK(same_as_get_color(colorizer, gray16s, boost::optional<double>(-3)));
+
+    // wider range than pixels
+    mapnik::image_gray32s sparse(4, 4);
+    sparse(0, 0) = -2000000;
+    sparse(3, 3) = 2000000;
+    sparse(1, 2) = 55;
+    CHECK(same_as_get_color(colorizer, sparse, boost::optional<double>()));
+}
+
+SECTION("float input matches get_color") {
+
+    mapnik::raster_colorizer colorizer = make_colorizer();
+    colorizer.set_epsilon(0.5);
+    mapnik::image_gray32f gray32f(257, 129);
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> dist(-200.0f, 300.0f);
+    for (auto & value : gray32f)
+    {
+        value = dist(gen);
+    }
+    gray32f(0, 0) = 50.2f;
+    gray32f(1, 0) = std::numeric_limits<float>::quiet_NaN();
+    gray32f(2, 0) = -100.0f;
+    gray32f(3, 0) = 250.0f;
+    CHECK(same_as_get_color(colorizer, gray32f, boost::optional<double>()));
+    CHECK(same_as_get_color(colorizer, gray32f, boost::optional<double>(0)));
+
+    // stops not in increasing order are searched in the given order
+    mapnik::colorizer_stops stops(colorizer.get_stops());
+    std::swap(stops[1], stops[4]);
+    colorizer.set_stops(stops);
+    CHECK(same_as_get_color(colorizer, gray32f, boost::optional<double>()));
+}
+
+SECTION("no stops") {
+
+    mapnik::raster_colorizer colorizer(mapnik::COLORIZER_LINEAR, mapnik::color(1, 2, 3, 4));
+    mapnik::image_gray16 gray16(10, 10);
+    gray16(5, 5) = 7;
+    CHECK(same_as_get_color(colorizer, gray16, boost::optional<double>(7)));
+}
+
+}
@@ -0,0 +1,137 @@
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/image_scaling_traits.hpp>
+#include <mapnik/span_image_filter.hpp>
+#include <mapnik/util/simd_resample.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_image_filters.h"
+#include "agg_rendering_buffer.h"
+#include "agg_trans_affine.h"
+#pragma GCC diagnostic pop
+
+#include <random>
+#include <vector>
+
+namespace {
+
+using traits = mapnik::detail::agg_scaling_traits<mapnik::image_rgba8>;
+
+mapnik::image_rgba8 random_premultiplied(int width, int height)
+{
+    mapnik::image_rgba8 img(width, height);
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> dist(0, 255);
+    for (auto & pixel : img)
+    {
+        unsigned a = dist(gen);
+        unsigned r = dist(gen) * a / 255;
+        unsigned g = dist(gen) * a / 255;
+        unsigned b = dist(gen) * a / 255;
+        pixel = (a << 24) | (b << 16) | (g << 8) | r;
+    }
+    return img;
+}
+
+std::vector<agg::trans_affine> random_transforms()
+{
+    std::vector<agg::trans_affine> result;
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> angle(-3.0, 3.0);
+    std::uniform_real_distribution<double> scale(0.2, 4.0);
+    std::uniform_real_distribution<double> shift(-20.0, 20.0);
+    for (int i = 0; i < 20; ++i)
+    {
+        agg::trans_affine tr;
+        tr *= agg::trans_affine_rotation(angle(gen));
+        tr *= agg::trans_affine_scaling(scale(gen), scale(gen));
+        tr *= agg::trans_affine_translation(shift(gen), shift(gen));
+        result.push_back(tr);
+    }
+    return result;
+}
+
+// Generates spans of 100 pixels starting left of the image with both generators
+template <typename Make, typename MakeSimd>
+bool same_spans(Make make, MakeSimd make_simd)
+{
+    std::vector<agg::rgba8> expected(100);
+    std::vector<agg::rgba8> actual(100);
+    for (int y = -5; y < 50; y += 3)
+    {
+        auto sg = make();
+        auto sg_simd = make_simd();
+        sg.prepare();
+        sg_simd.prepare();
+        sg.generate(expected.data(), -10, y, 100);
+        sg_simd.generate(actual.data(), -10, y, 100);
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            if (expected[i].r != actual[i].r || expected[i].g != actual[i].g ||
+                expected[i].b != actual[i].b || expected[i].a != actual[i].a)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("span_image_filter_simd") {
+
+mapnik::image_rgba8 source = random_premultiplied(37, 29);
+agg::rendering_buffer buf(source.bytes(), source.width(), source.height(), source.row_size());
+traits::pixfmt_pre pixf(buf);
+traits::img_src_type ia(pixf);
+mapnik::util::rgba8_source pixels{source.bytes(),
+                                  static_cast<int>(source.width()),
+                                  static_cast<int>(source.height()),
+                                  static_cast<int>(source.row_size())};
+mapnik::span_coordinates coords;
+
+SECTION("bilinear") {
+
+    mapnik::util::bilinear_kernel kernel = mapnik::util::simd_bilinear_kernel(mapnik::util::cpu_simd_level());
+    if (!kernel)
+    {
+        CHECK(mapnik::util::cpu_simd_level() == mapnik::util::simd_level::none);
+        return;
+    }
+    for (auto const& tr : random_transforms())
+    {
+        traits::interpolator_type interpolator(tr);
+        CHECK(same_spans(
+            [&] { return traits::span_image_filter_bilinear(ia, interpolator); },
+            [&] { return mapnik::span_image_filter_rgba_bilinear_simd<traits::img_src_type, traits::interpolator_type>(
+                      ia, interpolator, pixels, kernel, coords); }));
+    }
+}
+
+SECTION("resample") {
+
+    mapnik::util::resample_kernel kernel = mapnik::util::simd_resample_kernel(mapnik::util::cpu_simd_level());
+    if (!kernel)
+    {
+        CHECK(mapnik::util::cpu_simd_level() == mapnik::util::simd_level::none);
+        return;
+    }
+    agg::image_filter_lut bicubic(agg::image_filter_bicubic(), true);
+    agg::image_filter_lut lanczos(agg::image_filter_lanczos(3.0), true);
+    for (agg::image_filter_lut const* filter : { &bicubic, &lanczos })
+    {
+        for (auto const& tr : random_transforms())
+        {
+            traits::interpolator_type interpolator(tr);
+            CHECK(same_spans(
+                [&] { return agg::span_image_resample_rgba_affine<traits::img_src_type>(ia, interpolator, *filter); },
+                [&] { return mapnik::span_image_resample_rgba_affine_simd<traits::img_src_type>(
+                          ia, interpolator, *filter, pixels, kernel, coords); }));
+        }
+    }
+}
+
+}
@@ -0,0 +1,75 @@
+#include "catch.hpp"
+
+#include <mapnik/label_collision_detector.hpp>
+
+#include <iterator>
+#include <random>
+
+TEST_CASE("label_collision_detector_packed") {
+
+SECTION("empty") {
+
+    mapnik::label_collision_detector_packed detector(mapnik::box2d<double>(0, 0, 256, 256));
+    CHECK(detector.has_placement(mapnik::box2d<double>(10, 10, 20, 20)));
+    CHECK(detector.size() == 0);
+}
+
+SECTION("insert outside of extent") {
+
+    mapnik::label_collision_detector_packed detector(mapnik::box2d<double>(0, 0, 256, 256));
+    detector.insert(mapnik::box2d<double>(300, 300, 310, 310));
+    CHECK(detector.size() == 0);
+    detector.insert(mapnik::box2d<double>(250, 250, 260, 260));
+    CHECK(detector.size() == 1);
+    CHECK(!detector.has_placement(mapnik::box2d<double>(255, 255, 256, 256)));
+    CHECK(detector.has_placement(mapnik::box2d<double>(240, 240, 245, 245)));
+    CHECK(!detector.has_placement(mapnik::box2d<double>(240, 240, 245, 245), 5.0));
+}
+
+SECTION("matches boost rtree detector") {
+
+    const mapnik::box2d<double> extent(-64, -64, 1088, 1088);
+    mapnik::label_collision_detector_packed packed(extent);
+    mapnik::label_collision_detector_boost boost_rtree(extent);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> position(-100, 1100);
+    std::uniform_real_distribution<double> size(1, 40);
+    std::uniform_int_distribution<int> text(0, 20);
+
+    bool same = true;
+    for (int i = 0; i < 5000; ++i)
+    {
+        double x = position(gen);
+        double y = position(gen);
+        mapnik::box2d<double> box(x, y, x + size(gen), y + size(gen));
+        mapnik::value_unicode_string label(std::to_string(text(gen)).c_str());
+
+        bool packed_free = packed.has_placement(box, 2.0, label, 50.0);
+        same = same && packed_free == boost_rtree.has_placement(box, 2.0, label, 50.0);
+        same = same && packed.has_placement(box) == boost_rtree.has_placement(box);
+
+        if (packed_free || i % 3 == 0)
+        {
+            packed.insert(box, label);
+            boost_rtree.insert(box, label);
+        }
+    }
+    CHECK(same);
+    CHECK(packed.size() == static_cast<std::size_t>(std::distance(boost_rtree.begin(), boost_rtree.end())));
+}
+
+SECTION("clear") {
+
+    mapnik::label_collision_detector_packed detector(mapnik::box2d<double>(0, 0, 256, 256));
+    for (int i = 0; i < 200; ++i)
+    {
+        detector.insert(mapnik::box2d<double>(i, i, i + 1, i + 1), "label");
+    }
+    CHECK(!detector.has_placement(mapnik::box2d<double>(10, 10, 11, 11)));
+    detector.clear();
+    CHECK(detector.size() == 0);
+    CHECK(detector.has_placement(mapnik::box2d<double>(10, 10, 11, 11), 0, "label", 100));
+}
+
+}
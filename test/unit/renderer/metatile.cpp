@@ -0,0 +1,90 @@
+#include "catch.hpp"
+
+#include <mapnik/metatile.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/image_util.hpp>
+
+TEST_CASE("metatile") {
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto datasource = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    {
+        // covers the whole left column and half of the right one
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        mapnik::geometry::polygon<double> poly;
+        mapnik::geometry::linear_ring<double> ring;
+        ring.emplace_back(-1, -1);
+        ring.emplace_back(1.5, -1);
+        ring.emplace_back(1.5, 3);
+        ring.emplace_back(-1, 3);
+        ring.emplace_back(-1, -1);
+        poly.set_exterior_ring(std::move(ring));
+        feature->set_geometry(std::move(poly));
+        datasource->push(feature);
+    }
+
+    mapnik::Map map(256, 256);
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    rule.append(mapnik::polygon_symbolizer());
+    style.add_rule(std::move(rule));
+    map.insert_style("polygons", std::move(style));
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(datasource);
+    lyr.add_style("polygons");
+    map.add_layer(lyr);
+
+    mapnik::metatile_grid grid{mapnik::box2d<double>(0, 0, 2, 2), 2, 2, 64};
+    CHECK(grid.tile_extent(1, 0) == mapnik::box2d<double>(1, 1, 2, 2));
+
+SECTION("tiles are views into a single render") {
+
+    mapnik::metatile meta(grid);
+    meta.render(map);
+    REQUIRE(meta.image().width() == 128);
+
+    mapnik::image_view_rgba8 view = meta.tile(1, 1);
+    CHECK(view.x() == 64);
+    CHECK(view.y() == 64);
+    CHECK(view.width() == 64);
+    CHECK(&view.data() == &meta.image());
+
+    CHECK(meta.content(0, 0) == mapnik::tile_content::uniform);
+    CHECK(meta.content(0, 1) == mapnik::tile_content::uniform);
+    CHECK(meta.content(1, 0) == mapnik::tile_content::painted);
+    REQUIRE_THROWS(meta.tile(2, 0));
+}
+
+#if defined(HAVE_PNG)
+SECTION("encoding") {
+
+    mapnik::metatile meta(grid);
+    meta.render(map);
+    std::vector<mapnik::encoded_tile> tiles = meta.encode("png32");
+    REQUIRE(tiles.size() == 4);
+    CHECK(tiles[0].data == tiles[2].data);
+    CHECK(tiles[1].data == mapnik::save_to_string(meta.tile(1, 0), "png32"));
+
+    map.remove_all();
+    mapnik::metatile blank(grid);
+    blank.render(map);
+    for (auto const& tile : blank.encode("png32"))
+    {
+        CHECK(tile.content == mapnik::tile_content::empty);
+        CHECK(tile.data.empty());
+    }
+}
+#endif
+
+}
@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include <mapnik/text/glyph_cache.hpp>
+#include <mapnik/font_engine_freetype.hpp>
+
+TEST_CASE("glyph_cache") {
+
+SECTION("subpixel snapping") {
+
+    mapnik::glyph_cache & cache = mapnik::glyph_cache::instance();
+    CHECK(cache.subpixel_steps() == 64);
+    CHECK(cache.snap(100) == 100);
+    CHECK(cache.snap(-37) == -37);
+
+    CHECK(!mapnik::glyph_cache::set_subpixel_steps(0));
+    CHECK(!mapnik::glyph_cache::set_subpixel_steps(3));
+    CHECK(!mapnik::glyph_cache::set_subpixel_steps(128));
+    REQUIRE(mapnik::glyph_cache::set_subpixel_steps(4));
+    CHECK(cache.snap(0) == 0);
+    CHECK(cache.snap(7) == 0);
+    CHECK(cache.snap(8) == 16);
+    CHECK(cache.snap(60) == 64);
+    CHECK(cache.snap(-7) == 0);
+    CHECK(cache.snap(-9) == -16);
+    REQUIRE(mapnik::glyph_cache::set_subpixel_steps(64));
+}
+
+SECTION("cached bitmaps") {
+
+    mapnik::glyph_cache & cache = mapnik::glyph_cache::instance();
+    unsigned char pixels[] = { 0, 64, 128, 255, 1, 2 };
+    FT_Bitmap src;
+    src.rows = 2;
+    src.width = 3;
+    src.pitch = 3;
+    src.buffer = pixels;
+    src.num_grays = 256;
+    src.pixel_mode = FT_PIXEL_MODE_GRAY;
+    src.palette_mode = 0;
+    src.palette = nullptr;
+
+    std::size_t face_id = mapnik::freetype_engine::face_id("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 0);
+    mapnik::glyph_cache_key key{face_id, 42, 12 * 64, 0x10000, 0, 0, 0x10000, 5, 0, 0, 0, 0};
+    auto bitmap = std::make_shared<mapnik::glyph_bitmap>(src, -1, 9);
+
+    cache.insert(key, bitmap);
+    CHECK(!cache.find(key));
+
+    mapnik::glyph_cache::set_capacity(1 << 20);
+    cache.insert(key, bitmap);
+    mapnik::glyph_bitmap_ptr found = cache.find(key);
+    REQUIRE(found);
+    CHECK(found->left == -1);
+    CHECK(found->top == 9);
+    FT_Bitmap view = found->bitmap();
+    CHECK(view.width == 3);
+    CHECK(view.rows == 2);
+    CHECK(view.buffer[3] == 255);
+
+    key.frac_x = 6;
+    CHECK(!cache.find(key));
+    key.frac_x = 5;
+    // the same glyph of another font
+    key.face_id = mapnik::freetype_engine::face_id("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSerif.ttf", 0);
+    CHECK(!cache.find(key));
+    mapnik::glyph_cache::set_capacity(0);
+}
+
+}
@@ -24,3 +24,31 @@ TEST_CASE("shapers compile") {
                                 fm,
                                 scale_factor);
 }
+
+TEST_CASE("font face ids") {
+
+    const std::string sans("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf");
+    const std::string serif("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSerif.ttf");
+    mapnik::font_library fl;
+    mapnik::freetype_engine::font_memory_cache_type font_memory_cache;
+
+    // same family name registered for different files in two maps
+    mapnik::freetype_engine::font_file_mapping_type sans_mapping{ { "Face", { 0, sans } } };
+    mapnik::freetype_engine::font_file_mapping_type serif_mapping{ { "Face", { 0, serif } } };
+    mapnik::freetype_engine::font_file_mapping_type other_sans_mapping{ { "Other", { 0, sans } } };
+    mapnik::face_manager sans_fm(fl, sans_mapping, font_memory_cache);
+    mapnik::face_manager serif_fm(fl, serif_mapping, font_memory_cache);
+    mapnik::face_manager other_sans_fm(fl, other_sans_mapping, font_memory_cache);
+
+    mapnik::face_ptr sans_face = sans_fm.get_face("Face");
+    mapnik::face_ptr serif_face = serif_fm.get_face("Face");
+    mapnik::face_ptr other_sans_face = other_sans_fm.get_face("Other");
+    REQUIRE(sans_face);
+    REQUIRE(serif_face);
+    REQUIRE(other_sans_face);
+
+    CHECK(sans_face->id() != serif_face->id());
+    CHECK(sans_face->id() == other_sans_face->id());
+    CHECK(sans_face->id() == mapnik::freetype_engine::face_id(sans, 0));
+    CHECK(sans_face->id() != mapnik::freetype_engine::face_id(sans, 1));
+}
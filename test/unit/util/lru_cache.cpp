@@ -0,0 +1,54 @@
+#include "catch.hpp"
+
+#include <mapnik/util/lru_cache.hpp>
+
+#include <string>
+
+TEST_CASE("sharded_lru_cache") {
+
+SECTION("disabled by default") {
+
+    mapnik::util::sharded_lru_cache<std::string, int> cache;
+    cache.insert("a", 1, 1);
+    int value = 0;
+    CHECK(!cache.find("a", value));
+    CHECK(cache.stats().entries == 0);
+}
+
+SECTION("evicts least recently used") {
+
+    // single shard so the eviction order is deterministic
+    mapnik::util::sharded_lru_cache<int, int> cache(3, 1);
+    cache.insert(1, 10, 1);
+    cache.insert(2, 20, 1);
+    cache.insert(3, 30, 1);
+    int value = 0;
+    REQUIRE(cache.find(1, value));
+    CHECK(value == 10);
+    cache.insert(4, 40, 1);
+    CHECK(!cache.find(2, value));
+    CHECK(cache.find(1, value));
+    CHECK(cache.find(3, value));
+    CHECK(cache.find(4, value));
+
+    auto stats = cache.stats();
+    CHECK(stats.hits == 4);
+    CHECK(stats.misses == 1);
+    CHECK(stats.evictions == 1);
+    CHECK(stats.entries == 3);
+    CHECK(stats.cost == 3);
+}
+
+SECTION("entries over capacity are not cached") {
+
+    mapnik::util::sharded_lru_cache<int, int> cache(4, 2);
+    cache.insert(1, 10, 3);
+    int value = 0;
+    CHECK(!cache.find(1, value));
+    cache.insert(1, 10, 2);
+    CHECK(cache.find(1, value));
+    cache.set_capacity(0);
+    CHECK(cache.stats().entries == 0);
+}
+
+}
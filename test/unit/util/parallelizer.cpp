@@ -5,8 +5,11 @@
 #include <mapnik/image_util.hpp>
 #include <mapnik/agg_renderer.hpp>
 #include <mapnik/image_scaling.hpp>
+#include <mapnik/util/thread_pool.hpp>
 
+#include <future>
 #include <istream>
+#include <vector>
 
 static void test_scale_denom(double scale_denom, bool should_pass)
 {
@@ -130,4 +133,143 @@ SECTION("layer with scale factor") {
     test_scale_denom(100000, false);
 }
 
+SECTION("premerge of src-over layers") {
+
+    mapnik::Map map(400, 400);
+    mapnik::load_map(map, "test/data/good_maps/parallelization-1.xml");
+    map.zoom_all();
+    map.get_extra_parameters()["parallel-premerge"] = true;
+
+    REQUIRE(mapnik::parallelizer::is_parallelizable(map));
+
+    mapnik::image_rgba8 parallel_img(map.width(), map.height());
+
+    const double scale_factor = 1;
+    const double scale_denom = 0;
+    mapnik::parallelizer::render(map, parallel_img, scale_denom, scale_factor);
+
+    mapnik::image_rgba8 img(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, img, scale_factor);
+    ren.apply();
+
+    // Merging layers before compositing them into the map image
+    // may differ in rounding of semi-transparent pixels
+    CHECK(parallel_img.painted() == img.painted());
+    CHECK(mapnik::compare(parallel_img, img, 1) == 0);
+}
+
+SECTION("render called from a worker of the pool") {
+
+    mapnik::Map map(400, 400);
+    mapnik::load_map(map, "test/data/good_maps/parallelization-1.xml");
+    map.zoom_all();
+
+    REQUIRE(mapnik::parallelizer::is_parallelizable(map));
+
+    mapnik::util::thread_pool & pool = mapnik::util::global_thread_pool::instance();
+    std::vector<mapnik::image_rgba8> parallel_imgs;
+    for (unsigned i = 0; i < pool.size() + 1; ++i)
+    {
+        parallel_imgs.emplace_back(map.width(), map.height());
+    }
+
+    // Every worker blocks in render, the layer jobs are queued behind them
+    std::vector<std::future<void>> renders;
+    for (auto & parallel_img : parallel_imgs)
+    {
+        renders.emplace_back(pool.submit([&map, &parallel_img] {
+            mapnik::parallelizer::render(map, parallel_img, 0, 1);
+        }));
+    }
+    for (auto & render : renders)
+    {
+        pool.get(render);
+    }
+
+    mapnik::image_rgba8 img(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, img, 1);
+    ren.apply();
+
+    for (auto const& parallel_img : parallel_imgs)
+    {
+        CHECK(parallel_img.painted() == img.painted());
+        CHECK(mapnik::compare(parallel_img, img) == 0);
+    }
+}
+
+SECTION("labels in layer order") {
+
+    const std::string map_style = R"STYLE(
+<Map background-color="white">
+    <Parameters>
+        <Parameter name="parallel" type="boolean">true</Parameter>
+        <Parameter name="parallel-labels" type="boolean">true</Parameter>
+    </Parameters>
+    <Style name="text">
+        <Rule>
+            <TextSymbolizer placement="point" face-name="DejaVu Sans Book" size="20">
+                [name]
+            </TextSymbolizer>
+        </Rule>
+    </Style>
+    <Style name="point">
+        <Rule>
+            <MarkersSymbolizer width="30" height="30" fill="red" />
+        </Rule>
+    </Style>
+    <Layer name="first">
+        <StyleName>text</StyleName>
+        <Datasource>
+            <Parameter name="type">csv</Parameter>
+            <Parameter name="inline">
+            x, y, name
+            0, 0, First
+            </Parameter>
+        </Datasource>
+    </Layer>
+    <Layer name="geometry">
+        <StyleName>point</StyleName>
+        <Datasource>
+            <Parameter name="type">csv</Parameter>
+            <Parameter name="inline">
+            x, y
+            0.5, 0.5
+            </Parameter>
+        </Datasource>
+    </Layer>
+    <Layer name="second">
+        <StyleName>text</StyleName>
+        <Datasource>
+            <Parameter name="type">csv</Parameter>
+            <Parameter name="inline">
+            x, y, name
+            0, 0, Second
+            0.8, -0.8, Third
+            </Parameter>
+        </Datasource>
+    </Layer>
+</Map>
+    )STYLE";
+
+    mapnik::Map map(256, 256);
+    mapnik::load_map_string(map, map_style);
+    REQUIRE(map.register_fonts("fonts", true));
+    map.zoom_to_box(mapnik::box2d<double>(-1, -1, 1, 1));
+
+    REQUIRE(mapnik::parallelizer::is_parallelizable(map));
+
+    mapnik::image_rgba8 parallel_img(map.width(), map.height());
+
+    const double scale_factor = 1;
+    const double scale_denom = 0;
+    mapnik::parallelizer::render(map, parallel_img, scale_denom, scale_factor);
+
+    mapnik::image_rgba8 img(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, img, scale_factor);
+    ren.apply();
+
+    CHECK(parallel_img.painted() == img.painted());
+    CHECK(mapnik::compare(parallel_img, img) == 0);
+}
+
 }
@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include <mapnik/util/thread_pool.hpp>
+#include <mapnik/util/parallelize.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("thread_pool") {
+
+SECTION("runs submitted tasks") {
+
+    mapnik::util::thread_pool pool(4);
+    CHECK(pool.size() == 4);
+
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 100; ++i)
+    {
+        futures.emplace_back(pool.submit([](int v) { return v * 2; }, i));
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        CHECK(pool.get(futures[i]) == i * 2);
+    }
+    CHECK(pool.queue_depth() == 0);
+}
+
+SECTION("propagates exceptions") {
+
+    mapnik::util::thread_pool pool(2);
+    std::future<void> f = pool.submit([] { throw std::runtime_error("job failed"); });
+    REQUIRE_THROWS(pool.get(f));
+}
+
+SECTION("nested tasks do not deadlock") {
+
+    mapnik::util::thread_pool pool(1);
+    std::future<int> outer = pool.submit([&pool] {
+        std::future<int> inner = pool.submit([] { return 21; });
+        return pool.get(inner) * 2;
+    });
+    CHECK(pool.get(outer) == 42);
+}
+
+SECTION("parallelize visits every item once") {
+
+    const unsigned size = 1000;
+    std::vector<std::atomic<int>> visits(size);
+    for (auto & v : visits)
+    {
+        v = 0;
+    }
+    mapnik::util::parallelize([&visits](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i)
+        {
+            ++visits[i];
+        }
+    }, 7, size);
+
+    bool all_once = true;
+    for (auto const& v : visits)
+    {
+        all_once = all_once && v == 1;
+    }
+    CHECK(all_once);
+}
+
+}
@@ -0,0 +1,121 @@
+#include "catch.hpp"
+#include "fake_path.hpp"
+
+// mapnik
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/transform_path_adapter.hpp>
+#include <mapnik/view_transform.hpp>
+
+// stl
+#include <tuple>
+#include <vector>
+
+TEST_CASE("transform path adapter") {
+
+SECTION("batched reprojection matches reprojection of single vertices") {
+
+    std::vector<double> coords;
+    for (int i = 0; i < 150; ++i)
+    {
+        coords.push_back(-170.0 + i * 2.25);
+        coords.push_back(-80.0 + (i % 17) * 9.5);
+    }
+    fake_path path(coords);
+    // closed rings within and across batches
+    std::get<2>(path.vertices_[70]) = mapnik::SEG_MOVETO;
+    path.vertices_.insert(path.vertices_.begin() + 70, std::make_tuple(0.0, 0.0, unsigned(mapnik::SEG_CLOSE)));
+    path.vertices_.insert(path.vertices_.begin() + 64, std::make_tuple(0.0, 0.0, unsigned(mapnik::SEG_CLOSE)));
+    path.vertices_.push_back(std::make_tuple(0.0, 0.0, unsigned(mapnik::SEG_CLOSE)));
+    path.rewind(0);
+
+    mapnik::projection source("+init=epsg:3857");
+    mapnik::projection dest("+init=epsg:4326");
+    mapnik::proj_transform prj_trans(source, dest);
+    mapnik::view_transform tr(256, 256, mapnik::box2d<double>(-2e7, -2e7, 2e7, 2e7));
+
+    mapnik::transform_path_adapter<mapnik::view_transform, fake_path> adapter(tr, path, prj_trans);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        adapter.rewind(0);
+        std::size_t count = 0;
+        for (auto const& v : path.vertices_)
+        {
+            double x, y;
+            unsigned cmd = adapter.vertex(&x, &y);
+            REQUIRE(cmd == std::get<2>(v));
+            if (cmd != mapnik::SEG_CLOSE)
+            {
+                double ex = std::get<0>(v);
+                double ey = std::get<1>(v);
+                double z = 0;
+                REQUIRE(prj_trans.backward(ex, ey, z));
+                tr.forward(&ex, &ey);
+                CHECK(x == ex);
+                CHECK(y == ey);
+            }
+            ++count;
+        }
+        double x, y;
+        CHECK(adapter.vertex(&x, &y) == mapnik::SEG_END);
+        CHECK(adapter.vertex(&x, &y) == mapnik::SEG_END);
+        CHECK(count == 153);
+    }
+}
+
+#ifdef MAPNIK_USE_PROJ4
+SECTION("vertices which can't be reprojected are skipped") {
+
+    // orthographic projection only shows the hemisphere around lon_0
+    mapnik::projection source("+proj=ortho +lat_0=0 +lon_0=0 +ellps=WGS84 +units=m +no_defs");
+    mapnik::projection dest("+proj=longlat +ellps=WGS84 +no_defs");
+    mapnik::proj_transform prj_trans(source, dest);
+    REQUIRE(!prj_trans.equal());
+    mapnik::view_transform tr(256, 256, mapnik::box2d<double>(-7e6, -7e6, 7e6, 7e6));
+
+    std::vector<double> coords;
+    for (int i = 0; i < 150; ++i)
+    {
+        // runs of 40 visible vertices followed by 10 on the far side
+        coords.push_back(i % 50 < 40 ? -60.0 + (i % 50) * 3.0 : 150.0);
+        coords.push_back((i % 7) * 5.0);
+    }
+    fake_path path(coords);
+
+    mapnik::transform_path_adapter<mapnik::view_transform, fake_path> adapter(tr, path, prj_trans);
+    adapter.rewind(0);
+    bool skipped = false;
+    std::size_t move_to_count = 0;
+    for (auto const& v : path.vertices_)
+    {
+        double ex = std::get<0>(v);
+        double ey = std::get<1>(v);
+        double z = 0;
+        if (!prj_trans.backward(ex, ey, z))
+        {
+            skipped = true;
+            continue;
+        }
+        unsigned expected_cmd = std::get<2>(v);
+        if (skipped && expected_cmd == mapnik::SEG_LINETO)
+        {
+            expected_cmd = mapnik::SEG_MOVETO;
+        }
+        skipped = false;
+        tr.forward(&ex, &ey);
+
+        double x, y;
+        unsigned cmd = adapter.vertex(&x, &y);
+        REQUIRE(cmd == expected_cmd);
+        CHECK(x == Approx(ex));
+        CHECK(y == Approx(ey));
+        if (cmd == mapnik::SEG_MOVETO) ++move_to_count;
+    }
+    double x, y;
+    CHECK(adapter.vertex(&x, &y) == mapnik::SEG_END);
+    // the first vertex and the first visible vertex of each following run
+    CHECK(move_to_count == 3);
+}
+#endif
+
+}
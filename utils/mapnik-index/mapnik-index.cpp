@@ -27,6 +27,7 @@
 
 #include <mapnik/util/fs.hpp>
 #include <mapnik/quad_tree.hpp>
+#include <mapnik/packed_hilbert_tree.hpp>
 
 #include "process_csv_file.hpp"
 #include "process_geojson_file.hpp"
@@ -62,6 +63,7 @@ int main (int argc, char** argv)
     namespace po = boost::program_options;
     bool verbose = false;
     bool validate_features = false;
+    bool packed = false;
     unsigned int depth = DEFAULT_DEPTH;
     double ratio = DEFAULT_RATIO;
     std::vector<std::string> files;
@@ -82,6 +84,7 @@ int main (int argc, char** argv)
             ("manual-headers,H", po::value<std::string>(), "CSV manual headers string")
             ("files",po::value<std::vector<std::string> >(),"Files to index: file1 file2 ...fileN")
             ("validate-features", "Validate GeoJSON features")
+            ("packed,p", "write packed Hilbert R-tree index (default: quadtree)")
             ;
 
         po::positional_options_description p;
@@ -108,6 +111,10 @@ int main (int argc, char** argv)
         {
             validate_features = true;
         }
+        if (vm.count("packed"))
+        {
+            packed = true;
+        }
         if (vm.count("depth"))
         {
             depth = vm["depth"].as<unsigned int>();
@@ -204,10 +211,13 @@ int main (int argc, char** argv)
             std::clog << extent << std::endl;
             mapnik::box2d<double> extent_d(extent.minx(), extent.miny(), extent.maxx(), extent.maxy());
             mapnik::quad_tree<std::pair<std::size_t, std::size_t>> tree(extent_d, depth, ratio);
+            mapnik::packed_hilbert_tree<std::pair<std::size_t, std::size_t>> packed_tree;
             for (auto const& item : boxes)
             {
                 auto ext_f = std::get<0>(item);
-                tree.insert(std::get<1>(item), mapnik::box2d<double>(ext_f.minx(), ext_f.miny(), ext_f.maxx(), ext_f.maxy()));
+                mapnik::box2d<double> item_ext(ext_f.minx(), ext_f.miny(), ext_f.maxx(), ext_f.maxy());
+                if (packed) packed_tree.insert(std::get<1>(item), item_ext);
+                else tree.insert(std::get<1>(item), item_ext);
             }
 
             std::fstream file((filename + ".index").c_str(),
@@ -219,11 +229,20 @@ int main (int argc, char** argv)
             }
             else
             {
-                tree.trim();
-                std::clog <<  "number nodes=" << tree.count() << std::endl;
-                std::clog <<  "number element=" << tree.count_items() << std::endl;
                 file.exceptions(std::ios::failbit | std::ios::badbit);
-                tree.write(file);
+                if (packed)
+                {
+                    std::clog <<  "number nodes=" << packed_tree.count() << std::endl;
+                    std::clog <<  "number element=" << packed_tree.count_items() << std::endl;
+                    packed_tree.write(file);
+                }
+                else
+                {
+                    tree.trim();
+                    std::clog <<  "number nodes=" << tree.count() << std::endl;
+                    std::clog <<  "number element=" << tree.count_items() << std::endl;
+                    tree.write(file);
+                }
                 file.flush();
                 file.close();
             }
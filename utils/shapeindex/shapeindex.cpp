@@ -26,6 +26,7 @@
 #include <string>
 #include <mapnik/util/fs.hpp>
 #include <mapnik/quad_tree.hpp>
+#include <mapnik/packed_hilbert_tree.hpp>
 #include <mapnik/geometry_envelope.hpp>
 #include "shapefile.hpp"
 #include "shape_io.hpp"
@@ -46,6 +47,7 @@ int main (int argc,char** argv)
 
     bool verbose=false;
     bool index_parts = false;
+    bool packed = false;
     unsigned int depth = DEFAULT_DEPTH;
     double ratio = DEFAULT_RATIO;
     std::vector<std::string> shape_files;
@@ -57,6 +59,7 @@ int main (int argc,char** argv)
             ("help,h", "produce usage message")
             ("version,V","print version string")
             ("index-parts","index individual shape parts (default: no)")
+            ("packed,p","write packed Hilbert R-tree index (default: quadtree)")
             ("verbose,v","verbose output")
             ("depth,d", po::value<unsigned int>(), "max tree depth\n(default 8)")
             ("ratio,r",po::value<double>(),"split ratio (default 0.55)")
@@ -88,6 +91,10 @@ int main (int argc,char** argv)
         {
             index_parts = true;
         }
+        if (vm.count("packed"))
+        {
+            packed = true;
+        }
         if (vm.count("depth"))
         {
             depth = vm["depth"].as<unsigned int>();
@@ -172,6 +179,12 @@ int main (int argc,char** argv)
         int pos = 50;
         shx.seek(pos * 2);
         mapnik::quad_tree<mapnik::detail::node> tree(extent, depth, ratio);
+        mapnik::packed_hilbert_tree<mapnik::detail::node> packed_tree;
+        auto insert = [&](mapnik::detail::node const& item, box2d<double> const& item_box)
+        {
+            if (packed) packed_tree.insert(item, item_box);
+            else tree.insert(item, item_box);
+        };
         int count = 0;
 
         if (shape_type != shape_io::shape_null)
@@ -234,7 +247,7 @@ int main (int argc,char** argv)
                             {
                                 std::clog << "record number " << record_number << " box=" << item_ext << std::endl;
                             }
-                            tree.insert(mapnik::detail::node(offset * 2, start, end),item_ext);
+                            insert(mapnik::detail::node(offset * 2, start, end),item_ext);
                             ++count;
                         }
                     }
@@ -251,7 +264,7 @@ int main (int argc,char** argv)
                     {
                         std::clog << "record number " << record_number << " box=" << item_ext << std::endl;
                     }
-                    tree.insert(mapnik::detail::node(offset * 2,-1,0),item_ext);
+                    insert(mapnik::detail::node(offset * 2,-1,0),item_ext);
                     ++count;
                 }
             }
@@ -268,10 +281,18 @@ int main (int argc,char** argv)
             }
             else
             {
-                tree.trim();
-                std::clog << " number nodes=" << tree.count() << std::endl;
                 file.exceptions(std::ios::failbit | std::ios::badbit);
-                tree.write(file);
+                if (packed)
+                {
+                    std::clog << " number nodes=" << packed_tree.count() << std::endl;
+                    packed_tree.write(file);
+                }
+                else
+                {
+                    tree.trim();
+                    std::clog << " number nodes=" << tree.count() << std::endl;
+                    tree.write(file);
+                }
                 file.flush();
                 file.close();
             }